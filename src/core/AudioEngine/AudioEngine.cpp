@@ -21,6 +21,7 @@
  */
 
 #include <core/AudioEngine/AudioEngine.h>
+#include <core/AudioEngine/TempoMap.h>
 
 #ifdef WIN32
 #    include "core/Timehelper.h"
@@ -42,6 +43,8 @@
 #include <core/Basics/InstrumentComponent.h>
 #include <core/Sampler/Sampler.h>
 #include <core/Helpers/Filesystem.h>
+#include <core/Helpers/SampleRegistry.h>
+#include <core/Helpers/VectorMath.h>
 
 #include <core/IO/AudioOutput.h>
 #include <core/IO/JackAudioDriver.h>
@@ -125,12 +128,22 @@ AudioEngine::AudioEngine()
 		, m_pLocker({nullptr, 0, nullptr})
 		, m_currentTickTime( {0,0})
 		, m_fTickMismatch( 0 )
+		, m_pTempoMap( nullptr )
+		, m_pRetiredTempoMap( nullptr )
 		, m_fLastTickIntervalEnd( -1 )
 		, m_nLastPlayingPatternsColumn( -1 )
 		, m_nFrameOffset( 0 )
 		, m_fTickOffset( 0 )
+		, m_nTempoRevision( 0 )
 {
 
+	// Pick the fastest mixing kernels supported by the CPU.
+	VectorMath::init();
+	// Notes created while processing audio are taken from a pool
+	// instead of the heap.
+	Note::createRealtimePool( Preferences::get_instance()->m_nMaxNotes );
+	
+	m_dueNotes.reserve( Preferences::get_instance()->m_nMaxNotes );
 	
 	m_pSampler = new Sampler;
 	m_pSynth = new Synth;
@@ -146,7 +159,7 @@ AudioEngine::AudioEngine()
 	QString sMetronomeFilename = Filesystem::click_file_path();
 	m_pMetronomeInstrument = std::make_shared<Instrument>( METRONOME_INSTR_ID, "metronome" );
 	
-	auto pLayer = std::make_shared<InstrumentLayer>( Sample::load( sMetronomeFilename ) );
+	auto pLayer = std::make_shared<InstrumentLayer>( SampleRegistry::load( sMetronomeFilename ) );
 	auto pCompo = std::make_shared<InstrumentComponent>( 0 );
 	pCompo->set_layer(pLayer, 0);
 	m_pMetronomeInstrument->get_components()->push_back( pCompo );
@@ -199,6 +212,10 @@ AudioEngine::~AudioEngine()
 //	delete Sequencer::get_instance();
 	delete m_pSampler;
 	delete m_pSynth;
+
+	delete m_pTempoMap.exchange( nullptr );
+	delete m_pRetiredTempoMap;
+	m_pRetiredTempoMap = nullptr;
 }
 
 Sampler* AudioEngine::getSampler() const
@@ -638,7 +655,6 @@ long long AudioEngine::computeFrameFromTick( const double fTick, double* fTickMi
 
 	const auto pHydrogen = Hydrogen::get_instance();
 	const auto pSong = pHydrogen->getSong();
-	const auto pTimeline = pHydrogen->getTimeline();
 	assert( pSong );
 
 	if ( nSampleRate == 0 ) {
@@ -661,144 +677,12 @@ long long AudioEngine::computeFrameFromTick( const double fTick, double* fTickMi
 		return 0;
 	}
 		
-	const auto tempoMarkers = pTimeline->getAllTempoMarkers();
-	
 	long long nNewFrames = 0;
-	if ( pHydrogen->isTimelineEnabled() &&
-		 ! ( tempoMarkers.size() == 1 &&
-			 pTimeline->isFirstTempoMarkerSpecial() ) ) {
-
-		double fNewTick = fTick;
-		double fRemainingTicks = fTick;
-		double fNextTick, fPassedTicks = 0;
-		double fNextTickSize;
-		double fNewFrames = 0;
-
-		int nColumns = pSong->getPatternGroupVector()->size();
-
-		while ( fRemainingTicks > 0 ) {
-		
-			for ( int ii = 1; ii <= tempoMarkers.size(); ++ii ) {
-				if ( ii == tempoMarkers.size() ||
-					 tempoMarkers[ ii ]->nColumn >= nColumns ) {
-					fNextTick = m_fSongSizeInTicks;
-				} else {
-					fNextTick =
-						static_cast<double>(pHydrogen->getTickForColumn( tempoMarkers[ ii ]->nColumn ) );
-				}
-
-				fNextTickSize =
-					AudioEngine::computeDoubleTickSize( nSampleRate,
-														tempoMarkers[ ii - 1 ]->fBpm,
-														nResolution );
-				
-				if ( fRemainingTicks > ( fNextTick - fPassedTicks ) ) {
-					// The whole segment of the timeline covered by tempo
-					// marker ii is left of the current transport position.
-					fNewFrames += ( fNextTick - fPassedTicks ) * fNextTickSize;
-
-					// DEBUGLOG( QString( "[segment] fTick: %1, fNewFrames: %2, nNextTick: %3, nRemainingTicks: %4, nPassedTicks: %5, fNextTickSize: %6, col: %7, bpm: %8, tick increment: %9, frame increment: %10" )
-					// 		  .arg( fTick, 0, 'f' )
-					// 		  .arg( fNewFrames, 0, 'f' )
-					// 		  .arg( fNextTick, 0, 'f' )
-					// 		  .arg( fRemainingTicks, 0, 'f' )
-					// 		  .arg( fPassedTicks, 0, 'f' )
-					// 		  .arg( fNextTickSize, 0, 'f' )
-					// 		  .arg( tempoMarkers[ ii - 1 ]->nColumn )
-					// 		  .arg( tempoMarkers[ ii - 1 ]->fBpm )
-					// 		  .arg( fNextTick - fPassedTicks, 0, 'f' )
-					// 		  .arg( ( fNextTick - fPassedTicks ) * fNextTickSize, 0, 'g', 30 )
-					// 		  );
-					
-					fRemainingTicks -= fNextTick - fPassedTicks;
-					
-					fPassedTicks = fNextTick;
-
-				} else {
-					// We are within this segment.
-					fNewFrames += fRemainingTicks * fNextTickSize;
-
-					nNewFrames = static_cast<long long>( std::round( fNewFrames ) );
-					if ( fRemainingTicks != ( fNextTick - fPassedTicks ) ) {
-						*fTickMismatch = ( fNewFrames - static_cast<double>( nNewFrames ) ) /
-							fNextTickSize;
-					} else {
-						// We ended at the very tick containing a
-						// tempo marker. If the mismatch is negative,
-						// we round the tick to a higher value, we
-						// need to use the tick size of the next tempo
-						// marker. For positive values, the mismatch
-						// resides on "this" side of the tempo marker.
-						double fMismatchInFrames =
-							fNewFrames - static_cast<double>( nNewFrames );
-						if ( fMismatchInFrames < 0 ) {
-							// Get the tick size of the next tempo
-							// marker.
-							if ( ii < tempoMarkers.size() ) {
-
-								fNextTickSize =
-									AudioEngine::computeDoubleTickSize( nSampleRate,
-																		tempoMarkers[ ii ]->fBpm,
-																		nResolution );
-							} else {
-								fNextTickSize =
-									AudioEngine::computeDoubleTickSize( nSampleRate,
-																		tempoMarkers[ 0 ]->fBpm,
-																		nResolution );
-							}
-						}
-						*fTickMismatch = fMismatchInFrames /
-							fNextTickSize;
-					}
-
-					// DEBUGLOG( QString( "[end] fTick: %1, fNewFrames: %2, nNewFrames: %9, fTickMismatch: %10, nNextTick: %3, nRemainingTicks: %4, nPassedTicks: %5, fNextTickSize: %6, col: %7, bpm: %8, tick increment: %11, frame increment: %12" )
-					// 		  .arg( fTick, 0, 'f' )
-					// 		  .arg( fNewFrames, 0, 'g', 30 )
-					// 		  .arg( fNextTick, 0, 'f' )
-					// 		  .arg( fRemainingTicks, 0, 'f' )
-					// 		  .arg( fPassedTicks, 0, 'f' )
-					// 		  .arg( fNextTickSize, 0, 'f' )
-					// 		  .arg( tempoMarkers[ ii - 1 ]->nColumn )
-					// 		  .arg( tempoMarkers[ ii - 1 ]->fBpm )
-					// 		  .arg( nNewFrames )
-					// 		  .arg( *fTickMismatch, 0, 'g', 30 )
-					// 		  .arg( fRemainingTicks, 0, 'f' )
-					// 		  .arg( fRemainingTicks * fNextTickSize, 0, 'g', 30 )
-					// 		  );
-
-					fRemainingTicks -= fNewTick - fPassedTicks;
-					break;
-				}
-			}
-
-			if ( fRemainingTicks != 0 ) {
-				// The provided fTick is larger than the song. But,
-				// luckily, we just calculated the song length in
-				// frames (fNewFrames).
-				int nRepetitions = std::floor(fTick / m_fSongSizeInTicks);
-				double fSongSizeInFrames = fNewFrames;
-				
-				fNewFrames *= static_cast<double>(nRepetitions);
-				fNewTick = std::fmod( fTick, m_fSongSizeInTicks );
-				fRemainingTicks = fNewTick;
-				fPassedTicks = 0;
-
-				// DEBUGLOG( QString( "[repeat] frames covered: %1, ticks covered: %2, ticks remaining: %3, nRepetitions: %4, fSongSizeInFrames: %5" )
-				// 		  .arg( fNewFrames, 0, 'g', 30 )
-				// 		  .arg( fTick - fNewTick, 0, 'g', 30 )
-				// 		  .arg( fRemainingTicks, 0, 'g', 30 )
-				// 		  .arg( nRepetitions )
-				// 		  .arg( fSongSizeInFrames, 0, 'g', 30 )
-				// 		  );
-
-				if ( std::isinf( fNewFrames ) ||
-					 static_cast<long long>(fNewFrames) >
-					 std::numeric_limits<long long>::max() ) {
-					ERRORLOG( QString( "Provided ticks [%1] are too large." ).arg( fTick ) );
-					return 0;
-				}
-			}
-		}
+	const auto pTempoMap = pHydrogen->isTimelineEnabled() ?
+		getTempoMap() : nullptr;
+	if ( pTempoMap != nullptr && ! pTempoMap->isConstant() ) {
+		nNewFrames = pTempoMap->computeFrameFromTick( fTick, fTickMismatch,
+													  nSampleRate );
 	} else {
 		
 		// No Timeline but a single tempo for the whole song.
@@ -825,7 +709,6 @@ double AudioEngine::computeTickFromFrame( const long long nFrame, int nSampleRat
 	}
 	
 	const auto pSong = pHydrogen->getSong();
-	const auto pTimeline = pHydrogen->getTimeline();
 	assert( pSong );
 
 	if ( nSampleRate == 0 ) {
@@ -848,122 +731,10 @@ double AudioEngine::computeTickFromFrame( const long long nFrame, int nSampleRat
 		return fTick;
 	}
 		
-	const auto tempoMarkers = pTimeline->getAllTempoMarkers();
-	
-	if ( pHydrogen->isTimelineEnabled() &&
-		 ! ( tempoMarkers.size() == 1 &&
-			 pTimeline->isFirstTempoMarkerSpecial() ) ) {
-
-		// We are using double precision in here to avoid rounding
-		// errors.
-		double fTargetFrames = static_cast<double>(nFrame);
-		double fPassedFrames = 0;
-		double fNextFrames = 0;
-		double fNextTicks, fPassedTicks = 0;
-		double fNextTickSize;
-		long long nRemainingFrames;
-
-		int nColumns = pSong->getPatternGroupVector()->size();
-
-		while ( fPassedFrames < fTargetFrames ) {
-		
-			for ( int ii = 1; ii <= tempoMarkers.size(); ++ii ) {
-
-				fNextTickSize =
-					AudioEngine::computeDoubleTickSize( nSampleRate,
-														tempoMarkers[ ii - 1 ]->fBpm,
-														nResolution );
-				if ( ii == tempoMarkers.size() ||
-					 tempoMarkers[ ii ]->nColumn >= nColumns ) {
-					fNextTicks = m_fSongSizeInTicks;
-				} else {
-					fNextTicks =
-						static_cast<double>(pHydrogen->getTickForColumn( tempoMarkers[ ii ]->nColumn ));
-				}
-				fNextFrames = (fNextTicks - fPassedTicks) * fNextTickSize;
-		
-				if ( fNextFrames < ( fTargetFrames -
-									 fPassedFrames ) ) {
-
-					// DEBUGLOG(QString( "[segment] nFrame: %1, fTick: %11, sampleRate: %2, tickSize: %3, nNextTicks: %5, fNextFrames: %6, col: %7, bpm: %8, nPassedTicks: %9, fPassedFrames: %10, tick increment: %12, frame increment: %13" )
-					// 		 .arg( nFrame )
-					// 		 .arg( nSampleRate )
-					// 		 .arg( fNextTickSize, 0, 'f' )
-					// 		 .arg( fNextTicks, 0, 'f' )
-					// 		 .arg( fNextFrames, 0, 'f' )
-					// 		 .arg( tempoMarkers[ ii -1 ]->nColumn )
-					// 		 .arg( tempoMarkers[ ii -1 ]->fBpm )
-					// 		 .arg( fPassedTicks, 0, 'f' )
-					// 		 .arg( fPassedFrames, 0, 'f' )
-					// 		 .arg( fTick, 0, 'f' )
-					// 		 .arg( fNextTicks - fPassedTicks, 0, 'f' )
-					// 		 .arg( (fNextTicks - fPassedTicks) * fNextTickSize, 0, 'g', 30 )
-					// 		 );
-					
-					// The whole segment of the timeline covered by tempo
-					// marker ii is left of the transport position.
-					fTick += fNextTicks - fPassedTicks;
-
-					fPassedFrames += fNextFrames;
-					fPassedTicks = fNextTicks;
-
-				} else {
-					// We are within this segment.
-					// We use a floor in here because only integers
-					// frames are supported.
-					double fNewTick = (fTargetFrames - fPassedFrames ) /
-						fNextTickSize;
-
-					fTick += fNewTick;
-											
-					fPassedFrames = fTargetFrames;
-					
-					// DEBUGLOG(QString( "[end] nFrame: %1, fTick: %11, sampleRate: %2, tickSize: %3, nNextTicks: %5, fNextFrames: %6, col: %7, bpm: %8, nPassedTicks: %9, fPassedFrames: %10, tick increment: %12, frame increment: %13" )
-					// 		 .arg( nFrame )
-					// 		 .arg( nSampleRate )
-					// 		 .arg( fNextTickSize, 0, 'f' )
-					// 		 .arg( fNextTicks, 0, 'f' )
-					// 		 .arg( fNextFrames, 0, 'f' )
-					// 		 .arg( tempoMarkers[ ii -1 ]->nColumn )
-					// 		 .arg( tempoMarkers[ ii -1 ]->fBpm )
-					// 		 .arg( fPassedTicks, 0, 'f' )
-					// 		 .arg( fPassedFrames, 0, 'f' )
-					// 		 .arg( fTick, 0, 'f' )
-					// 		 .arg( fNewTick, 0, 'f' )
-					// 		 .arg( fNewTick * fNextTickSize, 0, 'g', 30 )
-					// 		 );
-					
-					break;
-				}
-			}
-
-			if ( fPassedFrames != fTargetFrames ) {
-				// The provided nFrame is larger than the song. But,
-				// luckily, we just calculated the song length in
-				// frames.
-				double fSongSizeInFrames = fPassedFrames;
-				int nRepetitions = std::floor(fTargetFrames / fSongSizeInFrames);
-				if ( m_fSongSizeInTicks * nRepetitions >
-					 std::numeric_limits<double>::max() ) {
-					ERRORLOG( QString( "Provided frames [%1] are too large." ).arg( nFrame ) );
-					return 0;
-				}
-				fTick = m_fSongSizeInTicks * nRepetitions;
-
-				fPassedFrames = static_cast<double>(nRepetitions) *
-					fSongSizeInFrames;
-				fPassedTicks = 0;
-
-				// DEBUGLOG( QString( "[repeat] frames covered: %1, frames remaining: %2, ticks covered: %3,  nRepetitions: %4, fSongSizeInFrames: %5" )
-				// 		  .arg( fPassedFrames, 0, 'g', 30 )
-				// 		  .arg( fTargetFrames - fPassedFrames, 0, 'g', 30 )
-				// 		  .arg( fTick, 0, 'g', 30 )
-				// 		  .arg( nRepetitions )
-				// 		  .arg( fSongSizeInFrames, 0, 'g', 30 )
-				// 		  );
-				
-			}
-		}
+	const auto pTempoMap = pHydrogen->isTimelineEnabled() ?
+		getTempoMap() : nullptr;
+	if ( pTempoMap != nullptr && ! pTempoMap->isConstant() ) {
+		fTick = pTempoMap->computeTickFromFrame( nFrame, nSampleRate );
 	} else {
 	
 		// No Timeline. Constant tempo/tick size for the whole song.
@@ -977,6 +748,39 @@ double AudioEngine::computeTickFromFrame( const long long nFrame, int nSampleRat
 	return fTick;
 }
 
+void AudioEngine::updateTempoMap() {
+	auto pHydrogen = Hydrogen::get_instance();
+
+	int nSampleRate = 0;
+	if ( pHydrogen->getAudioOutput() != nullptr ) {
+		nSampleRate = pHydrogen->getAudioOutput()->getSampleRate();
+	}
+
+	const TempoMap* pTempoMap =
+		new TempoMap( pHydrogen->getSong(), pHydrogen->getTimeline(),
+					  nSampleRate, m_fSongSizeInTicks );
+
+	// The audio thread only reads the map while processing a single
+	// cycle. The one retired during the previous call is not in use
+	// anymore and can be freed in here instead of in a realtime
+	// thread.
+	delete m_pRetiredTempoMap;
+	m_pRetiredTempoMap = m_pTempoMap.exchange( pTempoMap, std::memory_order_acq_rel );
+}
+
+const TempoMap* AudioEngine::getTempoMap() const {
+	const TempoMap* pTempoMap = m_pTempoMap.load( std::memory_order_acquire );
+
+	const auto pSong = Hydrogen::get_instance()->getSong();
+	if ( pTempoMap == nullptr || pSong == nullptr ||
+		 ! pTempoMap->matches( pSong->getResolution(), m_fSongSizeInTicks ) ) {
+		ERRORLOG( "Tempo map is outdated. updateTempoMap() was not called after a change of the song. Falling back to constant tempo." );
+		return nullptr;
+	}
+
+	return pTempoMap;
+}
+
 void AudioEngine::clearAudioBuffers( uint32_t nFrames )
 {
 	QMutexLocker mx( &m_MutexOutputPointer );
@@ -1214,6 +1018,9 @@ void AudioEngine::setAudioDriver( AudioOutput* pAudioDriver ) {
 	}
 
 	handleDriverChange();
+
+	// The sample rate might have changed.
+	pHydrogen->updateSampleRates();
 }
 
 void AudioEngine::stopAudioDrivers()
@@ -1368,89 +1175,106 @@ void AudioEngine::processPlayNotes( unsigned long nframes )
 		nFrames = getRealtimeFrames();
 	}
 
-	// reading from m_songNoteQueue
-	while ( !m_songNoteQueue.empty() ) {
-		Note *pNote = m_songNoteQueue.top();
-		long long nNoteStartInFrames = pNote->getNoteStart();
+	const long long nBufferEnd = nFrames + static_cast<long long>(nframes);
+
+	// The notes in m_songNoteQueue are ordered by their position in
+	// ticks. Their start in frames is only computed once they enter
+	// the current buffer window (or recomputed in case the tempo
+	// changed in the meantime). Since a note might be shifted by a
+	// negative humanization delay, all notes positioned before the
+	// end of the buffer plus the maximum delay have to be
+	// considered.
+	const long long nPositionEnd = static_cast<long long>(
+		std::floor( computeTickFromFrame( nBufferEnd +
+										  AudioEngine::nMaxTimeHumanize ) ) ) + 1;
+
+	m_dueNotes.clear();
+	m_songNoteQueue.extract( nPositionEnd, [&]( Note* pNote ) {
+		return pNote->updateNoteStart() < nBufferEnd;
+	}, m_dueNotes );
+
+	// Play back the due notes in the order of their start. They are
+	// almost sorted already and the insertion sort does not allocate
+	// memory.
+	for ( auto it = m_dueNotes.begin(); it != m_dueNotes.end(); ++it ) {
+		std::rotate( std::upper_bound( m_dueNotes.begin(), it, *it,
+									   []( Note* pNote1, Note* pNote2 ) {
+										   return pNote1->getNoteStart() <
+											   pNote2->getNoteStart();
+									   } ),
+					 it, it + 1 );
+	}
+
+	for ( auto pNote : m_dueNotes ) {
 
 		// DEBUGLOG( QString( "getDoubleTick(): %1, getFrames(): %2, nframes: %3, " )
 		// 		  .arg( getDoubleTick() ).arg( getFrames() )
 		// 		  .arg( nframes ).append( pNote->toQString( "", true ) ) );
 
-		if ( nNoteStartInFrames <
-			 nFrames + static_cast<long long>(nframes) ) {
-			/* Check if the current note has probability != 1
-			 * If yes remove call random function to dequeue or not the note
-			 */
-			float fNoteProbability = pNote->get_probability();
-			if ( fNoteProbability != 1. ) {
-				if ( fNoteProbability < (float) rand() / (float) RAND_MAX ) {
-					m_songNoteQueue.pop();
-					pNote->get_instrument()->dequeue();
-					continue;
-				}
+		/* Check if the current note has probability != 1
+		 * If yes remove call random function to dequeue or not the note
+		 */
+		float fNoteProbability = pNote->get_probability();
+		if ( fNoteProbability != 1. ) {
+			if ( fNoteProbability < (float) rand() / (float) RAND_MAX ) {
+				pNote->get_instrument()->dequeue();
+				continue;
 			}
+		}
 
-			if ( pSong->getHumanizeVelocityValue() != 0 ) {
-				float random = pSong->getHumanizeVelocityValue() * getGaussian( 0.2 );
-				pNote->set_velocity(
-							pNote->get_velocity()
-							+ ( random
-								- ( pSong->getHumanizeVelocityValue() / 2.0 ) )
-							);
-				if ( pNote->get_velocity() > 1.0 ) {
-					pNote->set_velocity( 1.0 );
-				} else if ( pNote->get_velocity() < 0.0 ) {
-					pNote->set_velocity( 0.0 );
-				}
+		if ( pSong->getHumanizeVelocityValue() != 0 ) {
+			float random = pSong->getHumanizeVelocityValue() * getGaussian( 0.2 );
+			pNote->set_velocity(
+						pNote->get_velocity()
+						+ ( random
+							- ( pSong->getHumanizeVelocityValue() / 2.0 ) )
+						);
+			if ( pNote->get_velocity() > 1.0 ) {
+				pNote->set_velocity( 1.0 );
+			} else if ( pNote->get_velocity() < 0.0 ) {
+				pNote->set_velocity( 0.0 );
 			}
+		}
 
-			// Offset + Random Pitch ;)
-			float fPitch = pNote->get_pitch() + pNote->get_instrument()->get_pitch_offset();
-			/* Check if the current instrument has random pitch factor != 0.
-			 * If yes add a gaussian perturbation to the pitch
-			 */
-			float fRandomPitchFactor = pNote->get_instrument()->get_random_pitch_factor();
-			if ( fRandomPitchFactor != 0. ) {
-				fPitch += getGaussian( 0.4 ) * fRandomPitchFactor;
-			}
-			pNote->set_pitch( fPitch );
-
-			/*
-			 * Check if the current instrument has the property "Stop-Note" set.
-			 * If yes, a NoteOff note is generated automatically after each note.
-			 */
-			auto  noteInstrument = pNote->get_instrument();
-			if ( noteInstrument->is_stop_notes() ){
-				Note *pOffNote = new Note( noteInstrument,
-										   0.0,
-										   0.0,
-										   0.0,
-										   -1,
-										   0 );
-				pOffNote->set_note_off( true );
-				pHydrogen->getAudioEngine()->getSampler()->noteOn( pOffNote );
-				delete pOffNote;
-			}
+		// Offset + Random Pitch ;)
+		float fPitch = pNote->get_pitch() + pNote->get_instrument()->get_pitch_offset();
+		/* Check if the current instrument has random pitch factor != 0.
+		 * If yes add a gaussian perturbation to the pitch
+		 */
+		float fRandomPitchFactor = pNote->get_instrument()->get_random_pitch_factor();
+		if ( fRandomPitchFactor != 0. ) {
+			fPitch += getGaussian( 0.4 ) * fRandomPitchFactor;
+		}
+		pNote->set_pitch( fPitch );
 
-			m_pSampler->noteOn( pNote );
-			m_songNoteQueue.pop(); // rimuovo la nota dalla lista di note
-			pNote->get_instrument()->dequeue();
-			// raise noteOn event
-			int nInstrument = pSong->getInstrumentList()->index( pNote->get_instrument() );
-			if( pNote->get_note_off() ){
-				delete pNote;
-			}
+		/*
+		 * Check if the current instrument has the property "Stop-Note" set.
+		 * If yes, a NoteOff note is generated automatically after each note.
+		 */
+		auto  noteInstrument = pNote->get_instrument();
+		if ( noteInstrument->is_stop_notes() ){
+			Note *pOffNote = new ( Note::realtime ) Note( noteInstrument,
+									   0.0,
+									   0.0,
+									   0.0,
+									   -1,
+									   0 );
+			pOffNote->set_note_off( true );
+			pHydrogen->getAudioEngine()->getSampler()->noteOn( pOffNote );
+			delete pOffNote;
+		}
 
-			// Check whether the instrument could be found.
-			if ( nInstrument != -1 ) {
-				m_pEventQueue->push_event( EVENT_NOTEON, nInstrument );
-			}
-			
-			continue;
-		} else {
-			// this note will not be played
-			break;
+		m_pSampler->noteOn( pNote );
+		pNote->get_instrument()->dequeue();
+		// raise noteOn event
+		int nInstrument = pSong->getInstrumentList()->index( pNote->get_instrument() );
+		if( pNote->get_note_off() ){
+			delete pNote;
+		}
+
+		// Check whether the instrument could be found.
+		if ( nInstrument != -1 ) {
+			m_pEventQueue->push_event( EVENT_NOTEON, nInstrument );
 		}
 	}
 }
@@ -1476,6 +1300,11 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 	AudioEngine* pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
 	timeval startTimeval = currentTime2();
 
+	// The thread calling this function is owned by the audio driver
+	// and might change whenever the driver is restarted. Setting the
+	// flag is cheap, so it is done each cycle.
+	VectorMath::enableFlushToZero();
+
 	// Resetting all audio output buffers with zeros.
 	pAudioEngine->clearAudioBuffers( nframes );
 
@@ -1620,21 +1449,15 @@ void AudioEngine::processAudio( uint32_t nFrames ) {
 
 	// SAMPLER
 	getSampler()->process( nFrames, pSong );
-	float* out_L = getSampler()->m_pMainOut_L;
-	float* out_R = getSampler()->m_pMainOut_R;
-	for ( unsigned i = 0; i < nFrames; ++i ) {
-		pBuffer_L[ i ] += out_L[ i ];
-		pBuffer_R[ i ] += out_R[ i ];
-	}
+	VectorMath::addStereo( pBuffer_L, pBuffer_R,
+						   getSampler()->m_pMainOut_L,
+						   getSampler()->m_pMainOut_R, nFrames );
 
 	// SYNTH
 	getSynth()->process( nFrames );
-	out_L = getSynth()->m_pOut_L;
-	out_R = getSynth()->m_pOut_R;
-	for ( unsigned i = 0; i < nFrames; ++i ) {
-		pBuffer_L[ i ] += out_L[ i ];
-		pBuffer_R[ i ] += out_R[ i ];
-	}
+	VectorMath::addStereo( pBuffer_L, pBuffer_R,
+						   getSynth()->m_pOut_L,
+						   getSynth()->m_pOut_R, nFrames );
 
 	timeval ladspaTime_start = currentTime2();
 
@@ -1654,17 +1477,9 @@ void AudioEngine::processAudio( uint32_t nFrames ) {
 				buf_R = buf_L;
 			}
 
-			for ( unsigned i = 0; i < nFrames; ++i ) {
-				pBuffer_L[ i ] += buf_L[ i ];
-				pBuffer_R[ i ] += buf_R[ i ];
-				if ( buf_L[ i ] > m_fFXPeak_L[nFX] ) {
-					m_fFXPeak_L[nFX] = buf_L[ i ];
-				}
-
-				if ( buf_R[ i ] > m_fFXPeak_R[nFX] ) {
-					m_fFXPeak_R[nFX] = buf_R[ i ];
-				}
-			}
+			VectorMath::addStereo( pBuffer_L, pBuffer_R, buf_L, buf_R, nFrames );
+			m_fFXPeak_L[nFX] = VectorMath::peak( buf_L, nFrames, m_fFXPeak_L[nFX] );
+			m_fFXPeak_R[nFX] = VectorMath::peak( buf_R, nFrames, m_fFXPeak_R[nFX] );
 		}
 	}
 #endif
@@ -1674,32 +1489,11 @@ void AudioEngine::processAudio( uint32_t nFrames ) {
 			+ ( ladspaTime_end.tv_usec - ladspaTime_start.tv_usec ) / 1000.0;
 
 	// update master peaks
-	float val_L, val_R;
-	for ( unsigned i = 0; i < nFrames; ++i ) {
-		val_L = pBuffer_L[i];
-		val_R = pBuffer_R[i];
+	m_fMasterPeak_L = VectorMath::peak( pBuffer_L, nFrames, m_fMasterPeak_L );
+	m_fMasterPeak_R = VectorMath::peak( pBuffer_R, nFrames, m_fMasterPeak_R );
 
-		if ( val_L > m_fMasterPeak_L ) {
-			m_fMasterPeak_L = val_L;
-		}
-
-		if ( val_R > m_fMasterPeak_R ) {
-			m_fMasterPeak_R = val_R;
-		}
-
-		for (std::vector<DrumkitComponent*>::iterator it = pSong->getComponents()->begin() ; it != pSong->getComponents()->end(); ++it) {
-			DrumkitComponent* drumkit_component = *it;
-
-			float compo_val_L = drumkit_component->get_out_L(i);
-			float compo_val_R = drumkit_component->get_out_R(i);
-
-			if( compo_val_L > drumkit_component->get_peak_l() ) {
-				drumkit_component->set_peak_l( compo_val_L );
-			}
-			if( compo_val_R > drumkit_component->get_peak_r() ) {
-				drumkit_component->set_peak_r( compo_val_R );
-			}
-		}
+	for ( auto& pComponent : *pSong->getComponents() ) {
+		pComponent->update_peaks( nFrames );
 	}
 
 }
@@ -1733,8 +1527,14 @@ void AudioEngine::setSong( std::shared_ptr<Song> pNewSong )
 	}
 
 	Hydrogen::get_instance()->renameJackPorts( pNewSong );
+	pNewSong->updateColumnStartTicks();
 	m_fSongSizeInTicks = static_cast<double>( pNewSong->lengthInTicks() );
 
+	// The tempo map has to be in place before the transport
+	// position is converted using it in locate().
+	Hydrogen::get_instance()->setTimeline( pNewSong->getTimeline() );
+	updateTempoMap();
+
 	// change the current audio engine state
 	setState( State::Ready );
 
@@ -1742,8 +1542,6 @@ void AudioEngine::setSong( std::shared_ptr<Song> pNewSong )
 	// Will adapt the audio engine to the song's BPM.
 	locate( 0 );
 
-	Hydrogen::get_instance()->setTimeline( pNewSong->getTimeline() );
-
 	this->unlock();
 }
 
@@ -1784,6 +1582,7 @@ void AudioEngine::updateSongSize() {
 		return;
 	}
 
+	pSong->updateColumnStartTicks();
 	double fNewSongSizeInTicks = static_cast<double>( pSong->lengthInTicks() );
 
 	// WARNINGLOG( QString( "[Before] frame: %1, bpm: %2, tickSize: %3, column: %4, tick: %5, mod(tick): %6, pTickPos: %7, pStartPos: %8, m_fLastTickIntervalEnd: %9, m_fSongSizeInTicks: %10" )
@@ -1807,6 +1606,7 @@ void AudioEngine::updateSongSize() {
 
 	//
 	m_fSongSizeInTicks = fNewSongSizeInTicks;
+	updateTempoMap();
 
 	// Expected behavior:
 	// - changing any part of the song except of the pattern currently
@@ -2005,6 +1805,7 @@ void AudioEngine::flushAndAddNextPattern( int nPatternNumber ) {
 
 void AudioEngine::handleTimelineChange() {
 
+	updateTempoMap();
 	setFrames( computeFrameFromTick( getDoubleTick(), &m_fTickMismatch ) );
 	updateBpmAndTickSize();
 
@@ -2015,47 +1816,18 @@ void AudioEngine::handleTimelineChange() {
 		return;
 	}
 
-	// Recalculate the note start in frames for all notes currently
-	// processed by the AudioEngine.
-	if ( m_songNoteQueue.size() > 0 ) {
-		std::vector<Note*> notes;
-		for ( ; ! m_songNoteQueue.empty(); m_songNoteQueue.pop() ) {
-			notes.push_back( m_songNoteQueue.top() );
-		}
-
-		for ( auto nnote : notes ) {
-			nnote->computeNoteStart();
-			m_songNoteQueue.push( nnote );
-		}
-	}
-	
-	getSampler()->handleTimelineOrTempoChange();
+	// The note start in frames of all notes currently processed by
+	// the AudioEngine and the Sampler will be recalculated once they
+	// are required.
+	++m_nTempoRevision;
 }
 
 void AudioEngine::handleTempoChange() {
-	if ( m_songNoteQueue.size() == 0 ) {
-		return;
-	}
-
-	// All notes share the same ticksize state (or things have gone
-	// wrong at some point).
-	if ( m_songNoteQueue.top()->getUsedTickSize() !=
-		 getTickSize() ) {
-
-		std::vector<Note*> notes;
-		for ( ; ! m_songNoteQueue.empty(); m_songNoteQueue.pop() ) {
-			notes.push_back( m_songNoteQueue.top() );
-		}
-
-		// All notes share the same ticksize state (or things have gone
-		// wrong at some point).
-		for ( auto nnote : notes ) {
-			nnote->computeNoteStart();
-			m_songNoteQueue.push( nnote );
-		}
-	
-		getSampler()->handleTimelineOrTempoChange();
-	}
+	// Notes in m_songNoteQueue are ordered by their position in ticks
+	// and thus are not affected. Their start in frames as well as the
+	// one of the notes rendered by the Sampler are recalculated
+	// lazily in processPlayNotes() and Sampler::prepareNote().
+	++m_nTempoRevision;
 }
 
 void AudioEngine::handleSongSizeChange() {
@@ -2063,12 +1835,8 @@ void AudioEngine::handleSongSizeChange() {
 		return;
 	}
 
-	std::vector<Note*> notes;
-	for ( ; ! m_songNoteQueue.empty(); m_songNoteQueue.pop() ) {
-		notes.push_back( m_songNoteQueue.top() );
-	}
-
-	for ( auto nnote : notes ) {
+	const long nTickOffset = static_cast<long>(std::floor(getTickOffset()));
+	m_songNoteQueue.update( [&]( Note* nnote ) {
 
 		// DEBUGLOG( QString( "name: %1, pos: %2, new pos: %3, tick offset: %4, tick offset floored: %5" )
 		// 		  .arg( nnote->get_instrument()->get_name() )
@@ -2079,14 +1847,15 @@ void AudioEngine::handleSongSizeChange() {
 		// 		  .arg( getTickOffset() )
 		// 		  .arg( std::floor(getTickOffset()) ) );
 		
-		nnote->set_position( std::max( nnote->get_position() +
-									   static_cast<long>(std::floor(getTickOffset())),
+		nnote->set_position( std::max( nnote->get_position() + nTickOffset,
 									   static_cast<long>(0) ) );
-		nnote->computeNoteStart();
-		m_songNoteQueue.push( nnote );
-	}
+	} );
 	
 	getSampler()->handleSongSizeChange();
+
+	// The start of all shifted notes will be recalculated once it is
+	// required.
+	++m_nTempoRevision;
 }
 
 long long AudioEngine::computeTickInterval( double* fTickStart, double* fTickEnd, unsigned nFrames ) {
@@ -2232,10 +2001,19 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 	// 		  .arg( fTickStart, 0, 'f' ).arg( fTickEnd, 0, 'f' )
 	// 		  .arg( getDoubleTick(), 0, 'f' ).arg( getFrames() ) );
 
-	// We loop over integer ticks to ensure that all notes encountered
-	// between two iterations belong to the same pattern.
+	// We loop over segments of integer ticks to ensure that all notes
+	// encountered within a segment belong to the same column and
+	// pattern repetition. The notes of each playing pattern are then
+	// looked up with a single range query per segment. Segments are
+	// only split at column and pattern boundaries.
+	const long nTickEnd = static_cast<long>(std::floor(fTickEnd));
+	long nSegmentTicks;
 	for ( long nnTick = static_cast<long>(std::floor(fTickStart));
-		  nnTick < static_cast<long>(std::floor(fTickEnd)); nnTick++ ) {
+		  nnTick < nTickEnd; nnTick += nSegmentTicks ) {
+		
+		// Fallback in case the end of the current column or pattern
+		// could not be determined.
+		nSegmentTicks = 1;
 		
 		//////////////////////////////////////////////////////////////
 		// SONG MODE
@@ -2284,6 +2062,10 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 				updatePlayingPatterns( nColumn );
 				m_nLastPlayingPatternsColumn = nColumn;
 			}
+
+			// The segment ends with the column.
+			nSegmentTicks = pSong->getColumnStartTick( nColumn + 1 ) -
+				pSong->getColumnStartTick( nColumn ) - nPatternTickPosition;
 		}
 		
 		//////////////////////////////////////////////////////////////
@@ -2309,6 +2091,9 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 				}
 			}
 
+			// Stacked patterns are switched at the beginning of a
+			// pattern, which always starts a segment. Changes of the
+			// selected pattern are picked up at the next segment.
 			updatePlayingPatterns( 0, nnTick, nPatternStartTick );
 
 			if ( nPatternSize == -1 ||
@@ -2344,22 +2129,36 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 					nPatternSize;
 			}
 
+			// The segment ends with the pattern.
+			if ( nPatternSize > 0 ) {
+				nSegmentTicks = nPatternSize - nPatternTickPosition;
+			}
+
 			// DEBUGLOG( QString( "[post] nnTick: %1, nPatternTickPosition: %2, nPatternStartTick: %3, nPatternSize: %4" )
 			// 		  .arg( nnTick ).arg( nPatternTickPosition )
 			// 		  .arg( nPatternStartTick ).arg( nPatternSize ) );
 		}
+
+		nSegmentTicks = std::min( nSegmentTicks, nTickEnd - nnTick );
+		if ( nSegmentTicks < 1 || nPatternTickPosition < 0 ) {
+			nSegmentTicks = 1;
+		}
 		
 		//////////////////////////////////////////////////////////////
 		// Metronome
 		// Only trigger the metronome at a predefined rate.
-		if ( nPatternTickPosition % 48 == 0 ) {
+		for ( long nnSegmentTick = 0; nnSegmentTick < nSegmentTicks; ++nnSegmentTick ) {
+			const long nMetronomePosition = nPatternTickPosition + nnSegmentTick;
+			if ( nMetronomePosition % 48 != 0 ) {
+				continue;
+			}
 			float fPitch;
 			float fVelocity;
 			
 			// Depending on whether the metronome beat will be issued
 			// at the beginning or in the remainder of the pattern,
 			// two different sounds and events will be used.
-			if ( nPatternTickPosition == 0 ) {
+			if ( nMetronomePosition == 0 ) {
 				fPitch = 3;
 				fVelocity = 1.0;
 				EventQueue::get_instance()->push_event( EVENT_METRONOME, 1 );
@@ -2375,8 +2174,8 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 				m_pMetronomeInstrument->set_volume(
 							Preferences::get_instance()->m_fMetronomeVolume
 							);
-				Note *pMetronomeNote = new Note( m_pMetronomeInstrument,
-												 nnTick,
+				Note *pMetronomeNote = new ( Note::realtime ) Note( m_pMetronomeInstrument,
+												 nnTick + nnSegmentTick,
 												 fVelocity,
 												 0.f, // pan
 												 -1,
@@ -2392,10 +2191,11 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 		// Update the notes queue.
 		//
 		// Supporting ticks with float precision:
-		// - make FOREACH_NOTE_CST_IT_BOUND loop over all notes
-		// `(_it)->first >= (_bound) && (_it)->first < (_bound + 1)`
+		// - make FOREACH_NOTE_CST_IT_RANGE loop over all notes
+		// `(_it)->first >= (_start) && (_it)->first < (_end)` with
+		// fractional bounds
 		// - add remainder of pNote->get_position() % 1 when setting
-		// nnTick as new position.
+		// nNoteTick as new position.
 		//
 		if ( m_pPlayingPatterns->size() != 0 ) {
 			for ( unsigned nPat = 0 ;
@@ -2403,15 +2203,22 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 				  ++nPat ) {
 				Pattern *pPattern = m_pPlayingPatterns->get( nPat );
 				assert( pPattern != nullptr );
-				Pattern::notes_t* notes = (Pattern::notes_t*)pPattern->get_notes();
-
-				// Loop over all notes at tick nPatternTickPosition
-				// (associated tick is determined by Note::__position
-				// at the time of insertion into the Pattern).
-				FOREACH_NOTE_CST_IT_BOUND(notes,it,nPatternTickPosition) {
+				const Pattern::notes_t* notes = pPattern->get_notes();
+
+				// Loop over all notes within the segment (associated
+				// tick is determined by Note::__position at the time
+				// of insertion into the Pattern). Notes sharing a
+				// tick are visited in the same order as the patterns
+				// and thus pushed to the queue in the same order as
+				// when handling one tick at a time.
+				FOREACH_NOTE_CST_IT_RANGE( notes, it, nPatternTickPosition,
+										   nPatternTickPosition + nSegmentTicks ) {
 					Note *pNote = it->second;
 					if ( pNote ) {
 						pNote->set_just_recorded( false );
+
+						const long nNotePosition = it->first;
+						const long nNoteTick = nnTick + nNotePosition - nPatternTickPosition;
 						
 						/** Time Offset in frames (relative to sample rate)
 						*	Sum of 3 components: swing, humanized timing, lead_lag
@@ -2421,8 +2228,8 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 					   /** Swing 16ths //
 						* delay the upbeat 16th-notes by a constant (manual) offset
 						*/
-						if ( ( ( nPatternTickPosition % ( MAX_NOTES / 16 ) ) == 0 )
-							 && ( ( nPatternTickPosition % ( MAX_NOTES / 8 ) ) != 0 )
+						if ( ( ( nNotePosition % ( MAX_NOTES / 16 ) ) == 0 )
+							 && ( ( nNotePosition % ( MAX_NOTES / 8 ) ) != 0 )
 							 && pSong->getSwingFactor() > 0 ) {
 							/* TODO: incorporate the factor MAX_NOTES / 32. either in Song::m_fSwingFactor
 							* or make it a member variable.
@@ -2439,9 +2246,9 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 							// calculated for a particular transport
 							// position and is not generally applicable.
 							nOffset +=
-								computeFrameFromTick( nnTick + MAX_NOTES / 32., &fTickMismatch ) *
+								computeFrameFromTick( nNoteTick + MAX_NOTES / 32., &fTickMismatch ) *
 								pSong->getSwingFactor() -
-								computeFrameFromTick( nnTick, &fTickMismatch );
+								computeFrameFromTick( nNoteTick, &fTickMismatch );
 						}
 
 						/* Humanize - Time parameter //
@@ -2486,16 +2293,16 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 						// humanized delay, and tick position is
 						// expressed referring to start time (and not
 						// pattern).
-						Note *pCopiedNote = new Note( pNote );
+						Note *pCopiedNote = new ( Note::realtime ) Note( pNote );
 						pCopiedNote->set_humanize_delay( nOffset );
 
-						// DEBUGLOG( QString( "getDoubleTick(): %1, getFrames(): %2, getColumn(): %3, nnTick: %4, nColumn: %5, " )
+						// DEBUGLOG( QString( "getDoubleTick(): %1, getFrames(): %2, getColumn(): %3, nNoteTick: %4, nColumn: %5, " )
 						// 		  .arg( getDoubleTick() ).arg( getFrames() )
-						// 		  .arg( getColumn() ).arg( nnTick )
+						// 		  .arg( getColumn() ).arg( nNoteTick )
 						// 		  .arg( nColumn )
 						// 		  .append( pCopiedNote->toQString("", true ) ) );
 						
-						pCopiedNote->set_position( nnTick );
+						pCopiedNote->set_position( nNoteTick );
 						// Important: this call has to be done _after_
 						// setting the position and the humanize_delay.
 						pCopiedNote->computeNoteStart();
@@ -2532,15 +2339,6 @@ void AudioEngine::noteOn( Note *note )
 	m_midiNoteQueue.push_back( note );
 }
 
-bool AudioEngine::compare_pNotes::operator()(Note* pNote1, Note* pNote2)
-{
-	float fTickSize = Hydrogen::get_instance()->getAudioEngine()->getTickSize();
-	return (pNote1->get_humanize_delay() +
-			AudioEngine::computeFrame( pNote1->get_position(), fTickSize ) ) >
-		(pNote2->get_humanize_delay() +
-		 AudioEngine::computeFrame( pNote2->get_position(), fTickSize ) );
-}
-
 void AudioEngine::play() {
 	
 	assert( m_pAudioDriver );
@@ -3824,7 +3622,7 @@ bool AudioEngine::testCheckAudioConsistency( const std::vector<std::shared_ptr<N
 						// processing depends on the sample rate of
 						// the driver and sample and has to be
 						// adjusted in here. This is equivalent to the
-						// question whether Sampler::renderNote() or
+						// question whether Sampler::renderNoteNoResample() or
 						// Sampler::renderNoteResample() was used.
 						if ( ppOldNote->getSample( nn )->get_sample_rate() !=
 							 Hydrogen::get_instance()->getAudioOutput()->getSampleRate() ||
@@ -3909,16 +3707,10 @@ bool AudioEngine::testCheckAudioConsistency( const std::vector<std::shared_ptr<N
 }
 
 std::vector<std::shared_ptr<Note>> AudioEngine::testCopySongNoteQueue() {
-	std::vector<Note*> rawNotes;
 	std::vector<std::shared_ptr<Note>> notes;
-	for ( ; ! m_songNoteQueue.empty(); m_songNoteQueue.pop() ) {
-		rawNotes.push_back( m_songNoteQueue.top() );
-		notes.push_back( std::make_shared<Note>( m_songNoteQueue.top() ) );
-	}
-
-	for ( auto nnote : rawNotes ) {
-		m_songNoteQueue.push( nnote );
-	}
+	m_songNoteQueue.forEach( [&]( Note* pNote ) {
+		notes.push_back( std::make_shared<Note>( pNote ) );
+	} );
 
 	return notes;
 }
@@ -29,6 +29,7 @@
 #include <core/Sampler/Sampler.h>
 #include <core/Synth/Synth.h>
 #include <core/Basics/Note.h>
+#include <core/AudioEngine/NoteQueue.h>
 #include <core/AudioEngine/TransportInfo.h>
 #include <core/CoreActionController.h>
 
@@ -37,6 +38,7 @@
 #include <core/IO/DiskWriterDriver.h>
 #include <core/IO/FakeDriver.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <cassert>
@@ -68,6 +70,7 @@ namespace H2Core
 	class PatternList;
 	class Drumkit;
 	class Song;
+	class TempoMap;
 	
 /**
  * Audio Engine main class.
@@ -460,13 +463,33 @@ public:
 	 * counterpart, however, is not affected. This function ensures
 	 * they are in sync again.
 	 *
-	 * Updates all notes in #m_songNoteQueue to be still valid after a
-	 * tempo change.
+	 * Invalidates the start in frames of all notes in
+	 * #m_songNoteQueue and the #Sampler. They will be recalculated
+	 * once required.
 	 *
 	 * See handleTimelineChange().
 	 */
 	void handleTimelineChange();
 
+	/**
+	 * Compiles the tempo markers of the current #Timeline into a
+	 * new TempoMap and publishes it to the audio thread.
+	 *
+	 * Has to be called with the audio engine locked whenever the
+	 * tempo markers, the resolution, or the length of a column
+	 * changed. handleTimelineChange(), updateSongSize(), and
+	 * setSong() take care of it. The map published by the previous
+	 * call is deleted in here since the audio thread can not be
+	 * using it anymore.
+	 */
+	void updateTempoMap();
+
+	/**
+	 * \return #m_nTempoRevision. Note::getNoteStart() is only valid
+	 * if it was calculated using the current revision.
+	 */
+	int getTempoRevision() const;
+
 	/** 
 	 * Unit test checking for consistency when converting frames to
 	 * ticks and back.
@@ -555,6 +578,8 @@ public:
 	friend int FakeDriver::connect();
 	friend void JackAudioDriver::updateTransportInfo();
 	friend void JackAudioDriver::relocateUsingBBT();
+	/** Is allowed to call computeDoubleTickSize().*/
+	friend class TempoMap;
 private:
 	/**
 	 * Converts a tick into frames under the assumption of a constant
@@ -588,6 +613,12 @@ private:
 
 	double getDoubleTick() const;
 	static double computeDoubleTickSize(const int nSampleRate, const float fBpm, const int nResolution);
+	/**
+	 * \return #m_pTempoMap or nullptr in case it does not fit the
+	 * current Song. The latter is a bug and the constant tempo of
+	 * the transport has to be used instead.
+	 */
+	const TempoMap* getTempoMap() const;
 	
 	inline void			processPlayNotes( unsigned long nframes );
 
@@ -700,8 +731,10 @@ private:
 	void			updateTransportPosition( double fTick, bool bUseLoopMode );
 
 	/**
-	 * Updates all notes in #m_songNoteQueue to be still valid after a
-	 * tempo change.
+	 * Invalidates the start in frames of all notes in
+	 * #m_songNoteQueue and the #Sampler after a tempo change. Since
+	 * this only increments #m_nTempoRevision, it is O(1)
+	 * regardless of the number of notes.
 	 *
 	 * This function will only be used with the #Timeline
 	 * disabled. See handleTimelineChange().
@@ -885,13 +918,14 @@ private:
 	
 	audioProcessCallback m_AudioProcessCallback;
 	
-	/// Song Note FIFO
-	// overload the > operator of Note objects for priority_queue
-	struct compare_pNotes {
-		bool operator() (Note* pNote1, Note* pNote2);
-	};
-
-	std::priority_queue<Note*, std::deque<Note*>, compare_pNotes > m_songNoteQueue;
+	/// Song Note FIFO ordered by Note::get_position()
+	NoteQueue			m_songNoteQueue;
+	/**
+	 * Notes taken from #m_songNoteQueue in processPlayNotes() to be
+	 * played back within the current buffer. Keeps its capacity
+	 * across calls.
+	 */
+	std::vector<Note*>	m_dueNotes;
 	std::deque<Note*>	m_midiNoteQueue;	///< Midi Note FIFO
 	
 	/**
@@ -910,6 +944,24 @@ private:
 	/** Number of frames TransportInfo::m_nFrames is ahead of
 		TransportInfo::m_nTick. */
 	double m_fTickMismatch;
+	/**
+	 * Compiled tempo markers used by computeFrameFromTick() and
+	 * computeTickFromFrame() with the #Timeline enabled. Replaced
+	 * by updateTempoMap() while the audio thread might read it.
+	 */
+	std::atomic<const TempoMap*> m_pTempoMap;
+	/**
+	 * Map replaced during the last call to updateTempoMap(). It is
+	 * kept alive until the next one since the audio thread might
+	 * still have been using it.
+	 */
+	const TempoMap* m_pRetiredTempoMap;
+	/**
+	 * Incremented whenever the mapping of ticks onto frames changes
+	 * and thus the start of all notes has to be recalculated. See
+	 * Note::updateNoteStart().
+	 */
+	int m_nTempoRevision;
 	double m_fTickOffset;
 	long long m_nFrameOffset;
 	double m_fLastTickIntervalEnd;
@@ -1035,6 +1087,10 @@ inline int AudioEngine::getColumn() const {
 	return m_nColumn;
 }
 
+inline int AudioEngine::getTempoRevision() const {
+	return m_nTempoRevision;
+}
+
 inline const PatternList* AudioEngine::getPlayingPatterns() const {
 	return m_pPlayingPatterns;
 }
@@ -0,0 +1,188 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#include <core/AudioEngine/NoteQueue.h>
+
+#include <algorithm>
+
+namespace H2Core {
+
+NoteQueue::NoteQueue( int nBuckets, int nBucketSize )
+	: m_nCurrent( 0 )
+	, m_nBasePosition( 0 )
+	, m_nBucketSize( std::max( nBucketSize, 1 ) )
+	, m_nSize( 0 )
+	, m_nRingSize( 0 ) {
+
+	m_buckets.resize( std::max( nBuckets, 1 ) );
+	for ( auto& bucket : m_buckets ) {
+		bucket.reserve( 16 );
+	}
+	m_overflow.reserve( 16 );
+	m_scratch.reserve( 16 * m_buckets.size() );
+}
+
+NoteQueue::~NoteQueue() {
+}
+
+void NoteQueue::push( Note* pNote ) {
+	if ( m_nSize == 0 ) {
+		rebase( pNote->get_position() );
+	}
+	insert( pNote );
+	++m_nSize;
+}
+
+Note* NoteQueue::top() {
+	if ( m_nSize == 0 ) {
+		return nullptr;
+	}
+	if ( m_buckets[ m_nCurrent ].empty() ) {
+		advance();
+	}
+	return m_buckets[ m_nCurrent ].back();
+}
+
+void NoteQueue::pop() {
+	if ( top() == nullptr ) {
+		return;
+	}
+	m_buckets[ m_nCurrent ].pop_back();
+	--m_nRingSize;
+	--m_nSize;
+}
+
+void NoteQueue::setBucketSize( int nBucketSize ) {
+	nBucketSize = std::max( nBucketSize, 1 );
+	if ( nBucketSize == m_nBucketSize ) {
+		return;
+	}
+
+	collect();
+	m_nBucketSize = nBucketSize;
+	redistribute();
+}
+
+void NoteQueue::collect() {
+	// Collected in order to retain the order of notes sharing the
+	// same position.
+	m_scratch.clear();
+	forEach( [&]( Note* pNote ) {
+		m_scratch.push_back( pNote );
+	} );
+	for ( auto& bucket : m_buckets ) {
+		bucket.clear();
+	}
+	m_overflow.clear();
+}
+
+void NoteQueue::insert( Note* pNote ) {
+	const long long nPosition = pNote->get_position();
+	const int nBuckets = m_buckets.size();
+
+	int nOffset = 0;
+	if ( nPosition >= m_nBasePosition ) {
+		const long long nBucketOffset = ( nPosition - m_nBasePosition ) / m_nBucketSize;
+		if ( nBucketOffset >= nBuckets ) {
+			insertSorted( m_overflow, pNote );
+			return;
+		}
+		nOffset = static_cast<int>( nBucketOffset );
+	}
+	// Notes positioned before the current bucket are put into it as
+	// well. They will be returned right away.
+
+	insertSorted( m_buckets[ ( m_nCurrent + nOffset ) % nBuckets ], pNote );
+	++m_nRingSize;
+}
+
+void NoteQueue::advance() {
+	const int nBuckets = m_buckets.size();
+
+	if ( m_nRingSize == 0 ) {
+		// Only notes far in the future are left. We jump right to
+		// the first one.
+		rebase( m_overflow.back()->get_position() );
+		migrate();
+		return;
+	}
+
+	while ( m_buckets[ m_nCurrent ].empty() ) {
+		m_nCurrent = ( m_nCurrent + 1 ) % nBuckets;
+		m_nBasePosition += m_nBucketSize;
+		migrate();
+	}
+}
+
+void NoteQueue::migrate() {
+	const long long nRingEnd = m_nBasePosition +
+		static_cast<long long>( m_nBucketSize ) * m_buckets.size();
+
+	while ( ! m_overflow.empty() &&
+			m_overflow.back()->get_position() < nRingEnd ) {
+		Note* pNote = m_overflow.back();
+		m_overflow.pop_back();
+		insert( pNote );
+	}
+}
+
+void NoteQueue::redistribute() {
+	m_nSize = 0;
+	m_nRingSize = 0;
+	if ( m_scratch.empty() ) {
+		return;
+	}
+
+	long long nMinPosition = m_scratch[ 0 ]->get_position();
+	for ( auto pNote : m_scratch ) {
+		nMinPosition = std::min( nMinPosition,
+								 static_cast<long long>( pNote->get_position() ) );
+	}
+	rebase( nMinPosition );
+
+	for ( auto pNote : m_scratch ) {
+		insert( pNote );
+	}
+	m_nSize = m_scratch.size();
+	m_scratch.clear();
+}
+
+void NoteQueue::rebase( long long nPosition ) {
+	long long nBucket = nPosition / m_nBucketSize;
+	if ( nPosition < 0 && nPosition % m_nBucketSize != 0 ) {
+		// Round towards negative infinity.
+		--nBucket;
+	}
+	m_nBasePosition = nBucket * m_nBucketSize;
+}
+
+void NoteQueue::insertSorted( std::vector<Note*>& notes, Note* pNote ) {
+	const long long nPosition = pNote->get_position();
+	// Notes sharing the same position are placed in front of the
+	// existing ones and are thus returned after them.
+	auto it = std::lower_bound( notes.begin(), notes.end(), nPosition,
+								[]( Note* pOther, long long nOtherPosition ) {
+									return pOther->get_position() > nOtherPosition;
+								} );
+	notes.insert( it, pNote );
+}
+
+};
@@ -0,0 +1,253 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#ifndef NOTE_QUEUE_H
+#define NOTE_QUEUE_H
+
+#include <core/Object.h>
+#include <core/Basics/Note.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace H2Core
+{
+
+/**
+ * Calendar queue holding the notes about to be played back by the
+ * AudioEngine ordered by their Note::get_position().
+ *
+ * Notes are kept in tick space. Their start in frames depends on
+ * the current tempo and is only required once they are about to be
+ * played back. Changes in tempo thus do not affect the queue.
+ *
+ * The queue consists of a ring of buckets each covering
+ * #m_nBucketSize ticks and an overflow holding notes too far in the
+ * future to fit into the ring. Notes positioned before the bucket
+ * currently processed are put into it as well. A bucket and the
+ * overflow are kept sorted with the earliest note at their
+ * back. Since notes are spread across the buckets, each of them
+ * holds only a couple of notes and both insertion and extraction
+ * are O(1) amortized.
+ *
+ * All buckets keep their capacity. Apart from warming up the queue
+ * does not allocate any memory and is safe to be used within the
+ * audio thread.
+ *
+ * Notes sharing the same position are returned in the order they were
+ * pushed.
+ */
+class NoteQueue : public H2Core::Object<NoteQueue>
+{
+	H2_OBJECT(NoteQueue)
+public:
+	/**
+	 * \param nBuckets Number of buckets in the ring. Per default
+	 * the ring covers a whole bar.
+	 * \param nBucketSize Number of ticks covered by a single
+	 * bucket.
+	 */
+	NoteQueue( int nBuckets = MAX_NOTES, int nBucketSize = 1 );
+	~NoteQueue();
+
+	void push( Note* pNote );
+	/** \return Note with the smallest position or nullptr in case
+	 * the queue is empty. */
+	Note* top();
+	/** Removes the note returned by top(). */
+	void pop();
+	bool empty() const;
+	int size() const;
+
+	/**
+	 * Changes the number of ticks covered by a single bucket and
+	 * redistributes all notes.
+	 */
+	void setBucketSize( int nBucketSize );
+	int getBucketSize() const;
+
+	/**
+	 * Calls @a updateNote on each note, e.g. to shift its position
+	 * after a change in song size, and redistributes all of them
+	 * afterwards. This is O(n) and does not allocate memory once
+	 * the queue was warmed up.
+	 */
+	template <typename F>
+	void update( F updateNote );
+	/**
+	 * Removes all notes positioned before @a nPositionEnd for which
+	 * @a isDue returns true.
+	 *
+	 * Only the buckets covering positions before @a nPositionEnd
+	 * are visited.
+	 *
+	 * \param nPositionEnd First tick not considered.
+	 * \param isDue Predicate deciding whether to remove a note.
+	 * \param notes Removed notes are appended in the order they
+	 * would be returned by top(). No memory is allocated as long as
+	 * its capacity suffices.
+	 */
+	template <typename P>
+	void extract( long long nPositionEnd, P isDue, std::vector<Note*>& notes );
+	/**
+	 * Calls @a f on each note in the order they would be returned
+	 * by top().
+	 */
+	template <typename F>
+	void forEach( F f ) const;
+
+private:
+	/** Inserts @a pNote without updating #m_nSize. */
+	void insert( Note* pNote );
+	/** Moves #m_nCurrent to the next bucket holding a note. */
+	void advance();
+	/** Moves all notes in #m_overflow fitting into the ring into
+	 * their buckets. */
+	void migrate();
+	/** Moves all notes into #m_scratch in the order they would be
+	 * returned by top(). */
+	void collect();
+	/** Sorts all notes in #m_scratch into the empty queue. */
+	void redistribute();
+	/** Sets #m_nBasePosition to the start of the bucket
+	 * @a nPosition belongs to. */
+	void rebase( long long nPosition );
+	/** Inserts @a pNote into @a notes sorted by descending
+	 * position. */
+	static void insertSorted( std::vector<Note*>& notes, Note* pNote );
+	/** Helper of extract() handling a single bucket or the
+	 * overflow.
+	 *
+	 * \return Number of removed notes. */
+	template <typename P>
+	static int extractFrom( std::vector<Note*>& source, long long nPositionEnd,
+							P isDue, std::vector<Note*>& notes );
+
+	/** Ring of buckets. Each one is sorted by descending note
+	 * position. */
+	std::vector<std::vector<Note*>> m_buckets;
+	/** Notes beyond the end of the ring sorted by descending note
+	 * position. */
+	std::vector<Note*> m_overflow;
+	/** Used to redistribute notes. */
+	std::vector<Note*> m_scratch;
+	/** Index of the bucket starting at #m_nBasePosition. */
+	int m_nCurrent;
+	long long m_nBasePosition;
+	int m_nBucketSize;
+	/** Number of notes in the whole queue. */
+	int m_nSize;
+	/** Number of notes in #m_buckets. */
+	int m_nRingSize;
+};
+
+inline bool NoteQueue::empty() const {
+	return m_nSize == 0;
+}
+
+inline int NoteQueue::size() const {
+	return m_nSize;
+}
+
+inline int NoteQueue::getBucketSize() const {
+	return m_nBucketSize;
+}
+
+template <typename F>
+void NoteQueue::update( F updateNote ) {
+	if ( m_nSize == 0 ) {
+		return;
+	}
+
+	collect();
+	for ( auto pNote : m_scratch ) {
+		updateNote( pNote );
+	}
+
+	redistribute();
+}
+
+template <typename P>
+void NoteQueue::extract( long long nPositionEnd, P isDue, std::vector<Note*>& notes ) {
+	if ( m_nSize == 0 ) {
+		return;
+	}
+
+	const int nBuckets = m_buckets.size();
+	int nExtracted = 0;
+	for ( int ii = 0; ii < nBuckets && m_nRingSize > 0; ++ii ) {
+		// The current bucket also holds all notes positioned before
+		// #m_nBasePosition.
+		if ( ii > 0 && m_nBasePosition +
+			 static_cast<long long>( ii ) * m_nBucketSize >= nPositionEnd ) {
+			break;
+		}
+		const int nRemoved =
+			extractFrom( m_buckets[ ( m_nCurrent + ii ) % nBuckets ],
+						 nPositionEnd, isDue, notes );
+		m_nRingSize -= nRemoved;
+		nExtracted += nRemoved;
+	}
+	nExtracted += extractFrom( m_overflow, nPositionEnd, isDue, notes );
+
+	m_nSize -= nExtracted;
+}
+
+template <typename P>
+int NoteQueue::extractFrom( std::vector<Note*>& source, long long nPositionEnd,
+							P isDue, std::vector<Note*>& notes ) {
+	int nRemoved = 0;
+	for ( auto it = source.rbegin(); it != source.rend(); ++it ) {
+		if ( (*it)->get_position() >= nPositionEnd ) {
+			break;
+		}
+		if ( isDue( *it ) ) {
+			notes.push_back( *it );
+			*it = nullptr;
+			++nRemoved;
+		}
+	}
+
+	if ( nRemoved > 0 ) {
+		source.erase( std::remove( source.begin(), source.end(), nullptr ),
+					  source.end() );
+	}
+
+	return nRemoved;
+}
+
+template <typename F>
+void NoteQueue::forEach( F f ) const {
+	const int nBuckets = m_buckets.size();
+	for ( int ii = 0; ii < nBuckets; ++ii ) {
+		const auto& bucket = m_buckets[ ( m_nCurrent + ii ) % nBuckets ];
+		for ( auto it = bucket.rbegin(); it != bucket.rend(); ++it ) {
+			f( *it );
+		}
+	}
+	for ( auto it = m_overflow.rbegin(); it != m_overflow.rend(); ++it ) {
+		f( *it );
+	}
+}
+
+};
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#include <core/AudioEngine/TempoMap.h>
+#include <core/AudioEngine/AudioEngine.h>
+#include <core/Basics/Song.h>
+#include <core/Timeline.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace H2Core {
+
+TempoMap::TempoMap( std::shared_ptr<Song> pSong, std::shared_ptr<Timeline> pTimeline,
+					int nSampleRate, double fSongSizeInTicks )
+	: m_nSampleRate( nSampleRate > 0 ? nSampleRate : REFERENCE_SAMPLE_RATE )
+	, m_nResolution( 0 )
+	, m_fSongSizeInTicks( fSongSizeInTicks )
+	, m_fSongSizeInFrames( 0 )
+	, m_bConstant( true ) {
+
+	if ( pSong == nullptr || pTimeline == nullptr ) {
+		return;
+	}
+	m_nResolution = pSong->getResolution();
+
+	const auto tempoMarkers = pTimeline->getAllTempoMarkers();
+	if ( tempoMarkers.size() == 0 ||
+		 ( tempoMarkers.size() == 1 && pTimeline->isFirstTempoMarkerSpecial() ) ||
+		 m_nResolution == 0 || fSongSizeInTicks <= 0 ) {
+		return;
+	}
+	m_bConstant = false;
+
+	const int nColumns = pSong->getPatternGroupVector()->size();
+	const int nSegments = tempoMarkers.size();
+	m_endTicks.resize( nSegments );
+	m_endFrames.resize( nSegments );
+	m_tickSizes.resize( nSegments );
+	m_nextTickSizes.resize( nSegments );
+
+	for ( int ii = 0; ii < nSegments; ++ii ) {
+		m_tickSizes[ ii ] =
+			AudioEngine::computeDoubleTickSize( m_nSampleRate, tempoMarkers[ ii ]->fBpm,
+												m_nResolution );
+	}
+
+	// The frames are accumulated in the same order the segments are
+	// traversed during playback to keep rounding consistent.
+	double fPassedTicks = 0;
+	double fPassedFrames = 0;
+	for ( int ii = 0; ii < nSegments; ++ii ) {
+		double fEndTick;
+		if ( ii + 1 == nSegments ||
+			 tempoMarkers[ ii + 1 ]->nColumn >= nColumns ) {
+			fEndTick = fSongSizeInTicks;
+		} else {
+			fEndTick = static_cast<double>(
+				pSong->getColumnStartTick( tempoMarkers[ ii + 1 ]->nColumn ) );
+		}
+
+		fPassedFrames += ( fEndTick - fPassedTicks ) * m_tickSizes[ ii ];
+		fPassedTicks = fEndTick;
+
+		m_endTicks[ ii ] = fEndTick;
+		m_endFrames[ ii ] = fPassedFrames;
+		m_nextTickSizes[ ii ] = m_tickSizes[ ( ii + 1 ) % nSegments ];
+	}
+
+	m_fSongSizeInFrames = fPassedFrames;
+}
+
+TempoMap::~TempoMap() {
+}
+
+long long TempoMap::computeFrameFromTick( double fTick, double* fTickMismatch,
+										  int nSampleRate ) const {
+	*fTickMismatch = 0;
+
+	if ( m_bConstant || fTick <= 0 || nSampleRate <= 0 ) {
+		return 0;
+	}
+
+	// Both the frames and the tick sizes stored in the map scale
+	// linearly with the sample rate.
+	const double fScale = static_cast<double>( nSampleRate ) /
+		static_cast<double>( m_nSampleRate );
+
+	// Positions beyond the end of the Song are mapped onto it and
+	// the frames of all preceding repetitions are added afterwards.
+	double fFrameOffset = 0;
+	if ( fTick > m_fSongSizeInTicks ) {
+		const double fTotalTick = fTick;
+		double fRepetitions = std::floor( fTick / m_fSongSizeInTicks );
+		fTick = std::fmod( fTick, m_fSongSizeInTicks );
+		if ( fTick == 0 ) {
+			// The very end of the last repetition.
+			fRepetitions -= 1;
+			fTick = m_fSongSizeInTicks;
+		}
+
+		fFrameOffset = fRepetitions * m_fSongSizeInFrames * fScale;
+		if ( std::isinf( fFrameOffset ) ||
+			 fFrameOffset > static_cast<double>(std::numeric_limits<long long>::max()) ) {
+			ERRORLOG( QString( "Provided ticks [%1] are too large." ).arg( fTotalTick ) );
+			return 0;
+		}
+	}
+
+	// First segment ending at or after fTick.
+	const int nSegment = std::min(
+		static_cast<int>( std::lower_bound( m_endTicks.begin(), m_endTicks.end(), fTick ) -
+						  m_endTicks.begin() ),
+		static_cast<int>( m_endTicks.size() ) - 1 );
+	const double fStartTick = nSegment > 0 ? m_endTicks[ nSegment - 1 ] : 0;
+	const double fStartFrame = nSegment > 0 ? m_endFrames[ nSegment - 1 ] : 0;
+
+	const double fNewFrames = fFrameOffset + fStartFrame * fScale +
+		( fTick - fStartTick ) * m_tickSizes[ nSegment ] * fScale;
+	const long long nNewFrames = static_cast<long long>( std::round( fNewFrames ) );
+	const double fMismatchInFrames = fNewFrames - static_cast<double>( nNewFrames );
+
+	if ( fTick == m_endTicks[ nSegment ] && fMismatchInFrames < 0 ) {
+		// We ended at the very tick containing a tempo marker. If the
+		// mismatch is negative, we rounded the tick to a higher value
+		// and need to use the tick size of the next tempo marker.
+		*fTickMismatch = fMismatchInFrames /
+			( m_nextTickSizes[ nSegment ] * fScale );
+	} else {
+		*fTickMismatch = fMismatchInFrames / ( m_tickSizes[ nSegment ] * fScale );
+	}
+
+	return nNewFrames;
+}
+
+double TempoMap::computeTickFromFrame( long long nFrame, int nSampleRate ) const {
+
+	if ( m_bConstant || nFrame <= 0 || nSampleRate <= 0 ) {
+		return 0;
+	}
+
+	// Convert into the sample rate the map was compiled for.
+	double fFrame = static_cast<double>( nFrame );
+	if ( nSampleRate != m_nSampleRate ) {
+		fFrame *= static_cast<double>( m_nSampleRate ) /
+			static_cast<double>( nSampleRate );
+	}
+	double fTickOffset = 0;
+	if ( fFrame > m_fSongSizeInFrames ) {
+		const double fRepetitions = std::floor( fFrame / m_fSongSizeInFrames );
+		fTickOffset = m_fSongSizeInTicks * fRepetitions;
+		if ( std::isinf( fTickOffset ) ) {
+			ERRORLOG( QString( "Provided frames [%1] are too large." ).arg( nFrame ) );
+			return 0;
+		}
+
+		fFrame -= fRepetitions * m_fSongSizeInFrames;
+		if ( fFrame <= 0 ) {
+			return fTickOffset;
+		}
+	}
+
+	// First segment ending at or after fFrame.
+	const int nSegment = std::min(
+		static_cast<int>( std::lower_bound( m_endFrames.begin(), m_endFrames.end(), fFrame ) -
+						  m_endFrames.begin() ),
+		static_cast<int>( m_endFrames.size() ) - 1 );
+	const double fStartTick = nSegment > 0 ? m_endTicks[ nSegment - 1 ] : 0;
+	const double fStartFrame = nSegment > 0 ? m_endFrames[ nSegment - 1 ] : 0;
+
+	return fTickOffset + fStartTick +
+		( fFrame - fStartFrame ) / m_tickSizes[ nSegment ];
+}
+
+};
@@ -0,0 +1,148 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#ifndef TEMPO_MAP_H
+#define TEMPO_MAP_H
+
+#include <core/Object.h>
+
+#include <memory>
+#include <vector>
+
+namespace H2Core
+{
+
+class Song;
+class Timeline;
+
+/**
+ * Immutable, compiled version of the tempo markers of a #Timeline
+ * used to convert transport positions in ticks into frames and vice
+ * versa.
+ *
+ * The Timeline splits a Song into segments each starting at a
+ * TempoMarker and ending at the next one or at the end of the
+ * Song. For each of them the map stores the tick and the frame it
+ * ends at as well as its tick size. Since the ends are increasing
+ * in both domains, the segment containing a transport position is
+ * found using a binary search instead of walking all markers.
+ *
+ * The map depends on the tempo markers, the resolution, and the
+ * lengths of all columns of the Song. It has to be compiled anew
+ * whenever one of them changes (see AudioEngine::updateTempoMap()).
+ * Since all frames are proportional to the sample rate, the map can
+ * be used for any of them without being compiled again. It does not
+ * depend on the current tempo of the transport either.
+ */
+class TempoMap : public H2Core::Object<TempoMap>
+{
+	H2_OBJECT(TempoMap)
+public:
+
+	/**
+	 * Compiles all tempo markers of @a pTimeline.
+	 *
+	 * \param pSong Song providing the resolution and the start
+	 * ticks of all columns.
+	 * \param pTimeline Timeline holding the tempo markers.
+	 * \param nSampleRate Sample rate the frames are stored in. If
+	 * 0, #REFERENCE_SAMPLE_RATE is used.
+	 * \param fSongSizeInTicks Length of @a pSong in ticks.
+	 */
+	TempoMap( std::shared_ptr<Song> pSong, std::shared_ptr<Timeline> pTimeline,
+			  int nSampleRate, double fSongSizeInTicks );
+	~TempoMap();
+
+	/**
+	 * \return Whether the map is compiled for the provided
+	 * parameters and can be used to convert positions of the
+	 * current Song.
+	 */
+	bool matches( int nResolution, double fSongSizeInTicks ) const;
+	/**
+	 * \return Whether the map does not contain any tempo marker set
+	 * by the user or there is no Song to map. In this case the
+	 * current tempo of the transport has to be used instead.
+	 */
+	bool isConstant() const;
+
+	/**
+	 * Counterpart of AudioEngine::computeFrameFromTick() with the
+	 * #Timeline enabled.
+	 *
+	 * \param fTick Transport position in ticks. Positions beyond
+	 * the end of the Song are treated as repetitions of it.
+	 * \param fTickMismatch Difference between @a fTick and the
+	 * tick corresponding to the returned frame.
+	 * \param nSampleRate Sample rate the returned frame is measured
+	 * in.
+	 *
+	 * \return frame
+	 */
+	long long computeFrameFromTick( double fTick, double* fTickMismatch,
+									int nSampleRate ) const;
+	/**
+	 * Counterpart of AudioEngine::computeTickFromFrame() with the
+	 * #Timeline enabled.
+	 *
+	 * \param nFrame Transport position in frames. Positions beyond
+	 * the end of the Song are treated as repetitions of it.
+	 * \param nSampleRate Sample rate @a nFrame is measured in.
+	 *
+	 * \return tick
+	 */
+	double computeTickFromFrame( long long nFrame, int nSampleRate ) const;
+
+	/** Sample rate used to compile the map while no audio driver
+	 * is running. */
+	static constexpr int REFERENCE_SAMPLE_RATE = 48000;
+
+private:
+	/** Tick each segment ends at. */
+	std::vector<double> m_endTicks;
+	/** Frame each segment ends at. */
+	std::vector<double> m_endFrames;
+	/** Tick size used within each segment. */
+	std::vector<double> m_tickSizes;
+	/** Tick size used right after the end of each segment. For the
+	 * last one this is the tick size of the first segment since
+	 * the Song starts over again. */
+	std::vector<double> m_nextTickSizes;
+
+	int m_nSampleRate;
+	int m_nResolution;
+	double m_fSongSizeInTicks;
+	double m_fSongSizeInFrames;
+	bool m_bConstant;
+};
+
+inline bool TempoMap::matches( int nResolution, double fSongSizeInTicks ) const {
+	return m_nResolution == nResolution &&
+		m_fSongSizeInTicks == fSongSizeInTicks;
+}
+
+inline bool TempoMap::isConstant() const {
+	return m_bConstant;
+}
+
+};
+
+#endif
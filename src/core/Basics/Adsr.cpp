@@ -22,6 +22,9 @@
 
 #include <core/Basics/Adsr.h>
 
+#include <algorithm>
+#include <cmath>
+
 namespace H2Core
 {
 
@@ -121,7 +124,9 @@ ADSR::~ADSR() { }
  * Even if the code is not SLP-vectorised, the unrolled loop should still have better performance
  * characteristics due to more flexible scheduling and reduced loop overhead.
  *
+ * With bStereo set to false only pA is processed and pB is ignored.
  */
+template <bool bStereo>
 inline double applyExponential( const float fExponent, const float fXOffset, const float fYOffset,
 								const float fScale,
 								float * __restrict__ pA, float * __restrict__ pB,
@@ -150,10 +155,12 @@ inline double applyExponential( const float fExponent, const float fXOffset, con
 			pA[i+2] *= fVal2;
 			pA[i+3] *= fVal3;
 
-			pB[i] *= fVal0;
-			pB[i+1] *= fVal1;
-			pB[i+2] *= fVal2;
-			pB[i+3] *= fVal3;
+			if ( bStereo ) {
+				pB[i] *= fVal0;
+				pB[i+1] *= fVal1;
+				pB[i+2] *= fVal2;
+				pB[i+3] *= fVal3;
+			}
 
 			fQ0 *= fFactor4;
 			fQ1 *= fFactor4;
@@ -168,13 +175,29 @@ inline double applyExponential( const float fExponent, const float fXOffset, con
 	for (; i < nFrames; i++) {
 		fVal = ( fQ - fXOffset ) * fScale + fYOffset;
 		pA[i] *= fVal;
-		pB[i] *= fVal;
+		if ( bStereo ) {
+			pB[i] *= fVal;
+		}
 		fQ *= fFactor;
 	}
 	*pfADSRVal = fVal;
 	return fQ;
 }
 
+/** Dispatches to the stereo or mono version of applyExponential()
+ * depending on whether @a pB was provided. */
+inline double applyExponential( const float fExponent, const float fXOffset, const float fYOffset,
+								const float fScale, float *pA, float *pB,
+								float fQ, int nFrames, int nFramesTotal, float fStep,
+								float *pfADSRVal ) {
+	if ( pB != nullptr ) {
+		return applyExponential<true>( fExponent, fXOffset, fYOffset, fScale, pA, pB,
+									   fQ, nFrames, nFramesTotal, fStep, pfADSRVal );
+	}
+	return applyExponential<false>( fExponent, fXOffset, fYOffset, fScale, pA, nullptr,
+									fQ, nFrames, nFramesTotal, fStep, pfADSRVal );
+}
+
 /**
  * Apply ADSR envelope to stereo pair sample fragments.
  * 
@@ -213,7 +236,8 @@ bool ADSR::applyADSR( float *pLeft, float *pRight, int nFrames, int nReleaseFram
 		}
 
 		m_fQ = applyExponential( fDecayExponent, -fDecayYOffset, __sustain, (1.0-__sustain),
-								 &pLeft[n], &pRight[n], m_fQ, nDecayFrames, __decay, fStep, &__value );
+								 &pLeft[n], pRight != nullptr ? &pRight[n] : nullptr,
+								 m_fQ, nDecayFrames, __decay, fStep, &__value );
 
 		n += nDecayFrames;
 		__ticks += nDecayFrames * fStep;
@@ -232,7 +256,11 @@ bool ADSR::applyADSR( float *pLeft, float *pRight, int nFrames, int nReleaseFram
 			if ( __sustain != 1.0 ) {
 				for ( int i = 0; i < nSustainFrames; i++ ) {
 					pLeft[ n + i ] *= __sustain;
-					pRight[ n + i ] *= __sustain;
+				}
+				if ( pRight != nullptr ) {
+					for ( int i = 0; i < nSustainFrames; i++ ) {
+						pRight[ n + i ] *= __sustain;
+					}
 				}
 			}
 			n += nSustainFrames;
@@ -249,12 +277,13 @@ bool ADSR::applyADSR( float *pLeft, float *pRight, int nFrames, int nReleaseFram
 	if ( __state == RELEASE ) {
 
 		int nReleaseFrames = nFrames - n;
-		if ( nReleaseFrames * fStep > __decay ) {
-			nReleaseFrames = ceil( __decay / fStep );
+		if ( __ticks + nReleaseFrames * fStep > __release ) {
+			nReleaseFrames = std::max( static_cast<int>( ceil( ( __release - __ticks ) / fStep ) ), 0 );
 		}
 
 		m_fQ = applyExponential( fDecayExponent, -fDecayYOffset, 0.0, __release_value,
-								 &pLeft[n], &pRight[n], m_fQ, nReleaseFrames, __release, fStep, &__value );
+								 &pLeft[n], pRight != nullptr ? &pRight[n] : nullptr,
+								 m_fQ, nReleaseFrames, __release, fStep, &__value );
 
 		n += nReleaseFrames;
 		__ticks += nReleaseFrames * fStep;
@@ -264,8 +293,13 @@ bool ADSR::applyADSR( float *pLeft, float *pRight, int nFrames, int nReleaseFram
 	}
 
 	if ( __state == IDLE ) {
-		for ( ; n < nFrames; n++ ) {
-			pLeft[ n ] = pRight[ n ] = 0.0;
+		for ( int i = n; i < nFrames; i++ ) {
+			pLeft[ i ] = 0.0;
+		}
+		if ( pRight != nullptr ) {
+			for ( int i = n; i < nFrames; i++ ) {
+				pRight[ i ] = 0.0;
+			}
 		}
 		return true;
 	}
@@ -290,6 +324,19 @@ float ADSR::release()
 	return __release_value;
 }
 
+void ADSR::fadeOut( unsigned int nRelease )
+{
+	if ( __state == IDLE ) {
+		return;
+	}
+	// Start a fresh release from the current value.
+	__release_value = __value;
+	__release = nRelease;
+	__state = RELEASE;
+	__ticks = 0;
+	m_fQ = fDecayInit;
+}
+
 QString ADSR::toQString( const QString& sPrefix, bool bShort ) const {
 	QString s = Base::sPrintIndention;
 	QString sOutput;
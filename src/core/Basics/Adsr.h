@@ -94,14 +94,34 @@ class ADSR : public Object<ADSR>
 		 * set state to RELEASE, save __release_value and return it.
 		 * */
 		float release();
+		/**
+		 * Fades out from the current value within @a nRelease ticks
+		 * regardless of the release time of the envelope. Used when
+		 * stealing voices.
+		 */
+		void fadeOut( unsigned int nRelease );
+		/** \return Whether the envelope is still in its attack
+		 * phase. */
+		bool is_attacking() const;
+		/** \return Whether the release phase was entered or the
+		 * envelope is finished already. */
+		bool is_released() const;
+		/** \return Envelope value of the last processed frame. */
+		float get_value() const;
 
 		/**
 		 * Compute and apply successive ADSR values to stereo buffers.
+		 *
+		 * By passing a buffer filled with ones as @a pLeft and
+		 * nullptr as @a pRight the envelope itself is rendered.
+		 *
 		 * \param pLeft left-channel audio buffer
-		 * \param pRight right-channel audio buffer
+		 * \param pRight right-channel audio buffer. May be nullptr
+		 * in order to process @a pLeft only.
 		 * \param nFrames number of frames of audio
 		 * \param nReleaseFrame frame number of the release point
 		 * \param fStep the increment to be added to __ticks
+		 * \return true once the envelope has finished.
 		 */
 
 		bool applyADSR( float *pLeft, float *pRight, int nFrames, int nReleaseFrame, float fStep );
@@ -180,6 +200,21 @@ inline unsigned int ADSR::get_release()
 	return __release;
 }
 
+inline bool ADSR::is_attacking() const
+{
+	return __state == ATTACK;
+}
+
+inline bool ADSR::is_released() const
+{
+	return __state == RELEASE || __state == IDLE;
+}
+
+inline float ADSR::get_value() const
+{
+	return __value;
+}
+
 };
 
 #endif // H2C_ADRS_H
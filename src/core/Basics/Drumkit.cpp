@@ -41,6 +41,8 @@
 #include <core/Basics/InstrumentComponent.h>
 #include <core/Basics/InstrumentLayer.h>
 
+#include <core/Helpers/SampleLoader.h>
+#include <core/Helpers/SampleRegistry.h>
 #include <core/Helpers/Xml.h>
 #include <core/Helpers/Legacy.h>
 
@@ -155,8 +157,10 @@ Drumkit* Drumkit::load_file( const QString& dk_path, const bool load_samples, bo
 	if ( ! bReadingSuccessful && bUpgrade ) {
 		upgrade_drumkit( pDrumkit, dk_path );
 	}
-	if( load_samples ){
-		pDrumkit->load_samples();
+	if ( load_samples && ! pDrumkit->load_samples() ) {
+		WARNINGLOG( QString( "Loading drumkit [%1] was superseded" ).arg( dk_path ) );
+		delete pDrumkit;
+		return nullptr;
 	}
 	return pDrumkit;
 }
@@ -216,13 +220,45 @@ Drumkit* Drumkit::load_from( XMLNode* node, const QString& dk_path, bool bSilent
 
 }
 
-void Drumkit::load_samples()
+bool Drumkit::load_samples()
 {
 	INFOLOG( QString( "Loading drumkit %1 instrument samples" ).arg( __name ) );
 	if( !__samples_loaded ) {
-		__instruments->load_samples();
+		const long nRegistryHits = SampleRegistry::getHits();
+		const long nRegistryMisses = SampleRegistry::getMisses();
+
+		std::vector<std::shared_ptr<InstrumentLayer>> layers;
+		std::vector<SampleLoader::Request> requests;
+		for ( const auto& pInstrument : *__instruments ) {
+			for ( const auto& pComponent : *pInstrument->get_components() ) {
+				for ( int n = 0; n < InstrumentComponent::getMaxLayers(); n++ ) {
+					auto pLayer = pComponent->get_layer( n );
+					if ( pLayer != nullptr && pLayer->get_sample() != nullptr ) {
+						layers.push_back( pLayer );
+						requests.push_back(
+							SampleLoader::Request( pLayer->get_sample()->get_filepath() ) );
+					}
+				}
+			}
+		}
+
+		if ( ! SampleLoader::load( requests, SampleLoader::Scope::Drumkit ) ) {
+			WARNINGLOG( QString( "Loading samples of drumkit %1 was cancelled" )
+						.arg( __name ) );
+			return false;
+		}
+
+		for ( int i = 0; i < layers.size(); i++ ) {
+			if ( requests[ i ].pSample != nullptr ) {
+				layers[ i ]->set_sample( requests[ i ].pSample );
+			}
+		}
 		__samples_loaded = true;
+		INFOLOG( QString( "Samples loaded: %1, shared with other instruments, kits, or songs: %2" )
+				 .arg( SampleRegistry::getMisses() - nRegistryMisses )
+				 .arg( SampleRegistry::getHits() - nRegistryHits ) );
 	}
+	return true;
 }
 
 void Drumkit::upgrade_drumkit(Drumkit* pDrumkit, const QString& dk_path, bool bSilent )
@@ -462,7 +498,13 @@ bool Drumkit::save_samples( const QString& dk_dir, bool overwrite )
 							}
 						}
 
-						pLayer->get_sample()->set_filename( dst );
+						if ( dst != original_dst ) {
+							// The sample might be shared with other
+							// drumkits. Rename a copy instead.
+							auto pSample = std::make_shared<Sample>( pLayer->get_sample() );
+							pSample->set_filename( dst );
+							pLayer->set_sample( pSample );
+						}
 
 						if( !Filesystem::file_copy( src, dst ) ) {
 							return false;
@@ -116,10 +116,14 @@ class Drumkit : public H2Core::Object<Drumkit>
 								   const bool load_samples = false,
 								   bool bUpgrade = true,
 								   bool bSilent = true );
-		/** Calls the InstrumentList::load_samples() member
-		 * function of #__instruments.
+		/**
+		 * Loads the samples of all layers of #__instruments
+		 * concurrently using the #SampleLoader.
+		 *
+		 * \return false in case loading was superseded by another
+		 * drumkit. The samples are not loaded in this case.
 		 */
-		void load_samples();
+		bool load_samples();
 		/** Calls the InstrumentList::unload_samples() member
 		 * function of #__instruments.
 		 */
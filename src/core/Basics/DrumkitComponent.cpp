@@ -30,6 +30,7 @@
 
 #include <core/Helpers/Xml.h>
 #include <core/Helpers/Filesystem.h>
+#include <core/Helpers/VectorMath.h>
 
 #include <core/Basics/Adsr.h>
 #include <core/Basics/Sample.h>
@@ -80,8 +81,22 @@ DrumkitComponent::~DrumkitComponent()
 
 void DrumkitComponent::reset_outs( uint32_t nFrames )
 {
-	memset( __out_L, 0, nFrames * sizeof( float ) );
-	memset( __out_R, 0, nFrames * sizeof( float ) );
+	VectorMath::clear( __out_L, nFrames );
+	VectorMath::clear( __out_R, nFrames );
+}
+
+void DrumkitComponent::add_outs( const float* pBuffer_L, const float* pBuffer_R,
+								 float fGain_L, float fGain_R,
+								 int nBufferPos, int nFrames )
+{
+	VectorMath::addScaled( __out_L + nBufferPos, pBuffer_L, fGain_L, nFrames );
+	VectorMath::addScaled( __out_R + nBufferPos, pBuffer_R, fGain_R, nFrames );
+}
+
+void DrumkitComponent::update_peaks( uint32_t nFrames )
+{
+	__peak_l = VectorMath::peak( __out_L, nFrames, __peak_l );
+	__peak_r = VectorMath::peak( __out_R, nFrames, __peak_r );
 }
 
 float DrumkitComponent::get_out_L( int nBufferPos )
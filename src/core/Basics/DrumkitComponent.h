@@ -71,6 +71,17 @@ class DrumkitComponent : public H2Core::Object<DrumkitComponent>
 
 		void						reset_outs( uint32_t nFrames );
 		void						set_outs( int nBufferPos, float valL, float valR );
+		/**
+		 * Adds @a nFrames frames of @a pBuffer_L and @a pBuffer_R
+		 * scaled by @a fGain_L and @a fGain_R to the outputs of the
+		 * component starting at @a nBufferPos.
+		 */
+		void						add_outs( const float* pBuffer_L, const float* pBuffer_R,
+											  float fGain_L, float fGain_R,
+											  int nBufferPos, int nFrames );
+		/** Raises #__peak_l and #__peak_r to the maximum of the
+		 * first @a nFrames frames of the outputs. */
+		void						update_peaks( uint32_t nFrames );
 		float						get_out_L( int nBufferPos );
 		float						get_out_R( int nBufferPos );
 		/** Formatted string version for debugging purposes.
@@ -31,6 +31,7 @@
 
 #include <core/Basics/Adsr.h>
 #include <core/Basics/Sample.h>
+#include <core/Helpers/SampleRegistry.h>
 #include <core/Basics/Drumkit.h>
 #include <core/Basics/DrumkitComponent.h>
 #include <core/Basics/InstrumentList.h>
@@ -169,7 +170,7 @@ void Instrument::load_from( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInst
 				pMyComponent->set_layer( nullptr, i );
 			} else {
 				QString sample_path =  pDrumkit->get_path() + "/" + src_layer->get_sample()->get_filename();
-				auto pSample = Sample::load( sample_path );
+				auto pSample = SampleRegistry::load( sample_path );
 				if ( pSample == nullptr ) {
 					_ERRORLOG( QString( "Error loading sample %1. Creating a new empty layer." ).arg( sample_path ) );
 					set_missing_samples( true );
@@ -207,6 +208,35 @@ void Instrument::load_from( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInst
 	this->set_apply_velocity ( pInstrument->get_apply_velocity() );
 }
 
+void Instrument::swap_from( std::shared_ptr<Instrument> pStaged )
+{
+	std::swap( __components, pStaged->__components );
+	__name.swap( pStaged->__name );
+	__drumkit_name.swap( pStaged->__drumkit_name );
+	__adsr.swap( pStaged->__adsr );
+
+	set_missing_samples( pStaged->has_missing_samples() );
+	set_id( pStaged->get_id() );
+	set_gain( pStaged->get_gain() );
+	set_volume( pStaged->get_volume() );
+	setPan( pStaged->getPan() );
+	set_filter_active( pStaged->is_filter_active() );
+	set_filter_cutoff( pStaged->get_filter_cutoff() );
+	set_filter_resonance( pStaged->get_filter_resonance() );
+	set_pitch_offset( pStaged->get_pitch_offset() );
+	set_random_pitch_factor( pStaged->get_random_pitch_factor() );
+	set_muted( pStaged->is_muted() );
+	set_mute_group( pStaged->get_mute_group() );
+	set_midi_out_channel( pStaged->get_midi_out_channel() );
+	set_midi_out_note( pStaged->get_midi_out_note() );
+	set_stop_notes( pStaged->is_stop_notes() );
+	set_sample_selection_alg( pStaged->sample_selection_alg() );
+	set_hihat_grp( pStaged->get_hihat_grp() );
+	set_lower_cc( pStaged->get_lower_cc() );
+	set_higher_cc( pStaged->get_higher_cc() );
+	set_apply_velocity( pStaged->get_apply_velocity() );
+}
+
 void Instrument::load_from( const QString& dk_name, const QString& instrument_name, Filesystem::Lookup lookup )
 {
 	Drumkit* pDrumkit = Drumkit::load_by_name( dk_name, false, lookup );
@@ -98,6 +98,19 @@ class Instrument : public H2Core::Object<Instrument>
 		 */
 		void load_from( Drumkit* drumkit, std::shared_ptr<Instrument> instrument );
 
+		/**
+		 * Takes over the components and all members set by
+		 * load_from( Drumkit*, std::shared_ptr<Instrument> ) from
+		 * @a pStaged without allocating or freeing memory.
+		 *
+		 * @a pStaged receives the former components in return and
+		 * is meant to be discarded afterwards, without holding the
+		 * audio engine lock. See Song::stageDrumkit().
+		 *
+		 * \param pStaged Instrument prepared using load_from().
+		 */
+		void swap_from( std::shared_ptr<Instrument> pStaged );
+
 		/**
 		 * Calls the InstrumentLayer::load_sample() member
 		 * function of all layers of each component of the
@@ -331,7 +344,7 @@ class Instrument : public H2Core::Object<Instrument>
 		bool					__soloed;				///< is the instrument in solo mode?
 		bool					__muted;				///< is the instrument muted?
 		int						__mute_group;			///< mute group of the instrument
-		int						__queued;				///< count the number of notes queued within Sampler::__playing_notes_queue or std::priority_queue m_songNoteQueue
+		int						__queued;				///< count the number of notes queued within Sampler::__playing_notes_queue or AudioEngine::m_songNoteQueue
 		float					__fx_level[MAX_FX];		///< Ladspa FX level array
 		int						__hihat_grp;			///< the instrument is part of a hihat
 		int						__lower_cc;				///< lower cc level
@@ -24,6 +24,7 @@
 
 #include <core/Helpers/Xml.h>
 #include <core/Basics/Sample.h>
+#include <core/Helpers/SampleRegistry.h>
 
 namespace H2Core
 {
@@ -67,14 +68,21 @@ void InstrumentLayer::set_sample( std::shared_ptr<Sample> sample )
 void InstrumentLayer::load_sample()
 {
 	if( __sample ) {
-		__sample->load();
+		// Samples are shared with all other layers using the same
+		// file. The one held so far is replaced instead of being
+		// loaded in place.
+		auto pSample = SampleRegistry::load( __sample->get_filepath() );
+		if ( pSample != nullptr ) {
+			__sample = pSample;
+		}
 	}
 }
 
 void InstrumentLayer::unload_sample()
 {
 	if( __sample ) {
-		__sample->unload();
+		// Other layers might still use the data.
+		__sample = std::make_shared<Sample>( __sample->get_filepath() );
 	}
 }
 
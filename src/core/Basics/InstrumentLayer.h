@@ -84,8 +84,8 @@ namespace H2Core
 		std::shared_ptr<Sample> get_sample() const;
 
 		/**
-		 * Calls the #H2Core::Sample::load()
-		 * member function of #__sample.
+		 * Replaces #__sample by a loaded version of the same file
+		 * obtained from the #H2Core::SampleRegistry.
 		 */
 		void load_sample();
 		/*
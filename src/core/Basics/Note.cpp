@@ -22,6 +22,8 @@
 
 #include <core/Basics/Note.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 
 #include <core/Helpers/Xml.h>
@@ -33,6 +35,8 @@
 #include <core/Basics/InstrumentLayer.h>
 #include <core/Basics/Song.h>
 #include <core/Hydrogen.h>
+#include <core/Helpers/RealtimePool.h>
+#include <core/Helpers/VectorMath.h>
 #include <core/Sampler/Sampler.h>
 
 namespace H2Core
@@ -40,6 +44,76 @@ namespace H2Core
 
 const char* Note::__key_str[] = { "C", "Cs", "D", "Ef", "E", "F", "Fs", "G", "Af", "A", "Bf", "B" };
 
+const Note::RealtimeTag Note::realtime = Note::RealtimeTag();
+
+static std::atomic<RealtimePool*> s_pRealtimePool( nullptr );
+static std::atomic<int> s_nRealtimePoolMisses( 0 );
+
+void* Note::operator new( size_t nSize ) {
+	return ::operator new( nSize );
+}
+
+void* Note::operator new( size_t nSize, const RealtimeTag& ) {
+	auto pPool = s_pRealtimePool.load( std::memory_order_acquire );
+	if ( pPool != nullptr && nSize <= pPool->getBlockSize() ) {
+		void* pNote = pPool->acquire();
+		if ( pNote != nullptr ) {
+			return pNote;
+		}
+		s_nRealtimePoolMisses.fetch_add( 1, std::memory_order_relaxed );
+	}
+	return ::operator new( nSize );
+}
+
+void Note::operator delete( void* pNote ) {
+	auto pPool = s_pRealtimePool.load( std::memory_order_acquire );
+	if ( pPool != nullptr && pPool->contains( pNote ) ) {
+		pPool->release( pNote );
+	} else {
+		::operator delete( pNote );
+	}
+}
+
+void Note::operator delete( void* pNote, const RealtimeTag& ) {
+	Note::operator delete( pNote );
+}
+
+void Note::createRealtimePool( int nMaxNotes ) {
+	if ( s_pRealtimePool.load() != nullptr ) {
+		return;
+	}
+	// Besides the notes played by the Sampler there are the ones
+	// enqueued for the upcoming cycles, the MIDI notes, and the
+	// note offs.
+	s_pRealtimePool.store( new RealtimePool( sizeof( Note ),
+											 4 * std::max( nMaxNotes, 16 ) ) );
+}
+
+RealtimePool* Note::getRealtimePool() {
+	return s_pRealtimePool.load();
+}
+
+int Note::getRealtimePoolMisses() {
+	return s_nRealtimePoolMisses.load();
+}
+
+Note::SamplerVoice::SamplerVoice()
+	: nQueueIndex( -1 )
+	, nSerial( 0 )
+	, nStealIndex( -1 )
+	, nStealTier( 0 )
+	, fStealPriority( 0 )
+	, nEnvelopeFrames( 0 )
+{
+	for ( int ii = 0; ii < Indices; ++ii ) {
+		nKeys[ ii ] = 0;
+		nBuckets[ ii ] = -1;
+		pPrev[ ii ] = nullptr;
+		pNext[ ii ] = nullptr;
+		bSuperseded[ ii ] = false;
+	}
+}
+
 Note::Note( std::shared_ptr<Instrument> instrument, int position, float velocity, float pan, int length, float pitch )
 	: __instrument( instrument ),
 	  __instrument_id( 0 ),
@@ -50,11 +124,11 @@ Note::Note( std::shared_ptr<Instrument> instrument, int position, float velocity
 	  __pitch( pitch ),
 	  __key( C ),
 	  __octave( P8 ),
-	  __adsr( nullptr ),
 	  __lead_lag( 0.0 ),
 	  __cut_off( 1.0 ),
 	  __resonance( 0.0 ),
 	  __humanize_delay( 0 ),
+	  __layers_selected_size( 0 ),
 	  __bpfb_l( 0.0 ),
 	  __bpfb_r( 0.0 ),
 	  __lpfb_l( 0.0 ),
@@ -63,21 +137,33 @@ Note::Note( std::shared_ptr<Instrument> instrument, int position, float velocity
 	  __midi_msg( -1 ),
 	  __note_off( false ),
 	  __just_recorded( false ),
+	  __stolen( false ),
 	  __probability( 1.0f ),
 	  m_nNoteStart( 0 ),
-	  m_fUsedTickSize( std::nan("") )
+	  m_fUsedTickSize( std::nan("") ),
+	  m_nTempoRevision( -1 )
 {
 	if ( __instrument != nullptr ) {
-		__adsr = __instrument->copy_adsr();
+		__adsr = *__instrument->get_adsr();
 		__instrument_id = __instrument->get_id();
+		__cut_off = __instrument->get_filter_cutoff();
+		__resonance = __instrument->get_filter_resonance();
 
 		for ( const auto& pCompo : *__instrument->get_components() ) {
-
-			std::shared_ptr<SelectedLayerInfo> sampleInfo = std::make_shared<SelectedLayerInfo>();
-			sampleInfo->SelectedLayer = -1;
-			sampleInfo->SamplePosition = 0;
-
-			__layers_selected[ pCompo->get_drumkit_componentID() ] = sampleInfo;
+			const int nComponentID = pCompo->get_drumkit_componentID();
+			if ( get_layer_selected( nComponentID ) != nullptr ) {
+				continue;
+			}
+			if ( __layers_selected_size >= MAX_COMPONENTS ) {
+				ERRORLOG( QString( "Instrument [%1] exceeds the maximum number of components" )
+						  .arg( __instrument->get_name() ) );
+				break;
+			}
+			__layers_selected_ids[ __layers_selected_size ] = nComponentID;
+			__layers_selected[ __layers_selected_size ].SelectedLayer = -1;
+			__layers_selected[ __layers_selected_size ].SamplePosition = 0;
+			__layers_selected[ __layers_selected_size ].nPrefetchedFrame = 0;
+			++__layers_selected_size;
 		}
 	}
 
@@ -101,6 +187,7 @@ Note::Note( Note* other, std::shared_ptr<Instrument> instrument )
 	  __cut_off( other->get_cut_off() ),
 	  __resonance( other->get_resonance() ),
 	  __humanize_delay( other->get_humanize_delay() ),
+	  __layers_selected_size( other->__layers_selected_size ),
 	  __bpfb_l( other->get_bpfb_l() ),
 	  __bpfb_r( other->get_bpfb_r() ),
 	  __lpfb_l( other->get_lpfb_l() ),
@@ -109,22 +196,27 @@ Note::Note( Note* other, std::shared_ptr<Instrument> instrument )
 	  __midi_msg( other->get_midi_msg() ),
 	  __note_off( other->get_note_off() ),
 	  __just_recorded( other->get_just_recorded() ),
+	  __stolen( other->get_stolen() ),
 	  __probability( other->get_probability() ),
 	  m_nNoteStart( other->getNoteStart() ),
-	  m_fUsedTickSize( other->getUsedTickSize() )
+	  m_fUsedTickSize( other->getUsedTickSize() ),
+	  m_nTempoRevision( other->m_nTempoRevision )
 {
 	if ( instrument != nullptr ) __instrument = instrument;
 	if ( __instrument != nullptr ) {
-		__adsr = __instrument->copy_adsr();
+		__adsr = *__instrument->get_adsr();
 		__instrument_id = __instrument->get_id();
+		// The filter state of @a other was captured when it was
+		// created. Starting from the current settings of the
+		// instrument avoids a filter sweep in the first block
+		// rendered by applyFilter().
+		__cut_off = __instrument->get_filter_cutoff();
+		__resonance = __instrument->get_filter_resonance();
 	}
 
-	for ( const auto& mm : other->__layers_selected ) {
-		std::shared_ptr<SelectedLayerInfo> pSampleInfo = std::make_shared<SelectedLayerInfo>();
-		pSampleInfo->SelectedLayer = mm.second->SelectedLayer;
-		pSampleInfo->SamplePosition = mm.second->SamplePosition;
-		
-		__layers_selected[ mm.first ] = pSampleInfo;
+	for ( int ii = 0; ii < __layers_selected_size; ++ii ) {
+		__layers_selected_ids[ ii ] = other->__layers_selected_ids[ ii ];
+		__layers_selected[ ii ] = other->__layers_selected[ ii ];
 	}
 }
 
@@ -192,8 +284,8 @@ void Note::set_key_octave( const QString& str )
 bool Note::isPartiallyRendered() const {
 	bool bRes = false;
 
-	for ( auto ll : __layers_selected ) {
-		if ( ll.second->SamplePosition > 0 ) {
+	for ( int ii = 0; ii < __layers_selected_size; ++ii ) {
+		if ( __layers_selected[ ii ].SamplePosition > 0 ) {
 			bRes = true;
 			break;
 		}
@@ -202,16 +294,48 @@ bool Note::isPartiallyRendered() const {
 	return bRes;
 }
 
+void Note::applyFilter( const float* pIn_L, const float* pIn_R,
+						float* pOut_L, float* pOut_R, int nFrames ) {
+	if ( nFrames <= 0 ) {
+		return;
+	}
+
+	const float fCutoff = __instrument->get_filter_cutoff();
+	const float fResonance = __instrument->get_filter_resonance();
+
+	float fCutoffStep = 0;
+	float fResonanceStep = 0;
+	if ( fCutoff != __cut_off ) {
+		fCutoffStep = ( fCutoff - __cut_off ) / nFrames;
+	}
+	if ( fResonance != __resonance ) {
+		fResonanceStep = ( fResonance - __resonance ) / nFrames;
+	}
+
+	float state[ 4 ] = { __bpfb_l, __bpfb_r, __lpfb_l, __lpfb_r };
+	VectorMath::resonantLowPass( pIn_L, pIn_R, pOut_L, pOut_R, nFrames,
+								 __cut_off, fCutoffStep,
+								 __resonance, fResonanceStep, state );
+	__bpfb_l = state[ 0 ];
+	__bpfb_r = state[ 1 ];
+	__lpfb_l = state[ 2 ];
+	__lpfb_r = state[ 3 ];
+
+	__cut_off = fCutoff;
+	__resonance = fResonance;
+}
+
 void Note::computeNoteStart() {
+	auto pHydrogen = Hydrogen::get_instance();
+	auto pAudioEngine = pHydrogen->getAudioEngine();
+	m_nTempoRevision = pAudioEngine->getTempoRevision();
+
 	// Notes not inserted via the audio engine but directly, using
 	// e.g. the GUI, will be insert at position 0 and don't require a
 	// specific start position.
 	if ( __position == 0 ) {
 		return;
 	}
-	
-	auto pHydrogen = Hydrogen::get_instance();
-	auto pAudioEngine = pHydrogen->getAudioEngine();
 
 	double fTickMismatch;
 	m_nNoteStart =
@@ -232,6 +356,15 @@ void Note::computeNoteStart() {
 	}
 }
 
+long long Note::updateNoteStart() {
+	if ( m_nTempoRevision !=
+		 Hydrogen::get_instance()->getAudioEngine()->getTempoRevision() ) {
+		computeNoteStart();
+	}
+
+	return m_nNoteStart;
+}
+
 std::shared_ptr<Sample> Note::getSample( int nComponentID, int nSelectedLayer ) {
 
 	std::shared_ptr<Sample> pSample;
@@ -452,7 +585,7 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( "%1%2pitch: %3\n" ).arg( sPrefix ).arg( s ).arg( __pitch ) )
 			.append( QString( "%1%2key: %3\n" ).arg( sPrefix ).arg( s ).arg( __key ) )
 			.append( QString( "%1%2octave: %3\n" ).arg( sPrefix ).arg( s ).arg( __octave ) )
-			.append( QString( "%1" ).arg( __adsr->toQString( sPrefix + s, bShort ) ) )
+			.append( QString( "%1" ).arg( __adsr.toQString( sPrefix + s, bShort ) ) )
 			.append( QString( "%1%2lead_lag: %3\n" ).arg( sPrefix ).arg( s ).arg( __lead_lag ) )
 			.append( QString( "%1%2cut_off: %3\n" ).arg( sPrefix ).arg( s ).arg( __cut_off ) )
 			.append( QString( "%1%2resonance: %3\n" ).arg( sPrefix ).arg( s ).arg( __resonance ) )
@@ -466,16 +599,17 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( "%1%2midi_msg: %3\n" ).arg( sPrefix ).arg( s ).arg( __midi_msg ) )
 			.append( QString( "%1%2note_off: %3\n" ).arg( sPrefix ).arg( s ).arg( __note_off ) )
 			.append( QString( "%1%2just_recorded: %3\n" ).arg( sPrefix ).arg( s ).arg( __just_recorded ) )
+			.append( QString( "%1%2stolen: %3\n" ).arg( sPrefix ).arg( s ).arg( __stolen ) )
 			.append( QString( "%1%2probability: %3\n" ).arg( sPrefix ).arg( s ).arg( __probability ) )
 			.append( QString( "%1" ).arg( __instrument->toQString( sPrefix + s, bShort ) ) );
 		sOutput.append( QString( "%1%2layers_selected:\n" )
 						.arg( sPrefix ).arg( s ) );
-		for ( auto ll : __layers_selected ) {
+		for ( int ii = 0; ii < __layers_selected_size; ++ii ) {
 			sOutput.append( QString( "%1%2[component: %3, selected layer: %4, sample position: %5]\n" )
 							.arg( sPrefix ).arg( s + s )
-							.arg( ll.first )
-							.arg( ll.second->SelectedLayer )
-							.arg( ll.second->SamplePosition ) );
+							.arg( __layers_selected_ids[ ii ] )
+							.arg( __layers_selected[ ii ].SelectedLayer )
+							.arg( __layers_selected[ ii ].SamplePosition ) );
 		}
 	} else {
 
@@ -491,7 +625,7 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( ", pitch: %1" ).arg( __pitch ) )
 			.append( QString( ", key: %1" ).arg( __key ) )
 			.append( QString( ", octave: %1" ).arg( __octave ) )
-			.append( QString( ", [%1" ).arg( __adsr->toQString( sPrefix + s, bShort ).replace( "\n", "]" ) ) )
+			.append( QString( ", [%1" ).arg( __adsr.toQString( sPrefix + s, bShort ).replace( "\n", "]" ) ) )
 			.append( QString( ", lead_lag: %1" ).arg( __lead_lag ) )
 			.append( QString( ", cut_off: %1" ).arg( __cut_off ) )
 			.append( QString( ", resonance: %1" ).arg( __resonance ) )
@@ -505,14 +639,15 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( ", midi_msg: %1" ).arg( __midi_msg ) )
 			.append( QString( ", note_off: %1" ).arg( __note_off ) )
 			.append( QString( ", just_recorded: %1" ).arg( __just_recorded ) )
+			.append( QString( ", stolen: %1" ).arg( __stolen ) )
 			.append( QString( ", probability: %1" ).arg( __probability ) )
 			.append( QString( ", instrument: %1" ).arg( __instrument->get_name() ) )
 			.append( QString( ", layers_selected: " ) );
-		for ( auto ll : __layers_selected ) {
+		for ( int ii = 0; ii < __layers_selected_size; ++ii ) {
 			sOutput.append( QString( "[component: %1, selected layer: %2, sample position: %3] " )
-							.arg( ll.first )
-							.arg( ll.second->SelectedLayer )
-							.arg( ll.second->SamplePosition ) );
+							.arg( __layers_selected_ids[ ii ] )
+							.arg( __layers_selected[ ii ].SelectedLayer )
+							.arg( __layers_selected[ ii ].SamplePosition ) );
 		}
 	}
 	return sOutput;
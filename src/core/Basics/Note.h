@@ -23,9 +23,11 @@
 #ifndef H2C_NOTE_H
 #define H2C_NOTE_H
 
+#include <cstdint>
 #include <memory>
 
 #include <core/Object.h>
+#include <core/Basics/Adsr.h>
 #include <core/Basics/Instrument.h>
 #include <core/Basics/Sample.h>
 
@@ -54,19 +56,22 @@ namespace H2Core
 {
 
 class XMLNode;
-class ADSR;
 class Instrument;
 class InstrumentList;
+class RealtimePool;
 
 struct SelectedLayerInfo {
 	/** Selected layer during layer selection
 	 * 
-	 * If set to -1 (during creation), Sampler::renderNote() will
+	 * If set to -1 (during creation), Sampler::prepareNote() will
 	 * determine which layer to use and overrides this variable with
 	 * the corresponding value.
 	 */
 	int SelectedLayer;
 	float SamplePosition;	///< place marker for overlapping process() cycles
+	/** First frame of a streamed sample not requested from the
+	 * SampleStreamer yet. */
+	int nPrefetchedFrame;
 };
 
 /**
@@ -102,6 +107,102 @@ class Note : public H2Core::Object<Note>
 		/** destructor */
 		~Note();
 
+		/** Tag type of #realtime. */
+		struct RealtimeTag {};
+		/**
+		 * Allocates a note from the realtime pool instead of the
+		 * heap: new ( Note::realtime ) Note( ... ).
+		 *
+		 * To be used for all notes created and destroyed while
+		 * processing audio, e.g. the ones passed to the #Sampler. In
+		 * case the pool is exhausted or was not created yet, the
+		 * note is allocated on the heap. Both kinds of notes are
+		 * freed using plain delete.
+		 */
+		static const RealtimeTag realtime;
+
+		static void* operator new( size_t nSize );
+		static void* operator new( size_t nSize, const RealtimeTag& );
+		static void operator delete( void* pNote );
+		static void operator delete( void* pNote, const RealtimeTag& );
+
+		/**
+		 * Creates the pool used by new ( Note::realtime ).
+		 *
+		 * Called once in AudioEngine::AudioEngine(). Since notes
+		 * obtained from the pool may be released at any time, the
+		 * pool is never destroyed and subsequent calls have no
+		 * effect.
+		 *
+		 * \param nMaxNotes Maximum number of notes played at once
+		 * (Preferences::m_nMaxNotes). The pool holds a multiple of
+		 * it to account for notes queued in the AudioEngine as well.
+		 */
+		static void createRealtimePool( int nMaxNotes );
+		/** \return Pool used by new ( Note::realtime ) or nullptr. */
+		static RealtimePool* getRealtimePool();
+		/** \return Number of realtime notes which had to be
+		 * allocated on the heap as the pool was exhausted. */
+		static int getRealtimePoolMisses();
+
+		/**
+		 * Bookkeeping of the #Sampler while the note is playing.
+		 *
+		 * Besides its position in the queue of playing notes, the
+		 * note is linked into the lists of voices sharing the same
+		 * instrument, mute group, and MIDI key. This way all of them
+		 * can be found and removed without scanning all voices.
+		 *
+		 * Neither copied nor written to disk.
+		 */
+		struct SamplerVoice {
+			enum Index {
+				ByInstrument = 0,
+				ByMuteGroup = 1,
+				ByMidiKey = 2,
+				Indices = 3
+			};
+
+			SamplerVoice();
+
+			/** Position in Sampler::m_playingNotesQueue. -1 if the
+			 * note is not playing. */
+			int nQueueIndex;
+			/** Increasing number assigned when the note started
+			 * playing. */
+			long long nSerial;
+			/** Key the note is indexed by. Stored as the properties
+			 * of the instrument might change while the note is
+			 * playing. */
+			intptr_t nKeys[ Indices ];
+			/** Hash bucket of #nKeys. -1 if the note is not part of
+			 * the index. */
+			int nBuckets[ Indices ];
+			Note* pPrev[ Indices ];
+			Note* pNext[ Indices ];
+			/** Whether a more recent voice with the same key, which
+			 * was not stolen yet, is playing. Only maintained for
+			 * #ByInstrument and #ByMuteGroup. */
+			bool bSuperseded[ Indices ];
+			/** Position in the heap of voices which can be stolen
+			 * (see Sampler::stealVoices()). -1 if the note was
+			 * stolen already or is not playing. */
+			int nStealIndex;
+			/** 0 - already released, 1 - superseded by a more recent
+			 * voice of the same instrument or mute group, 2 - all
+			 * others. Lower tiers are stolen first. */
+			int nStealTier;
+			/** Within a tier the voice with the lowest value is
+			 * stolen first. */
+			double fStealPriority;
+			/** Number of frames the envelope of the note was
+			 * rendered for. Used to place the release of notes
+			 * with a length. */
+			long long nEnvelopeFrames;
+		};
+		/** \return Bookkeeping of the #Sampler. */
+		SamplerVoice* get_sampler_voice();
+
 		/*
 		 * save the note within the given XMLNode
 		 * \param node the XMLNode to feed
@@ -210,11 +311,20 @@ class Note : public H2Core::Object<Note>
 		void set_just_recorded( bool value );
 		/** #__just_recorded accessor */
 		bool get_just_recorded() const;
+		/**
+		 * #__stolen setter
+		 * \param value the new value
+		 */
+		void set_stolen( bool value );
+		/** #__stolen accessor */
+		bool get_stolen() const;
 
 		/*
 		 * selected sample
 		 * */
-	std::shared_ptr<SelectedLayerInfo> get_layer_selected( int CompoID );
+	/** \return Layer selection of the component with ID @a
+	 * CompoID or nullptr if the instrument holds no such component. */
+	SelectedLayerInfo* get_layer_selected( int CompoID );
 
 
 		void set_probability( float value );
@@ -285,7 +395,7 @@ class Note : public H2Core::Object<Note>
 		void set_midi_info( Key key, Octave octave, int msg );
 
 		/** get the ADSR of the note */
-		std::shared_ptr<ADSR> get_adsr() const;
+		ADSR* get_adsr();
 		/** call release on adsr */
 		//float release_adsr() const              { return __adsr->release(); }
 		/** call get value on adsr */
@@ -302,11 +412,21 @@ class Note : public H2Core::Object<Note>
 		bool match( const Note *pNote ) const;
 
 		/**
-		 * compute left and right output based on filters
-		 * \param val_l the left channel value
-		 * \param val_r the right channel value
+		 * Applies the resonant low pass filter of #__instrument to a
+		 * block of frames.
+		 *
+		 * The filter parameters of the instrument are read once per
+		 * block. Changes since the previous block are ramped
+		 * linearly across the frames to avoid zipper noise.
+		 *
+		 * \param pIn_L left input. May be the same as @a pOut_L.
+		 * \param pIn_R right input. May be the same as @a pOut_R.
+		 * \param pOut_L left output
+		 * \param pOut_R right output
+		 * \param nFrames number of frames to filter
 		 */
-		void compute_lr_values( float* val_l, float* val_r );
+		void applyFilter( const float* pIn_L, const float* pIn_R,
+						  float* pOut_L, float* pOut_R, int nFrames );
 
 	long long getNoteStart() const;
 	float getUsedTickSize() const;
@@ -327,6 +447,13 @@ class Note : public H2Core::Object<Note>
 	 * needs to be rerun.
 	 */
 	void computeNoteStart();
+	/**
+	 * Calls computeNoteStart() in case the tempo changed since
+	 * #m_nNoteStart was calculated.
+	 *
+	 * \return #m_nNoteStart
+	 */
+	long long updateNoteStart();
 	
 		/** Formatted string version for debugging purposes.
 		 * \param sPrefix String prefix which will be added in front of
@@ -380,11 +507,12 @@ class Note : public H2Core::Object<Note>
 		float			__pitch;              ///< the frequency of the note
 		Key				__key;                  ///< the key, [0;11]==[C;B]
 		Octave			 __octave;            ///< the octave [-3;3]
-		std::shared_ptr<ADSR>			__adsr;               ///< attack decay sustain release
+		ADSR			__adsr;               ///< attack decay sustain release
 		float			__lead_lag;           ///< lead or lag offset of the note
-		float			__cut_off;            ///< filter cutoff [0;1]
+		float			__cut_off;            ///< filter cutoff [0;1] used for the last filtered frame
 		float			__resonance;          ///< filter resonant
-											  ///frequency [0;1]
+											  ///frequency [0;1] used
+											  ///for the last filtered frame
 		/** Offset of the note start in frames.
 		 * 
 		 * It includes contributions of the onset humanization, the
@@ -395,7 +523,16 @@ class Note : public H2Core::Object<Note>
 		 * It is incorporated in the #m_nNoteStart.
 		 */
 		int				__humanize_delay;
-	std::map< int, std::shared_ptr<SelectedLayerInfo>> __layers_selected;
+		/** Layer selection of the components of #__instrument.
+		 *
+		 * Stored within the note itself - instead of a map - to not
+		 * allocate memory when creating notes on the audio thread.
+		 * Only the first #__layers_selected_size elements are used.
+		 */
+		SelectedLayerInfo __layers_selected[ MAX_COMPONENTS ];
+		/** Component IDs of the elements in #__layers_selected. */
+		int				__layers_selected_ids[ MAX_COMPONENTS ];
+		int				__layers_selected_size;
 		float			__bpfb_l;             ///< left band pass filter buffer
 		float			__bpfb_r;             ///< right band pass filter buffer
 		float			__lpfb_l;             ///< left low pass filter buffer
@@ -404,6 +541,7 @@ class Note : public H2Core::Object<Note>
 		int				__midi_msg;             ///< TODO
 		bool			__note_off;            ///< note type on|off
 		bool			__just_recorded;       ///< used in record+delete
+		bool			__stolen;              ///< fading out after being stolen by the #Sampler
 		float			__probability;        ///< note probability
 		static const char* __key_str[]; ///< used to build QString
 										///from #__key an #__octave
@@ -428,13 +566,28 @@ class Note : public H2Core::Object<Note>
 	 * during processing and not written to disk.
 	 */
 	float m_fUsedTickSize;
+	/**
+	 * AudioEngine::getTempoRevision() at the time #m_nNoteStart was
+	 * calculated. Used by updateNoteStart() to recalculate it lazily
+	 * after a change in tempo.
+	 *
+	 * This member is only used by the #AudioEngine and #Sampler
+	 * during processing and not written to disk.
+	 */
+	int m_nTempoRevision;
+	SamplerVoice m_samplerVoice;
 };
 
 // DEFINITIONS
 
-inline std::shared_ptr<ADSR> Note::get_adsr() const
+inline ADSR* Note::get_adsr()
+{
+	return &__adsr;
+}
+
+inline Note::SamplerVoice* Note::get_sampler_voice()
 {
-	return __adsr;
+	return &m_samplerVoice;
 }
 
 inline std::shared_ptr<Instrument> Note::get_instrument()
@@ -547,6 +700,16 @@ inline bool Note::get_just_recorded() const
 	return __just_recorded;
 }
 
+inline void Note::set_stolen( bool value )
+{
+	__stolen = value;
+}
+
+inline bool Note::get_stolen() const
+{
+	return __stolen;
+}
+
 inline float Note::get_probability() const
 {
 	return __probability;
@@ -557,9 +720,14 @@ inline void Note::set_probability( float value )
 	__probability = value;
 }
 
-inline std::shared_ptr<SelectedLayerInfo> Note::get_layer_selected( int CompoID )
+inline SelectedLayerInfo* Note::get_layer_selected( int CompoID )
 {
-	return __layers_selected[ CompoID ];
+	for ( int ii = 0; ii < __layers_selected_size; ++ii ) {
+		if ( __layers_selected_ids[ ii ] == CompoID ) {
+			return &__layers_selected[ ii ];
+		}
+	}
+	return nullptr;
 }
 
 inline void Note::set_humanize_delay( int value )
@@ -665,25 +833,6 @@ inline bool Note::match( const Note *pNote ) const
 	return match( pNote->__instrument, pNote->__key, pNote->__octave );
 }
 
-inline void Note::compute_lr_values( float* val_l, float* val_r )
-{
-	/* TODO ???
-	if( !has_instrument() ) {
-		*val_l = 0.0f;
-		*val_r = 0.0f;
-		return;
-	}
-	*/
-	float cut_off = __instrument->get_filter_cutoff();
-	float resonance = __instrument->get_filter_resonance();
-	__bpfb_l  =  resonance * __bpfb_l  + cut_off * ( *val_l - __lpfb_l );
-	__lpfb_l +=  cut_off   * __bpfb_l;
-	__bpfb_r  =  resonance * __bpfb_r  + cut_off * ( *val_r - __lpfb_r );
-	__lpfb_r +=  cut_off   * __bpfb_r;
-	*val_l = __lpfb_l;
-	*val_r = __lpfb_r;
-}
-
 inline long long Note::getNoteStart() const {
 	return m_nNoteStart;
 }
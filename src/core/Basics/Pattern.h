@@ -237,6 +237,9 @@ class Pattern : public H2Core::Object<Pattern>
 #define FOREACH_NOTE_CST_IT_BOUND(_notes,_it,_bound) \
 	for( Pattern::notes_cst_it_t _it=(_notes)->lower_bound((_bound)); (_it)!=(_notes)->end() && (_it)->first == (_bound); (_it)++ )
 
+#define FOREACH_NOTE_CST_IT_RANGE(_notes,_it,_start,_end) \
+	for( Pattern::notes_cst_it_t _it=(_notes)->lower_bound((_start)); (_it)!=(_notes)->end() && (_it)->first < (_end); (_it)++ )
+
 #define FOREACH_NOTE_IT_BEGIN_END(_notes,_it) \
 	for( Pattern::notes_it_t _it=(_notes)->begin(); (_it)!=(_notes)->end(); (_it)++ )
 
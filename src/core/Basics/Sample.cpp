@@ -22,12 +22,16 @@
 
 
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <limits>
 #include <memory>
 
 #include <core/Hydrogen.h>
 #include <core/Preferences/Preferences.h>
 #include <core/Helpers/Filesystem.h>
+#include <core/Helpers/SampleRateConverter.h>
 #include <core/Basics/Sample.h>
 #include <core/Basics/Note.h>
 
@@ -42,6 +46,8 @@ namespace H2Core
 
 const std::vector<QString> Sample::__loop_modes = { "forward", "reverse", "pingpong" };
 
+static_assert( sizeof( Sample::PackedInt24 ) == 3, "Unexpected size of packed 24 bit integers" );
+
 #if defined(H2CORE_HAVE_RUBBERBAND) || _DOXYGEN_
 static double compute_pitch_scale( const Sample::Rubberband& r );
 static RubberBand::RubberBandStretcher::Options compute_rubberband_options( const Sample::Rubberband& r );
@@ -69,6 +75,9 @@ Sample::Sample( const QString& filepath,  int frames, int sample_rate, float* da
 	__sample_rate( sample_rate ),
 	__data_l( data_l ),
 	__data_r( data_r ),
+	__format( Format::Float ),
+	__pcm_l( nullptr ),
+	__pcm_r( nullptr ),
 	__is_modified( false )
 {
 	assert( filepath.lastIndexOf( "/" ) >0 );
@@ -80,20 +89,40 @@ Sample::Sample( std::shared_ptr<Sample> pOther ): Object( *pOther ),
 	__sample_rate( pOther->get_sample_rate() ),
 	__data_l( nullptr ),
 	__data_r( nullptr ),
+	__format( Format::Float ),
+	__pcm_l( nullptr ),
+	__pcm_r( nullptr ),
 	__is_modified( pOther->get_is_modified() ),
 	__loops( pOther->__loops ),
 	__rubberband( pOther->__rubberband )
 {
 
-	__data_l = new float[__frames];
-	__data_r = new float[__frames];
-	
 	// Since the third argument of memcpy takes the number of bytes,
 	// which are about to be copied, and the data is given in float,
 	// which are  four bytes each, the number of copied frames
 	// `__frames` has to be multiplied by four.
-	memcpy( __data_l, pOther->get_data_l(), __frames * 4 );
-	memcpy( __data_r, pOther->get_data_r(), __frames * 4 );
+	// Copies of samples not loaded yet remain unloaded.
+	if ( pOther->get_data_l() != nullptr ) {
+		__data_l = new float[__frames];
+		memcpy( __data_l, pOther->get_data_l(), __frames * 4 );
+		if ( pOther->is_mono() ) {
+			__data_r = __data_l;
+		} else {
+			__data_r = new float[__frames];
+			memcpy( __data_r, pOther->get_data_r(), __frames * 4 );
+		}
+	} else if ( pOther->__pcm_l != nullptr ) {
+		const size_t nBytes = static_cast<size_t>( __frames ) * value_size( pOther->__format );
+		__format = pOther->__format;
+		__pcm_l = new char[ nBytes ];
+		memcpy( __pcm_l, pOther->__pcm_l, nBytes );
+		if ( pOther->is_mono() ) {
+			__pcm_r = __pcm_l;
+		} else {
+			__pcm_r = new char[ nBytes ];
+			memcpy( __pcm_r, pOther->__pcm_r, nBytes );
+		}
+	}
 	
 	PanEnvelope* pPan = pOther->get_pan_envelope();
 	for( int i=0; i<pPan->size(); i++ ) {
@@ -108,12 +137,43 @@ Sample::Sample( std::shared_ptr<Sample> pOther ): Object( *pOther ),
 
 Sample::~Sample()
 {
-	if ( __data_l != nullptr ) {
-		delete[] __data_l;
+	free_data();
+}
+
+void Sample::make_float()
+{
+	if ( __format == Format::Float ) {
+		return;
+	}
+	const bool bMono = is_mono();
+	float* data_l = new float[ __frames ];
+	float* data_r = bMono ? data_l : new float[ __frames ];
+	for ( int i = 0; i < __frames; ++i ) {
+		data_l[ i ] = get_value_l( i );
+	}
+	if ( ! bMono ) {
+		for ( int i = 0; i < __frames; ++i ) {
+			data_r[ i ] = get_value_r( i );
+		}
 	}
-	if ( __data_r != nullptr ) {
-		delete[] __data_r;
+	free_data();
+	__data_l = data_l;
+	__data_r = data_r;
+}
+
+void Sample::make_stereo()
+{
+	if ( ! is_mono() ) {
+		return;
 	}
+	make_float();
+	float* data_l = new float[ __frames ];
+	float* data_r = new float[ __frames ];
+	memcpy( data_l, __data_l, __frames * sizeof( float ) );
+	memcpy( data_r, __data_l, __frames * sizeof( float ) );
+	free_data();
+	__data_l = data_l;
+	__data_r = data_r;
 }
 
 void Sample::set_filename( const QString& filename )
@@ -124,7 +184,7 @@ void Sample::set_filename( const QString& filename )
 }
 
 
-std::shared_ptr<Sample> Sample::load( const QString& sFilepath )
+std::shared_ptr<Sample> Sample::load( const QString& sFilepath, int nSampleRate )
 {
 	std::shared_ptr<Sample> pSample;
 	
@@ -135,7 +195,7 @@ std::shared_ptr<Sample> Sample::load( const QString& sFilepath )
 
 	pSample = std::make_shared<Sample>( sFilepath );
 		
-	if( !pSample->load() ) {
+	if( !pSample->load( nSampleRate ) ) {
 		pSample.reset();
 		return pSample;
 	}
@@ -143,12 +203,57 @@ std::shared_ptr<Sample> Sample::load( const QString& sFilepath )
 	return pSample;
 }
 
-std::shared_ptr<Sample> Sample::load( const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan, float fBpm )
+std::shared_ptr<Sample> Sample::load( const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan, float fBpm, int nSampleRate )
 {
+	// Stretching is by far the most expensive transformation. Its
+	// results are kept in the SampleCache to make returning to a
+	// previous tempo cheap.
+	auto pPref = Preferences::get_instance();
+	const bool bUseCache = rubber.use && pPref != nullptr &&
+		pPref->m_bUseSampleCache && SampleCache::isCacheable( filepath ) &&
+		Filesystem::file_readable( filepath, true );
+	QString sVariant;
+	if ( bUseCache ) {
+		sVariant = transformations_to_key( loops, rubber, velocity, pan, fBpm );
+#ifdef H2CORE_HAVE_RUBBERBAND
+		sVariant.append( ";library" );
+#else
+		sVariant.append( ";cli" );
+#endif
+		if ( nSampleRate > 0 ) {
+			sVariant.append( ";" + sample_rate_variant( nSampleRate ) );
+		}
+
+		auto pSample = std::make_shared<Sample>( filepath );
+		if ( pSample->load_from_cache( sVariant ) ) {
+			pSample->__loops = loops;
+			pSample->__rubberband = rubber;
+			pSample->__velocity_envelope = velocity;
+			pSample->__pan_envelope = pan;
+			pSample->__is_modified = true;
+			return pSample;
+		}
+	}
+
 	auto pSample = Sample::load( filepath );
 	
 	if( pSample ){
 		pSample->apply( loops, rubber, velocity, pan, fBpm );
+		if ( nSampleRate > 0 ) {
+			pSample->convert_sample_rate( nSampleRate );
+		}
+
+		// Only store the sample in case stretching did succeed.
+		if ( bUseCache && pSample->get_rubberband().use ) {
+			pSample->make_float();
+			if ( SampleCache::store( filepath, pSample->__frames,
+									 pSample->__sample_rate, pSample->__data_l,
+									 pSample->__data_r, sVariant ) &&
+				 exceeds_streaming_threshold( pSample->__frames,
+											  pSample->is_mono() ) ) {
+				pSample->load_from_cache( sVariant );
+			}
+		}
 	}
 
 	return pSample;
@@ -166,8 +271,187 @@ void Sample::apply( const Loops& loops, const Rubberband& rubber, const Velocity
 #endif
 }
 
-bool Sample::load()
+static sf_count_t readChunk( SNDFILE* pFile, float* pBuffer, sf_count_t nFrames )
+{
+	return sf_readf_float( pFile, pBuffer, nFrames );
+}
+
+static sf_count_t readChunk( SNDFILE* pFile, short* pBuffer, sf_count_t nFrames )
+{
+	return sf_readf_short( pFile, pBuffer, nFrames );
+}
+
+static sf_count_t readChunk( SNDFILE* pFile, int* pBuffer, sf_count_t nFrames )
+{
+	return sf_readf_int( pFile, pBuffer, nFrames );
+}
+
+static inline void storeValue( float fValue, float* pDst )
+{
+	*pDst = fValue;
+}
+
+static inline void storeValue( short nValue, int16_t* pDst )
+{
+	*pDst = nValue;
+}
+
+static inline void storeValue( int nValue, Sample::PackedInt24* pDst )
+{
+	// libsndfile returns 24 bit PCM in the upper bytes of an int.
+	const uint32_t nBits = static_cast<uint32_t>( nValue );
+	pDst->bytes[ 0 ] = static_cast<uint8_t>( nBits >> 8 );
+	pDst->bytes[ 1 ] = static_cast<uint8_t>( nBits >> 16 );
+	pDst->bytes[ 2 ] = static_cast<uint8_t>( nBits >> 24 );
+}
+
+/**
+ * Reads @a nFrames frames of @a pFile as @a Decoded and stores them
+ * as @a Stored in @a pData_L and @a pData_R. Frames missing in the
+ * file are set to zero.
+ *
+ * The frames are split into left and right channel while reading
+ * the file in chunks. This way the interleaved frames are never
+ * held in memory all at once. If only one channel is present in
+ * the file, @a pData_L and @a pData_R have to be the same buffer.
+ *
+ * \return Number of frames read from @a pFile.
+ */
+template < typename Decoded, typename Stored >
+static sf_count_t readFrames( SNDFILE* pFile, int nFileChannels, sf_count_t nFrames,
+							  Stored* pData_L, Stored* pData_R )
+{
+	const sf_count_t nChunkFrames = 4096;
+	std::vector<Decoded> buffer( nChunkFrames * nFileChannels );
+	sf_count_t nReadFrames = 0;
+	while ( nReadFrames < nFrames ) {
+		const sf_count_t nCount =
+			readChunk( pFile, buffer.data(),
+					   std::min( nChunkFrames, nFrames - nReadFrames ) );
+		if ( nCount <= 0 ) {
+			break;
+		}
+		if ( pData_L == pData_R ) {
+			for ( sf_count_t i = 0; i < nCount; i++ ) {
+				storeValue( buffer[ i ], &pData_L[ nReadFrames + i ] );
+			}
+		} else {
+			for ( sf_count_t i = 0; i < nCount; i++ ) {
+				storeValue( buffer[ i * nFileChannels ], &pData_L[ nReadFrames + i ] );
+				storeValue( buffer[ i * nFileChannels + 1 ], &pData_R[ nReadFrames + i ] );
+			}
+		}
+		nReadFrames += nCount;
+	}
+	for ( sf_count_t i = nReadFrames; i < nFrames; i++ ) {
+		storeValue( Decoded( 0 ), &pData_L[ i ] );
+		storeValue( Decoded( 0 ), &pData_R[ i ] );
+	}
+	return nReadFrames;
+}
+
+/** Allocates a buffer for @a nFrames values of @a Stored and reads
+ * them using readFrames(). */
+template < typename Decoded, typename Stored >
+static sf_count_t readCompactFrames( SNDFILE* pFile, int nFileChannels, sf_count_t nFrames,
+									 char** ppData_L, char** ppData_R )
+{
+	const size_t nBytes = static_cast<size_t>( nFrames ) * sizeof( Stored );
+	*ppData_L = new char[ nBytes ];
+	*ppData_R = nFileChannels == 1 ? *ppData_L : new char[ nBytes ];
+	return readFrames<Decoded>( pFile, nFileChannels, nFrames,
+								reinterpret_cast<Stored*>( *ppData_L ),
+								reinterpret_cast<Stored*>( *ppData_R ) );
+}
+
+/** \return Format a sample encoded in @a nFileFormat can be stored
+ * in without loss of precision. */
+static Sample::Format compactFormat( int nFileFormat )
+{
+	switch ( nFileFormat & SF_FORMAT_SUBMASK ) {
+	case SF_FORMAT_PCM_S8:
+	case SF_FORMAT_PCM_U8:
+	case SF_FORMAT_PCM_16:
+		return Sample::Format::Int16;
+	case SF_FORMAT_PCM_24:
+		return Sample::Format::Int24;
+	default:
+		return Sample::Format::Float;
+	}
+}
+
+bool Sample::load( int nSampleRate )
+{
+	auto pPref = Preferences::get_instance();
+	const bool bUseCache = pPref != nullptr && pPref->m_bUseSampleCache &&
+		SampleCache::isCacheable( __filepath );
+	if ( nSampleRate > 0 && bUseCache &&
+		 load_from_cache( sample_rate_variant( nSampleRate ) ) ) {
+		return true;
+	}
+
+	if ( ! load_file( nSampleRate ) ) {
+		return false;
+	}
+	if ( nSampleRate <= 0 || ! convert_sample_rate( nSampleRate ) ) {
+		return true;
+	}
+
+	if ( bUseCache &&
+		 SampleCache::store( __filepath, __frames, __sample_rate, __data_l, __data_r,
+							 sample_rate_variant( nSampleRate ) ) &&
+		 exceeds_streaming_threshold( __frames, is_mono() ) ) {
+		load_from_cache( sample_rate_variant( nSampleRate ) );
+	}
+
+	return true;
+}
+
+QString Sample::sample_rate_variant( int nSampleRate )
 {
+	return QString( "rate=%1" ).arg( nSampleRate );
+}
+
+static QString envelope_to_key( const Sample::VelocityEnvelope& envelope )
+{
+	QString sKey;
+	for ( const auto& point : envelope ) {
+		sKey.append( QString( "%1:%2," ).arg( point.frame ).arg( point.value ) );
+	}
+	return sKey;
+}
+
+QString Sample::transformations_to_key( const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan, float fBpm )
+{
+	QString sKey = QString( "loops=%1,%2,%3,%4,%5;" )
+		.arg( loops.start_frame ).arg( loops.loop_frame )
+		.arg( loops.end_frame ).arg( loops.count )
+		.arg( static_cast<int>( loops.mode ) );
+	if ( rubber.use ) {
+		sKey.append( QString( "rubberband=%1,%2,%3,%4;" )
+					 .arg( rubber.divider, 0, 'g', 9 )
+					 .arg( rubber.pitch, 0, 'g', 9 )
+					 .arg( rubber.c_settings )
+					 .arg( fBpm, 0, 'g', 9 ) );
+	}
+	sKey.append( QString( "velocity=%1;pan=%2" )
+				 .arg( envelope_to_key( velocity ) )
+				 .arg( envelope_to_key( pan ) ) );
+	return sKey;
+}
+
+bool Sample::load_file( int nSampleRate )
+{
+	auto pPref = Preferences::get_instance();
+	const bool bUseCache = pPref != nullptr && pPref->m_bUseSampleCache &&
+		SampleCache::isCacheable( __filepath );
+	// The cache holds floats. Whether a sample can be stored
+	// compactly is only known after opening its file.
+	const bool bCompact = pPref != nullptr && pPref->m_bUseCompactSamples;
+	if ( bUseCache && ! bCompact && load_from_cache() ) {
+		return true;
+	}
+
 	// Will contain a bunch of metadata about the loaded sample.
 	SF_INFO sound_info = {0};
 
@@ -178,6 +462,10 @@ bool Sample::load()
 		return false;
 	}
 	
+	// Number of channels of the interleaved frames read from the
+	// file.
+	const int nFileChannels = sound_info.channels;
+
 	// Sanity check. SAMPLE_CHANNELS is defined in
 	// core/include/hydrogen/globals.h and set to 2.
 	if ( sound_info.channels > SAMPLE_CHANNELS ) {
@@ -189,18 +477,47 @@ bool Sample::load()
 		sound_info.frames = ( std::numeric_limits<int>::max()/sound_info.channels );
 	}
 
-	// Create an array, which will hold the block of samples read
-	// from file.
-	float* buffer = new float[ sound_info.frames * sound_info.channels ];
-	
-	//memset( buffer, 0, sound_info.frames *sound_info.channels );
-	
-	// Read all frames into `buffer'. Libsndfile does seamlessly
-	// convert the format of the underlying data on the fly. The
-	// output will be an array of floats regardless of file's
-	// encoding (e.g. 16 bit PCM).
-	sf_count_t count = sf_read_float( file, buffer, sound_info.frames * sound_info.channels );
-	if( count==0 ){
+	const bool bMono = nFileChannels == 1;
+	// Samples converted to another rate end up as floats anyway.
+	const bool bConvert = nSampleRate > 0 && sound_info.samplerate != nSampleRate;
+
+	// Large samples are streamed as floats from the cache instead.
+	Format format = Format::Float;
+	if ( bCompact && ! bConvert && ! ( bUseCache &&
+						 exceeds_streaming_threshold( sound_info.frames, bMono ) ) ) {
+		format = compactFormat( sound_info.format );
+	}
+	if ( bCompact && format == Format::Float && bUseCache && load_from_cache() ) {
+		sf_close( file );
+		return true;
+	}
+
+	// Libsndfile does seamlessly convert the format of the
+	// underlying data on the fly. Unless stored compactly, the
+	// output will be floats regardless of file's encoding (e.g. 16
+	// bit PCM). If only one channel was present in the underlying
+	// data, both channels share a single buffer.
+	float* data_l = nullptr;
+	float* data_r = nullptr;
+	char* pcm_l = nullptr;
+	char* pcm_r = nullptr;
+	sf_count_t nReadFrames;
+	switch ( format ) {
+	case Format::Int16:
+		nReadFrames = readCompactFrames<short, int16_t>(
+			file, nFileChannels, sound_info.frames, &pcm_l, &pcm_r );
+		break;
+	case Format::Int24:
+		nReadFrames = readCompactFrames<int, PackedInt24>(
+			file, nFileChannels, sound_info.frames, &pcm_l, &pcm_r );
+		break;
+	default:
+		data_l = new float[ sound_info.frames ];
+		data_r = bMono ? data_l : new float[ sound_info.frames ];
+		nReadFrames = readFrames<float>( file, nFileChannels, sound_info.frames,
+										 data_l, data_r );
+	}
+	if ( nReadFrames == 0 ) {
 		WARNINGLOG( QString( "%1 is an empty sample" ).arg( __filepath ) );
 	}
 	
@@ -217,88 +534,106 @@ bool Sample::load()
 	// of the Sample class.
 	__frames = sound_info.frames;
 	__sample_rate = sound_info.samplerate;
-
-	// Split the loaded frames into left and right channel. 
-	// If only one channels was present in the underlying data,
-	// duplicate its content.
-	__data_l = new float[ sound_info.frames ];
-	__data_r = new float[ sound_info.frames ];
-	if ( sound_info.channels == 1 ) {
-		memcpy( __data_l, buffer, __frames * sizeof( float ) );
-		memcpy( __data_r, buffer, __frames * sizeof( float ) );
-	} else if ( sound_info.channels == SAMPLE_CHANNELS ) {
-		for ( int i = 0; i < __frames; i++ ) {
-			__data_l[i] = buffer[i * SAMPLE_CHANNELS ];
-			__data_r[i] = buffer[i * SAMPLE_CHANNELS + 1 ];
-		}
+	__data_l = data_l;
+	__data_r = data_r;
+	__format = format;
+	__pcm_l = pcm_l;
+	__pcm_r = pcm_r;
+
+	if ( bUseCache && format == Format::Float && ! bConvert &&
+		 SampleCache::store( __filepath, __frames, __sample_rate, __data_l, __data_r ) &&
+		 exceeds_streaming_threshold( __frames, is_mono() ) ) {
+		// Large samples are streamed from the cache file right
+		// away instead of being held in memory.
+		load_from_cache();
 	}
-	delete[] buffer;
 
 	return true;
 }
 
-bool Sample::apply_loops( const Loops& lo )
+bool Sample::exceeds_streaming_threshold( int nFrames, bool bMono )
 {
-	if( __loops == lo ) {
-		return true;
-	}
-	if( lo.start_frame<0 ) {
-		ERRORLOG( QString( "start_frame %1 < 0 is not allowed" ).arg( lo.start_frame ) );
-		return false;
-	}
-	if( lo.loop_frame<lo.start_frame ) {
-		ERRORLOG( QString( "loop_frame %1 < start_frame %2 is not allowed" ).arg( lo.loop_frame ).arg( lo.start_frame ) );
-		return false;
-	}
-	if( lo.end_frame<lo.loop_frame ) {
-		ERRORLOG( QString( "end_frame %1 < loop_frame %2 is not allowed" ).arg( lo.end_frame ).arg( lo.loop_frame ) );
-		return false;
-	}
-	if( lo.end_frame>__frames ) {
-		ERRORLOG( QString( "end_frame %1 > __frames %2 is not allowed" ).arg( lo.end_frame ).arg( __frames ) );
+	const int nThreshold = Preferences::get_instance()->m_nStreamingThreshold;
+	const long long nBytes = static_cast<long long>( nFrames ) * sizeof( float ) *
+		( bMono ? 1 : 2 );
+	return nThreshold > 0 && nBytes >= static_cast<long long>( nThreshold ) * 1024 * 1024;
+}
+
+bool Sample::load_from_cache( const QString& sVariant )
+{
+	int nFrames, nSampleRate;
+	float* pData_L;
+	float* pData_R;
+	auto pMapping = SampleCache::map( __filepath, &nFrames, &nSampleRate,
+									  &pData_L, &pData_R, sVariant );
+	if ( pMapping == nullptr ) {
 		return false;
 	}
-	if( lo.count<0 ) {
-		ERRORLOG( QString( "count %1 < 0 is not allowed" ).arg( lo.count ) );
-		return false;
+
+	unload();
+	__frames = nFrames;
+	__sample_rate = nSampleRate;
+	__data_l = pData_L;
+	__data_r = pData_R;
+	__mapping = std::move( pMapping );
+	prepare_mapping();
+
+	return true;
+}
+
+void Sample::prepare_mapping()
+{
+	const bool bStreamed = exceeds_streaming_threshold( __frames, is_mono() );
+	__mapping->setStreamed( bStreamed );
+	if ( bStreamed ) {
+		const int nPreloadFrames =
+			std::min( __frames, static_cast<int>(
+						  static_cast<long long>( Preferences::get_instance()->m_nStreamingPreload ) *
+						  __sample_rate / 1000 ) );
+		bool bLocked = SampleCache::lock( __data_l, nPreloadFrames );
+		if ( ! is_mono() ) {
+			bLocked = SampleCache::lock( __data_r, nPreloadFrames ) && bLocked;
+		}
+		static std::atomic<bool> bWarned( false );
+		if ( ! bLocked && ! bWarned.exchange( true ) ) {
+			WARNINGLOG( QString( "Unable to lock the beginning of streamed sample [%1] in memory. Consider raising RLIMIT_MEMLOCK." )
+						.arg( __filepath ) );
+		}
+	} else {
+		// Avoid page faults in the audio thread.
+		SampleCache::populate( __data_l, __frames );
+		if ( ! is_mono() ) {
+			SampleCache::populate( __data_r, __frames );
+		}
 	}
-	//if( lo == __loops ) return true;
+}
 
+void Sample::apply_loops_to_channel( const float* pData, float* pNewData, const Loops& lo )
+{
 	bool full_loop = lo.start_frame==lo.loop_frame;
 	int full_length =  lo.end_frame - lo.start_frame;
 	int loop_length =  lo.end_frame - lo.loop_frame;
 	int new_length = full_length + loop_length * lo.count;
 
-	float* new_data_l = new float[ new_length ];
-	float* new_data_r = new float[ new_length ];
-
 	// copy full_length frames to new_data
 	if ( lo.mode==Loops::REVERSE && ( lo.count==0 || full_loop ) ) {
 		if( full_loop ) {
 			// copy end => start
 			for( int i=0, j=lo.end_frame; i<full_length; i++, j-- ) {
-				new_data_l[i]=__data_l[j];
-			}
-			for( int i=0, j=lo.end_frame; i<full_length; i++, j-- ) {
-				new_data_r[i]=__data_r[j];
+				pNewData[i]=pData[j];
 			}
 		} else {
 			// copy start => loop
 			int to_loop = lo.loop_frame - lo.start_frame;
-			memcpy( new_data_l, __data_l+lo.start_frame, sizeof( float )*to_loop );
-			memcpy( new_data_r, __data_r+lo.start_frame, sizeof( float )*to_loop );
+			memcpy( pNewData, pData+lo.start_frame, sizeof( float )*to_loop );
 			// copy end => loop
 			for( int i=to_loop, j=lo.end_frame; i<full_length; i++, j-- ) {
-				new_data_l[i]=__data_l[j];
-			}
-			for( int i=to_loop, j=lo.end_frame; i<full_length; i++, j-- ) {
-				new_data_r[i]=__data_r[j];
+				pNewData[i]=pData[j];
 			}
 		}
 	} else {
 		// copy start => end
-		memcpy( new_data_l, __data_l+lo.start_frame, sizeof( float )*full_length );
-		memcpy( new_data_r, __data_r+lo.start_frame, sizeof( float )*full_length );
+		memcpy( pNewData, pData+lo.start_frame, sizeof( float )*full_length );
 	}
 	// copy the loops
 	if( lo.count>0 ) {
@@ -308,15 +643,11 @@ bool Sample::apply_loops( const Loops& lo )
 		for( int i=0; i<lo.count; i++ ) {
 			if ( forward ) {
 				// copy loop => end
-				memcpy( &new_data_l[x], __data_l+lo.loop_frame, sizeof( float )*loop_length );
-				memcpy( &new_data_r[x], __data_r+lo.loop_frame, sizeof( float )*loop_length );
+				memcpy( &pNewData[x], pData+lo.loop_frame, sizeof( float )*loop_length );
 			} else {
 				// copy end => loop
 				for( int i=lo.end_frame, y=x; i>lo.loop_frame; i--, y++ ) {
-					new_data_l[y]=__data_l[i];
-				}
-				for( int i=lo.end_frame, y=x; i>lo.loop_frame; i--, y++ ) {
-					new_data_r[y]=__data_r[i];
+					pNewData[y]=pData[i];
 				}
 			}
 			x+=loop_length;
@@ -326,9 +657,50 @@ bool Sample::apply_loops( const Loops& lo )
 		}
 		assert( x==new_length );
 	}
+}
+
+bool Sample::apply_loops( const Loops& lo )
+{
+	if( __loops == lo ) {
+		return true;
+	}
+	if( lo.start_frame<0 ) {
+		ERRORLOG( QString( "start_frame %1 < 0 is not allowed" ).arg( lo.start_frame ) );
+		return false;
+	}
+	if( lo.loop_frame<lo.start_frame ) {
+		ERRORLOG( QString( "loop_frame %1 < start_frame %2 is not allowed" ).arg( lo.loop_frame ).arg( lo.start_frame ) );
+		return false;
+	}
+	if( lo.end_frame<lo.loop_frame ) {
+		ERRORLOG( QString( "end_frame %1 < loop_frame %2 is not allowed" ).arg( lo.end_frame ).arg( lo.loop_frame ) );
+		return false;
+	}
+	if( lo.end_frame>__frames ) {
+		ERRORLOG( QString( "end_frame %1 > __frames %2 is not allowed" ).arg( lo.end_frame ).arg( __frames ) );
+		return false;
+	}
+	if( lo.count<0 ) {
+		ERRORLOG( QString( "count %1 < 0 is not allowed" ).arg( lo.count ) );
+		return false;
+	}
+	//if( lo == __loops ) return true;
+
+	int new_length = ( lo.end_frame - lo.start_frame ) +
+		( lo.end_frame - lo.loop_frame ) * lo.count;
+
+	make_float();
+
+	float* new_data_l = new float[ new_length ];
+	apply_loops_to_channel( __data_l, new_data_l, lo );
+	float* new_data_r = new_data_l;
+	if ( ! is_mono() ) {
+		new_data_r = new float[ new_length ];
+		apply_loops_to_channel( __data_r, new_data_r, lo );
+	}
+
 	__loops = lo;
-	delete[] __data_l;
-	delete[] __data_r;
+	free_data();
 	__data_l = new_data_l;
 	__data_r = new_data_r;
 	__frames = new_length;
@@ -349,6 +721,7 @@ void Sample::apply_velocity( const VelocityEnvelope& v )
 	
 	__velocity_envelope.clear();
 	if ( v.size() > 0 ) {
+		make_float();
 		float inv_resolution = __frames / 841.0F;
 		for ( int i = 1; i < v.size(); i++ ) {
 			float y = ( 91 - v[i - 1].value ) / 91.0F;
@@ -360,9 +733,12 @@ void Sample::apply_velocity( const VelocityEnvelope& v )
 			}
 			int length = end_frame - start_frame ;
 			float step = ( y - k ) / length;;
+			const bool bMono = is_mono();
 			for ( int z = start_frame ; z < end_frame; z++ ) {
 				__data_l[z] = __data_l[z] * y;
-				__data_r[z] = __data_r[z] * y;
+				if ( ! bMono ) {
+					__data_r[z] = __data_r[z] * y;
+				}
 				y-=step;
 			}
 		}
@@ -384,6 +760,9 @@ void Sample::apply_pan( const PanEnvelope& p )
 	
 	__pan_envelope.clear();
 	if ( p.size() > 0 ) {
+		// Panning renders the channels different from each other.
+		make_float();
+		make_stereo();
 		float inv_resolution = __frames / 841.0F;
 		for ( int i = 1; i < p.size(); i++ ) {
 			float y = ( 45 - p[i - 1].value ) / 45.0F;
@@ -426,6 +805,7 @@ void Sample::apply_rubberband( const Rubberband& rb, float fBpm ) {
 	if( !rb.use ){
 		return;
 	}
+	make_float();
 	// compute rubberband options
 	double output_duration = 60.0 / fBpm * rb.divider;
 	double time_ratio = output_duration / get_sample_duration();
@@ -440,8 +820,10 @@ void Sample::apply_rubberband( const Rubberband& rb, float fBpm ) {
 	// place to cover the more frequent situations of a difference of
 	// just one frame.
 	int out_buffer_size = static_cast<int>( __frames * time_ratio + 0.1 + 10 );
-	// instantiate rubberband
-	RubberBand::RubberBandStretcher rubber = RubberBand::RubberBandStretcher( __sample_rate, 2, options, time_ratio, pitch_scale );
+	// instantiate rubberband. Mono samples are stretched using a
+	// single channel.
+	const bool bMono = is_mono();
+	RubberBand::RubberBandStretcher rubber = RubberBand::RubberBandStretcher( __sample_rate, bMono ? 1 : 2, options, time_ratio, pitch_scale );
 	rubber.setDebugLevel( RUBBERBAND_DEBUG );
 	// This option will be ignored in real-time processing.
 	rubber.setExpectedInputDuration( __frames );
@@ -570,12 +952,15 @@ void Sample::apply_rubberband( const Rubberband& rb, float fBpm ) {
 		retrieved += n;
 	}
 	
-	delete [] __data_l;
-	delete [] __data_r;
+	free_data();
 	__data_l = new float[ retrieved ];
-	__data_r = new float[ retrieved ];
 	memcpy( __data_l, out_data_l, retrieved*sizeof( float ) );
-	memcpy( __data_r, out_data_r, retrieved*sizeof( float ) );
+	if ( bMono ) {
+		__data_r = __data_l;
+	} else {
+		__data_r = new float[ retrieved ];
+		memcpy( __data_r, out_data_r, retrieved*sizeof( float ) );
+	}
 	delete [] out_data_l;
 	delete [] out_data_r;
 
@@ -597,9 +982,14 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb, float fBpm )
 	}
 
 	if( rb.use ) {
-		QString outfilePath =  QDir::tempPath() + "/tmp_rb_outfile.wav";
+		// Unique file names allow several samples to be stretched
+		// concurrently.
+		QString outfilePath = Filesystem::tmp_file_path( "rb_outfile.wav" );
+		QString rubberResultPath = Filesystem::tmp_file_path( "rb_result.wav" );
 		if( !write( outfilePath ) ) {
 			ERRORLOG( "unable to write sample" );
+			QFile( outfilePath ).remove();
+			QFile( rubberResultPath ).remove();
 			return false;
 		};
 
@@ -621,7 +1011,6 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb, float fBpm )
 		QString rCs = QString( " %1" ).arg( rb.c_settings );
 		float fFrequency = Note::pitchToFrequency( ( double )rb.pitch );
 		QString rFs = QString( " %1" ).arg( fFrequency );
-		QString rubberResultPath = QDir::tempPath() + "/tmp_rb_result_file.wav";
 
 		arguments << "-D" << QString( " %1" ).arg( durationtime ) 	//stretch or squash to make output file X seconds long
 		          << "--threads"					//assume multi-CPU even if only one CPU is identified
@@ -639,26 +1028,31 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb, float fBpm )
 		}
 
 		delete pRubberbandProc;
+		QFile( outfilePath ).remove();
 		if ( QFile( rubberResultPath ).exists() == false ) {
 			_ERRORLOG( QString( "Rubberband reimporter File %1 not found" ).arg( rubberResultPath ) );
 			return false;
 		}
 
 		auto p_Rubberbanded = Sample::load( rubberResultPath.toLocal8Bit() );
+		QFile( rubberResultPath ).remove();
 		if( p_Rubberbanded == nullptr ) {
 			return false;
 		}
 
-		QFile( outfilePath ).remove();
-
-		QFile( rubberResultPath ).remove();
-
 		__frames = p_Rubberbanded->get_frames();
 
+		free_data();
 		__data_l = p_Rubberbanded->get_data_l();
 		__data_r = p_Rubberbanded->get_data_r();
+		__format = p_Rubberbanded->__format;
+		__pcm_l = p_Rubberbanded->__pcm_l;
+		__pcm_r = p_Rubberbanded->__pcm_r;
+		__mapping = std::move( p_Rubberbanded->__mapping );
 		p_Rubberbanded->__data_l = nullptr;
 		p_Rubberbanded->__data_r = nullptr;
+		p_Rubberbanded->__pcm_l = nullptr;
+		p_Rubberbanded->__pcm_r = nullptr;
 
 		__is_modified = true;
 		__rubberband = rb;
@@ -666,6 +1060,124 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb, float fBpm )
 	return true;
 }
 
+bool Sample::convert_sample_rate( int nSampleRate )
+{
+	if ( is_empty() || nSampleRate <= 0 || __sample_rate <= 0 ||
+		 nSampleRate == __sample_rate ) {
+		return false;
+	}
+	make_float();
+
+	const SampleRateConverter converter( __sample_rate, nSampleRate );
+	const int nFrames = converter.getFrames( __frames );
+	const bool bMono = is_mono();
+	float* data_l = new float[ nFrames ];
+	float* data_r = bMono ? data_l : new float[ nFrames ];
+	converter.process( __data_l, __frames, data_l );
+	if ( ! bMono ) {
+		converter.process( __data_r, __frames, data_r );
+	}
+
+	free_data();
+	__frames = nFrames;
+	__sample_rate = nSampleRate;
+	__data_l = data_l;
+	__data_r = data_r;
+	return true;
+}
+
+void Sample::detect_silence( float fLevel, int* pnStart, int* pnEnd ) const
+{
+	const bool bMono = is_mono();
+	auto isAudible = [&]( int nFrame ) {
+		return std::fabs( get_value_l( nFrame ) ) > fLevel ||
+			( ! bMono && std::fabs( get_value_r( nFrame ) ) > fLevel );
+	};
+
+	int nStart = 0;
+	while ( nStart < __frames && ! isAudible( nStart ) ) {
+		++nStart;
+	}
+	int nEnd = __frames;
+	while ( nEnd > nStart && ! isAudible( nEnd - 1 ) ) {
+		--nEnd;
+	}
+
+	*pnStart = nStart;
+	*pnEnd = nEnd;
+}
+
+bool Sample::trim_silence( float fThreshold, const QString& sVariant )
+{
+	if ( is_empty() || __frames <= 1 ) {
+		return false;
+	}
+
+	auto pPref = Preferences::get_instance();
+	const bool bUseCache = pPref != nullptr && pPref->m_bUseSampleCache &&
+		SampleCache::isCacheable( __filepath );
+	int nStart, nEnd;
+	if ( ! bUseCache ||
+		 ! SampleCache::readTrimRange( __filepath, sVariant, fThreshold, __frames,
+									   &nStart, &nEnd ) ) {
+		detect_silence( std::pow( 10.0f, fThreshold / 20.0f ), &nStart, &nEnd );
+		if ( bUseCache ) {
+			SampleCache::storeTrimRange( __filepath, sVariant, fThreshold, __frames,
+										 nStart, nEnd );
+		}
+	}
+
+	// Keep a single frame of entirely silent samples.
+	if ( nStart == nEnd ) {
+		nStart = 0;
+		nEnd = 1;
+	}
+	if ( nStart == 0 && nEnd == __frames ) {
+		return false;
+	}
+
+	const int nOldFrames = __frames;
+	const int nFrames = nEnd - nStart;
+	const bool bMono = is_mono();
+	if ( __mapping != nullptr ) {
+		// The mapping is released as a whole.
+		__data_l += nStart;
+		__data_r = bMono ? __data_l : __data_r + nStart;
+		__frames = nFrames;
+		prepare_mapping();
+	} else if ( __format == Format::Float ) {
+		float* data_l = new float[ nFrames ];
+		float* data_r = bMono ? data_l : new float[ nFrames ];
+		memcpy( data_l, __data_l + nStart, nFrames * sizeof( float ) );
+		if ( ! bMono ) {
+			memcpy( data_r, __data_r + nStart, nFrames * sizeof( float ) );
+		}
+		free_data();
+		__data_l = data_l;
+		__data_r = data_r;
+		__frames = nFrames;
+	} else {
+		const Format format = __format;
+		const size_t nValueSize = value_size( format );
+		char* pcm_l = new char[ nFrames * nValueSize ];
+		char* pcm_r = bMono ? pcm_l : new char[ nFrames * nValueSize ];
+		memcpy( pcm_l, __pcm_l + nStart * nValueSize, nFrames * nValueSize );
+		if ( ! bMono ) {
+			memcpy( pcm_r, __pcm_r + nStart * nValueSize, nFrames * nValueSize );
+		}
+		free_data();
+		__format = format;
+		__pcm_l = pcm_l;
+		__pcm_r = pcm_r;
+		__frames = nFrames;
+	}
+
+	INFOLOG( QString( "Trimmed %1 leading and %2 trailing frames of [%3]" )
+			 .arg( nStart ).arg( nOldFrames - nEnd )
+			 .arg( __filepath ) );
+	return true;
+}
+
 Sample::Loops::LoopMode Sample::parse_loop_mode( const QString& sMode )
 {
 	if ( sMode == "forward" ) {
@@ -683,8 +1195,8 @@ bool Sample::write( const QString& path, int format )
 {
 	float* obuf = new float[ SAMPLE_CHANNELS * __frames ];
 	for ( int i = 0; i < __frames; ++i ) {
-		float value_l = __data_l[i];
-		float value_r = __data_r[i];
+		float value_l = get_value_l( i );
+		float value_r = get_value_r( i );
 		
 		if ( value_l > 1.f ) {
 			value_l = 1.f;
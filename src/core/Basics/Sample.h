@@ -23,11 +23,13 @@
 #ifndef H2C_SAMPLE_H
 #define H2C_SAMPLE_H
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <sndfile.h>
 
 #include <core/Object.h>
+#include <core/Helpers/SampleCache.h>
 
 namespace H2Core
 {
@@ -128,6 +130,31 @@ class Sample : public H2Core::Object<Sample>
 				QString toQString( const QString& sPrefix, bool bShort ) const;
 		};
 
+		/**
+		 * Type used to hold the frames of the sample in memory.
+		 *
+		 * Samples are stored as floats by default. With
+		 * Preferences::m_bUseCompactSamples enabled, the frames of
+		 * 8 and 16 bit PCM files are held as int16_t and those of
+		 * 24 bit PCM files as #PackedInt24 instead, halving or
+		 * reducing by a quarter the memory they occupy. They are
+		 * converted to float while being rendered.
+		 */
+		enum class Format {
+			/** #__data_l and #__data_r hold floats. */
+			Float = 0,
+			/** #__pcm_l and #__pcm_r hold int16_t. */
+			Int16 = 1,
+			/** #__pcm_l and #__pcm_r hold #PackedInt24. */
+			Int24 = 2
+		};
+
+		/** Signed 24 bit integer stored in three bytes, least
+		 * significant byte first. */
+		struct PackedInt24 {
+			uint8_t bytes[ 3 ];
+		};
+
 		/**
 		 * Sample constructor
 		 * \param filepath the path to the sample
@@ -158,14 +185,16 @@ class Sample : public H2Core::Object<Sample>
 		 * load() member on it.
 		 *
 		 * \param filepath the file to load audio data from
+		 * \param nSampleRate Sample rate the sample is converted
+		 * to. See load( int ).
 		 *
 		 * \return Pointer to the newly initialized Sample. If
 		 * the provided @a filepath is not readable, a nullptr
 		 * is returned instead.
 		 *
-		 * \fn load(const QString& filepath)
+		 * \fn load(const QString& filepath, int nSampleRate)
 		 */
-		static std::shared_ptr<Sample> load( const QString& filepath);
+		static std::shared_ptr<Sample> load( const QString& filepath, int nSampleRate = 0 );
 	
 		/**
 		 * Load a sample from a file and apply the
@@ -177,14 +206,18 @@ class Sample : public H2Core::Object<Sample>
 		 * \param velocity envelope points
 		 * \param pan envelope points
 		 * \param fBpm tempo the Rubberband transformation will target
+		 * \param nSampleRate Sample rate the sample is converted
+		 * to after the transformations were applied. The frames in
+		 * @a loops and the envelopes thus always refer to the
+		 * sample file itself.
 		 *
 		 * \return Pointer to the newly initialized Sample. If
 		 * the provided @a filepath is not readable, a nullptr
 		 * is returned instead.
 		 *
-		 * \overload load(const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan)
+		 * \overload load(const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan, float fBpm, int nSampleRate)
 		 */
-		static std::shared_ptr<Sample> load( const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan, float fBpm );
+		static std::shared_ptr<Sample> load( const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan, float fBpm, int nSampleRate = 0 );
 
 		/**
 		 * Load the sample stored in #__filepath into
@@ -198,18 +231,28 @@ class Sample : public H2Core::Object<Sample>
 		 * (two per default) channels in the audio file. If
 		 * there are more, Hydrogen will _NOT_ downmix its
 		 * content but simply extract the first two channels
-		 * and display a warning message. For mono file the
-		 * same content will be assigned to both the left
-		 * (#__data_l) and right channel (#__data_r).
+		 * and display a warning message. For mono files both
+		 * the left (#__data_l) and right channel (#__data_r)
+		 * point to the same buffer. See is_mono().
 		 *
 		 * If the total number of frames in the file is larger
 		 * than the maximum value of an `int', the content is
 		 * truncated and a warning log message will be
 		 * displayed.
 		 *
-		 * \fn load()
+		 * Unless disabled in the #Preferences, the decoded data
+		 * is written to the SampleCache. Subsequent loads of an
+		 * unaltered file map the cached data into memory instead
+		 * of decoding it again.
+		 *
+		 * \param nSampleRate If positive and different from the
+		 * rate of the file, the sample is converted to it using
+		 * convert_sample_rate(). The converted data is cached as
+		 * well.
+		 *
+		 * \fn load(int nSampleRate)
 		 */
-		bool load();
+		bool load( int nSampleRate = 0 );
 		/**
 		 * Flush the current content of the left and right
 		 * channel and the current metadata.
@@ -264,9 +307,75 @@ class Sample : public H2Core::Object<Sample>
 		 * \param fBpm tempo the Rubberband transformation will target
 		 */
 		bool exec_rubberband_cli( const Rubberband& rb, float fBpm );
+		/**
+		 * Converts the sample to @a nSampleRate using the
+		 * SampleRateConverter.
+		 *
+		 * Only the frames and the sample rate change. #__loops and
+		 * the envelopes keep referring to the frames of the sample
+		 * file.
+		 *
+		 * \return false in case the sample is empty or does
+		 * already have @a nSampleRate.
+		 */
+		bool convert_sample_rate( int nSampleRate );
+		/** \return Variant of the SampleCache holding the sample
+		 * converted to @a nSampleRate. */
+		static QString sample_rate_variant( int nSampleRate );
+		/**
+		 * \return Key uniquely identifying the result of apply()
+		 * called with the provided arguments. Used by the
+		 * #SampleRegistry and as variant of the SampleCache.
+		 */
+		static QString transformations_to_key( const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan, float fBpm );
+		/**
+		 * Removes leading and trailing frames which are below @a
+		 * fThreshold in all channels.
+		 *
+		 * Voices of the sample end as soon as its audible content
+		 * is done and the silence is not held in memory. Samples
+		 * mapped from the SampleCache are trimmed without copying
+		 * the data.
+		 *
+		 * At least a single frame is kept. #__loops and the
+		 * envelopes are not adjusted. Trim samples only after all
+		 * transformations were applied.
+		 *
+		 * \param fThreshold Level in dBFS.
+		 * \param sVariant Variant of the SampleCache corresponding
+		 * to the current content of the sample. The detected range
+		 * is stored using SampleCache::storeTrimRange() and read
+		 * back on subsequent calls instead of being detected again.
+		 *
+		 * \return Whether frames were removed.
+		 */
+		bool trim_silence( float fThreshold, const QString& sVariant = "" );
 
 		/** \return true if both data channels are null pointers */
 		bool is_empty() const;
+		/** \return #__format */
+		Format get_format() const;
+		/** \return Whether the data is mapped from the
+		 * SampleCache. */
+		bool is_mapped() const;
+		/**
+		 * \return Whether the data is streamed from disk.
+		 *
+		 * Only the first Preferences::m_nStreamingPreload
+		 * milliseconds of streamed samples are guaranteed to be in
+		 * memory. The SampleStreamer reads the remainder ahead of
+		 * the voices playing the sample.
+		 */
+		bool is_streamed() const;
+		/**
+		 * \return Whether the sample holds a single channel.
+		 *
+		 * Both #__data_l and #__data_r point to the same buffer in
+		 * this case. Transformations altering only one of the
+		 * channels, like apply_pan(), convert the sample to stereo
+		 * first.
+		 */
+		bool is_mono() const;
 		/** \return #__filepath */
 		const QString get_filepath() const;
 		/** \return Filename part of #__filepath */
@@ -290,13 +399,34 @@ class Sample : public H2Core::Object<Sample>
 		double get_sample_duration( ) const;
 	
 		/** \return data size, which is calculated by
-		 * #__frames time sizeof( float ) * 2 
+		 * #__frames time the size of a single value of #__format
+		 * times the number of channels held in memory (one if
+		 * is_mono()).
 		 */
 		int get_size() const;
-		/** \return #__data_l*/
+		/** \return #__data_l. nullptr unless #__format is
+		 * Format::Float. */
 		float* get_data_l() const;
-		/** \return #__data_r*/
+		/** \return #__data_r. nullptr unless #__format is
+		 * Format::Float. */
 		float* get_data_r() const;
+		/** \return #__pcm_l. nullptr if #__format is
+		 * Format::Float. */
+		const void* get_pcm_l() const;
+		/** \return #__pcm_r. nullptr if #__format is
+		 * Format::Float. */
+		const void* get_pcm_r() const;
+		/** \return Frame @a nFrame of the left channel as float
+		 * regardless of #__format. */
+		float get_value_l( int nFrame ) const;
+		/** \return Frame @a nFrame of the right channel as float
+		 * regardless of #__format. */
+		float get_value_r( int nFrame ) const;
+		/** Converts a single value stored in #__data_l or #__pcm_l
+		 * to float. */
+		static float to_float( float fValue );
+		static float to_float( int16_t nValue );
+		static float to_float( const PackedInt24& value );
 		/**
 		 * #__is_modified setter
 		 * \param value the new value for #__is_modified
@@ -329,11 +459,79 @@ class Sample : public H2Core::Object<Sample>
 		 * \return String presentation of current object.*/
 		QString toQString( const QString& sPrefix, bool bShort = true ) const override;
 	private:
+		/** Releases #__data_l and #__data_r, regardless of whether
+		 * they were allocated or mapped from the cache, as well as
+		 * #__pcm_l and #__pcm_r. */
+		void free_data();
+		/** Converts compactly stored data into floats. All
+		 * transformations operate on floats. */
+		void make_float();
+		/** \return Number of bytes a single value of @a format
+		 * occupies. */
+		static int value_size( Format format );
+		/**
+		 * Decodes #__filepath or maps its cached content at the
+		 * sample rate of the file.
+		 *
+		 * \param nSampleRate Rate the sample will be converted to
+		 * by load(). The decoded data is neither stored compactly
+		 * nor cached in case the file has a different one.
+		 */
+		bool load_file( int nSampleRate );
+		/**
+		 * Replaces the current data by the content of the
+		 * SampleCache.
+		 *
+		 * Samples exceeding Preferences::m_nStreamingThreshold are
+		 * marked for streaming. Only their beginning is read into
+		 * memory right away. All other samples are read entirely.
+		 *
+		 * \param sVariant Cached version of the sample to use.
+		 * See SampleCache::map().
+		 *
+		 * \return false in case there is no up-to-date cache file.
+		 */
+		bool load_from_cache( const QString& sVariant = "" );
+		/**
+		 * Marks mapped samples exceeding
+		 * Preferences::m_nStreamingThreshold for streaming and locks
+		 * their beginning in memory. All other mapped samples are
+		 * read entirely.
+		 */
+		void prepare_mapping();
+		/**
+		 * Determines the frames [@a pnStart, @a pnEnd) holding
+		 * content above @a fLevel in at least one channel.
+		 *
+		 * \param fLevel Linear level.
+		 */
+		void detect_silence( float fLevel, int* pnStart, int* pnEnd ) const;
+
+		/** \return Whether @a nFrames stored as floats occupy at
+		 * least Preferences::m_nStreamingThreshold MiB. */
+		static bool exceeds_streaming_threshold( int nFrames, bool bMono );
+		/** Gives a mono sample separate buffers for both
+		 * channels. */
+		void make_stereo();
+		/** Applies @a lo to a single channel @a pData and writes
+		 * the result into @a pNewData. */
+		static void apply_loops_to_channel( const float* pData, float* pNewData,
+											const Loops& lo );
+
 		QString				__filepath;          ///< filepath of the sample
 		int					__frames;            ///< number of frames in this sample
 		int					__sample_rate;       ///< samplerate for this sample
 		float*				__data_l;            ///< left channel data
 		float*				__data_r;            ///< right channel data
+		Format				__format;            ///< type of the values of the sample
+		/** Left channel data unless #__format is Format::Float */
+		char*				__pcm_l;
+		/** Right channel data unless #__format is
+		 * Format::Float. Same as #__pcm_l for mono samples. */
+		char*				__pcm_r;
+		/** Cache file #__data_l and #__data_r are located in or
+		 * nullptr if they were allocated. */
+		std::unique_ptr<SampleCache::Mapping> __mapping;
 		bool				__is_modified;       ///< true if sample is modified
 		PanEnvelope			__pan_envelope;      ///< pan envelope vector
 		VelocityEnvelope	__velocity_envelope; ///< velocity envelope vector
@@ -345,25 +543,64 @@ class Sample : public H2Core::Object<Sample>
 
 // DEFINITIONS
 
-inline void Sample::unload()
+inline void Sample::free_data()
 {
-	if ( __data_l != nullptr ) {
-		delete [] __data_l;
+	if ( __mapping != nullptr ) {
+		__mapping.reset();
+	} else {
+		if ( __data_r != nullptr && __data_r != __data_l ) {
+			delete [] __data_r;
+		}
+		if ( __data_l != nullptr ) {
+			delete [] __data_l;
+		}
 	}
-	
-	if ( __data_r != nullptr ) {
-		delete [] __data_r;
+	__data_l = __data_r = nullptr;
+
+	if ( __pcm_r != nullptr && __pcm_r != __pcm_l ) {
+		delete [] __pcm_r;
+	}
+	if ( __pcm_l != nullptr ) {
+		delete [] __pcm_l;
 	}
+	__pcm_l = __pcm_r = nullptr;
+	__format = Format::Float;
+}
+
+inline void Sample::unload()
+{
+	free_data();
 	__frames = __sample_rate = 0;
 	/** #__is_modified = false; leave this unchanged as pan,
 	    velocity, loop and rubberband are kept unchanged */
-
-	__data_l = __data_r = nullptr;
 }
 
 inline bool Sample::is_empty() const
 {
-	return ( __data_l == 0 && __data_r == 0 );
+	return ( __data_l == 0 && __data_r == 0 && __pcm_l == nullptr );
+}
+
+inline Sample::Format Sample::get_format() const
+{
+	return __format;
+}
+
+inline bool Sample::is_mapped() const
+{
+	return __mapping != nullptr;
+}
+
+inline bool Sample::is_streamed() const
+{
+	return __mapping != nullptr && __mapping->isStreamed();
+}
+
+inline bool Sample::is_mono() const
+{
+	if ( __pcm_l != nullptr ) {
+		return __pcm_l == __pcm_r;
+	}
+	return __data_l != nullptr && __data_l == __data_r;
 }
 
 inline const QString Sample::get_filepath() const
@@ -403,7 +640,19 @@ inline double Sample::get_sample_duration() const
 
 inline int Sample::get_size() const
 {
-	return __frames * sizeof( float ) * 2;
+	return __frames * value_size( __format ) * ( is_mono() ? 1 : 2 );
+}
+
+inline int Sample::value_size( Format format )
+{
+	switch ( format ) {
+	case Format::Int16:
+		return sizeof( int16_t );
+	case Format::Int24:
+		return sizeof( PackedInt24 );
+	default:
+		return sizeof( float );
+	}
 }
 
 inline float* Sample::get_data_l() const
@@ -416,6 +665,63 @@ inline float* Sample::get_data_r() const
 	return __data_r;
 }
 
+inline const void* Sample::get_pcm_l() const
+{
+	return __pcm_l;
+}
+
+inline const void* Sample::get_pcm_r() const
+{
+	return __pcm_r;
+}
+
+inline float Sample::to_float( float fValue )
+{
+	return fValue;
+}
+
+inline float Sample::to_float( int16_t nValue )
+{
+	// Same scaling libsndfile uses when reading floats. The
+	// conversion is thus lossless.
+	return nValue * ( 1.0f / 0x8000 );
+}
+
+inline float Sample::to_float( const PackedInt24& value )
+{
+	// Shifting the value into the upper bytes takes care of the
+	// sign.
+	const int32_t nValue = static_cast<int32_t>(
+		( static_cast<uint32_t>( value.bytes[ 0 ] ) << 8 ) |
+		( static_cast<uint32_t>( value.bytes[ 1 ] ) << 16 ) |
+		( static_cast<uint32_t>( value.bytes[ 2 ] ) << 24 ) );
+	return nValue * ( 1.0f / 0x80000000u );
+}
+
+inline float Sample::get_value_l( int nFrame ) const
+{
+	switch ( __format ) {
+	case Format::Int16:
+		return to_float( reinterpret_cast<const int16_t*>( __pcm_l )[ nFrame ] );
+	case Format::Int24:
+		return to_float( reinterpret_cast<const PackedInt24*>( __pcm_l )[ nFrame ] );
+	default:
+		return __data_l[ nFrame ];
+	}
+}
+
+inline float Sample::get_value_r( int nFrame ) const
+{
+	switch ( __format ) {
+	case Format::Int16:
+		return to_float( reinterpret_cast<const int16_t*>( __pcm_r )[ nFrame ] );
+	case Format::Int24:
+		return to_float( reinterpret_cast<const PackedInt24*>( __pcm_r )[ nFrame ] );
+	default:
+		return __data_r[ nFrame ];
+	}
+}
+
 inline void Sample::set_is_modified( bool is_modified )
 {
 	__is_modified = is_modified;
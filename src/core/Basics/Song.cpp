@@ -22,6 +22,7 @@
 
 #include "Version.h"
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 
@@ -45,6 +46,8 @@
 #include <core/AutomationPathSerializer.h>
 #include <core/Helpers/Xml.h>
 #include <core/Helpers/Filesystem.h>
+#include <core/Helpers/SampleLoader.h>
+#include <core/Helpers/SampleRegistry.h>
 #include <core/Hydrogen.h>
 #include <core/Sampler/Sampler.h>
 
@@ -174,6 +177,69 @@ long Song::lengthInTicks() const {
     return nSongLength;
 }
 
+void Song::updateColumnStartTicks() {
+	if ( m_pPatternGroupSequence == nullptr ) {
+		m_columnStartTicks.clear();
+		return;
+	}
+
+	const int nColumns = m_pPatternGroupSequence->size();
+	m_columnStartTicks.resize( nColumns + 1 );
+
+	// Use the macro MAX_NOTES in case some of the columns are empty.
+	long nTick = 0;
+	for ( int i = 0; i < nColumns; i++ ) {
+		m_columnStartTicks[ i ] = nTick;
+		PatternList *pColumn = ( *m_pPatternGroupSequence )[ i ];
+		if ( pColumn->size() != 0 ) {
+			nTick += pColumn->longest_pattern_length();
+		} else {
+			nTick += MAX_NOTES;
+		}
+	}
+	m_columnStartTicks[ nColumns ] = nTick;
+}
+
+bool Song::checkColumnStartTicks() const {
+	if ( m_columnStartTicks.size() != m_pPatternGroupSequence->size() + 1 ) {
+		ERRORLOG( QString( "Column start ticks are outdated. [%1] columns cached, [%2] present" )
+				  .arg( static_cast<int>( m_columnStartTicks.size() ) - 1 )
+				  .arg( m_pPatternGroupSequence->size() ) );
+		return false;
+	}
+	return true;
+}
+
+long Song::getColumnStartTick( int nColumn ) const {
+	if ( ! checkColumnStartTicks() ) {
+		return -1;
+	}
+	if ( nColumn < 0 || nColumn >= static_cast<int>( m_columnStartTicks.size() ) ) {
+		ERRORLOG( QString( "Provided column [%1] is out of bound [0,%2]" )
+				  .arg( nColumn ).arg( m_columnStartTicks.size() - 1 ) );
+		return -1;
+	}
+	return m_columnStartTicks[ nColumn ];
+}
+
+int Song::findColumn( long nTick, long* pColumnStartTick ) const {
+	if ( ! checkColumnStartTicks() ) {
+		*pColumnStartTick = 0;
+		return -1;
+	}
+	if ( nTick < 0 || nTick >= m_columnStartTicks.back() ) {
+		*pColumnStartTick = 0;
+		return -1;
+	}
+
+	// First column starting after nTick. Since the first one starts
+	// at 0 and nTick is within the song, it is not the first one.
+	const auto it = std::upper_bound( m_columnStartTicks.begin(),
+									  m_columnStartTicks.end(), nTick );
+	*pColumnStartTick = *( it - 1 );
+	return static_cast<int>( it - m_columnStartTicks.begin() ) - 1;
+}
+
 bool Song::isPatternActive( int nColumn, int nRow ) const {
 	if ( nRow < 0 || nRow > m_pPatternList->size() ) {
 		return false;
@@ -647,26 +713,51 @@ void Song::setPanLawKNorm( float fKNorm ) {
 	}
 }
 
-void Song::loadDrumkit( Drumkit *pDrumkit, bool bConditional ) {
-	assert ( pDrumkit );
-	auto pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
-
-	// Load DrumkitComponents 
-	std::vector<DrumkitComponent*>* pDrumkitCompoList = pDrumkit->get_components();
-	
-	for( auto &pComponent : *m_pComponents ){
+Song::StagedDrumkit::~StagedDrumkit() {
+	for ( auto& pComponent : components ) {
 		delete pComponent;
 	}
-	m_pComponents->clear();
-	
-	for (std::vector<DrumkitComponent*>::iterator it = pDrumkitCompoList->begin() ; it != pDrumkitCompoList->end(); ++it) {
-		DrumkitComponent* pSrcComponent = *it;
+}
+
+std::unique_ptr<Song::StagedDrumkit> Song::stageDrumkit( Drumkit *pDrumkit ) {
+	assert ( pDrumkit );
+	auto pStaged = std::make_unique<StagedDrumkit>();
+
+	for ( const auto& pSrcComponent : *pDrumkit->get_components() ) {
 		DrumkitComponent* pNewComponent = new DrumkitComponent( pSrcComponent->get_id(), pSrcComponent->get_name() );
 		pNewComponent->load_from( pSrcComponent );
 
-		m_pComponents->push_back( pNewComponent );
+		pStaged->components.push_back( pNewComponent );
+	}
+
+	InstrumentList *pDrumkitInstrList = pDrumkit->get_instruments();
+	for ( int nnInstr = 0; nnInstr < pDrumkitInstrList->size(); ++nnInstr ) {
+		auto pNewInstr = pDrumkitInstrList->get( nnInstr );
+		assert( pNewInstr );
+		INFOLOG( QString( "Loading instrument (%1 of %2) [%3]" )
+				 .arg( nnInstr + 1 )
+				 .arg( pDrumkitInstrList->size() )
+				 .arg( pNewInstr->get_name() ) );
+
+		auto pInstr = std::make_shared<Instrument>();
+		pInstr->load_from( pDrumkit, pNewInstr );
+		pStaged->instruments.push_back( pInstr );
 	}
 
+	return pStaged;
+}
+
+void Song::loadDrumkit( Drumkit *pDrumkit, bool bConditional ) {
+	auto pStaged = stageDrumkit( pDrumkit );
+	loadDrumkit( pStaged.get(), bConditional );
+}
+
+void Song::loadDrumkit( StagedDrumkit* pStaged, bool bConditional ) {
+	assert ( pStaged );
+
+	// The former components will be freed along with pStaged.
+	m_pComponents->swap( pStaged->components );
+
 	//////
 	// Load InstrumentList
 	/*
@@ -677,39 +768,34 @@ void Song::loadDrumkit( Drumkit *pDrumkit, bool bConditional ) {
 	 * pos > pDrumkitInstrList->size() stay in the
 	 * new instrumentlist
 	 */
-	InstrumentList *pDrumkitInstrList = pDrumkit->get_instruments();
-	
-	int nInstrumentDiff = m_pInstrumentList->size() - pDrumkitInstrList->size();
+	const int nStagedInstruments = pStaged->instruments.size();
+	int nInstrumentDiff = m_pInstrumentList->size() - nStagedInstruments;
 	int nMaxID = -1;
 	
-	std::shared_ptr<Instrument> pInstr, pNewInstr;
-	for ( int nnInstr = 0; nnInstr < pDrumkitInstrList->size(); ++nnInstr ) {
+	for ( int nnInstr = 0; nnInstr < nStagedInstruments; ++nnInstr ) {
+		auto pStagedInstr = pStaged->instruments[ nnInstr ];
+
+		// Preserve instrument IDs. Where the new drumkit has more
+		// instruments than the song does, new instruments need new
+		// ids.
+		std::shared_ptr<Instrument> pInstr;
+		int nID = EMPTY_INSTR_ID;
 		if ( nnInstr < m_pInstrumentList->size() ) {
-			// Instrument exists already
+			// Instrument exists already and is referenced by the
+			// patterns.
 			pInstr = m_pInstrumentList->get( nnInstr );
 			assert( pInstr );
+			nID = pInstr->get_id();
+			pInstr->swap_from( pStagedInstr );
 		} else {
-			pInstr = std::make_shared<Instrument>();
+			pInstr = pStagedInstr;
 			m_pInstrumentList->add( pInstr );
 		}
 
-		pNewInstr = pDrumkitInstrList->get( nnInstr );
-		assert( pNewInstr );
-		INFOLOG( QString( "Loading instrument (%1 of %2) [%3]" )
-				 .arg( nnInstr + 1 )
-				 .arg( pDrumkitInstrList->size() )
-				 .arg( pNewInstr->get_name() ) );
-
-		// Preserve instrument IDs. Where the new drumkit has more
-		// instruments than the song does, new instruments need new
-		// ids.
-		int nID = pInstr->get_id();
 		if ( nID == EMPTY_INSTR_ID ) {
 			nID = nMaxID + 1;
 		}
 		nMaxID = std::max( nID, nMaxID );
-
-		pInstr->load_from( pDrumkit, pNewInstr );
 		pInstr->set_id( nID );
 	}
 
@@ -1130,6 +1216,13 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 	if ( ( ! instrumentListNode.isNull()  ) ) {
 		// INSTRUMENT NODE
 		int instrumentList_count = 0;
+		const long nRegistryHits = SampleRegistry::getHits();
+		const long nRegistryMisses = SampleRegistry::getMisses();
+		// The samples of all layers are loaded concurrently once all
+		// instruments have been read.
+		std::vector<SampleLoader::Request> sampleRequests;
+		std::vector<std::pair<std::shared_ptr<Instrument>,
+							  std::shared_ptr<InstrumentLayer>>> requestedLayers;
 		QDomNode instrumentNode;
 		instrumentNode = instrumentListNode.firstChildElement( "instrument" );
 		while ( ! instrumentNode.isNull()  ) {
@@ -1261,14 +1354,14 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 				if ( !QFile( sFilename ).exists() && !drumkitPath.isEmpty() ) {
 					sFilename = drumkitPath + "/" + sFilename;
 				}
-				auto pSample = Sample::load( sFilename );
+				auto pSample = SampleRegistry::load( sFilename );
 				if ( pSample == nullptr ) {
 					// nel passaggio tra 0.8.2 e 0.9.0 il drumkit di default e' cambiato.
 					// Se fallisce provo a caricare il corrispettivo file in formato flac
 //					warningLog( "[readSong] Error loading sample: " + sFilename + " not found. Trying to load a flac..." );
 					sFilename = sFilename.left( sFilename.length() - 4 );
 					sFilename += ".flac";
-					pSample = Sample::load( sFilename );
+					pSample = SampleRegistry::load( sFilename );
 				}
 				if ( pSample == nullptr ) {
 					ERRORLOG( "Error loading sample: " + sFilename + " not found" );
@@ -1328,9 +1421,8 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 							ro.use = false;
 						}
 
-						std::shared_ptr<Sample> pSample;
 						if ( !sIsModified ) {
-							pSample = Sample::load( sFilename );
+							sampleRequests.push_back( SampleLoader::Request( sFilename ) );
 						} else {
 							// FIXME, kill EnvelopePoint, create Envelope class
 							EnvelopePoint pt;
@@ -1354,14 +1446,11 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 								panNode = panNode.nextSiblingElement( "pan" );
 							}
 
-							pSample = Sample::load( sFilename, lo, ro, velocity, pan, fBpm );
-						}
-						if ( pSample == nullptr ) {
-							ERRORLOG( "Error loading sample: " + sFilename + " not found" );
-							pInstrument->set_muted( true );
-							pInstrument->set_missing_samples( true );
+							sampleRequests.push_back(
+								SampleLoader::Request( sFilename, lo, ro, velocity, pan, fBpm ) );
 						}
-						auto pLayer = std::make_shared<InstrumentLayer>( pSample );
+						auto pLayer = std::make_shared<InstrumentLayer>( nullptr );
+						requestedLayers.push_back( std::make_pair( pInstrument, pLayer ) );
 						pLayer->set_start_velocity( fMin );
 						pLayer->set_end_velocity( fMax );
 						pLayer->set_gain( fGain );
@@ -1416,9 +1505,8 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 							ro.use = false;
 						}
 
-						std::shared_ptr<Sample> pSample = nullptr;
 						if ( !sIsModified ) {
-							pSample = Sample::load( sFilename );
+							sampleRequests.push_back( SampleLoader::Request( sFilename ) );
 						} else {
 							EnvelopePoint pt;
 
@@ -1441,14 +1529,11 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 								panNode = panNode.nextSiblingElement( "pan" );
 							}
 
-							pSample = Sample::load( sFilename, lo, ro, velocity, pan, fBpm );
+							sampleRequests.push_back(
+								SampleLoader::Request( sFilename, lo, ro, velocity, pan, fBpm ) );
 						}
-						if ( pSample == nullptr ) {
-							ERRORLOG( "Error loading sample: " + sFilename + " not found" );
-							pInstrument->set_muted( true );
-							pInstrument->set_missing_samples( true );
-						}
-						auto pLayer = std::make_shared<InstrumentLayer>( pSample );
+						auto pLayer = std::make_shared<InstrumentLayer>( nullptr );
+						requestedLayers.push_back( std::make_pair( pInstrument, pLayer ) );
 						pLayer->set_start_velocity( fMin );
 						pLayer->set_end_velocity( fMax );
 						pLayer->set_gain( fGain );
@@ -1468,6 +1553,24 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 		if ( instrumentList_count == 0 ) {
 			WARNINGLOG( "0 instruments?" );
 		}
+
+		if ( ! SampleLoader::load( sampleRequests, SampleLoader::Scope::Song ) ) {
+			ERRORLOG( "Error reading song: loading samples was superseded by another song" );
+			delete pInstrList;
+			return nullptr;
+		}
+		for ( int i = 0; i < requestedLayers.size(); i++ ) {
+			auto pSample = sampleRequests[ i ].pSample;
+			if ( pSample == nullptr ) {
+				ERRORLOG( "Error loading sample: " + sampleRequests[ i ].sFilepath + " not found" );
+				requestedLayers[ i ].first->set_muted( true );
+				requestedLayers[ i ].first->set_missing_samples( true );
+			}
+			requestedLayers[ i ].second->set_sample( pSample );
+		}
+		INFOLOG( QString( "Samples loaded: %1, shared with other instruments, kits, or songs: %2" )
+				 .arg( SampleRegistry::getMisses() - nRegistryMisses )
+				 .arg( SampleRegistry::getHits() - nRegistryHits ) );
 		pSong->setInstrumentList( pInstrList );
 	} else {
 		ERRORLOG( "Error reading song: instrumentList node not found" );
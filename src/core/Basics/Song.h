@@ -143,6 +143,35 @@ class Song : public H2Core::Object<Song>, public std::enable_shared_from_this<So
 		/** get the length of the song, in tick units */
 		long lengthInTicks() const;
 
+		/**
+		 * Recomputes the ticks all columns of
+		 * #m_pPatternGroupSequence start at.
+		 *
+		 * Has to be called whenever a column is added or removed,
+		 * a pattern is added to or removed from a column, or the
+		 * length of a pattern changes. AudioEngine::updateSongSize()
+		 * takes care of it while the audio engine is locked.
+		 */
+		void updateColumnStartTicks();
+		/**
+		 * \param nColumn Index within [0, number of columns]. The
+		 * latter yields the total length of the song.
+		 *
+		 * \return Tick column @a nColumn starts at.
+		 */
+		long getColumnStartTick( int nColumn ) const;
+		/**
+		 * Binary search for the column holding @a nTick.
+		 *
+		 * \param nTick Position within the song. Loops are not
+		 * taken into account.
+		 * \param pColumnStartTick Tick the found column starts at.
+		 *
+		 * \return Index of the column or -1 in case @a nTick is
+		 * not within the song.
+		 */
+		int findColumn( long nTick, long* pColumnStartTick ) const;
+
 		static std::shared_ptr<Song> 	load( const QString& sFilename );
 		bool 			save( const QString& sFilename );
 
@@ -242,6 +271,47 @@ class Song : public H2Core::Object<Song>, public std::enable_shared_from_this<So
 
 	std::shared_ptr<Timeline> getTimeline() const;
 
+	/**
+	 * Instruments and components of a drumkit prepared by
+	 * stageDrumkit() to be published using loadDrumkit().
+	 *
+	 * After being published it holds the instruments and
+	 * components replaced by the drumkit. Those are freed along
+	 * with it.
+	 */
+	struct StagedDrumkit {
+		~StagedDrumkit();
+		std::vector<std::shared_ptr<Instrument>> instruments;
+		std::vector<DrumkitComponent*> components;
+	};
+
+	/**
+	 * Builds the instruments and components of @a pDrumkit,
+	 * including their samples, without altering any song.
+	 *
+	 * Meant to be called without holding the audio engine lock
+	 * while the current drumkit keeps playing.
+	 */
+	static std::unique_ptr<StagedDrumkit> stageDrumkit( Drumkit* pDrumkit );
+	/**
+	 * Replaces the drumkit of the song by @a pStaged.
+	 *
+	 * Existing instruments are retained, since patterns refer to
+	 * them, but take over the content of their staged
+	 * counterparts using Instrument::swap_from(). No samples are
+	 * loaded and, apart from additional instruments, no memory is
+	 * allocated or freed. The whole operation is thus short
+	 * enough to be done while holding the audio engine lock
+	 * without causing xruns.
+	 *
+	 * \param pStaged Created by stageDrumkit(). Holds the former
+	 * content afterwards and should be destroyed after releasing
+	 * the audio engine lock.
+	 * \param bConditional Whether instruments not present in the
+	 * new drumkit are kept in case they are used in any pattern.
+	 */
+	void loadDrumkit( StagedDrumkit* pStaged, bool bConditional );
+	/** Stages and loads @a pDrumkit at once. */
 	void loadDrumkit( Drumkit* pDrumkit, bool bConditional );
 	void removeInstrument( int nInstrumentNumber, bool bConditional );
 
@@ -290,6 +360,21 @@ private:
 		PatternList*	m_pPatternList;
 		///< Sequence of pattern groups
 		std::vector<PatternList*>* m_pPatternGroupSequence;
+		/**
+		 * Prefix sums of the lengths of the columns in
+		 * #m_pPatternGroupSequence. It holds one element more than
+		 * there are columns, the last one being the length of the
+		 * song.
+		 *
+		 * Only written by updateColumnStartTicks(). All lookups
+		 * are read-only.
+		 */
+		std::vector<long> m_columnStartTicks;
+		/** \return false and reports an error in case
+		 * #m_columnStartTicks does not match the number of columns,
+		 * i.e. updateColumnStartTicks() was not called after the
+		 * columns changed. */
+		bool checkColumnStartTicks() const;
 		///< Instrument list
 		InstrumentList*	       	m_pInstrumentList;
 		///< list of drumkit component
@@ -463,6 +548,7 @@ inline const std::vector<PatternList*>* Song::getPatternGroupVector() const
 inline void Song::setPatternGroupVector( std::vector<PatternList*>* pGroupVector )
 {
 	m_pPatternGroupSequence = pGroupVector;
+	updateColumnStartTicks();
 }
 
 inline void Song::setNotes( const QString& sNotes )
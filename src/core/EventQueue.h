@@ -163,7 +163,10 @@ enum EventType {
 		(either during playback or when relocated by the user)*/
 	EVENT_COLUMN_CHANGED,
 	/** A the current drumkit was replaced by a new one*/
-	EVENT_DRUMKIT_LOADED
+	EVENT_DRUMKIT_LOADED,
+	/** Progress of the SampleLoader in percent. A value of 100
+		indicates all samples of the current batch are loaded.*/
+	EVENT_SAMPLE_LOADING_PROGRESS
 };
 
 /** Basic building block for the communication between the core of
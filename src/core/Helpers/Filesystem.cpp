@@ -49,6 +49,7 @@
 #define PLAYLISTS       "playlists/"
 #define PLUGINS         "plugins/"
 #define REPOSITORIES    "repositories/"
+#define SAMPLE_CACHE    "samples/"
 #define SCRIPTS         "scripts/"
 #define SONGS           "songs/"
 #define THEMES          "themes/"
@@ -115,6 +116,7 @@ QString Filesystem::__usr_cfg_path;
 QStringList Filesystem::__ladspa_paths;
 
 QString Filesystem::m_sPreferencesOverwritePath = "";
+QString Filesystem::m_sSampleCacheOverwritePath = "";
 
 /* TODO QCoreApplication is not instantiated */
 bool Filesystem::bootstrap( Logger* logger, const QString& sys_path )
@@ -420,6 +422,7 @@ bool Filesystem::check_usr_paths()
 	if( !path_usable( __usr_data_path ) ) ret = false;
 	if( !path_usable( cache_dir() ) ) ret = false;
 	if( !path_usable( repositories_cache_dir() ) ) ret = false;
+	if( !path_usable( sample_cache_dir() ) ) ret = false;
 	if( !path_usable( usr_drumkits_dir() ) ) ret = false;
 	if( !path_usable( patterns_dir() ) ) ret = false;
 	if( !path_usable( playlists_dir() ) ) ret = false;
@@ -599,6 +602,13 @@ QString Filesystem::repositories_cache_dir()
 {
 	return __usr_data_path + CACHE + REPOSITORIES;
 }
+QString Filesystem::sample_cache_dir()
+{
+	if ( ! m_sSampleCacheOverwritePath.isEmpty() ) {
+		return m_sSampleCacheOverwritePath;
+	}
+	return __usr_data_path + CACHE + SAMPLE_CACHE;
+}
 QString Filesystem::demos_dir()
 {
 	return __sys_data_path + DEMOS;
@@ -933,6 +943,7 @@ void Filesystem::info()
 	INFOLOG( QString( "User Click file            : %1" ).arg( usr_click_file_path() ) );
 	INFOLOG( QString( "Cache dir                  : %1" ).arg( cache_dir() ) );
 	INFOLOG( QString( "Reporitories Cache dir     : %1" ).arg( repositories_cache_dir() ) );
+	INFOLOG( QString( "Sample Cache dir           : %1" ).arg( sample_cache_dir() ) );
 	INFOLOG( QString( "User drumkit dir           : %1" ).arg( usr_drumkits_dir() ) );
 	INFOLOG( QString( "Patterns dir               : %1" ).arg( patterns_dir() ) );
 	INFOLOG( QString( "Playlist dir               : %1" ).arg( playlists_dir() ) );
@@ -180,6 +180,9 @@ namespace H2Core
 		static QString cache_dir();
 		/** returns user repository cache path */
 		static QString repositories_cache_dir();
+		/** returns path of the decoded sample cache or
+		 * #m_sSampleCacheOverwritePath if set */
+		static QString sample_cache_dir();
 		/** returns system demos path */
 		static QString demos_dir();
 		/** returns system xsd path */
@@ -417,6 +420,10 @@ namespace H2Core
 		static const QString& getPreferencesOverwritePath();
 		/** \param sPath Sets m_sPreferencesOverwritePath*/
 		static void setPreferencesOverwritePath( const QString& sPath );
+		/** \return m_sSampleCacheOverwritePath*/
+		static const QString& getSampleCacheOverwritePath();
+		/** \param sPath Sets m_sSampleCacheOverwritePath*/
+		static void setSampleCacheOverwritePath( const QString& sPath );
 
 	private:
 		static Logger* __logger;                    ///< a pointer to the logger
@@ -428,6 +435,11 @@ namespace H2Core
 		 * If this variable is non-empty, its content will be used as
 		 * an alternative to store and load the preferences.*/
 		static QString m_sPreferencesOverwritePath;
+		/**
+		 * If this variable is non-empty, it will be used instead of
+		 * the user's sample cache directory. Has to end with a
+		 * slash.*/
+		static QString m_sSampleCacheOverwritePath;
 		/**
 		 * \return a list of usable drumkits, which means having a readable drumkit.xml file
 		 * \param path the path to search in for drumkits
@@ -477,6 +489,12 @@ namespace H2Core
 	inline void Filesystem::setPreferencesOverwritePath( const QString& sPath ) {
 		Filesystem::m_sPreferencesOverwritePath = sPath;
 	}
+	inline const QString& Filesystem::getSampleCacheOverwritePath() {
+		return Filesystem::m_sSampleCacheOverwritePath;
+	}
+	inline void Filesystem::setSampleCacheOverwritePath( const QString& sPath ) {
+		Filesystem::m_sSampleCacheOverwritePath = sPath;
+	}
 
 };
 #endif  // H2C_FILESYSTEM_H
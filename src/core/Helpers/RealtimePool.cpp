@@ -0,0 +1,105 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Helpers/RealtimePool.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace H2Core
+{
+
+RealtimePool::RealtimePool( size_t nBlockSize, int nCapacity )
+	: m_nBlockSize( 0 )
+	, m_nCapacity( std::max( nCapacity, 0 ) )
+	, m_nUsed( 0 )
+{
+	// Keep all blocks suitably aligned for any type.
+	const size_t nAlignment = alignof( std::max_align_t );
+	m_nBlockSize = ( std::max( nBlockSize, static_cast<size_t>( 1 ) ) +
+					 nAlignment - 1 ) / nAlignment * nAlignment;
+
+	m_pMemory = static_cast<char*>( ::operator new( m_nBlockSize * m_nCapacity ) );
+	// Touch all pages now rather than on first use in the audio
+	// thread.
+	memset( m_pMemory, 0, m_nBlockSize * m_nCapacity );
+
+	m_pNext = new std::atomic<uint32_t>[ m_nCapacity ];
+	for ( int ii = 0; ii < m_nCapacity; ++ii ) {
+		m_pNext[ ii ].store( ii + 1, std::memory_order_relaxed );
+	}
+	m_head.store( pack( 0, 0 ) );
+
+	INFOLOG( QString( "[%1] blocks of [%2] bytes" )
+			 .arg( m_nCapacity ).arg( m_nBlockSize ) );
+}
+
+RealtimePool::~RealtimePool() {
+	if ( m_nUsed.load() != 0 ) {
+		ERRORLOG( QString( "[%1] blocks still in use" ).arg( m_nUsed.load() ) );
+	}
+	delete[] m_pNext;
+	::operator delete( m_pMemory );
+}
+
+void* RealtimePool::acquire() {
+	uint64_t nHead = m_head.load( std::memory_order_acquire );
+	while ( true ) {
+		const uint32_t nIndex = static_cast<uint32_t>( nHead );
+		if ( nIndex >= static_cast<uint32_t>( m_nCapacity ) ) {
+			return nullptr;
+		}
+		const uint32_t nNext = m_pNext[ nIndex ].load( std::memory_order_relaxed );
+		const uint64_t nNewHead = pack( nNext, static_cast<uint32_t>( nHead >> 32 ) + 1 );
+		if ( m_head.compare_exchange_weak( nHead, nNewHead,
+										   std::memory_order_acq_rel,
+										   std::memory_order_acquire ) ) {
+			m_nUsed.fetch_add( 1, std::memory_order_relaxed );
+			return m_pMemory + nIndex * m_nBlockSize;
+		}
+	}
+}
+
+void RealtimePool::release( void* pBlock ) {
+	if ( pBlock == nullptr ) {
+		return;
+	}
+	const uint32_t nIndex = static_cast<uint32_t>(
+		( static_cast<char*>( pBlock ) - m_pMemory ) / m_nBlockSize );
+
+	uint64_t nHead = m_head.load( std::memory_order_relaxed );
+	while ( true ) {
+		m_pNext[ nIndex ].store( static_cast<uint32_t>( nHead ),
+								 std::memory_order_relaxed );
+		const uint64_t nNewHead = pack( nIndex, static_cast<uint32_t>( nHead >> 32 ) + 1 );
+		if ( m_head.compare_exchange_weak( nHead, nNewHead,
+										   std::memory_order_release,
+										   std::memory_order_relaxed ) ) {
+			m_nUsed.fetch_sub( 1, std::memory_order_relaxed );
+			return;
+		}
+	}
+}
+
+};
+
+/* vim: set softtabstop=4 noexpandtab: */
@@ -0,0 +1,114 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_REALTIME_POOL_H
+#define H2C_REALTIME_POOL_H
+
+#include <core/Object.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace H2Core
+{
+
+/**
+ * Fixed number of equally sized memory blocks, all allocated
+ * up front.
+ *
+ * acquire() and release() neither lock nor call into the system
+ * allocator. They may be called from any number of threads at once,
+ * including the audio thread.
+ *
+ * The free blocks form a lock-free stack. The head of the stack
+ * carries a tag that is incremented on every change to avoid the ABA
+ * problem.
+ */
+/** \ingroup docCore */
+class RealtimePool : public H2Core::Object<RealtimePool>
+{
+		H2_OBJECT(RealtimePool)
+	public:
+		/**
+		 * \param nBlockSize Size of a single block in bytes.
+		 * \param nCapacity Number of blocks.
+		 */
+		RealtimePool( size_t nBlockSize, int nCapacity );
+		~RealtimePool();
+
+		/** \return A free block or nullptr in case the pool is
+		 * exhausted. */
+		void* acquire();
+		/** Returns @a pBlock, which must have been obtained by
+		 * acquire(), to the pool. */
+		void release( void* pBlock );
+		/** \return Whether @a pBlock is located within the memory
+		 * of the pool. */
+		bool contains( const void* pBlock ) const;
+
+		size_t getBlockSize() const;
+		int getCapacity() const;
+		/** \return Number of blocks currently handed out. */
+		int getUsed() const;
+
+	private:
+		/** Index of the first free block in the lower and a tag in
+		 * the upper 32 bits. */
+		static uint64_t pack( uint32_t nIndex, uint32_t nTag );
+
+		char* m_pMemory;
+		size_t m_nBlockSize;
+		int m_nCapacity;
+		/** Index of the next free block for each block. #m_nCapacity
+		 * marks the end of the stack. */
+		std::atomic<uint32_t>* m_pNext;
+		std::atomic<uint64_t> m_head;
+		std::atomic<int> m_nUsed;
+};
+
+inline bool RealtimePool::contains( const void* pBlock ) const {
+	const char* p = static_cast<const char*>( pBlock );
+	return p >= m_pMemory && p < m_pMemory + m_nBlockSize * m_nCapacity;
+}
+
+inline size_t RealtimePool::getBlockSize() const {
+	return m_nBlockSize;
+}
+
+inline int RealtimePool::getCapacity() const {
+	return m_nCapacity;
+}
+
+inline int RealtimePool::getUsed() const {
+	return m_nUsed.load( std::memory_order_relaxed );
+}
+
+inline uint64_t RealtimePool::pack( uint32_t nIndex, uint32_t nTag ) {
+	return ( static_cast<uint64_t>( nTag ) << 32 ) | nIndex;
+}
+
+};
+
+#endif // H2C_REALTIME_POOL_H
+
+/* vim: set softtabstop=4 noexpandtab: */
@@ -0,0 +1,371 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Helpers/SampleCache.h>
+#include <core/Helpers/Filesystem.h>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SAMPLE_CACHE_EXT ".h2sc"
+#define SAMPLE_TRIM_EXT ".h2st"
+
+namespace H2Core
+{
+
+/** Bumped whenever the layout of the cache files changes. */
+static const uint32_t nCacheVersion = 2;
+static const char sCacheMagic[ 8 ] = { 'H', '2', 'S', 'C', 'A', 'C', 'H', 'E' };
+
+/** Leading part of each cache file. Its size keeps the sample data
+ * aligned for vector loads. */
+struct CacheHeader {
+	char sMagic[ 8 ];
+	uint32_t nVersion;
+	uint32_t nChannels;
+	int64_t nFrames;
+	int64_t nSampleRate;
+	/** Size of the sample file in bytes. */
+	int64_t nSourceSize;
+	/** Modification time of the sample file in ms since epoch. */
+	int64_t nSourceModified;
+	char padding[ 16 ];
+};
+static_assert( sizeof( CacheHeader ) == 64, "Unexpected cache header size" );
+
+static const uint32_t nTrimVersion = 1;
+static const char sTrimMagic[ 8 ] = { 'H', '2', 'S', 'C', 'T', 'R', 'I', 'M' };
+
+/** Content of the sidecar files written by
+ * SampleCache::storeTrimRange(). */
+struct TrimRange {
+	char sMagic[ 8 ];
+	uint32_t nVersion;
+	float fThreshold;
+	int64_t nSourceSize;
+	int64_t nSourceModified;
+	int64_t nFrames;
+	int64_t nStart;
+	int64_t nEnd;
+};
+
+/** \return Path of the sidecar file holding the trim range of
+ * variant @a sVariant of @a sFilepath. */
+static QString getTrimPath( const QString& sFilepath, const QString& sVariant )
+{
+	QString sPath = SampleCache::getCachePath( sFilepath, sVariant );
+	sPath.chop( static_cast<int>( strlen( SAMPLE_CACHE_EXT ) ) );
+	return sPath + SAMPLE_TRIM_EXT;
+}
+
+SampleCache::Mapping::Mapping( void* pAddress, size_t nSize )
+	: m_pAddress( pAddress )
+	, m_nSize( nSize )
+	, m_bStreamed( false ) {
+}
+
+SampleCache::Mapping::~Mapping() {
+#ifndef WIN32
+	if ( m_pAddress != nullptr ) {
+		munmap( m_pAddress, m_nSize );
+	}
+#endif
+}
+
+QString SampleCache::getCachePath( const QString& sFilepath, const QString& sVariant )
+{
+	QString sKey = QFileInfo( sFilepath ).absoluteFilePath();
+	if ( ! sVariant.isEmpty() ) {
+		sKey.append( "|" ).append( sVariant );
+	}
+	const QByteArray hash = QCryptographicHash::hash( sKey.toUtf8(),
+													  QCryptographicHash::Sha1 );
+	return Filesystem::sample_cache_dir() + QString( hash.toHex() ) + SAMPLE_CACHE_EXT;
+}
+
+bool SampleCache::isCacheable( const QString& sFilepath )
+{
+#ifdef WIN32
+	return false;
+#else
+	return ! QFileInfo( sFilepath ).absoluteFilePath()
+		.startsWith( QFileInfo( Filesystem::tmp_dir() ).absoluteFilePath() );
+#endif
+}
+
+std::unique_ptr<SampleCache::Mapping> SampleCache::map( const QString& sFilepath,
+														int* pnFrames, int* pnSampleRate,
+														float** ppData_L, float** ppData_R,
+														const QString& sVariant )
+{
+#ifdef WIN32
+	return nullptr;
+#else
+	const QFileInfo sourceInfo( sFilepath );
+	if ( ! sourceInfo.exists() ) {
+		return nullptr;
+	}
+
+	const QString sCachePath = getCachePath( sFilepath, sVariant );
+	int fd = ::open( sCachePath.toLocal8Bit().constData(), O_RDONLY );
+	if ( fd < 0 ) {
+		// Not cached yet.
+		return nullptr;
+	}
+
+	CacheHeader header;
+	struct stat cacheStat;
+	bool bValid = fstat( fd, &cacheStat ) == 0 &&
+		::read( fd, &header, sizeof( header ) ) == static_cast<ssize_t>( sizeof( header ) ) &&
+		memcmp( header.sMagic, sCacheMagic, sizeof( sCacheMagic ) ) == 0 &&
+		header.nVersion == nCacheVersion &&
+		( header.nChannels == 1 || header.nChannels == 2 ) &&
+		header.nFrames >= 0 &&
+		header.nFrames <= std::numeric_limits<int>::max() &&
+		header.nSourceSize == sourceInfo.size() &&
+		header.nSourceModified == sourceInfo.lastModified().toMSecsSinceEpoch() &&
+		static_cast<int64_t>( cacheStat.st_size ) ==
+		static_cast<int64_t>( sizeof( header ) +
+							  header.nChannels * header.nFrames * sizeof( float ) );
+	if ( ! bValid ) {
+		::close( fd );
+		INFOLOG( QString( "Cache file [%1] of [%2] is outdated" )
+				 .arg( sCachePath ).arg( sFilepath ) );
+		return nullptr;
+	}
+
+	// A private mapping allows transformations like
+	// Sample::apply_velocity() to alter the data in place. Only
+	// the pages written to will be copied.
+	const size_t nSize = static_cast<size_t>( cacheStat.st_size );
+	void* pAddress = mmap( nullptr, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	// The mapping stays valid after the descriptor was closed.
+	::close( fd );
+	if ( pAddress == MAP_FAILED ) {
+		WARNINGLOG( QString( "Unable to map cache file [%1]: %2" )
+					.arg( sCachePath ).arg( strerror( errno ) ) );
+		return nullptr;
+	}
+
+	auto pData = reinterpret_cast<float*>( static_cast<char*>( pAddress ) + sizeof( header ) );
+	*pnFrames = static_cast<int>( header.nFrames );
+	*pnSampleRate = static_cast<int>( header.nSampleRate );
+	*ppData_L = pData;
+	*ppData_R = header.nChannels == 1 ? pData : pData + header.nFrames;
+
+	return std::make_unique<Mapping>( pAddress, nSize );
+#endif
+}
+
+bool SampleCache::store( const QString& sFilepath, int nFrames, int nSampleRate,
+						 const float* pData_L, const float* pData_R,
+						 const QString& sVariant )
+{
+#ifdef WIN32
+	return false;
+#else
+	const QFileInfo sourceInfo( sFilepath );
+	if ( ! sourceInfo.exists() || nFrames < 0 ) {
+		return false;
+	}
+
+	if ( ! Filesystem::path_usable( Filesystem::sample_cache_dir(), true, true ) ) {
+		return false;
+	}
+
+	CacheHeader header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.sMagic, sCacheMagic, sizeof( sCacheMagic ) );
+	header.nVersion = nCacheVersion;
+	// Mono samples share a single buffer for both channels.
+	header.nChannels = pData_L == pData_R ? 1 : 2;
+	header.nFrames = nFrames;
+	header.nSampleRate = nSampleRate;
+	header.nSourceSize = sourceInfo.size();
+	header.nSourceModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+
+	const QString sCachePath = getCachePath( sFilepath, sVariant );
+	const qint64 nChannelBytes = static_cast<qint64>( nFrames ) * sizeof( float );
+	QSaveFile file( sCachePath );
+	if ( ! file.open( QIODevice::WriteOnly ) ||
+		 file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) ) !=
+		 static_cast<qint64>( sizeof( header ) ) ||
+		 file.write( reinterpret_cast<const char*>( pData_L ), nChannelBytes ) !=
+		 nChannelBytes ||
+		 ( header.nChannels == 2 &&
+		   file.write( reinterpret_cast<const char*>( pData_R ), nChannelBytes ) !=
+		   nChannelBytes ) ||
+		 ! file.commit() ) {
+		WARNINGLOG( QString( "Unable to write cache file [%1] of [%2]: %3" )
+					.arg( sCachePath ).arg( sFilepath ).arg( file.errorString() ) );
+		return false;
+	}
+
+	return true;
+#endif
+}
+
+bool SampleCache::storeTrimRange( const QString& sFilepath, const QString& sVariant,
+								  float fThreshold, int nFrames,
+								  int nStart, int nEnd )
+{
+	const QFileInfo sourceInfo( sFilepath );
+	if ( ! sourceInfo.exists() ||
+		 ! Filesystem::path_usable( Filesystem::sample_cache_dir(), true, true ) ) {
+		return false;
+	}
+
+	TrimRange range;
+	memset( &range, 0, sizeof( range ) );
+	memcpy( range.sMagic, sTrimMagic, sizeof( sTrimMagic ) );
+	range.nVersion = nTrimVersion;
+	range.fThreshold = fThreshold;
+	range.nSourceSize = sourceInfo.size();
+	range.nSourceModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+	range.nFrames = nFrames;
+	range.nStart = nStart;
+	range.nEnd = nEnd;
+
+	const QString sTrimPath = getTrimPath( sFilepath, sVariant );
+	QSaveFile file( sTrimPath );
+	if ( ! file.open( QIODevice::WriteOnly ) ||
+		 file.write( reinterpret_cast<const char*>( &range ), sizeof( range ) ) !=
+		 static_cast<qint64>( sizeof( range ) ) ||
+		 ! file.commit() ) {
+		WARNINGLOG( QString( "Unable to write trim range [%1] of [%2]: %3" )
+					.arg( sTrimPath ).arg( sFilepath ).arg( file.errorString() ) );
+		return false;
+	}
+
+	return true;
+}
+
+bool SampleCache::readTrimRange( const QString& sFilepath, const QString& sVariant,
+								 float fThreshold, int nFrames,
+								 int* pnStart, int* pnEnd )
+{
+	const QFileInfo sourceInfo( sFilepath );
+	if ( ! sourceInfo.exists() ) {
+		return false;
+	}
+
+	QFile file( getTrimPath( sFilepath, sVariant ) );
+	if ( ! file.open( QIODevice::ReadOnly ) ) {
+		// Not detected yet.
+		return false;
+	}
+
+	TrimRange range;
+	const bool bValid =
+		file.read( reinterpret_cast<char*>( &range ), sizeof( range ) ) ==
+		static_cast<qint64>( sizeof( range ) ) &&
+		memcmp( range.sMagic, sTrimMagic, sizeof( sTrimMagic ) ) == 0 &&
+		range.nVersion == nTrimVersion &&
+		range.fThreshold == fThreshold &&
+		range.nSourceSize == sourceInfo.size() &&
+		range.nSourceModified == sourceInfo.lastModified().toMSecsSinceEpoch() &&
+		range.nFrames == nFrames &&
+		range.nStart >= 0 && range.nStart <= range.nEnd && range.nEnd <= nFrames;
+	if ( ! bValid ) {
+		return false;
+	}
+
+	*pnStart = static_cast<int>( range.nStart );
+	*pnEnd = static_cast<int>( range.nEnd );
+	return true;
+}
+
+#ifndef WIN32
+/** Widens [@a pData, @a pData + @a nFrames) to whole pages. */
+static void pageRange( const float* pData, int nFrames, char** ppStart, size_t* pnSize )
+{
+	static const uintptr_t nPageSize = static_cast<uintptr_t>( sysconf( _SC_PAGESIZE ) );
+	const uintptr_t nBegin = reinterpret_cast<uintptr_t>( pData ) & ~( nPageSize - 1 );
+	const uintptr_t nEnd = reinterpret_cast<uintptr_t>( pData + nFrames );
+	*ppStart = reinterpret_cast<char*>( nBegin );
+	*pnSize = nEnd - nBegin;
+}
+#endif
+
+void SampleCache::populate( const float* pData, int nFrames )
+{
+#ifndef WIN32
+	if ( pData == nullptr || nFrames <= 0 ) {
+		return;
+	}
+	char* pStart;
+	size_t nSize;
+	pageRange( pData, nFrames, &pStart, &nSize );
+
+	// Let the kernel read all pages at once before touching them
+	// one by one.
+	madvise( pStart, nSize, MADV_WILLNEED );
+
+	const size_t nPageSize = static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+	volatile char cSink = 0;
+	for ( size_t nOffset = 0; nOffset < nSize; nOffset += nPageSize ) {
+		cSink = pStart[ nOffset ];
+	}
+	(void) cSink;
+#endif
+}
+
+bool SampleCache::lock( const float* pData, int nFrames )
+{
+#ifdef WIN32
+	return false;
+#else
+	if ( pData == nullptr || nFrames <= 0 ) {
+		return true;
+	}
+	char* pStart;
+	size_t nSize;
+	pageRange( pData, nFrames, &pStart, &nSize );
+
+	// Locking reads the pages as well.
+	if ( mlock( pStart, nSize ) == 0 ) {
+		return true;
+	}
+
+	populate( pData, nFrames );
+	return false;
+#endif
+}
+
+};
+
+/* vim: set softtabstop=4 noexpandtab: */
@@ -0,0 +1,194 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SAMPLE_CACHE_H
+#define H2C_SAMPLE_CACHE_H
+
+#include <core/Object.h>
+
+#include <memory>
+
+namespace H2Core
+{
+
+/**
+ * Persistent cache of decoded samples located in
+ * Filesystem::sample_cache_dir().
+ *
+ * Each cache file holds the frames of a single sample file as
+ * de-interleaved floats - all frames of the left channel followed by
+ * all frames of the right one. Mono samples are stored using a
+ * single channel. It is named after a hash of the
+ * absolute path of the sample and stores both size and modification
+ * time of the sample file it was created from. A cache file is
+ * only used as long as both still match. Processed versions of a
+ * sample - e.g. one converted to another sample rate - are stored
+ * in separate cache files told apart by a variant string.
+ *
+ * Cache files are mapped into memory instead of being read. Loading
+ * a cached sample thus requires no decoding and the pages are
+ * shared between all Hydrogen instances using the same sample.
+ * Large samples are streamed (see Sample::is_streamed()): only
+ * their beginning is read on load while the SampleStreamer reads
+ * the remaining pages ahead of playback.
+ *
+ * The cache is not available on Windows.
+ */
+/** \ingroup docCore */
+class SampleCache : public H2Core::Object<SampleCache>
+{
+		H2_OBJECT(SampleCache)
+	public:
+		/** Cache file mapped into memory. The mapping is released
+		 * on destruction. */
+		class Mapping {
+			public:
+				Mapping( void* pAddress, size_t nSize );
+				~Mapping();
+				Mapping( const Mapping& ) = delete;
+				Mapping& operator=( const Mapping& ) = delete;
+
+				/** Whether the data is streamed from disk by the
+				 * SampleStreamer instead of being held in memory
+				 * entirely. */
+				bool isStreamed() const;
+				void setStreamed( bool bStreamed );
+
+			private:
+				void* m_pAddress;
+				size_t m_nSize;
+				bool m_bStreamed;
+		};
+
+		/**
+		 * Maps the cached content of @a sFilepath into memory.
+		 *
+		 * The mapping is private. Writing to @a ppData_L or @a
+		 * ppData_R does neither alter the cache file nor other
+		 * processes mapping it.
+		 *
+		 * \param sFilepath Sample file.
+		 * \param pnFrames Number of frames per channel.
+		 * \param pnSampleRate Sample rate of the sample.
+		 * \param ppData_L Left channel within the mapping.
+		 * \param ppData_R Right channel within the mapping. Same as
+		 * @a ppData_L for mono samples.
+		 * \param sVariant Processed version of the sample. The
+		 * plain decoded content if empty.
+		 *
+		 * \return Mapping holding the data. nullptr in case there
+		 * is no up-to-date cache file for @a sFilepath.
+		 */
+		static std::unique_ptr<Mapping> map( const QString& sFilepath,
+										   int* pnFrames, int* pnSampleRate,
+										   float** ppData_L, float** ppData_R,
+										   const QString& sVariant = "" );
+		/**
+		 * Writes the decoded content of @a sFilepath into the cache.
+		 *
+		 * Passing the same buffer as @a pData_L and @a pData_R
+		 * stores a mono sample.
+		 *
+		 * The cache file is written to a temporary file first and
+		 * renamed afterwards. Other processes will thus never map a
+		 * partially written one.
+		 *
+		 * \param sVariant Processed version of the sample @a
+		 * pData_L and @a pData_R hold. See map().
+		 *
+		 * \return true on success.
+		 */
+		static bool store( const QString& sFilepath, int nFrames, int nSampleRate,
+						   const float* pData_L, const float* pData_R,
+						   const QString& sVariant = "" );
+		/** \return Path of the cache file of variant @a sVariant of
+		 * @a sFilepath. */
+		static QString getCachePath( const QString& sFilepath,
+									 const QString& sVariant = "" );
+		/**
+		 * Stores the frames [@a nStart, @a nEnd) of variant @a
+		 * sVariant of @a sFilepath holding content above @a
+		 * fThreshold. See Sample::trim_silence().
+		 *
+		 * The range is written to a small sidecar file next to the
+		 * cache file. It does not require the sample data itself to
+		 * be cached.
+		 *
+		 * \param nFrames Number of frames of the sample the range
+		 * was detected in.
+		 *
+		 * \return true on success.
+		 */
+		static bool storeTrimRange( const QString& sFilepath, const QString& sVariant,
+									float fThreshold, int nFrames,
+									int nStart, int nEnd );
+		/**
+		 * Reads a range stored by storeTrimRange().
+		 *
+		 * \return false in case there is no up-to-date range of a
+		 * sample of @a nFrames frames detected using @a
+		 * fThreshold.
+		 */
+		static bool readTrimRange( const QString& sFilepath, const QString& sVariant,
+								   float fThreshold, int nFrames,
+								   int* pnStart, int* pnEnd );
+		/**
+		 * Whether samples in @a sFilepath should be cached.
+		 *
+		 * Files in Filesystem::tmp_dir() - e.g. the output of the
+		 * Rubber Band CLI - are never cached.
+		 */
+		static bool isCacheable( const QString& sFilepath );
+
+		/**
+		 * Reads the pages of a mapping holding the @a nFrames frames
+		 * starting at @a pData from disk unless they are already
+		 * in memory.
+		 *
+		 * Blocks till all pages are read. Must thus never be called
+		 * from the audio thread.
+		 */
+		static void populate( const float* pData, int nFrames );
+		/**
+		 * Like populate() but additionally pins the pages in memory
+		 * till the mapping is released.
+		 *
+		 * \return false in case the pages could not be locked, e.g.
+		 * because RLIMIT_MEMLOCK was exceeded. They are populated
+		 * nevertheless.
+		 */
+		static bool lock( const float* pData, int nFrames );
+};
+
+inline bool SampleCache::Mapping::isStreamed() const {
+	return m_bStreamed;
+}
+
+inline void SampleCache::Mapping::setStreamed( bool bStreamed ) {
+	m_bStreamed = bStreamed;
+}
+
+};
+
+#endif // H2C_SAMPLE_CACHE_H
+
+/* vim: set softtabstop=4 noexpandtab: */
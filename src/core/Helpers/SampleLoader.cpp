@@ -0,0 +1,132 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Helpers/SampleLoader.h>
+#include <core/Helpers/SampleRegistry.h>
+#include <core/EventQueue.h>
+
+#include <algorithm>
+#include <thread>
+
+namespace H2Core
+{
+
+std::atomic<unsigned> SampleLoader::m_generations[ SampleLoader::nScopes ] = {};
+
+SampleLoader::Request::Request( const QString& sFilepath )
+	: sFilepath( sFilepath )
+	, bApply( false )
+	, fBpm( 0 )
+	, pSample( nullptr ) {
+}
+
+SampleLoader::Request::Request( const QString& sFilepath, const Sample::Loops& loops,
+								const Sample::Rubberband& rubberband,
+								const Sample::VelocityEnvelope& velocity,
+								const Sample::PanEnvelope& pan, float fBpm )
+	: sFilepath( sFilepath )
+	, bApply( true )
+	, loops( loops )
+	, rubberband( rubberband )
+	, velocity( velocity )
+	, pan( pan )
+	, fBpm( fBpm )
+	, pSample( nullptr ) {
+}
+
+bool SampleLoader::load( std::vector<Request>& requests, Scope scope )
+{
+	std::atomic<unsigned>& generation = m_generations[ static_cast<int>( scope ) ];
+	const unsigned nGeneration = ++generation;
+	const int nRequests = requests.size();
+	if ( nRequests == 0 ) {
+		return true;
+	}
+
+	EventQueue* pEventQueue = EventQueue::get_instance();
+	if ( pEventQueue != nullptr ) {
+		pEventQueue->push_event( EVENT_SAMPLE_LOADING_PROGRESS, 0 );
+	}
+
+	std::atomic<int> nNextRequest( 0 );
+	std::atomic<int> nFinishedRequests( 0 );
+	auto work = [&]() {
+		int nRequest;
+		while ( generation == nGeneration &&
+				( nRequest = nNextRequest++ ) < nRequests ) {
+			loadRequest( requests[ nRequest ] );
+
+			// Report each percent once. Completion is reported by
+			// the calling thread after all workers are done.
+			const int nFinished = ++nFinishedRequests;
+			const int nPercent = nFinished * 100 / nRequests;
+			if ( pEventQueue != nullptr && nFinished < nRequests &&
+				 nPercent != ( nFinished - 1 ) * 100 / nRequests ) {
+				pEventQueue->push_event( EVENT_SAMPLE_LOADING_PROGRESS, nPercent );
+			}
+		}
+	};
+
+	const int nThreads = std::min( { nRequests, nMaxThreads,
+			static_cast<int>( std::max( 1u, std::thread::hardware_concurrency() ) ) } );
+	std::vector<std::thread> workers;
+	for ( int ii = 1; ii < nThreads; ++ii ) {
+		workers.emplace_back( work );
+	}
+	work();
+	for ( auto& worker : workers ) {
+		worker.join();
+	}
+
+	if ( generation != nGeneration ) {
+		INFOLOG( QString( "Loading samples cancelled after %1 of %2" )
+				 .arg( nFinishedRequests.load() ).arg( nRequests ) );
+		return false;
+	}
+
+	if ( pEventQueue != nullptr ) {
+		pEventQueue->push_event( EVENT_SAMPLE_LOADING_PROGRESS, 100 );
+	}
+
+	return true;
+}
+
+void SampleLoader::cancel( Scope scope )
+{
+	++m_generations[ static_cast<int>( scope ) ];
+}
+
+void SampleLoader::loadRequest( Request& request )
+{
+	if ( ! request.bApply ) {
+		request.pSample = SampleRegistry::load( request.sFilepath );
+		return;
+	}
+
+	request.pSample = SampleRegistry::load( request.sFilepath, request.loops,
+											request.rubberband, request.velocity,
+											request.pan, request.fBpm );
+}
+
+};
+
+/* vim: set softtabstop=4 noexpandtab: */
@@ -0,0 +1,129 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SAMPLE_LOADER_H
+#define H2C_SAMPLE_LOADER_H
+
+#include <core/Object.h>
+#include <core/Basics/Sample.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace H2Core
+{
+
+/**
+ * Loads a batch of samples - e.g. all layers of a drumkit or song -
+ * concurrently.
+ *
+ * All samples are obtained via the #SampleRegistry. The batch is
+ * distributed across a bounded number of threads spawned for each
+ * call of load(). Progress is reported via
+ * #EVENT_SAMPLE_LOADING_PROGRESS.
+ *
+ * Each batch belongs to a #Scope. Only a single batch per scope is
+ * loaded at a time. Starting another one while a batch of the same
+ * scope is still in progress - e.g. because the user picked a
+ * different drumkit or a playlist advanced to the next song -
+ * cancels the previous batch. Batches of other scopes are not
+ * affected.
+ */
+/** \ingroup docCore */
+class SampleLoader : public H2Core::Object<SampleLoader>
+{
+		H2_OBJECT(SampleLoader)
+	public:
+		/** Kind of load a batch is part of. A newer batch only
+		 * cancels outdated ones of the same kind. */
+		enum class Scope {
+			/** Samples of a Drumkit, see Drumkit::load_samples(). */
+			Drumkit = 0,
+			/** Samples of a Song read from disk. */
+			Song = 1,
+			/** Samples converted to a new sample rate, see
+			 * Hydrogen::updateSampleRates(). */
+			SampleRate = 2
+		};
+
+		/** Single sample to be loaded by load(). */
+		struct Request {
+			Request( const QString& sFilepath );
+			Request( const QString& sFilepath, const Sample::Loops& loops,
+					 const Sample::Rubberband& rubberband,
+					 const Sample::VelocityEnvelope& velocity,
+					 const Sample::PanEnvelope& pan, float fBpm );
+
+			QString sFilepath;
+			/** Whether #loops, #rubberband, #velocity, and #pan are
+			 * applied to the sample. */
+			bool bApply;
+			Sample::Loops loops;
+			Sample::Rubberband rubberband;
+			Sample::VelocityEnvelope velocity;
+			Sample::PanEnvelope pan;
+			float fBpm;
+			/** Loaded sample. nullptr in case loading failed or
+			 * was cancelled. */
+			std::shared_ptr<Sample> pSample;
+		};
+
+		/**
+		 * Loads the samples of all @a requests and returns once all
+		 * of them are done.
+		 *
+		 * \param requests Samples to load.
+		 * \param scope Kind of load the batch belongs to.
+		 *
+		 * \return false in case the batch was cancelled by cancel()
+		 * or superseded by a newer call to load() using the same
+		 * @a scope. Requests not handled by then hold no sample.
+		 */
+		static bool load( std::vector<Request>& requests, Scope scope );
+		/** Cancels the batch of @a scope currently loaded (if any). */
+		static void cancel( Scope scope );
+
+		/**
+		 * Upper bound of the number of samples decoded
+		 * concurrently. Loading is largely bound by disk I/O and
+		 * more threads would just compete for the same drive.
+		 */
+		static constexpr int nMaxThreads = 4;
+
+	private:
+		static void loadRequest( Request& request );
+
+		/** Number of values of #Scope. */
+		static constexpr int nScopes = 3;
+		/** Incremented by each call of load() and cancel() for the
+		 * corresponding #Scope. A batch is aborted as soon as its
+		 * entry does not match the number it was started with
+		 * anymore. */
+		static std::atomic<unsigned> m_generations[ nScopes ];
+};
+
+};
+
+#endif // H2C_SAMPLE_LOADER_H
+
+/* vim: set softtabstop=4 noexpandtab: */
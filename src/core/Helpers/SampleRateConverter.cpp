@@ -0,0 +1,161 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Helpers/SampleRateConverter.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace H2Core
+{
+
+/** Cutoff of the lowpass relative to the lower of both Nyquist
+ * frequencies. */
+static const double fRolloff = 0.95;
+/** Shape parameter of the Kaiser window. Yields about 90 dB
+ * stopband attenuation. */
+static const double fKaiserBeta = 9.0;
+
+/** Zeroth order modified Bessel function of the first kind. */
+static double besselI0( double fX )
+{
+	double fSum = 1.0;
+	double fTerm = 1.0;
+	const double fHalfX = fX / 2.0;
+	for ( int k = 1; k < 64; ++k ) {
+		fTerm *= ( fHalfX / k ) * ( fHalfX / k );
+		fSum += fTerm;
+		if ( fTerm < fSum * 1e-12 ) {
+			break;
+		}
+	}
+	return fSum;
+}
+
+SampleRateConverter::SampleRateConverter( int nSourceRate, int nTargetRate )
+{
+	assert( nSourceRate > 0 && nTargetRate > 0 );
+	const long long nGcd = std::gcd( static_cast<long long>( nSourceRate ),
+									 static_cast<long long>( nTargetRate ) );
+	m_nUp = nTargetRate / nGcd;
+	m_nDown = nSourceRate / nGcd;
+	m_nPhases = static_cast<int>( std::min( m_nUp, static_cast<long long>( nMaxPhases ) ) );
+
+	// Cutoff in cycles per source frame times two. When
+	// downsampling the sinc is stretched to remove everything above
+	// the Nyquist frequency of the target rate.
+	const double fCutoff = fRolloff *
+		std::min( 1.0, static_cast<double>( nTargetRate ) / nSourceRate );
+	const double fHalfWidth = nZeroCrossings / fCutoff;
+	const int nHalfTaps = static_cast<int>( std::ceil( fHalfWidth ) );
+	m_nTaps = 2 * nHalfTaps;
+
+	const double fNormalization = besselI0( fKaiserBeta );
+	m_coefficients.resize( static_cast<size_t>( m_nPhases + 1 ) * m_nTaps );
+	for ( int nPhase = 0; nPhase <= m_nPhases; ++nPhase ) {
+		const double fFraction = static_cast<double>( nPhase ) / m_nPhases;
+		float* pPhase = &m_coefficients[ static_cast<size_t>( nPhase ) * m_nTaps ];
+		for ( int nTap = 0; nTap < m_nTaps; ++nTap ) {
+			// Distance of the input frame from the position of the
+			// output frame in source frames.
+			const double fX = nTap - ( nHalfTaps - 1 ) - fFraction;
+			const double fRelative = fX / fHalfWidth;
+			if ( std::abs( fRelative ) >= 1.0 ) {
+				pPhase[ nTap ] = 0;
+				continue;
+			}
+			const double fArg = M_PI * fCutoff * fX;
+			const double fSinc = fArg == 0.0 ? 1.0 : std::sin( fArg ) / fArg;
+			const double fWindow =
+				besselI0( fKaiserBeta * std::sqrt( 1.0 - fRelative * fRelative ) ) /
+				fNormalization;
+			pPhase[ nTap ] = static_cast<float>( fCutoff * fSinc * fWindow );
+		}
+	}
+}
+
+int SampleRateConverter::getFrames( int nFrames ) const
+{
+	const long long nTargetFrames =
+		( static_cast<long long>( nFrames ) * m_nUp + m_nDown - 1 ) / m_nDown;
+	return static_cast<int>( std::min( nTargetFrames,
+									   static_cast<long long>( std::numeric_limits<int>::max() ) ) );
+}
+
+/** Applies the @a nTaps coefficients in @a pPhase to the frames of
+ * @a pSource starting at @a nFirst. Frames outside of [0, @a
+ * nFrames) are silent. */
+static inline float applyPhase( const float* pPhase, int nTaps, const float* pSource,
+								long long nFirst, int nFrames )
+{
+	float fSum = 0;
+	if ( nFirst >= 0 && nFirst + nTaps <= nFrames ) {
+		const float* pFrames = pSource + nFirst;
+		for ( int nTap = 0; nTap < nTaps; ++nTap ) {
+			fSum += pPhase[ nTap ] * pFrames[ nTap ];
+		}
+	} else {
+		const int nBegin = static_cast<int>( std::max( 0LL, -nFirst ) );
+		const int nEnd = static_cast<int>(
+			std::min( static_cast<long long>( nTaps ), nFrames - nFirst ) );
+		for ( int nTap = nBegin; nTap < nEnd; ++nTap ) {
+			fSum += pPhase[ nTap ] * pSource[ nFirst + nTap ];
+		}
+	}
+	return fSum;
+}
+
+void SampleRateConverter::process( const float* pSource, int nFrames, float* pTarget ) const
+{
+	const int nTargetFrames = getFrames( nFrames );
+	const long long nHalfTaps = m_nTaps / 2;
+	const bool bExact = m_nPhases == m_nUp;
+	for ( int nFrame = 0; nFrame < nTargetFrames; ++nFrame ) {
+		// Position of the output frame in units of 1 / m_nUp source
+		// frames.
+		const long long nPosition = nFrame * m_nDown;
+		const long long nIndex = nPosition / m_nUp;
+		const long long nRemainder = nPosition % m_nUp;
+		const long long nFirst = nIndex - ( nHalfTaps - 1 );
+
+		if ( bExact ) {
+			pTarget[ nFrame ] = applyPhase(
+				&m_coefficients[ static_cast<size_t>( nRemainder ) * m_nTaps ],
+				m_nTaps, pSource, nFirst, nFrames );
+		} else {
+			const double fPhase = static_cast<double>( nRemainder ) * m_nPhases / m_nUp;
+			const int nPhase = static_cast<int>( fPhase );
+			const float fWeight = static_cast<float>( fPhase - nPhase );
+			const float* pPhase = &m_coefficients[ static_cast<size_t>( nPhase ) * m_nTaps ];
+			const float fLower = applyPhase( pPhase, m_nTaps, pSource, nFirst, nFrames );
+			const float fUpper = applyPhase( pPhase + m_nTaps, m_nTaps, pSource, nFirst, nFrames );
+			pTarget[ nFrame ] = fLower + ( fUpper - fLower ) * fWeight;
+		}
+	}
+}
+
+};
+
+/* vim: set softtabstop=4 noexpandtab: */
@@ -0,0 +1,103 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SAMPLE_RATE_CONVERTER_H
+#define H2C_SAMPLE_RATE_CONVERTER_H
+
+#include <core/Object.h>
+
+#include <vector>
+
+namespace H2Core
+{
+
+/**
+ * High quality sample rate conversion used to bring samples to the
+ * sample rate of the audio driver while they are loaded (see
+ * Preferences::m_bConvertSampleRates).
+ *
+ * The signal is filtered by a Kaiser windowed sinc lowpass
+ * implemented as a polyphase filter bank. The ratio of both rates
+ * is reduced to a fraction and, as long as its denominator is
+ * small enough, each output frame uses a dedicated phase of the
+ * bank. Otherwise the coefficients are interpolated linearly
+ * between #nMaxPhases phases.
+ *
+ * The passband extends to about 95% of the lower of both Nyquist
+ * frequencies and the stopband attenuation is about 90 dB.
+ * Frames prior to the start and past the end of the input are
+ * treated as silence.
+ *
+ * Converting is way too expensive to be done in the audio thread.
+ */
+/** \ingroup docCore */
+class SampleRateConverter : public H2Core::Object<SampleRateConverter>
+{
+		H2_OBJECT(SampleRateConverter)
+	public:
+		/** Sets up the filter bank for converting from @a
+		 * nSourceRate to @a nTargetRate. Both have to be
+		 * positive. */
+		SampleRateConverter( int nSourceRate, int nTargetRate );
+
+		/** \return Number of frames @a nFrames frames at the
+		 * source rate are converted into. */
+		int getFrames( int nFrames ) const;
+		/**
+		 * Converts a single channel.
+		 *
+		 * \param pSource @a nFrames frames at the source rate.
+		 * \param nFrames Number of frames in @a pSource.
+		 * \param pTarget Buffer receiving getFrames( @a nFrames )
+		 * frames at the target rate.
+		 */
+		void process( const float* pSource, int nFrames, float* pTarget ) const;
+
+		/** Upper bound of the number of phases of the filter
+		 * bank. */
+		static constexpr int nMaxPhases = 1024;
+		/** Number of zero crossings of the sinc on either side of
+		 * its center. Determines the steepness of the filter. */
+		static constexpr int nZeroCrossings = 64;
+
+	private:
+		/** Numerator of the reduced ratio of target and source
+		 * rate. */
+		long long m_nUp;
+		/** Denominator of the reduced ratio of target and source
+		 * rate. */
+		long long m_nDown;
+		/** Number of phases in #m_coefficients. */
+		int m_nPhases;
+		/** Number of taps of each phase. */
+		int m_nTaps;
+		/** #m_nPhases + 1 phases of #m_nTaps coefficients each. The
+		 * last one allows to interpolate between the first phase
+		 * and the first one of the next input frame. */
+		std::vector<float> m_coefficients;
+};
+
+};
+
+#endif // H2C_SAMPLE_RATE_CONVERTER_H
+
+/* vim: set softtabstop=4 noexpandtab: */
@@ -0,0 +1,231 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Helpers/SampleRegistry.h>
+#include <core/Hydrogen.h>
+#include <core/IO/AudioOutput.h>
+#include <core/Preferences/Preferences.h>
+
+#include <QDateTime>
+#include <QFileInfo>
+
+namespace H2Core
+{
+
+std::mutex SampleRegistry::m_mutex;
+std::map<QString, std::weak_ptr<Sample>> SampleRegistry::m_samples;
+int SampleRegistry::m_nInsertions = 0;
+std::atomic<long> SampleRegistry::m_nHits( 0 );
+std::atomic<long> SampleRegistry::m_nMisses( 0 );
+
+std::shared_ptr<Sample> SampleRegistry::load( const QString& sFilepath )
+{
+	// Samples stored compactly, converted to another rate, or
+	// trimmed are kept apart from the plain ones. This way toggling
+	// the options affects all samples loaded afterwards.
+	auto pPref = Preferences::get_instance();
+	const int nSampleRate = getTargetSampleRate();
+	QString sOptions = pPref != nullptr && pPref->m_bUseCompactSamples ? "compact;" : "";
+	if ( nSampleRate > 0 ) {
+		sOptions.append( QString( "rate=%1;" ).arg( nSampleRate ) );
+	}
+	sOptions.append( getTrimOptions() );
+	const QString sKey = createKey( sFilepath, sOptions );
+	if ( sKey.isEmpty() ) {
+		// Let Sample::load() report the error.
+		return Sample::load( sFilepath, nSampleRate );
+	}
+
+	auto pSample = lookup( sKey );
+	if ( pSample != nullptr ) {
+		return pSample;
+	}
+
+	pSample = Sample::load( sFilepath, nSampleRate );
+	if ( pSample == nullptr ) {
+		return nullptr;
+	}
+	trimSilence( pSample, nSampleRate > 0 ?
+				 Sample::sample_rate_variant( nSampleRate ) : "" );
+
+	return insert( sKey, pSample );
+}
+
+std::shared_ptr<Sample> SampleRegistry::load( const QString& sFilepath,
+											  const Sample::Loops& loops,
+											  const Sample::Rubberband& rubber,
+											  const Sample::VelocityEnvelope& velocity,
+											  const Sample::PanEnvelope& pan,
+											  float fBpm )
+{
+	const Sample::Loops defaultLoops;
+	if ( loops == defaultLoops && ! rubber.use &&
+		 velocity.empty() && pan.empty() ) {
+		// Sample::apply() would not alter the sample. Share it
+		// with all plain requests.
+		return load( sFilepath );
+	}
+
+	QString sTransformations =
+		Sample::transformations_to_key( loops, rubber, velocity, pan, fBpm );
+	const int nSampleRate = getTargetSampleRate();
+	if ( nSampleRate > 0 ) {
+		sTransformations.append( QString( ";rate=%1" ).arg( nSampleRate ) );
+	}
+
+	const QString sKey = createKey( sFilepath, sTransformations + ";" +
+									getTrimOptions() );
+	if ( sKey.isEmpty() ) {
+		return Sample::load( sFilepath, loops, rubber, velocity, pan, fBpm,
+							 nSampleRate );
+	}
+
+	auto pSample = lookup( sKey );
+	if ( pSample != nullptr ) {
+		return pSample;
+	}
+
+	pSample = Sample::load( sFilepath, loops, rubber, velocity, pan, fBpm,
+							nSampleRate );
+	if ( pSample == nullptr ) {
+		return nullptr;
+	}
+	// Trimming is done after the transformations since they refer
+	// to the frames of the file.
+	trimSilence( pSample, sTransformations );
+
+	return insert( sKey, pSample );
+}
+
+int SampleRegistry::getTargetSampleRate()
+{
+	auto pPref = Preferences::get_instance();
+	auto pHydrogen = Hydrogen::get_instance();
+	if ( pPref == nullptr || ! pPref->m_bConvertSampleRates ||
+		 pHydrogen == nullptr ) {
+		return 0;
+	}
+
+	auto pAudioOutput = pHydrogen->getAudioOutput();
+	return pAudioOutput != nullptr ?
+		static_cast<int>( pAudioOutput->getSampleRate() ) : 0;
+}
+
+QString SampleRegistry::getTrimOptions()
+{
+	auto pPref = Preferences::get_instance();
+	if ( pPref == nullptr || ! pPref->m_bTrimSilence ) {
+		return "";
+	}
+	return QString( "trim=%1;" ).arg( pPref->m_fTrimSilenceThreshold );
+}
+
+void SampleRegistry::trimSilence( std::shared_ptr<Sample> pSample,
+								  const QString& sVariant )
+{
+	auto pPref = Preferences::get_instance();
+	if ( pPref != nullptr && pPref->m_bTrimSilence ) {
+		pSample->trim_silence( pPref->m_fTrimSilenceThreshold, sVariant );
+	}
+}
+
+int SampleRegistry::getSize()
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	int nSize = 0;
+	for ( const auto& entry : m_samples ) {
+		if ( ! entry.second.expired() ) {
+			++nSize;
+		}
+	}
+	return nSize;
+}
+
+QString SampleRegistry::createKey( const QString& sFilepath,
+								   const QString& sTransformations )
+{
+	const QFileInfo info( sFilepath );
+	const QString sCanonicalPath = info.canonicalFilePath();
+	if ( sCanonicalPath.isEmpty() ) {
+		return "";
+	}
+
+	// The multi-arg version of QString::arg() ensures placeholders
+	// within the path itself are left untouched.
+	return QString( "%1|%2|%3|%4" )
+		.arg( sCanonicalPath,
+			  QString::number( info.size() ),
+			  QString::number( info.lastModified().toMSecsSinceEpoch() ),
+			  sTransformations );
+}
+
+std::shared_ptr<Sample> SampleRegistry::lookup( const QString& sKey )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	auto it = m_samples.find( sKey );
+	if ( it == m_samples.end() ) {
+		return nullptr;
+	}
+
+	auto pSample = it->second.lock();
+	if ( pSample != nullptr ) {
+		++m_nHits;
+	}
+	return pSample;
+}
+
+std::shared_ptr<Sample> SampleRegistry::insert( const QString& sKey,
+												std::shared_ptr<Sample> pSample )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	auto& pRegistered = m_samples[ sKey ];
+	auto pOther = pRegistered.lock();
+	if ( pOther != nullptr ) {
+		// The same sample was loaded concurrently.
+		++m_nHits;
+		return pOther;
+	}
+
+	++m_nMisses;
+	pRegistered = pSample;
+
+	// Drop the entries of freed samples once in a while. Doing so
+	// after as many insertions as there are entries keeps the
+	// amortized costs per insertion constant.
+	if ( ++m_nInsertions >= static_cast<int>( m_samples.size() ) ) {
+		for ( auto it = m_samples.begin(); it != m_samples.end(); ) {
+			if ( it->second.expired() ) {
+				it = m_samples.erase( it );
+			} else {
+				++it;
+			}
+		}
+		m_nInsertions = 0;
+	}
+
+	return pSample;
+}
+
+};
+
+/* vim: set softtabstop=4 noexpandtab: */
@@ -0,0 +1,151 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SAMPLE_REGISTRY_H
+#define H2C_SAMPLE_REGISTRY_H
+
+#include <core/Object.h>
+#include <core/Basics/Sample.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace H2Core
+{
+
+/**
+ * Process-wide registry of all samples loaded from disk.
+ *
+ * Whenever the same sample file is requested with the same
+ * transformations - be it by several layers of a drumkit, by
+ * different drumkits, by consecutive songs of a playlist, or by the
+ * preview and playback track instruments - the already loaded
+ * #Sample is handed out again instead of decoding the file another
+ * time.
+ *
+ * Samples are identified by the canonical path of their file, its
+ * size and modification time, as well as the loops, Rubber Band
+ * settings, and envelopes applied to them and the sample rate they
+ * were converted to (see getTargetSampleRate()). Samples are trimmed
+ * after being loaded in case Preferences::m_bTrimSilence is
+ * set. The registry only holds
+ * weak references. A sample is freed as soon as the last
+ * #InstrumentLayer using it is gone.
+ *
+ * Samples handed out by the registry are shared and must not be
+ * altered in place. Create a copy using Sample::Sample( std::shared_ptr<Sample> )
+ * instead.
+ */
+/** \ingroup docCore */
+class SampleRegistry : public H2Core::Object<SampleRegistry>
+{
+		H2_OBJECT(SampleRegistry)
+	public:
+		/**
+		 * Shared version of Sample::load( const QString& ).
+		 *
+		 * \return The registered sample or a newly loaded one.
+		 * nullptr in case @a sFilepath could not be loaded.
+		 */
+		static std::shared_ptr<Sample> load( const QString& sFilepath );
+		/**
+		 * Shared version of Sample::load( const QString&, const
+		 * Sample::Loops&, const Sample::Rubberband&, const
+		 * Sample::VelocityEnvelope&, const Sample::PanEnvelope&, float ).
+		 *
+		 * \param fBpm Only taken into account in case @a rubber is
+		 * used.
+		 */
+		static std::shared_ptr<Sample> load( const QString& sFilepath,
+											 const Sample::Loops& loops,
+											 const Sample::Rubberband& rubber,
+											 const Sample::VelocityEnvelope& velocity,
+											 const Sample::PanEnvelope& pan,
+											 float fBpm );
+
+		/** \return Number of requests served by an already loaded
+		 * sample. */
+		static long getHits();
+		/** \return Number of requests which required to load the
+		 * sample. */
+		static long getMisses();
+		/** \return Number of samples currently alive. */
+		static int getSize();
+		/**
+		 * \return Sample rate of the audio driver in case
+		 * Preferences::m_bConvertSampleRates is set and 0
+		 * otherwise.
+		 *
+		 * All samples loaded via the registry are converted to
+		 * this rate.
+		 */
+		static int getTargetSampleRate();
+
+	private:
+		/**
+		 * \return Key identifying the file at @a sFilepath along
+		 * with the transformations in @a sTransformations. An empty
+		 * string in case the file does not exist.
+		 */
+		static QString createKey( const QString& sFilepath,
+								  const QString& sTransformations );
+		static std::shared_ptr<Sample> lookup( const QString& sKey );
+		/** \return Part of the key covering
+		 * Preferences::m_bTrimSilence. */
+		static QString getTrimOptions();
+		/** Calls Sample::trim_silence() on @a pSample in case
+		 * Preferences::m_bTrimSilence is set. */
+		static void trimSilence( std::shared_ptr<Sample> pSample,
+								 const QString& sVariant );
+		/**
+		 * Registers @a pSample under @a sKey unless another thread
+		 * was faster.
+		 *
+		 * \return The sample registered under @a sKey.
+		 */
+		static std::shared_ptr<Sample> insert( const QString& sKey,
+											   std::shared_ptr<Sample> pSample );
+
+		static std::mutex m_mutex;
+		static std::map<QString, std::weak_ptr<Sample>> m_samples;
+		/** Number of insertions since expired entries were last
+		 * removed from #m_samples. */
+		static int m_nInsertions;
+		static std::atomic<long> m_nHits;
+		static std::atomic<long> m_nMisses;
+};
+
+inline long SampleRegistry::getHits() {
+	return m_nHits;
+}
+
+inline long SampleRegistry::getMisses() {
+	return m_nMisses;
+}
+
+};
+
+#endif // H2C_SAMPLE_REGISTRY_H
+
+/* vim: set softtabstop=4 noexpandtab: */
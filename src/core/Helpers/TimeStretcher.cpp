@@ -0,0 +1,187 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Helpers/TimeStretcher.h>
+#include <core/AudioEngine/AudioEngine.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/Sample.h>
+#include <core/Basics/Song.h>
+#include <core/Helpers/SampleRegistry.h>
+#include <core/Hydrogen.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace H2Core
+{
+
+TimeStretcher::TimeStretcher()
+	: m_fBpm( 0 )
+	, m_nRequests( 0 )
+	, m_nHandledRequests( 0 )
+	, m_bShutdown( false )
+{
+	m_thread = std::thread( &TimeStretcher::stretchingLoop, this );
+}
+
+TimeStretcher::~TimeStretcher() {
+	m_bShutdown = true;
+	// Abandons the request in progress.
+	++m_nRequests;
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_condition.notify_all();
+	}
+	m_thread.join();
+}
+
+void TimeStretcher::request( float fBpm )
+{
+	m_fBpm = fBpm;
+	++m_nRequests;
+	m_condition.notify_one();
+}
+
+void TimeStretcher::stretch( float fBpm, bool bLocked )
+{
+	stretchAll( fBpm, 0, bLocked );
+}
+
+void TimeStretcher::stretchingLoop()
+{
+	while ( ! m_bShutdown ) {
+		const unsigned nRequest = m_nRequests;
+		if ( nRequest == m_nHandledRequests ) {
+			// request() does not acquire the mutex and a wakeup
+			// might be missed. Poll regularly.
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_condition.wait_for( lock, std::chrono::milliseconds( 10 ) );
+			continue;
+		}
+
+		stretchAll( m_fBpm, nRequest, false );
+		m_nHandledRequests = nRequest;
+	}
+}
+
+std::vector<TimeStretcher::Job> TimeStretcher::createJobs()
+{
+	std::vector<Job> jobs;
+	auto pSong = Hydrogen::get_instance()->getSong();
+	if ( pSong == nullptr || pSong->getInstrumentList() == nullptr ) {
+		return jobs;
+	}
+
+	auto pInstrumentList = pSong->getInstrumentList();
+	for ( int nnInstr = 0; nnInstr < pInstrumentList->size(); ++nnInstr ) {
+		auto pInstr = pInstrumentList->get( nnInstr );
+		for ( const auto& pComponent : *pInstr->get_components() ) {
+			if ( pComponent == nullptr ) {
+				continue;
+			}
+			for ( int nnLayer = 0; nnLayer < InstrumentComponent::getMaxLayers(); nnLayer++ ) {
+				auto pLayer = pComponent->get_layer( nnLayer );
+				if ( pLayer == nullptr ) {
+					continue;
+				}
+				auto pSample = pLayer->get_sample();
+				if ( pSample != nullptr && pSample->get_rubberband().use ) {
+					jobs.push_back( { pLayer, pSample, nullptr } );
+				}
+			}
+		}
+	}
+	return jobs;
+}
+
+void TimeStretcher::stretchAll( float fBpm, unsigned nRequest, bool bLocked )
+{
+	auto pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
+	if ( ! bLocked ) {
+		pAudioEngine->lock( RIGHT_HERE );
+	}
+	auto jobs = createJobs();
+	if ( ! bLocked ) {
+		pAudioEngine->unlock();
+	}
+	const int nJobs = jobs.size();
+	if ( nJobs == 0 ) {
+		return;
+	}
+
+	auto isSuperseded = [&]() {
+		return nRequest != 0 && m_nRequests != nRequest;
+	};
+
+	std::atomic<int> nNextJob( 0 );
+	auto work = [&]() {
+		int nJob;
+		while ( ! isSuperseded() && ( nJob = nNextJob++ ) < nJobs ) {
+			auto& job = jobs[ nJob ];
+			job.pStretchedSample = SampleRegistry::load( job.pSample->get_filepath(),
+														 job.pSample->get_loops(),
+														 job.pSample->get_rubberband(),
+														 *job.pSample->get_velocity_envelope(),
+														 *job.pSample->get_pan_envelope(),
+														 fBpm );
+		}
+	};
+
+	const int nThreads = std::min( { nJobs, nMaxThreads,
+			static_cast<int>( std::max( 1u, std::thread::hardware_concurrency() ) ) } );
+	std::vector<std::thread> workers;
+	for ( int ii = 1; ii < nThreads; ++ii ) {
+		workers.emplace_back( work );
+	}
+	work();
+	for ( auto& worker : workers ) {
+		worker.join();
+	}
+
+	if ( isSuperseded() ) {
+		INFOLOG( QString( "Stretching samples to %1 bpm was superseded" ).arg( fBpm ) );
+		return;
+	}
+
+	// The previous samples are released along with the jobs after
+	// unlocking.
+	if ( ! bLocked ) {
+		pAudioEngine->lock( RIGHT_HERE );
+	}
+	for ( auto& job : jobs ) {
+		if ( job.pStretchedSample != nullptr &&
+			 job.pLayer->get_sample() == job.pSample ) {
+			job.pLayer->set_sample( job.pStretchedSample );
+		}
+	}
+	if ( ! bLocked ) {
+		pAudioEngine->unlock();
+	}
+	INFOLOG( QString( "%1 samples stretched to %2 bpm" ).arg( nJobs ).arg( fBpm ) );
+}
+
+};
+
+/* vim: set softtabstop=4 noexpandtab: */
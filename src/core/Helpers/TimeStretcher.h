@@ -0,0 +1,151 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_TIME_STRETCHER_H
+#define H2C_TIME_STRETCHER_H
+
+#include <core/Object.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace H2Core
+{
+
+class InstrumentLayer;
+class Sample;
+
+/**
+ * Background thread time-stretching the samples of all layers of
+ * the current song using Rubber Band (see Sample::Rubberband) to a
+ * new tempo.
+ *
+ * Whenever the tempo changes while Rubber Band batch mode is
+ * enabled (see Preferences::getRubberBandBatchMode()), request()
+ * hands the new tempo over to the stretching thread and returns
+ * right away. It neither allocates memory nor waits on a lock and
+ * is thus safe to be called from the audio thread. The stretching
+ * thread distributes the affected samples across a bounded number of
+ * worker threads. Once all of them are done, the stretched samples
+ * replace the previous ones while the #AudioEngine is locked. Till
+ * then the previous versions keep playing. A request superseded by
+ * a newer one before being done is abandoned.
+ *
+ * Stretched samples are obtained via the #SampleRegistry and are
+ * thus shared in memory. They are stored in the SampleCache as well
+ * (see Sample::load( const QString&, const Sample::Loops&, const
+ * Sample::Rubberband&, const Sample::VelocityEnvelope&, const
+ * Sample::PanEnvelope&, float, int )). Returning to a previous tempo
+ * is thus cheap.
+ */
+/** \ingroup docCore */
+class TimeStretcher : public H2Core::Object<TimeStretcher>
+{
+		H2_OBJECT(TimeStretcher)
+	public:
+		TimeStretcher();
+		~TimeStretcher();
+
+		/**
+		 * Requests all samples of the current song using Rubber
+		 * Band to be stretched to @a fBpm in the background.
+		 *
+		 * Can be called from any thread, including the audio
+		 * thread.
+		 */
+		void request( float fBpm );
+		/**
+		 * Stretches all samples of the current song using Rubber
+		 * Band to @a fBpm and waits till they are done.
+		 *
+		 * Used while exporting a song, which has to render the
+		 * same result regardless of the time required for
+		 * stretching. Requests still in progress do not replace the
+		 * samples set by this function.
+		 *
+		 * \param bLocked Whether the calling thread does already
+		 * hold the lock of the #AudioEngine.
+		 */
+		void stretch( float fBpm, bool bLocked );
+
+		/** \return Whether all requests were handled. */
+		bool isIdle() const;
+
+		/**
+		 * Upper bound of the number of samples stretched
+		 * concurrently.
+		 */
+		static constexpr int nMaxThreads = 4;
+
+	private:
+		/** Sample of a single layer to be stretched. */
+		struct Job {
+			std::shared_ptr<InstrumentLayer> pLayer;
+			/** Sample of #pLayer at the time the job was created.
+			 * It is only replaced in case the layer still holds
+			 * it and released after the #AudioEngine was
+			 * unlocked. */
+			std::shared_ptr<Sample> pSample;
+			std::shared_ptr<Sample> pStretchedSample;
+		};
+
+		void stretchingLoop();
+		/**
+		 * Stretches all samples to @a fBpm.
+		 *
+		 * \param nRequest Number of the request handled. The jobs
+		 * are abandoned as soon as there is a newer one. 0 for a
+		 * synchronous call by stretch().
+		 * \param bLocked Whether the calling thread does already
+		 * hold the lock of the #AudioEngine.
+		 */
+		void stretchAll( float fBpm, unsigned nRequest, bool bLocked );
+		/** \return Jobs for all layers of the current song using
+		 * Rubber Band. */
+		static std::vector<Job> createJobs();
+
+		/** Tempo of the latest request. */
+		std::atomic<float> m_fBpm;
+		/** Number of requests made by request(). */
+		std::atomic<unsigned> m_nRequests;
+		/** Number of requests handled by the stretching thread. */
+		std::atomic<unsigned> m_nHandledRequests;
+		std::atomic<bool> m_bShutdown;
+
+		std::thread m_thread;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+};
+
+inline bool TimeStretcher::isIdle() const {
+	return m_nHandledRequests == m_nRequests;
+}
+
+};
+
+#endif // H2C_TIME_STRETCHER_H
+
+/* vim: set softtabstop=4 noexpandtab: */
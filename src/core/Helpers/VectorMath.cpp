@@ -0,0 +1,483 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Helpers/VectorMath.h>
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#    define H2CORE_VECTOR_MATH_X86
+#    include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    define H2CORE_VECTOR_MATH_NEON
+#    include <arm_neon.h>
+#endif
+
+namespace H2Core
+{
+
+VectorMath::Backend VectorMath::m_backend = VectorMath::Backend::Generic;
+
+/** Kernels of a single backend. */
+struct VectorMathKernels {
+	void ( *clear )( float*, int );
+	void ( *add )( float*, const float*, int );
+	void ( *addScaled )( float*, const float*, float, int );
+	void ( *multiply )( float*, const float*, int );
+	float ( *peak )( const float*, int, float );
+	float ( *peakScaled )( const float*, float, int, float );
+};
+
+// Generic
+
+static void genericClear( float* pBuffer, int nFrames ) {
+	if ( nFrames <= 0 ) {
+		return;
+	}
+	memset( pBuffer, 0, nFrames * sizeof( float ) );
+}
+
+static void genericAdd( float* __restrict__ pDst, const float* __restrict__ pSrc, int nFrames ) {
+	for ( int i = 0; i < nFrames; ++i ) {
+		pDst[ i ] += pSrc[ i ];
+	}
+}
+
+static void genericAddScaled( float* __restrict__ pDst, const float* __restrict__ pSrc,
+							  float fGain, int nFrames ) {
+	for ( int i = 0; i < nFrames; ++i ) {
+		float fVal = pSrc[ i ] * fGain;
+		pDst[ i ] += fVal;
+	}
+}
+
+static void genericMultiply( float* __restrict__ pDst, const float* __restrict__ pGain,
+							 int nFrames ) {
+	for ( int i = 0; i < nFrames; ++i ) {
+		pDst[ i ] *= pGain[ i ];
+	}
+}
+
+static float genericPeak( const float* pSrc, int nFrames, float fPeak ) {
+	for ( int i = 0; i < nFrames; ++i ) {
+		if ( pSrc[ i ] > fPeak ) {
+			fPeak = pSrc[ i ];
+		}
+	}
+	return fPeak;
+}
+
+static float genericPeakScaled( const float* pSrc, float fGain, int nFrames, float fPeak ) {
+	for ( int i = 0; i < nFrames; ++i ) {
+		float fVal = pSrc[ i ] * fGain;
+		if ( fVal > fPeak ) {
+			fPeak = fVal;
+		}
+	}
+	return fPeak;
+}
+
+// The filter is recursive in time and can not be vectorised across
+// frames. Packing the two channels into one register does not pay
+// off either. Therefore, all backends share this version.
+static void genericResonantLowPass( const float* pSrc_L, const float* pSrc_R,
+								   float* pDst_L, float* pDst_R, int nFrames,
+								   float fCutoff, float fCutoffStep,
+								   float fResonance, float fResonanceStep,
+								   float* pState ) {
+	float fBandPass_L = pState[ 0 ];
+	float fBandPass_R = pState[ 1 ];
+	float fLowPass_L = pState[ 2 ];
+	float fLowPass_R = pState[ 3 ];
+
+	for ( int i = 0; i < nFrames; ++i ) {
+		const float fC = fCutoff + fCutoffStep * ( i + 1 );
+		const float fR = fResonance + fResonanceStep * ( i + 1 );
+
+		fBandPass_L = fR * fBandPass_L + fC * ( pSrc_L[ i ] - fLowPass_L );
+		fLowPass_L += fC * fBandPass_L;
+		fBandPass_R = fR * fBandPass_R + fC * ( pSrc_R[ i ] - fLowPass_R );
+		fLowPass_R += fC * fBandPass_R;
+
+		pDst_L[ i ] = fLowPass_L;
+		pDst_R[ i ] = fLowPass_R;
+	}
+
+	pState[ 0 ] = fBandPass_L;
+	pState[ 1 ] = fBandPass_R;
+	pState[ 2 ] = fLowPass_L;
+	pState[ 3 ] = fLowPass_R;
+}
+
+static const VectorMathKernels genericKernels = {
+	genericClear, genericAdd, genericAddScaled, genericMultiply,
+	genericPeak, genericPeakScaled };
+
+#ifdef H2CORE_VECTOR_MATH_X86
+
+// SSE2
+
+__attribute__((target("sse2")))
+static void sse2Add( float* pDst, const float* pSrc, int nFrames ) {
+	int i = 0;
+	for ( ; i + 4 <= nFrames; i += 4 ) {
+		_mm_storeu_ps( pDst + i, _mm_add_ps( _mm_loadu_ps( pDst + i ),
+											 _mm_loadu_ps( pSrc + i ) ) );
+	}
+	genericAdd( pDst + i, pSrc + i, nFrames - i );
+}
+
+__attribute__((target("sse2")))
+static void sse2AddScaled( float* pDst, const float* pSrc, float fGain, int nFrames ) {
+	const __m128 gain = _mm_set1_ps( fGain );
+	int i = 0;
+	for ( ; i + 4 <= nFrames; i += 4 ) {
+		__m128 val = _mm_mul_ps( _mm_loadu_ps( pSrc + i ), gain );
+		_mm_storeu_ps( pDst + i, _mm_add_ps( _mm_loadu_ps( pDst + i ), val ) );
+	}
+	genericAddScaled( pDst + i, pSrc + i, fGain, nFrames - i );
+}
+
+__attribute__((target("sse2")))
+static void sse2Multiply( float* pDst, const float* pGain, int nFrames ) {
+	int i = 0;
+	for ( ; i + 4 <= nFrames; i += 4 ) {
+		_mm_storeu_ps( pDst + i, _mm_mul_ps( _mm_loadu_ps( pDst + i ),
+											 _mm_loadu_ps( pGain + i ) ) );
+	}
+	genericMultiply( pDst + i, pGain + i, nFrames - i );
+}
+
+__attribute__((target("sse2")))
+static float sse2HorizontalMax( __m128 val, float fPeak ) {
+	float values[ 4 ];
+	_mm_storeu_ps( values, val );
+	return genericPeak( values, 4, fPeak );
+}
+
+__attribute__((target("sse2")))
+static float sse2Peak( const float* pSrc, int nFrames, float fPeak ) {
+	int i = 0;
+	if ( nFrames >= 4 ) {
+		__m128 peak = _mm_set1_ps( fPeak );
+		for ( ; i + 4 <= nFrames; i += 4 ) {
+			peak = _mm_max_ps( _mm_loadu_ps( pSrc + i ), peak );
+		}
+		fPeak = sse2HorizontalMax( peak, fPeak );
+	}
+	return genericPeak( pSrc + i, nFrames - i, fPeak );
+}
+
+__attribute__((target("sse2")))
+static float sse2PeakScaled( const float* pSrc, float fGain, int nFrames, float fPeak ) {
+	int i = 0;
+	if ( nFrames >= 4 ) {
+		const __m128 gain = _mm_set1_ps( fGain );
+		__m128 peak = _mm_set1_ps( fPeak );
+		for ( ; i + 4 <= nFrames; i += 4 ) {
+			peak = _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( pSrc + i ), gain ), peak );
+		}
+		fPeak = sse2HorizontalMax( peak, fPeak );
+	}
+	return genericPeakScaled( pSrc + i, fGain, nFrames - i, fPeak );
+}
+
+static const VectorMathKernels sse2Kernels = {
+	genericClear, sse2Add, sse2AddScaled, sse2Multiply,
+	sse2Peak, sse2PeakScaled };
+
+// AVX2
+
+__attribute__((target("avx2")))
+static void avx2Add( float* pDst, const float* pSrc, int nFrames ) {
+	int i = 0;
+	for ( ; i + 8 <= nFrames; i += 8 ) {
+		_mm256_storeu_ps( pDst + i, _mm256_add_ps( _mm256_loadu_ps( pDst + i ),
+												   _mm256_loadu_ps( pSrc + i ) ) );
+	}
+	genericAdd( pDst + i, pSrc + i, nFrames - i );
+}
+
+__attribute__((target("avx2")))
+static void avx2AddScaled( float* pDst, const float* pSrc, float fGain, int nFrames ) {
+	const __m256 gain = _mm256_set1_ps( fGain );
+	int i = 0;
+	for ( ; i + 8 <= nFrames; i += 8 ) {
+		// No FMA on purpose. Rounding has to be identical to the
+		// other backends.
+		__m256 val = _mm256_mul_ps( _mm256_loadu_ps( pSrc + i ), gain );
+		_mm256_storeu_ps( pDst + i, _mm256_add_ps( _mm256_loadu_ps( pDst + i ), val ) );
+	}
+	genericAddScaled( pDst + i, pSrc + i, fGain, nFrames - i );
+}
+
+__attribute__((target("avx2")))
+static void avx2Multiply( float* pDst, const float* pGain, int nFrames ) {
+	int i = 0;
+	for ( ; i + 8 <= nFrames; i += 8 ) {
+		_mm256_storeu_ps( pDst + i, _mm256_mul_ps( _mm256_loadu_ps( pDst + i ),
+												   _mm256_loadu_ps( pGain + i ) ) );
+	}
+	genericMultiply( pDst + i, pGain + i, nFrames - i );
+}
+
+__attribute__((target("avx2")))
+static float avx2HorizontalMax( __m256 val, float fPeak ) {
+	float values[ 8 ];
+	_mm256_storeu_ps( values, val );
+	return genericPeak( values, 8, fPeak );
+}
+
+__attribute__((target("avx2")))
+static float avx2Peak( const float* pSrc, int nFrames, float fPeak ) {
+	int i = 0;
+	if ( nFrames >= 8 ) {
+		__m256 peak = _mm256_set1_ps( fPeak );
+		for ( ; i + 8 <= nFrames; i += 8 ) {
+			peak = _mm256_max_ps( _mm256_loadu_ps( pSrc + i ), peak );
+		}
+		fPeak = avx2HorizontalMax( peak, fPeak );
+	}
+	return genericPeak( pSrc + i, nFrames - i, fPeak );
+}
+
+__attribute__((target("avx2")))
+static float avx2PeakScaled( const float* pSrc, float fGain, int nFrames, float fPeak ) {
+	int i = 0;
+	if ( nFrames >= 8 ) {
+		const __m256 gain = _mm256_set1_ps( fGain );
+		__m256 peak = _mm256_set1_ps( fPeak );
+		for ( ; i + 8 <= nFrames; i += 8 ) {
+			peak = _mm256_max_ps( _mm256_mul_ps( _mm256_loadu_ps( pSrc + i ), gain ), peak );
+		}
+		fPeak = avx2HorizontalMax( peak, fPeak );
+	}
+	return genericPeakScaled( pSrc + i, fGain, nFrames - i, fPeak );
+}
+
+static const VectorMathKernels avx2Kernels = {
+	genericClear, avx2Add, avx2AddScaled, avx2Multiply,
+	avx2Peak, avx2PeakScaled };
+
+#endif // H2CORE_VECTOR_MATH_X86
+
+#ifdef H2CORE_VECTOR_MATH_NEON
+
+static void neonAdd( float* pDst, const float* pSrc, int nFrames ) {
+	int i = 0;
+	for ( ; i + 4 <= nFrames; i += 4 ) {
+		vst1q_f32( pDst + i, vaddq_f32( vld1q_f32( pDst + i ), vld1q_f32( pSrc + i ) ) );
+	}
+	genericAdd( pDst + i, pSrc + i, nFrames - i );
+}
+
+static void neonAddScaled( float* pDst, const float* pSrc, float fGain, int nFrames ) {
+	const float32x4_t gain = vdupq_n_f32( fGain );
+	int i = 0;
+	for ( ; i + 4 <= nFrames; i += 4 ) {
+		float32x4_t val = vmulq_f32( vld1q_f32( pSrc + i ), gain );
+		vst1q_f32( pDst + i, vaddq_f32( vld1q_f32( pDst + i ), val ) );
+	}
+	genericAddScaled( pDst + i, pSrc + i, fGain, nFrames - i );
+}
+
+static void neonMultiply( float* pDst, const float* pGain, int nFrames ) {
+	int i = 0;
+	for ( ; i + 4 <= nFrames; i += 4 ) {
+		vst1q_f32( pDst + i, vmulq_f32( vld1q_f32( pDst + i ), vld1q_f32( pGain + i ) ) );
+	}
+	genericMultiply( pDst + i, pGain + i, nFrames - i );
+}
+
+static float neonHorizontalMax( float32x4_t val, float fPeak ) {
+	float values[ 4 ];
+	vst1q_f32( values, val );
+	return genericPeak( values, 4, fPeak );
+}
+
+static float neonPeak( const float* pSrc, int nFrames, float fPeak ) {
+	int i = 0;
+	if ( nFrames >= 4 ) {
+		float32x4_t peak = vdupq_n_f32( fPeak );
+		for ( ; i + 4 <= nFrames; i += 4 ) {
+			peak = vmaxq_f32( vld1q_f32( pSrc + i ), peak );
+		}
+		fPeak = neonHorizontalMax( peak, fPeak );
+	}
+	return genericPeak( pSrc + i, nFrames - i, fPeak );
+}
+
+static float neonPeakScaled( const float* pSrc, float fGain, int nFrames, float fPeak ) {
+	int i = 0;
+	if ( nFrames >= 4 ) {
+		const float32x4_t gain = vdupq_n_f32( fGain );
+		float32x4_t peak = vdupq_n_f32( fPeak );
+		for ( ; i + 4 <= nFrames; i += 4 ) {
+			peak = vmaxq_f32( vmulq_f32( vld1q_f32( pSrc + i ), gain ), peak );
+		}
+		fPeak = neonHorizontalMax( peak, fPeak );
+	}
+	return genericPeakScaled( pSrc + i, fGain, nFrames - i, fPeak );
+}
+
+static const VectorMathKernels neonKernels = {
+	genericClear, neonAdd, neonAddScaled, neonMultiply,
+	neonPeak, neonPeakScaled };
+
+#endif // H2CORE_VECTOR_MATH_NEON
+
+static const VectorMathKernels* pKernels = &genericKernels;
+
+void VectorMath::init() {
+	Backend backend = Backend::Generic;
+	if ( isSupported( Backend::AVX2 ) ) {
+		backend = Backend::AVX2;
+	} else if ( isSupported( Backend::SSE2 ) ) {
+		backend = Backend::SSE2;
+	} else if ( isSupported( Backend::NEON ) ) {
+		backend = Backend::NEON;
+	}
+
+	setBackend( backend );
+	INFOLOG( QString( "Using [%1] audio kernels" ).arg( backendToQString( backend ) ) );
+}
+
+bool VectorMath::isSupported( Backend backend ) {
+	switch ( backend ) {
+	case Backend::Generic:
+		return true;
+#ifdef H2CORE_VECTOR_MATH_X86
+	case Backend::SSE2:
+		return __builtin_cpu_supports( "sse2" );
+	case Backend::AVX2:
+		return __builtin_cpu_supports( "avx2" );
+#endif
+#ifdef H2CORE_VECTOR_MATH_NEON
+	case Backend::NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+bool VectorMath::enableFlushToZero() {
+#if defined(H2CORE_VECTOR_MATH_X86)
+	// Flush to zero (bit 15) and denormals are zero (bit 6).
+	_mm_setcsr( _mm_getcsr() | 0x8040 );
+	return true;
+#elif defined(__aarch64__) && defined(__GNUC__)
+	// Flush to zero (bit 24) covering both inputs and results.
+	uint64_t nFPCR;
+	__asm__ __volatile__( "mrs %0, fpcr" : "=r"( nFPCR ) );
+	__asm__ __volatile__( "msr fpcr, %0" : : "r"( nFPCR | ( 1 << 24 ) ) );
+	return true;
+#elif defined(__arm__) && defined(__GNUC__) && defined(__ARM_FP)
+	uint32_t nFPSCR;
+	__asm__ __volatile__( "vmrs %0, fpscr" : "=r"( nFPSCR ) );
+	__asm__ __volatile__( "vmsr fpscr, %0" : : "r"( nFPSCR | ( 1 << 24 ) ) );
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool VectorMath::setBackend( Backend backend ) {
+	if ( ! isSupported( backend ) ) {
+		return false;
+	}
+
+	switch ( backend ) {
+#ifdef H2CORE_VECTOR_MATH_X86
+	case Backend::SSE2:
+		pKernels = &sse2Kernels;
+		break;
+	case Backend::AVX2:
+		pKernels = &avx2Kernels;
+		break;
+#endif
+#ifdef H2CORE_VECTOR_MATH_NEON
+	case Backend::NEON:
+		pKernels = &neonKernels;
+		break;
+#endif
+	default:
+		pKernels = &genericKernels;
+	}
+
+	m_backend = backend;
+	return true;
+}
+
+QString VectorMath::backendToQString( Backend backend ) {
+	switch ( backend ) {
+	case Backend::Generic:
+		return "Generic";
+	case Backend::SSE2:
+		return "SSE2";
+	case Backend::AVX2:
+		return "AVX2";
+	case Backend::NEON:
+		return "NEON";
+	default:
+		return "Unknown";
+	}
+}
+
+void VectorMath::clear( float* pBuffer, int nFrames ) {
+	pKernels->clear( pBuffer, nFrames );
+}
+
+void VectorMath::add( float* pDst, const float* pSrc, int nFrames ) {
+	pKernels->add( pDst, pSrc, nFrames );
+}
+
+void VectorMath::addScaled( float* pDst, const float* pSrc, float fGain, int nFrames ) {
+	pKernels->addScaled( pDst, pSrc, fGain, nFrames );
+}
+
+void VectorMath::multiply( float* pDst, const float* pGain, int nFrames ) {
+	pKernels->multiply( pDst, pGain, nFrames );
+}
+
+float VectorMath::peak( const float* pSrc, int nFrames, float fPeak ) {
+	return pKernels->peak( pSrc, nFrames, fPeak );
+}
+
+float VectorMath::peakScaled( const float* pSrc, float fGain, int nFrames, float fPeak ) {
+	return pKernels->peakScaled( pSrc, fGain, nFrames, fPeak );
+}
+
+void VectorMath::resonantLowPass( const float* pSrc_L, const float* pSrc_R,
+								  float* pDst_L, float* pDst_R, int nFrames,
+								  float fCutoff, float fCutoffStep,
+								  float fResonance, float fResonanceStep,
+								  float* pState ) {
+	genericResonantLowPass( pSrc_L, pSrc_R, pDst_L, pDst_R, nFrames,
+							fCutoff, fCutoffStep, fResonance, fResonanceStep,
+							pState );
+}
+
+};
+
+/* vim: set softtabstop=4 noexpandtab: */
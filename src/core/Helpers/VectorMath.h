@@ -0,0 +1,184 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_VECTOR_MATH_H
+#define H2C_VECTOR_MATH_H
+
+#include <core/Object.h>
+
+namespace H2Core
+{
+
+/**
+ * Small set of vectorised kernels used to mix and meter audio
+ * buffers in the #Sampler and #AudioEngine.
+ *
+ * Each kernel is available in a portable version as well as in
+ * SSE2, AVX2, and NEON variants. The fastest variant supported by
+ * the current CPU is selected once in init(). All variants perform
+ * exactly the same floating point operations in the same order.
+ * Provided H2CORE_HAVE_STRICT_VECTOR_MATH is set - the kernels are
+ * compiled with -ffp-contract=off and -fno-associative-math - the
+ * compiler does not fuse or reorder them either and all variants
+ * produce bit-identical results. Otherwise, they may differ by a
+ * rounding error.
+ */
+/** \ingroup docCore docAudioEngine */
+class VectorMath : public H2Core::Object<VectorMath>
+{
+		H2_OBJECT(VectorMath)
+	public:
+		enum class Backend {
+			/** Plain C++ loops */
+			Generic = 0,
+			SSE2 = 1,
+			AVX2 = 2,
+			NEON = 3
+		};
+
+		/**
+		 * Selects the fastest backend supported by the CPU Hydrogen
+		 * is running on.
+		 *
+		 * Called in AudioEngine::AudioEngine(). Prior to this call the
+		 * #Backend::Generic kernels are used.
+		 */
+		static void init();
+
+		/** \return Whether @a backend was compiled in and is
+		 * supported by the current CPU.*/
+		static bool isSupported( Backend backend );
+		/**
+		 * Enforces the use of a particular backend.
+		 *
+		 * \return false in case @a backend is not supported. The
+		 * current backend will be left untouched in this case.
+		 */
+		static bool setBackend( Backend backend );
+		static Backend getBackend();
+		static QString backendToQString( Backend backend );
+
+		/**
+		 * Makes the FPU of the calling thread flush denormal results
+		 * and inputs to zero (FTZ/DAZ).
+		 *
+		 * Decaying filter states and envelopes otherwise pass through
+		 * denormal numbers, which are processed very slowly by most
+		 * CPUs. Has to be called in each thread processing audio.
+		 *
+		 * \return false in case this is not supported on the current
+		 * architecture.
+		 */
+		static bool enableFlushToZero();
+
+		/** Sets the first @a nFrames elements of @a pBuffer to zero. */
+		static void clear( float* pBuffer, int nFrames );
+		/** @a pDst[ i ] += @a pSrc[ i ] */
+		static void add( float* pDst, const float* pSrc, int nFrames );
+		/** add() for both the left and right channel. */
+		static void addStereo( float* pDst_L, float* pDst_R,
+							   const float* pSrc_L, const float* pSrc_R,
+							   int nFrames );
+		/** @a pDst[ i ] += @a pSrc[ i ] * @a fGain */
+		static void addScaled( float* pDst, const float* pSrc, float fGain,
+							   int nFrames );
+		/** @a pDst[ i ] *= @a pGain[ i ] */
+		static void multiply( float* pDst, const float* pGain, int nFrames );
+		/** multiply() for both the left and right channel using the
+		 * same gains. */
+		static void multiplyStereo( float* pDst_L, float* pDst_R,
+									const float* pGain, int nFrames );
+		/**
+		 * \return Maximum of @a fPeak and all elements in @a pSrc.
+		 *
+		 * Just like the meters throughout Hydrogen only the positive
+		 * excursion of the signal is taken into account.
+		 */
+		static float peak( const float* pSrc, int nFrames, float fPeak );
+		/** peak() of the elements of @a pSrc multiplied by @a
+		 * fGain. */
+		static float peakScaled( const float* pSrc, float fGain, int nFrames,
+								 float fPeak );
+		/** peak() of the absolute values of the elements of @a
+		 * pSrc. */
+		static float absPeak( const float* pSrc, int nFrames, float fPeak );
+		/**
+		 * Resonant low pass filter of the #Note processing both
+		 * channels at once.
+		 *
+		 * As the filter is recursive in time, it has no vectorised
+		 * variants and all backends use the same implementation.
+		 *
+		 * Frame @a i is filtered using a cutoff of @a fCutoff + @a
+		 * fCutoffStep * ( i + 1 ) and a resonance of @a fResonance +
+		 * @a fResonanceStep * ( i + 1 ). This way changes of the
+		 * filter parameters can be ramped across a block.
+		 *
+		 * \param pSrc_L Left input. May be the same as @a pDst_L.
+		 * \param pSrc_R Right input. May be the same as @a pDst_R.
+		 * \param pDst_L Left output.
+		 * \param pDst_R Right output.
+		 * \param nFrames Number of frames to filter.
+		 * \param fCutoff Cutoff prior to the first frame.
+		 * \param fCutoffStep Increment of the cutoff per frame.
+		 * \param fResonance Resonance prior to the first frame.
+		 * \param fResonanceStep Increment of the resonance per frame.
+		 * \param pState Band pass left, band pass right, low pass
+		 * left, and low pass right filter buffer. Updated in place.
+		 */
+		static void resonantLowPass( const float* pSrc_L, const float* pSrc_R,
+									 float* pDst_L, float* pDst_R, int nFrames,
+									 float fCutoff, float fCutoffStep,
+									 float fResonance, float fResonanceStep,
+									 float* pState );
+
+	private:
+		static Backend m_backend;
+};
+
+inline VectorMath::Backend VectorMath::getBackend() {
+	return m_backend;
+}
+
+inline float VectorMath::absPeak( const float* pSrc, int nFrames,
+								  float fPeak ) {
+	return peakScaled( pSrc, -1.0, nFrames, peak( pSrc, nFrames, fPeak ) );
+}
+
+inline void VectorMath::addStereo( float* pDst_L, float* pDst_R,
+								   const float* pSrc_L, const float* pSrc_R,
+								   int nFrames ) {
+	add( pDst_L, pSrc_L, nFrames );
+	add( pDst_R, pSrc_R, nFrames );
+}
+
+inline void VectorMath::multiplyStereo( float* pDst_L, float* pDst_R,
+										const float* pGain, int nFrames ) {
+	multiply( pDst_L, pGain, nFrames );
+	multiply( pDst_R, pGain, nFrames );
+}
+
+};
+
+#endif // H2C_VECTOR_MATH_H
+
+/* vim: set softtabstop=4 noexpandtab: */
@@ -62,6 +62,9 @@
 #include <core/Basics/PatternList.h>
 #include <core/Basics/Note.h>
 #include <core/Helpers/Filesystem.h>
+#include <core/Helpers/SampleLoader.h>
+#include <core/Helpers/SampleRegistry.h>
+#include <core/Helpers/TimeStretcher.h>
 #include <core/FX/LadspaFX.h>
 #include <core/FX/Effects.h>
 
@@ -127,6 +130,7 @@ Hydrogen::Hydrogen() : m_nSelectedInstrumentNumber( 0 )
 	InstrumentComponent::setMaxLayers( Preferences::get_instance()->getMaxLayers() );
 	
 	m_pAudioEngine = new AudioEngine();
+	m_pTimeStretcher = new TimeStretcher();
 	Playlist::create_instance();
 
 	EventQueue::get_instance()->push_event( EVENT_STATE, static_cast<int>(AudioEngine::State::Initialized) );
@@ -160,6 +164,9 @@ Hydrogen::~Hydrogen()
 		delete pOscServer;
 	}
 #endif
+
+	// Has to be stopped before the song is removed.
+	delete m_pTimeStretcher;
 	
 	removeSong();
 	
@@ -519,13 +526,13 @@ void Hydrogen::addRealtimeNote(	int		instrument,
 
 	if ( !pPreferences->__playselectedinstrument ) {
 		if ( hearnote && instrRef ) {
-			Note *pNote2 = new Note( instrRef, nRealColumn, velocity, fPan, -1, 0 );
+			Note *pNote2 = new ( Note::realtime ) Note( instrRef, nRealColumn, velocity, fPan, -1, 0 );
 			
 			midi_noteOn( pNote2 );
 		}
 	} else if ( hearnote  ) {
 		auto pInstr = pSong->getInstrumentList()->get( getSelectedInstrumentNumber() );
-		Note *pNote2 = new Note( pInstr, nRealColumn, velocity, fPan, -1, 0 );
+		Note *pNote2 = new ( Note::realtime ) Note( pInstr, nRealColumn, velocity, fPan, -1, 0 );
 
 		int divider = msg1 / 12;
 		Note::Octave octave = (Note::Octave)(divider -3);
@@ -674,6 +681,25 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool bConditional )
 	if ( pSong != nullptr ) {
 
 		INFOLOG( pDrumkitInfo->get_name() );
+
+		// Decode the samples concurrently before locking the audio
+		// engine. The staged instruments will obtain them from the
+		// SampleRegistry.
+		const bool bSamplesLoaded = pDrumkitInfo->samples_loaded();
+		if ( ! bSamplesLoaded && ! pDrumkitInfo->load_samples() ) {
+			ERRORLOG( QString( "Loading drumkit [%1] was superseded" )
+					  .arg( pDrumkitInfo->get_name() ) );
+			return -1;
+		}
+
+		// Build the new instruments while the current drumkit keeps
+		// playing. Only swapping them in requires the lock.
+		auto pStaged = Song::stageDrumkit( pDrumkitInfo );
+		if ( ! bSamplesLoaded ) {
+			// The staged instruments hold the samples by now.
+			pDrumkitInfo->unload_samples();
+		}
+
 		m_sCurrentDrumkitName = pDrumkitInfo->get_name();
 		if ( pDrumkitInfo->isUserDrumkit() ) {
 			m_currentDrumkitLookup = Filesystem::Lookup::user;
@@ -683,7 +709,7 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool bConditional )
 
 		m_pAudioEngine->lock( RIGHT_HERE );
 		
-		pSong->loadDrumkit( pDrumkitInfo, bConditional );
+		pSong->loadDrumkit( pStaged.get(), bConditional );
 		if ( m_nSelectedInstrumentNumber >=
 			 pSong->getInstrumentList()->size() ) {
 			setSelectedInstrumentNumber( std::max( 0, pSong->getInstrumentList()->size() -1 ) );
@@ -691,6 +717,10 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool bConditional )
 
 		renameJackPorts( getSong() );
 		m_pAudioEngine->unlock();
+
+		// Free the replaced components and samples outside of the
+		// lock.
+		pStaged.reset();
 	
 		m_pCoreActionController->initExternalControlInterfaces();
 
@@ -1276,58 +1306,84 @@ void Hydrogen::recalculateRubberband( float fBpm ) {
 	}
 	
 	if ( getSong() != nullptr ) {
-		auto pInstrumentList = getSong()->getInstrumentList();
-		if ( pInstrumentList != nullptr ) {
-			for ( unsigned nnInstr = 0; nnInstr < pInstrumentList->size(); ++nnInstr ) {
-				auto pInstr = pInstrumentList->get( nnInstr );
-				if ( pInstr == nullptr ) {
-					return;
-				}
-				assert( pInstr );
-				if ( pInstr != nullptr ){
-					for ( int nnComponent = 0; nnComponent < pInstr->get_components()->size();
-						  ++nnComponent ) {
-						auto pInstrumentComponent = pInstr->get_component( nnComponent );
-						if ( pInstrumentComponent == nullptr ) {
-							continue; // regular case when you have a new component empty
-						}
-				
-						for ( int nnLayer = 0; nnLayer < InstrumentComponent::getMaxLayers(); nnLayer++ ) {
-							auto pLayer = pInstrumentComponent->get_layer( nnLayer );
-							if ( pLayer != nullptr ) {
-								auto pSample = pLayer->get_sample();
-								if ( pSample != nullptr ) {
-									if( pSample->get_rubberband().use ) {
-										auto pNewSample = Sample::load(
-																	   pSample->get_filepath(),
-																	   pSample->get_loops(),
-																	   pSample->get_rubberband(),
-																	   *pSample->get_velocity_envelope(),
-																	   *pSample->get_pan_envelope(),
-																	   fBpm
-																	   );
-										if( pNewSample == nullptr ){
-											continue;
-										}
-								
-										// insert new sample from newInstrument
-										pLayer->set_sample( pNewSample );
-									}
-								}
-							}
-						}
-					}
-				}
-			}
-			setIsModified( true );
+		if ( m_bExportSessionIsActive ) {
+			// The caller already holds the lock.
+			m_pTimeStretcher->stretch( fBpm, true );
 		} else {
-			ERRORLOG( "No InstrumentList present" );
+			m_pTimeStretcher->request( fBpm );
 		}
+		setIsModified( true );
 	} else {
 		ERRORLOG( "No song set" );
 	}
 }
 
+void Hydrogen::updateSampleRates() {
+	const int nSampleRate = SampleRegistry::getTargetSampleRate();
+	auto pSong = getSong();
+	if ( nSampleRate == 0 || pSong == nullptr ||
+		 pSong->getInstrumentList() == nullptr ) {
+		return;
+	}
+
+	std::vector<std::shared_ptr<InstrumentLayer>> layers;
+	std::vector<SampleLoader::Request> requests;
+	auto pInstrumentList = pSong->getInstrumentList();
+	for ( int nnInstr = 0; nnInstr < pInstrumentList->size(); ++nnInstr ) {
+		auto pInstr = pInstrumentList->get( nnInstr );
+		for ( const auto& pComponent : *pInstr->get_components() ) {
+			if ( pComponent == nullptr ) {
+				continue;
+			}
+			for ( int nnLayer = 0; nnLayer < InstrumentComponent::getMaxLayers(); nnLayer++ ) {
+				auto pLayer = pComponent->get_layer( nnLayer );
+				if ( pLayer == nullptr ) {
+					continue;
+				}
+				auto pSample = pLayer->get_sample();
+				if ( pSample == nullptr || pSample->is_empty() ||
+					 pSample->get_sample_rate() == nSampleRate ) {
+					continue;
+				}
+				if ( pSample->get_is_modified() ) {
+					requests.push_back( SampleLoader::Request(
+											pSample->get_filepath(),
+											pSample->get_loops(),
+											pSample->get_rubberband(),
+											*pSample->get_velocity_envelope(),
+											*pSample->get_pan_envelope(),
+											pSong->getBpm() ) );
+				} else {
+					requests.push_back( SampleLoader::Request( pSample->get_filepath() ) );
+				}
+				layers.push_back( pLayer );
+			}
+		}
+	}
+	if ( requests.empty() ) {
+		return;
+	}
+
+	INFOLOG( QString( "Converting %1 samples to %2 Hz" )
+			 .arg( requests.size() ).arg( nSampleRate ) );
+	if ( ! SampleLoader::load( requests, SampleLoader::Scope::SampleRate ) ) {
+		WARNINGLOG( "Converting samples was superseded" );
+		return;
+	}
+
+	m_pAudioEngine->lock( RIGHT_HERE );
+	for ( int ii = 0; ii < layers.size(); ++ii ) {
+		if ( requests[ ii ].pSample != nullptr ) {
+			// The replaced sample is kept by the request and freed
+			// after unlocking.
+			auto pOldSample = layers[ ii ]->get_sample();
+			layers[ ii ]->set_sample( requests[ ii ].pSample );
+			requests[ ii ].pSample = pOldSample;
+		}
+	}
+	m_pAudioEngine->unlock();
+}
+
 void Hydrogen::setIsModified( bool bIsModified ) {
 	if ( getSong() != nullptr ) {
 		if ( getSong()->getIsModified() != bIsModified ) {
@@ -1378,62 +1434,22 @@ int Hydrogen::getColumnForTick( long nTick, bool bLoopMode, long* pPatternStartT
 	std::shared_ptr<Song> pSong = getSong();
 	assert( pSong );
 
-	long nTotalTick = 0;
-
-	std::vector<PatternList*> *pPatternColumns = pSong->getPatternGroupVector();
-	int nColumns = pPatternColumns->size();
-
-	// Sum the lengths of all pattern columns and use the macro
-	// MAX_NOTES in case some of them are of size zero. If the
-	// supplied value nTick is bigger than this and doesn't belong to
-	// the next pattern column, we just found the pattern list we were
-	// searching for.
-	int nPatternSize;
-	for ( int i = 0; i < nColumns; ++i ) {
-		PatternList *pColumn = ( *pPatternColumns )[ i ];
-		if ( pColumn->size() != 0 ) {
-			nPatternSize = pColumn->longest_pattern_length();
-		} else {
-			nPatternSize = MAX_NOTES;
-		}
-
-		if ( ( nTick >= nTotalTick ) && ( nTick < nTotalTick + nPatternSize ) ) {
-			( *pPatternStartTick ) = nTotalTick;
-			return i;
-		}
-		nTotalTick += nPatternSize;
-	}
+	int nColumn = pSong->findColumn( nTick, pPatternStartTick );
 
 	// If the song is played in loop mode, the tick numbers of the
 	// second turn are added on top of maximum tick number of the
 	// song. Therefore, we will introduced periodic boundary
 	// conditions and start the search again.
-	if ( bLoopMode ) {
-		long nLoopTick = 0;
-		// nTotalTicks is now the same as m_nSongSizeInTicks
-		if ( nTotalTick != 0 ) {
-			nLoopTick = nTick % nTotalTick;
-		}
-		nTotalTick = 0;
-		for ( int i = 0; i < nColumns; ++i ) {
-			PatternList *pColumn = ( *pPatternColumns )[ i ];
-			if ( pColumn->size() != 0 ) {
-				nPatternSize = pColumn->longest_pattern_length();
-			} else {
-				nPatternSize = MAX_NOTES;
-			}
-
-			if ( ( nLoopTick >= nTotalTick )
-				 && ( nLoopTick < nTotalTick + nPatternSize ) ) {
-				( *pPatternStartTick ) = nTotalTick;
-				return i;
-			}
-			nTotalTick += nPatternSize;
+	if ( nColumn == -1 && bLoopMode ) {
+		const long nSongSizeInTicks = pSong->getColumnStartTick(
+			pSong->getPatternGroupVector()->size() );
+		if ( nSongSizeInTicks != 0 ) {
+			nColumn = pSong->findColumn( nTick % nSongSizeInTicks,
+										 pPatternStartTick );
 		}
 	}
 
-	( *pPatternStartTick ) = 0;
-	return -1;
+	return nColumn;
 }
 
 long Hydrogen::getTickForColumn( int nColumn ) const
@@ -1460,24 +1476,7 @@ long Hydrogen::getTickForColumn( int nColumn ) const
 		}
 	}
 
-	std::vector<PatternList*> *pColumns = pSong->getPatternGroupVector();
-	long totalTick = 0;
-	int nPatternSize;
-	Pattern *pPattern = nullptr;
-	
-	for ( int i = 0; i < nColumn; ++i ) {
-		PatternList *pColumn = ( *pColumns )[ i ];
-		
-		if( pColumn->size() > 0)
-		{
-			nPatternSize = pColumn->longest_pattern_length();
-		} else {
-			nPatternSize = MAX_NOTES;
-		}
-		totalTick += nPatternSize;
-	}
-	
-	return totalTick;
+	return pSong->getColumnStartTick( nColumn );
 }
 
 long Hydrogen::getPatternLength( int nPattern ) const
@@ -45,6 +45,7 @@ namespace H2Core
 {
 	class CoreActionController;
 	class AudioEngine;
+	class TimeStretcher;
 ///
 /// Hydrogen Audio Engine.
 ///
@@ -252,10 +253,26 @@ void			previewSample( Sample *pSample );
 	/** Recalculates all Samples using RubberBand for a specific
 		tempo @a fBpm.
 	*
+	* The samples are stretched by #m_pTimeStretcher in the
+	* background and this function returns right away. The previous
+	* versions of the samples keep playing till all of them are
+	* done. During an export session the samples are stretched
+	* right away instead in order to render the same result
+	* regardless of the time required for stretching.
+	*
 	* This function requires the calling function to lock the
 	* #AudioEngine first.
 	*/ 
 	void recalculateRubberband( float fBpm );
+	/**
+	 * Reloads all samples of the current song which do not match
+	 * SampleRegistry::getTargetSampleRate(), e.g. because the
+	 * audio driver was restarted with a different sample rate.
+	 *
+	 * The samples are loaded without holding the lock of the
+	 * #AudioEngine. It is only locked to replace them.
+	 */
+	void updateSampleRates();
 	/** Wrapper around Song::setIsModified() that checks whether a
 		song is set.*/
 	void setIsModified( bool bIsModified );
@@ -584,6 +601,11 @@ private:
 	 * Central instance of the audio engine. 
 	 */
 	AudioEngine*	m_pAudioEngine;
+	/**
+	 * Stretches the samples using Rubber Band in the background
+	 * whenever the tempo changes.
+	 */
+	TimeStretcher*	m_pTimeStretcher;
 
 	/** 
 	 * Constructor, entry point, and initialization of the
@@ -382,7 +382,7 @@ void MidiInput::handleNoteOffMessage( const MidiMessage& msg, bool CymbalChoke )
 				return;
 			}
 			
-			Note *pOffNote = new Note( pInstr,
+			Note *pOffNote = new ( Note::realtime ) Note( pInstr,
 										0.0,
 										0.0,
 										0.0,
@@ -144,6 +144,17 @@ Preferences::Preferences()
 	m_bUseMetronome = false;
 	m_fMetronomeVolume = 0.5;
 	m_nMaxNotes = 256;
+	m_nRenderThreads = 1;
+	m_voiceStealing = VoiceStealing::Oldest;
+	m_bStealSameInstrumentFirst = true;
+	m_fVoiceTailThreshold = -120.0;
+	m_bUseSampleCache = true;
+	m_nStreamingThreshold = 16;
+	m_nStreamingPreload = 250;
+	m_bUseCompactSamples = false;
+	m_bConvertSampleRates = false;
+	m_bTrimSilence = false;
+	m_fTrimSilenceThreshold = -90.0;
 	m_nBufferSize = 1024;
 	m_nSampleRate = 44100;
 
@@ -430,6 +441,29 @@ void Preferences::loadPreferences( bool bGlobal )
 				m_bUseMetronome = LocalFileMng::readXmlBool( audioEngineNode, "use_metronome", m_bUseMetronome );
 				m_fMetronomeVolume = LocalFileMng::readXmlFloat( audioEngineNode, "metronome_volume", 0.5f );
 				m_nMaxNotes = LocalFileMng::readXmlInt( audioEngineNode, "maxNotes", m_nMaxNotes );
+				m_nRenderThreads = LocalFileMng::readXmlInt( audioEngineNode, "renderThreads", m_nRenderThreads );
+				int nVoiceStealing = LocalFileMng::readXmlInt( audioEngineNode, "voiceStealing", 0 );
+				switch ( nVoiceStealing ) {
+				case 0:
+					m_voiceStealing = VoiceStealing::Oldest;
+					break;
+				case 1:
+					m_voiceStealing = VoiceStealing::Quietest;
+					break;
+				default:
+					WARNINGLOG( QString( "Unknown voiceStealing value [%1]. Using VoiceStealing::Oldest instead." )
+								.arg( nVoiceStealing ) );
+					m_voiceStealing = VoiceStealing::Oldest;
+				}
+				m_bStealSameInstrumentFirst = LocalFileMng::readXmlBool( audioEngineNode, "stealSameInstrumentFirst", m_bStealSameInstrumentFirst );
+				m_fVoiceTailThreshold = LocalFileMng::readXmlFloat( audioEngineNode, "voiceTailThreshold", m_fVoiceTailThreshold );
+				m_bUseSampleCache = LocalFileMng::readXmlBool( audioEngineNode, "useSampleCache", m_bUseSampleCache );
+				m_nStreamingThreshold = std::max( 0, LocalFileMng::readXmlInt( audioEngineNode, "streamingThreshold", m_nStreamingThreshold ) );
+				m_nStreamingPreload = std::max( 1, LocalFileMng::readXmlInt( audioEngineNode, "streamingPreload", m_nStreamingPreload ) );
+				m_bUseCompactSamples = LocalFileMng::readXmlBool( audioEngineNode, "useCompactSamples", m_bUseCompactSamples );
+				m_bConvertSampleRates = LocalFileMng::readXmlBool( audioEngineNode, "convertSampleRates", m_bConvertSampleRates );
+				m_bTrimSilence = LocalFileMng::readXmlBool( audioEngineNode, "trimSilence", m_bTrimSilence );
+				m_fTrimSilenceThreshold = LocalFileMng::readXmlFloat( audioEngineNode, "trimSilenceThreshold", m_fTrimSilenceThreshold );
 				m_nBufferSize = LocalFileMng::readXmlInt( audioEngineNode, "buffer_size", m_nBufferSize );
 				m_nSampleRate = LocalFileMng::readXmlInt( audioEngineNode, "samplerate", m_nSampleRate );
 
@@ -933,6 +967,17 @@ void Preferences::savePreferences()
 		LocalFileMng::writeXmlString( audioEngineNode, "use_metronome", m_bUseMetronome ? "true": "false" );
 		LocalFileMng::writeXmlString( audioEngineNode, "metronome_volume", QString("%1").arg( m_fMetronomeVolume ) );
 		LocalFileMng::writeXmlString( audioEngineNode, "maxNotes", QString("%1").arg( m_nMaxNotes ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "renderThreads", QString("%1").arg( m_nRenderThreads ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "voiceStealing", QString("%1").arg( static_cast<int>( m_voiceStealing ) ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "stealSameInstrumentFirst", m_bStealSameInstrumentFirst ? "true": "false" );
+		LocalFileMng::writeXmlString( audioEngineNode, "voiceTailThreshold", QString("%1").arg( m_fVoiceTailThreshold ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "useSampleCache", m_bUseSampleCache ? "true": "false" );
+		LocalFileMng::writeXmlString( audioEngineNode, "streamingThreshold", QString("%1").arg( m_nStreamingThreshold ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "streamingPreload", QString("%1").arg( m_nStreamingPreload ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "useCompactSamples", m_bUseCompactSamples ? "true": "false" );
+		LocalFileMng::writeXmlString( audioEngineNode, "convertSampleRates", m_bConvertSampleRates ? "true": "false" );
+		LocalFileMng::writeXmlString( audioEngineNode, "trimSilence", m_bTrimSilence ? "true": "false" );
+		LocalFileMng::writeXmlString( audioEngineNode, "trimSilenceThreshold", QString("%1").arg( m_fTrimSilenceThreshold ) );
 		LocalFileMng::writeXmlString( audioEngineNode, "buffer_size", QString("%1").arg( m_nBufferSize ) );
 		LocalFileMng::writeXmlString( audioEngineNode, "samplerate", QString("%1").arg( m_nSampleRate ) );
 
@@ -187,6 +187,81 @@ public:
 	float				m_fMetronomeVolume;
 	/// max notes
 	unsigned			m_nMaxNotes;
+	/**
+	 * Number of threads used by the #Sampler to render voices.
+	 *
+	 * 1 renders all voices on the audio thread itself and 0 uses
+	 * one thread per available CPU core. The output does not depend
+	 * on this setting. Applied via Sampler::setRenderThreads().
+	 */
+	int					m_nRenderThreads;
+
+	/** Criterion the #Sampler uses to pick the voices to steal once
+	 * more than #m_nMaxNotes are playing. */
+	enum class VoiceStealing {
+		/** The voice started first is stolen first. */
+		Oldest = 0,
+		/** The voice with the lowest product of its current
+		 * envelope value and velocity is stolen first. */
+		Quietest = 1
+	};
+	VoiceStealing		m_voiceStealing;
+	/**
+	 * Whether voices of an instrument or mute group which has a more
+	 * recent voice playing are stolen before all others.
+	 *
+	 * Regardless of this setting voices already released - e.g. by
+	 * a note off or their mute group - are always stolen first.
+	 */
+	bool				m_bStealSameInstrumentFirst;
+	/**
+	 * Level in dBFS below which a voice, whose sample is done
+	 * playing or whose envelope is released, is considered
+	 * silent. Such a voice is stopped once both its envelope and its
+	 * output stay below this level for a whole buffer. This keeps
+	 * filter resonances and long releases from piling up inaudible
+	 * voices.
+	 */
+	float				m_fVoiceTailThreshold;
+	/**
+	 * Whether decoded samples are stored in and mapped from
+	 * Filesystem::sample_cache_dir(). See SampleCache.
+	 */
+	bool				m_bUseSampleCache;
+	/**
+	 * Samples mapped from the SampleCache occupying at least this
+	 * many MiB are streamed from disk instead of being held in
+	 * memory entirely. 0 disables streaming. See SampleStreamer.
+	 */
+	int					m_nStreamingThreshold;
+	/**
+	 * Length in milliseconds of the beginning of each streamed
+	 * sample kept in memory at all times. The SampleStreamer reads
+	 * the same amount ahead of the position of each voice.
+	 */
+	int					m_nStreamingPreload;
+	/**
+	 * Whether samples encoded as 8, 16, or 24 bit PCM are held in
+	 * memory as integers instead of floats. See
+	 * Sample::Format. Samples exceeding #m_nStreamingThreshold are
+	 * always streamed as floats instead.
+	 */
+	bool				m_bUseCompactSamples;
+	/**
+	 * Whether samples are converted to the sample rate of the audio
+	 * driver while being loaded. Unpitched notes of such samples
+	 * are rendered without interpolation. See
+	 * SampleRateConverter.
+	 */
+	bool				m_bConvertSampleRates;
+	/**
+	 * Whether leading and trailing content of samples below
+	 * #m_fTrimSilenceThreshold is removed while they are
+	 * loaded. See Sample::trim_silence().
+	 */
+	bool				m_bTrimSilence;
+	/** Level in dBFS below which content is trimmed. */
+	float				m_fTrimSilenceThreshold;
 	/** 
 	 * Buffer size of the audio.
 	 *
@@ -118,6 +118,36 @@ namespace Interpolation
 			return( a0 * mu * mu2 + a1 * mu2 + a2 * mu + a3 );
 	};
 
+	/**
+	 * Interpolation method resolved at compile time.
+	 *
+	 * Used by the resampling kernels of the #Sampler so the
+	 * interpolation mode has to be dispatched only once per note
+	 * instead of once per frame. Methods requiring just two support
+	 * points ignore @a y0 and @a y3.
+	 *
+	 * \param y0 buffervalue on position -1
+	 * \param y1 buffervalue on position
+	 * \param y2 buffervalue on position +1
+	 * \param y3 buffervalue on position +2
+	 * \param mu where to estimate the value between @a y1 and @a y2
+	 */
+	template < InterpolateMode mode >
+	inline float interpolate( float y0, float y1, float y2, float y3, double mu )
+	{
+		if constexpr ( mode == InterpolateMode::Linear ) {
+			return y1 * ( 1 - mu ) + y2 * mu;
+		} else if constexpr ( mode == InterpolateMode::Cosine ) {
+			return cosine_Interpolate( y1, y2, mu );
+		} else if constexpr ( mode == InterpolateMode::Third ) {
+			return third_Interpolate( y0, y1, y2, y3, mu );
+		} else if constexpr ( mode == InterpolateMode::Cubic ) {
+			return cubic_Interpolate( y0, y1, y2, y3, mu );
+		} else {
+			return hermite_Interpolate( y0, y1, y2, y3, mu );
+		}
+	};
+
 };
 
 }
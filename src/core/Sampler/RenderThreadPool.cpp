@@ -0,0 +1,262 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Sampler/RenderThreadPool.h>
+#include <core/Helpers/VectorMath.h>
+
+#include <algorithm>
+
+#if defined(WIN32)
+#include <windows.h>
+#include <climits>
+#elif defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <cerrno>
+#include <semaphore.h>
+#endif
+
+namespace H2Core
+{
+
+/** Number of polls of an idle worker before it goes to sleep. */
+static const int nSpinCount = 4096;
+
+class RenderThreadPool::Semaphore {
+	public:
+#if defined(WIN32)
+		Semaphore() {
+			m_handle = CreateSemaphore( nullptr, 0, LONG_MAX, nullptr );
+		}
+		~Semaphore() {
+			CloseHandle( m_handle );
+		}
+		void post() {
+			ReleaseSemaphore( m_handle, 1, nullptr );
+		}
+		void wait() {
+			WaitForSingleObject( m_handle, INFINITE );
+		}
+	private:
+		HANDLE m_handle;
+#elif defined(__APPLE__)
+		Semaphore() {
+			m_semaphore = dispatch_semaphore_create( 0 );
+		}
+		~Semaphore() {
+			dispatch_release( m_semaphore );
+		}
+		void post() {
+			dispatch_semaphore_signal( m_semaphore );
+		}
+		void wait() {
+			dispatch_semaphore_wait( m_semaphore, DISPATCH_TIME_FOREVER );
+		}
+	private:
+		dispatch_semaphore_t m_semaphore;
+#else
+		Semaphore() {
+			sem_init( &m_semaphore, 0, 0 );
+		}
+		~Semaphore() {
+			sem_destroy( &m_semaphore );
+		}
+		void post() {
+			sem_post( &m_semaphore );
+		}
+		void wait() {
+			while ( sem_wait( &m_semaphore ) != 0 && errno == EINTR ) {
+			}
+		}
+	private:
+		sem_t m_semaphore;
+#endif
+};
+
+RenderThreadPool::RenderThreadPool( int nThreads )
+	: m_deques( new Deque[ std::max( nThreads, 1 ) ] )
+	, m_job( nullptr )
+	, m_pContext( nullptr )
+	, m_nPendingJobs( 0 )
+	, m_nActiveWorkers( 0 )
+	, m_bAcceptingWorkers( false )
+	, m_nGeneration( 0 )
+	, m_bShutdown( false )
+	, m_nSleepingWorkers( 0 )
+	, m_pWakeup( new Semaphore() )
+{
+	for ( int ii = 0; ii < std::max( nThreads, 1 ); ++ii ) {
+		m_deques[ ii ].range.store( packRange( 0, 0 ) );
+	}
+	for ( int ii = 1; ii < nThreads; ++ii ) {
+		m_workers.push_back( std::thread( &RenderThreadPool::workerLoop, this, ii ) );
+	}
+	INFOLOG( QString( "Rendering voices using [%1] threads" ).arg( nThreads ) );
+}
+
+RenderThreadPool::~RenderThreadPool() {
+	m_bShutdown = true;
+	for ( size_t ii = 0; ii < m_workers.size(); ++ii ) {
+		m_pWakeup->post();
+	}
+	for ( auto& worker : m_workers ) {
+		worker.join();
+	}
+}
+
+uint64_t RenderThreadPool::packRange( int nFront, int nBack ) {
+	return ( static_cast<uint64_t>( static_cast<uint32_t>( nFront ) ) << 32 ) |
+		static_cast<uint32_t>( nBack );
+}
+
+bool RenderThreadPool::popFront( Deque* pDeque, int* pJob ) {
+	uint64_t nRange = pDeque->range.load( std::memory_order_acquire );
+	while ( true ) {
+		const int nFront = static_cast<int>( nRange >> 32 );
+		const int nBack = static_cast<int>( nRange & 0xffffffff );
+		if ( nFront >= nBack ) {
+			return false;
+		}
+		if ( pDeque->range.compare_exchange_weak( nRange, packRange( nFront + 1, nBack ),
+												  std::memory_order_acq_rel ) ) {
+			*pJob = nFront;
+			return true;
+		}
+	}
+}
+
+bool RenderThreadPool::stealBack( Deque* pDeque, int* pJob ) {
+	uint64_t nRange = pDeque->range.load( std::memory_order_acquire );
+	while ( true ) {
+		const int nFront = static_cast<int>( nRange >> 32 );
+		const int nBack = static_cast<int>( nRange & 0xffffffff );
+		if ( nFront >= nBack ) {
+			return false;
+		}
+		if ( pDeque->range.compare_exchange_weak( nRange, packRange( nFront, nBack - 1 ),
+												  std::memory_order_acq_rel ) ) {
+			*pJob = nBack - 1;
+			return true;
+		}
+	}
+}
+
+void RenderThreadPool::run( JobFunction job, void* pContext, int nJobs ) {
+	if ( nJobs <= 0 ) {
+		return;
+	}
+
+	m_job = job;
+	m_pContext = pContext;
+	m_nPendingJobs.store( nJobs );
+
+	// Jobs are rendered in the order of their indices within each
+	// deque. Contiguous ranges keep the voices of a thread close to
+	// each other in memory.
+	const int nThreads = getThreadCount();
+	for ( int ii = 0; ii < nThreads; ++ii ) {
+		m_deques[ ii ].range.store(
+			packRange( static_cast<int>( static_cast<long long>( nJobs ) * ii / nThreads ),
+					   static_cast<int>( static_cast<long long>( nJobs ) * ( ii + 1 ) / nThreads ) ) );
+	}
+	m_bAcceptingWorkers = true;
+	++m_nGeneration;
+
+	// Wake up workers which went to sleep. A worker, which
+	// registered itself after this point, sees the new generation
+	// and does not wait.
+	if ( nJobs > 1 ) {
+		for ( int nSleeping = m_nSleepingWorkers.exchange( 0 ); nSleeping > 0; --nSleeping ) {
+			m_pWakeup->post();
+		}
+	}
+
+	processJobs( 0 );
+
+	while ( m_nPendingJobs.load() > 0 ) {
+		std::this_thread::yield();
+	}
+
+	// Make sure no worker is still about to claim a job while the
+	// deques are refilled in the next call.
+	m_bAcceptingWorkers = false;
+	while ( m_nActiveWorkers.load() > 0 ) {
+		std::this_thread::yield();
+	}
+}
+
+void RenderThreadPool::processJobs( int nThread ) {
+	const int nThreads = getThreadCount();
+	int nJob;
+	while ( popFront( &m_deques[ nThread ], &nJob ) ) {
+		m_job( m_pContext, nJob );
+		m_nPendingJobs.fetch_sub( 1 );
+	}
+	for ( int ii = 1; ii < nThreads; ++ii ) {
+		Deque* pVictim = &m_deques[ ( nThread + ii ) % nThreads ];
+		while ( stealBack( pVictim, &nJob ) ) {
+			m_job( m_pContext, nJob );
+			m_nPendingJobs.fetch_sub( 1 );
+		}
+	}
+}
+
+void RenderThreadPool::workerLoop( int nThread ) {
+	VectorMath::enableFlushToZero();
+
+	unsigned nGeneration = m_nGeneration.load();
+
+	while ( ! m_bShutdown.load() ) {
+
+		int nSpins = 0;
+		while ( m_nGeneration.load() == nGeneration && ! m_bShutdown.load() ) {
+			if ( ++nSpins < nSpinCount ) {
+				std::this_thread::yield();
+			} else {
+				// Register before checking the generation once more.
+				// Either run() sees the registration and posts the
+				// semaphore or this thread sees the new generation.
+				// A superfluous post only results in a spurious
+				// wakeup.
+				m_nSleepingWorkers.fetch_add( 1 );
+				if ( m_nGeneration.load() == nGeneration && ! m_bShutdown.load() ) {
+					m_pWakeup->wait();
+				}
+				nSpins = 0;
+			}
+		}
+		if ( m_bShutdown.load() ) {
+			break;
+		}
+		nGeneration = m_nGeneration.load();
+
+		++m_nActiveWorkers;
+		if ( m_bAcceptingWorkers.load() ) {
+			processJobs( nThread );
+		}
+		--m_nActiveWorkers;
+	}
+}
+
+};
+
+/* vim: set softtabstop=4 noexpandtab: */
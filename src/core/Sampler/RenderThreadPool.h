@@ -0,0 +1,137 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_RENDER_THREAD_POOL_H
+#define H2C_RENDER_THREAD_POOL_H
+
+#include <core/Object.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace H2Core
+{
+
+/**
+ * Pool of pre-spawned threads helping the audio thread to render
+ * the voices of the #Sampler.
+ *
+ * Each thread - including the one calling run() - owns a deque of
+ * jobs. A batch is split into contiguous ranges, one per deque.
+ * Threads take jobs from the front of their own deque and, once it
+ * is empty, steal from the back of the others. As all jobs of a
+ * batch are known in advance, each deque is just a range of job
+ * indices packed into a single atomic word, so both ends are
+ * claimed with a compare-and-swap. run() neither allocates memory
+ * nor waits on a lock. In case none of the workers is awake in time
+ * the calling thread renders all jobs itself.
+ *
+ * Idle workers spin for a short while before going to sleep on a
+ * semaphore. Posting it does not take a lock and never blocks, so
+ * the audio thread can wake them safely.
+ */
+/** \ingroup docCore docAudioEngine */
+class RenderThreadPool : public H2Core::Object<RenderThreadPool>
+{
+		H2_OBJECT(RenderThreadPool)
+	public:
+		typedef void (*JobFunction)( void* pContext, int nJob );
+
+		/**
+		 * \param nThreads Overall number of threads rendering
+		 * jobs. Since the thread calling run() participates,
+		 * @a nThreads - 1 workers will be spawned.
+		 */
+		RenderThreadPool( int nThreads );
+		~RenderThreadPool();
+
+		/** \return Overall number of threads including the one
+		 * calling run(). */
+		int getThreadCount() const;
+
+		/**
+		 * Calls @a job( @a pContext, n ) for all n in [0, @a nJobs)
+		 * and returns once all of them are done.
+		 *
+		 * The order in which the jobs are executed as well as the
+		 * thread executing them is arbitrary. Must not be called
+		 * concurrently.
+		 */
+		void run( JobFunction job, void* pContext, int nJobs );
+
+	private:
+		/** Jobs of a single thread. The front index is stored in
+		 * the upper and the back index in the lower 32 bits of
+		 * #range. Aligned to avoid false sharing. */
+		struct alignas( 64 ) Deque {
+			std::atomic<uint64_t> range;
+		};
+		/** Counting semaphore of the current platform. */
+		class Semaphore;
+
+		static uint64_t packRange( int nFront, int nBack );
+		/** Claims the job at the front of @a pDeque. \return false
+		 * if the deque is empty. */
+		static bool popFront( Deque* pDeque, int* pJob );
+		/** Claims the job at the back of @a pDeque. \return false if
+		 * the deque is empty. */
+		static bool stealBack( Deque* pDeque, int* pJob );
+
+		void workerLoop( int nThread );
+		/** Renders the jobs of thread @a nThread and steals from all
+		 * others afterwards till no job is left. */
+		void processJobs( int nThread );
+
+		std::vector<std::thread> m_workers;
+		/** One deque per thread. The one of the thread calling
+		 * run() comes first. */
+		std::unique_ptr<Deque[]> m_deques;
+
+		JobFunction m_job;
+		void* m_pContext;
+		/** Jobs of the current batch not done yet. */
+		std::atomic<int> m_nPendingJobs;
+		/** Number of workers currently claiming jobs. */
+		std::atomic<int> m_nActiveWorkers;
+		/** Whether workers are allowed to join the current batch. */
+		std::atomic<bool> m_bAcceptingWorkers;
+		std::atomic<unsigned> m_nGeneration;
+		std::atomic<bool> m_bShutdown;
+
+		/** Number of workers which are about to wait or waiting for
+		 * #m_pWakeup. */
+		std::atomic<int> m_nSleepingWorkers;
+		std::unique_ptr<Semaphore> m_pWakeup;
+};
+
+inline int RenderThreadPool::getThreadCount() const {
+	return m_workers.size() + 1;
+}
+
+};
+
+#endif // H2C_RENDER_THREAD_POOL_H
+
+/* vim: set softtabstop=4 noexpandtab: */
@@ -0,0 +1,138 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Sampler/SampleStreamer.h>
+#include <core/Basics/Sample.h>
+#include <core/Helpers/SampleCache.h>
+#include <core/Preferences/Preferences.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace H2Core
+{
+
+SampleStreamer::SampleStreamer()
+	: m_nWriteIndex( 0 )
+	, m_nReadIndex( 0 )
+	, m_nDroppedRequests( 0 )
+	, m_bShutdown( false )
+{
+	for ( auto& request : m_requests ) {
+		request.nFrame = 0;
+		request.nFrames = 0;
+	}
+	m_thread = std::thread( &SampleStreamer::streamingLoop, this );
+}
+
+SampleStreamer::~SampleStreamer() {
+	m_bShutdown = true;
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_condition.notify_all();
+	}
+	m_thread.join();
+}
+
+bool SampleStreamer::prefetch( const std::shared_ptr<Sample>& pSample, int nFrame, int nFrames )
+{
+	const unsigned nWriteIndex = m_nWriteIndex.load( std::memory_order_relaxed );
+	if ( nWriteIndex - m_nReadIndex.load( std::memory_order_acquire ) >= nQueueSize ) {
+		++m_nDroppedRequests;
+		return false;
+	}
+
+	// The streaming thread releases the sample of a request before
+	// handing back its slot. Assigning it here thus never destroys
+	// a sample in the audio thread.
+	auto& request = m_requests[ nWriteIndex % nQueueSize ];
+	request.pSample = pSample;
+	request.nFrame = nFrame;
+	request.nFrames = nFrames;
+	m_nWriteIndex.store( nWriteIndex + 1, std::memory_order_release );
+
+	m_condition.notify_one();
+	return true;
+}
+
+void SampleStreamer::update( const std::shared_ptr<Sample>& pSample, int nPosition,
+							 int* pnPrefetchedFrame )
+{
+	if ( pSample == nullptr || ! pSample->is_streamed() ) {
+		return;
+	}
+
+	const int nLookahead = std::max( 1, static_cast<int>(
+		static_cast<long long>( Preferences::get_instance()->m_nStreamingPreload ) *
+		pSample->get_sample_rate() / 1000 ) );
+
+	int nFrom = *pnPrefetchedFrame;
+	if ( nPosition > nFrom || nFrom - nPosition > nLookahead ) {
+		// The voice either outran the frames requested so far or
+		// was relocated (e.g. the playback track).
+		nFrom = nPosition;
+	} else if ( nFrom - nPosition >= nLookahead / 2 ) {
+		// Enough frames requested ahead.
+		return;
+	}
+
+	const int nTo = std::min( pSample->get_frames(), nPosition + nLookahead );
+	if ( nTo <= nFrom ) {
+		return;
+	}
+
+	if ( prefetch( pSample, nFrom, nTo - nFrom ) ) {
+		*pnPrefetchedFrame = nTo;
+	}
+}
+
+void SampleStreamer::streamingLoop()
+{
+	while ( ! m_bShutdown ) {
+		const unsigned nReadIndex = m_nReadIndex.load( std::memory_order_relaxed );
+		if ( nReadIndex == m_nWriteIndex.load( std::memory_order_acquire ) ) {
+			// prefetch() does not acquire the mutex and a wakeup
+			// might be missed. Poll regularly.
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_condition.wait_for( lock, std::chrono::milliseconds( 2 ) );
+			continue;
+		}
+
+		auto& request = m_requests[ nReadIndex % nQueueSize ];
+		auto pSample = std::move( request.pSample );
+		const int nFrame = request.nFrame;
+		const int nFrames = request.nFrames;
+		m_nReadIndex.store( nReadIndex + 1, std::memory_order_release );
+
+		if ( pSample != nullptr && pSample->is_streamed() &&
+			 nFrame >= 0 && nFrame + nFrames <= pSample->get_frames() ) {
+			SampleCache::populate( pSample->get_data_l() + nFrame, nFrames );
+			if ( ! pSample->is_mono() ) {
+				SampleCache::populate( pSample->get_data_r() + nFrame, nFrames );
+			}
+		}
+	}
+}
+
+};
+
+/* vim: set softtabstop=4 noexpandtab: */
@@ -0,0 +1,127 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SAMPLE_STREAMER_H
+#define H2C_SAMPLE_STREAMER_H
+
+#include <core/Object.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace H2Core
+{
+
+class Sample;
+
+/**
+ * Background thread reading streamed samples (see
+ * Sample::is_streamed()) from disk ahead of the voices playing them.
+ *
+ * Streamed samples are mapped from the SampleCache and only their
+ * beginning is guaranteed to be in memory. Each cycle the #Sampler
+ * reports the position of all voices playing a streamed sample via
+ * update(). Once a voice comes close to the end of the frames read
+ * so far, the next Preferences::m_nStreamingPreload milliseconds are
+ * requested. They are read from disk by the streaming thread while
+ * the voice is still playing the previous ones.
+ *
+ * Requests are passed using a fixed-size single producer, single
+ * consumer queue. Neither update() nor prefetch() allocate memory
+ * or wait on a lock. The streaming thread takes ownership of the
+ * requested sample till the pages are read. Samples released by the
+ * #Sampler in the meantime are thus destroyed by the streaming thread
+ * rather than the audio thread.
+ */
+/** \ingroup docCore docAudioEngine */
+class SampleStreamer : public H2Core::Object<SampleStreamer>
+{
+		H2_OBJECT(SampleStreamer)
+	public:
+		SampleStreamer();
+		~SampleStreamer();
+
+		/**
+		 * Requests the frames [@a nFrame, @a nFrame + @a nFrames) of
+		 * @a pSample to be read from disk.
+		 *
+		 * To be called by the audio thread only. Requests exceeding
+		 * the capacity of the queue are dropped.
+		 *
+		 * \return false in case the request was dropped.
+		 */
+		bool prefetch( const std::shared_ptr<Sample>& pSample, int nFrame, int nFrames );
+		/**
+		 * Requests the frames ahead of a voice playing @a pSample at
+		 * @a nPosition in case they were not requested yet.
+		 *
+		 * \param pSample Sample played. Nothing is done unless it is
+		 * streamed.
+		 * \param nPosition Current position of the voice within @a
+		 * pSample.
+		 * \param pnPrefetchedFrame First frame of @a pSample not
+		 * requested for the voice yet. Updated in place. Has to be 0
+		 * for a voice not requesting any frames yet.
+		 */
+		void update( const std::shared_ptr<Sample>& pSample, int nPosition,
+					 int* pnPrefetchedFrame );
+
+		/** Number of requests dropped since the streamer was
+		 * created. */
+		int getDroppedRequests() const;
+
+	private:
+		struct Request {
+			std::shared_ptr<Sample> pSample;
+			int nFrame;
+			int nFrames;
+		};
+		/** Capacity of #m_requests. Power of two. */
+		static constexpr unsigned nQueueSize = 1024;
+
+		void streamingLoop();
+
+		Request m_requests[ nQueueSize ];
+		/** Number of requests ever written by the audio thread. */
+		std::atomic<unsigned> m_nWriteIndex;
+		/** Number of requests ever handled by the streaming thread. */
+		std::atomic<unsigned> m_nReadIndex;
+		std::atomic<int> m_nDroppedRequests;
+		std::atomic<bool> m_bShutdown;
+
+		std::thread m_thread;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+};
+
+inline int SampleStreamer::getDroppedRequests() const {
+	return m_nDroppedRequests;
+}
+
+};
+
+#endif // H2C_SAMPLE_STREAMER_H
+
+/* vim: set softtabstop=4 noexpandtab: */
@@ -20,9 +20,12 @@
  *
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
+#include <cstdint>
+#include <thread>
 
 #include <core/IO/AudioOutput.h>
 #include <core/IO/JackAudioDriver.h>
@@ -43,10 +46,14 @@
 #include <core/Basics/Pattern.h>
 #include <core/Basics/PatternList.h>
 #include <core/Helpers/Filesystem.h>
+#include <core/Helpers/SampleRegistry.h>
+#include <core/Helpers/VectorMath.h>
 #include <core/EventQueue.h>
 
 #include <core/FX/Effects.h>
 #include <core/Sampler/Sampler.h>
+#include <core/Sampler/RenderThreadPool.h>
+#include <core/Sampler/SampleStreamer.h>
 
 #include <iostream>
 #include <QDebug>
@@ -58,7 +65,7 @@ static std::shared_ptr<Instrument> createInstrument(int id, const QString& filep
 {
 	auto pInstrument = std::make_shared<Instrument>( id, filepath );
 	pInstrument->set_volume( volume );
-	auto pLayer = std::make_shared<InstrumentLayer>( Sample::load( filepath ) );
+	auto pLayer = std::make_shared<InstrumentLayer>( SampleRegistry::load( filepath ) );
 	auto pComponent = std::make_shared<InstrumentComponent>( 0 );
 	
 	pComponent->set_layer( pLayer, 0 );
@@ -69,6 +76,14 @@ static std::shared_ptr<Instrument> createInstrument(int id, const QString& filep
 Sampler::Sampler()
 		: m_pMainOut_L( nullptr )
 		, m_pMainOut_R( nullptr )
+		, m_pRenderThreadPool( nullptr )
+		, m_pRenderBuffers( nullptr )
+		, m_pRenderBuffersMemory( nullptr )
+		, m_nRenderSlots( 0 )
+		, m_nRenderBufferSize( 0 )
+		, m_nMaxVoices( 0 )
+		, m_nNextVoiceSerial( 0 )
+		, m_nStolenVoices( 0 )
 		, m_pPreviewInstrument( nullptr )
 		, m_interpolateMode( Interpolation::InterpolateMode::Linear )
 {
@@ -88,6 +103,17 @@ Sampler::Sampler()
 	// dummy instrument used for playback track
 	m_pPlaybackTrackInstrument = createInstrument( PLAYBACK_INSTR_ID, sEmptySampleFilename, 0.8 );
 	m_nPlayBackSamplePosition = 0;
+	m_nPlaybackTrackPrefetchedFrame = 0;
+
+	m_pSampleStreamer = new SampleStreamer();
+
+	setRenderThreads( Preferences::get_instance()->m_nRenderThreads );
+
+	for ( int ii = 0; ii < VOICE_INDICES; ++ii ) {
+		std::fill( m_voiceBuckets[ ii ], m_voiceBuckets[ ii ] + VOICE_BUCKETS, nullptr );
+	}
+
+	setMaxNotes( Preferences::get_instance()->m_nMaxNotes );
 }
 
 
@@ -98,6 +124,10 @@ Sampler::~Sampler()
 	delete[] m_pMainOut_L;
 	delete[] m_pMainOut_R;
 
+	delete m_pRenderThreadPool;
+	delete m_pSampleStreamer;
+	delete[] m_pRenderBuffersMemory;
+
 	m_pPreviewInstrument = nullptr;
 	m_pPlaybackTrackInstrument = nullptr;
 }
@@ -107,67 +137,460 @@ Sampler::~Sampler()
  */
 float const Sampler::K_NORM_DEFAULT = 1.33333333333333;
 
+void Sampler::setRenderThreads( int nThreads )
+{
+	if ( nThreads <= 0 ) {
+		nThreads = std::max( static_cast<int>( std::thread::hardware_concurrency() ), 1 );
+	}
+
+	if ( m_pRenderBuffersMemory != nullptr &&
+		 ( m_pRenderThreadPool != nullptr ?
+		   m_pRenderThreadPool->getThreadCount() : 1 ) == nThreads ) {
+		return;
+	}
+
+	delete m_pRenderThreadPool;
+	m_pRenderThreadPool = nullptr;
+	delete[] m_pRenderBuffersMemory;
+	m_pRenderBuffersMemory = nullptr;
+
+	if ( nThreads > 1 ) {
+		m_pRenderThreadPool = new RenderThreadPool( nThreads );
+		// Each component rendered within a wave requires scratch
+		// buffers of its own. Allow for a couple of notes per thread
+		// to keep all of them busy.
+		m_nRenderSlots = std::max( MAX_COMPONENTS, 4 * nThreads );
+	} else {
+		// Components are rendered and mixed one after another.
+		m_nRenderSlots = 1;
+	}
+
+	const int nRenders = std::max( MAX_COMPONENTS, m_nRenderSlots );
+	m_componentRenders.resize( nRenders );
+	m_noteRenders.resize( nRenders );
+
+	// Align the scratch buffers to 32 bytes to allow for aligned
+	// vector loads and stores.
+	const size_t nScratchFloats =
+		static_cast<size_t>( m_nRenderSlots ) * 4 * MAX_BUFFER_SIZE;
+	const size_t nRenderBufferFloats =
+		nScratchFloats + static_cast<size_t>( nRenders ) * MAX_BUFFER_SIZE;
+	m_pRenderBuffersMemory = new float[ nRenderBufferFloats + 8 ];
+	uintptr_t nAddress = reinterpret_cast<uintptr_t>( m_pRenderBuffersMemory );
+	nAddress = ( nAddress + 31 ) & ~static_cast<uintptr_t>( 31 );
+	m_pRenderBuffers = reinterpret_cast<float*>( nAddress );
+	std::fill( m_pRenderBuffers, m_pRenderBuffers + nRenderBufferFloats, 0.0f );
+
+	for ( int ii = 0; ii < nRenders; ++ii ) {
+		m_noteRenders[ ii ].pEnvelope = m_pRenderBuffers + nScratchFloats +
+			static_cast<size_t>( ii ) * MAX_BUFFER_SIZE;
+	}
+}
+
 void Sampler::process( uint32_t nFrames, std::shared_ptr<Song> pSong )
 {
 	AudioOutput* pAudioOutpout = Hydrogen::get_instance()->getAudioOutput();
 	assert( pAudioOutpout );
 
-	memset( m_pMainOut_L, 0, nFrames * sizeof( float ) );
-	memset( m_pMainOut_R, 0, nFrames * sizeof( float ) );
+	VectorMath::clear( m_pMainOut_L, nFrames );
+	VectorMath::clear( m_pMainOut_R, nFrames );
 
 	// Track output queues are zeroed by
 	// audioEngine_process_clearAudioBuffers()
 
-	// Max notes limit
-	int m_nMaxNotes = Preferences::get_instance()->m_nMaxNotes;
-	while ( ( int )m_playingNotesQueue.size() > m_nMaxNotes ) {
-		Note * pOldNote = m_playingNotesQueue[ 0 ];
-		m_playingNotesQueue.erase( m_playingNotesQueue.begin() );
-		pOldNote->get_instrument()->dequeue();
-		delete  pOldNote;	// FIXME: send note-off instead of removing the note from the list?
-	}
+	// Max notes limit. Surplus voices are faded out. If that does
+	// not keep up - e.g. because lots of notes are triggered within a
+	// few cycles - and the queue reaches its capacity of
+	// #m_nMaxVoices, addVoice() drops voices right away.
+	stealVoices( Preferences::get_instance()->m_nMaxNotes );
 
 	for ( auto& pComponent : *pSong->getComponents() ) {
 		pComponent->reset_outs(nFrames);
 	}
 
+	updateMixerSnapshot( pSong );
+
 	// eseguo tutte le note nella lista di note in esecuzione
+	//
+	// The notes are handled in waves. All notes of a wave are
+	// prepared on this thread, rendered - in parallel in case a
+	// thread pool is present -, and mixed in the order of the queue.
+	// This way the output does not depend on the number of threads.
+	// Finished notes are removed from the queue only after all waves
+	// are done.
 	unsigned i = 0;
 	Note* pNote;
 	while ( i < m_playingNotesQueue.size() ) {
-		pNote = m_playingNotesQueue[ i ];		// recupero una nuova nota
-		if ( renderNote( pNote, nFrames, pSong ) ) {	// la nota e' finita
-			m_playingNotesQueue.erase( m_playingNotesQueue.begin() + i );
-			pNote->get_instrument()->dequeue();
-			m_queuedNoteOffs.push_back( pNote );
+		int nNotes = 0;
+		int nComponents = 0;
+		for ( unsigned nn = i; nn < m_playingNotesQueue.size(); ++nn ) {
+			pNote = m_playingNotesQueue[ nn ];
+			int nNoteComponents = 0;
+			if ( pNote->get_instrument() != nullptr ) {
+				nNoteComponents = pNote->get_instrument()->get_components()->size();
+			}
+			if ( nNotes > 0 &&
+				 ( m_pRenderThreadPool == nullptr ||
+				   nNotes >= static_cast<int>( m_noteRenders.size() ) ||
+				   nComponents + nNoteComponents > m_nRenderSlots ) ) {
+				break;
+			}
+
+			prepareNote( pNote, nFrames, pSong, &m_noteRenders[ nNotes ], nComponents );
+			nComponents += m_noteRenders[ nNotes ].nComponents;
+			++nNotes;
+		}
+
+		if ( m_pRenderThreadPool != nullptr ) {
+			m_nRenderBufferSize = nFrames;
+			m_pRenderThreadPool->run( renderNoteJob, this, nNotes );
+
+			for ( int nn = 0; nn < nNotes; ++nn ) {
+				for ( int cc = 0; cc < m_noteRenders[ nn ].nComponents; ++cc ) {
+					mixComponent( &m_noteRenders[ nn ], cc );
+				}
+			}
 		} else {
+			// All components share the same scratch buffer.
+			for ( int cc = 0; cc < m_noteRenders[ 0 ].nComponents; ++cc ) {
+				renderComponent( &m_noteRenders[ 0 ], cc, nFrames, m_pRenderBuffers );
+				mixComponent( &m_noteRenders[ 0 ], cc );
+			}
+		}
+
+		for ( int nn = 0; nn < nNotes; ++nn ) {
+			auto pNoteRender = &m_noteRenders[ nn ];
+			bool bEnded = pNoteRender->bEnded;
+			for ( int cc = 0; cc < pNoteRender->nComponents; ++cc ) {
+				if ( ! m_componentRenders[ pNoteRender->nFirstComponent + cc ].bEnded ) {
+					bEnded = false;
+				}
+			}
+
+			if ( bEnded ) {	// la nota e' finita
+				m_queuedNoteOffs.push_back( pNoteRender->pNote );
+			} else {
+				// The envelope progressed and might have been
+				// released.
+				updateStealPriority( pNoteRender->pNote );
+			}
 			++i; // carico la prox nota
 		}
 	}
 
+	for ( const auto& pEndedNote : m_queuedNoteOffs ) {
+		removeVoice( pEndedNote );
+		pEndedNote->get_instrument()->dequeue();
+	}
+
 	//Queue midi note off messages for notes that have a length specified for them
-	while ( !m_queuedNoteOffs.empty() ) {
-		pNote =  m_queuedNoteOffs[0];
-		MidiOutput* pMidiOut = Hydrogen::get_instance()->getMidiOutput();
-		
-		if( pMidiOut != nullptr && !pNote->get_instrument()->is_muted() ){
-			pMidiOut->handleQueueNoteOff(	pNote->get_instrument()->get_midi_out_channel(), 
-											pNote->get_midi_key(),
-											pNote->get_midi_velocity() );
-		}
-		
-		m_queuedNoteOffs.erase( m_queuedNoteOffs.begin() );
-		
-		if( pNote != nullptr ){
-			delete pNote;
+	MidiOutput* pMidiOut = Hydrogen::get_instance()->getMidiOutput();
+	for ( const auto& pEndedNote : m_queuedNoteOffs ) {
+		if( pMidiOut != nullptr && !pEndedNote->get_instrument()->is_muted() ){
+			pMidiOut->handleQueueNoteOff(	pEndedNote->get_instrument()->get_midi_out_channel(), 
+											pEndedNote->get_midi_key(),
+											pEndedNote->get_midi_velocity() );
 		}
-		
-		pNote = nullptr;
-	}//while
+		delete pEndedNote;
+	}
+	m_queuedNoteOffs.clear();
 
 	processPlaybackTrack(nFrames);
 }
 
+void Sampler::setMaxNotes( int nMaxNotes )
+{
+	// Avoid allocations in the audio thread when adding, removing,
+	// and stealing voices. Voices beyond the capacity are dropped by
+	// addVoice().
+	m_nMaxVoices = std::max( 2 * nMaxNotes, 2 );
+	while ( static_cast<int>( m_playingNotesQueue.size() ) > m_nMaxVoices ) {
+		dropVoice();
+	}
+	m_playingNotesQueue.reserve( m_nMaxVoices );
+	m_queuedNoteOffs.reserve( m_nMaxVoices );
+	m_stealHeap.reserve( m_nMaxVoices );
+}
+
+void Sampler::dropVoice()
+{
+	// Prefer voices fading out already.
+	Note* pVictim = nullptr;
+	for ( const auto& pNote : m_playingNotesQueue ) {
+		if ( pNote->get_stolen() ) {
+			pVictim = pNote;
+			break;
+		}
+	}
+	if ( pVictim == nullptr ) {
+		if ( m_stealHeap.empty() ) {
+			return;
+		}
+		pVictim = m_stealHeap[ 0 ];
+		m_nStolenVoices.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	removeVoice( pVictim );
+	pVictim->get_instrument()->dequeue();
+	delete pVictim;
+}
+
+void Sampler::stealVoices( int nMaxNotes )
+{
+	// Length of the fade out in frames at the original pitch. This
+	// is the shortest release an ADSR supports.
+	const unsigned int nStealFadeOut = 256;
+
+	while ( static_cast<int>( m_stealHeap.size() ) > nMaxNotes ) {
+		Note* pVictim = m_stealHeap[ 0 ];
+		removeStealCandidate( pVictim );
+
+		pVictim->set_stolen( true );
+		pVictim->get_adsr()->fadeOut( nStealFadeOut );
+		m_nStolenVoices.fetch_add( 1, std::memory_order_relaxed );
+	}
+}
+
+bool Sampler::isStolenBefore( Note* pNote, Note* pOther )
+{
+	auto pVoice = pNote->get_sampler_voice();
+	auto pOtherVoice = pOther->get_sampler_voice();
+	if ( pVoice->nStealTier != pOtherVoice->nStealTier ) {
+		return pVoice->nStealTier < pOtherVoice->nStealTier;
+	}
+	if ( pVoice->fStealPriority != pOtherVoice->fStealPriority ) {
+		return pVoice->fStealPriority < pOtherVoice->fStealPriority;
+	}
+	return pVoice->nSerial < pOtherVoice->nSerial;
+}
+
+void Sampler::siftStealCandidate( int nIndex )
+{
+	Note* pNote = m_stealHeap[ nIndex ];
+
+	while ( nIndex > 0 ) {
+		const int nParent = ( nIndex - 1 ) / 2;
+		if ( ! isStolenBefore( pNote, m_stealHeap[ nParent ] ) ) {
+			break;
+		}
+		m_stealHeap[ nIndex ] = m_stealHeap[ nParent ];
+		m_stealHeap[ nIndex ]->get_sampler_voice()->nStealIndex = nIndex;
+		nIndex = nParent;
+	}
+
+	const int nSize = m_stealHeap.size();
+	while ( 2 * nIndex + 1 < nSize ) {
+		int nChild = 2 * nIndex + 1;
+		if ( nChild + 1 < nSize &&
+			 isStolenBefore( m_stealHeap[ nChild + 1 ], m_stealHeap[ nChild ] ) ) {
+			++nChild;
+		}
+		if ( ! isStolenBefore( m_stealHeap[ nChild ], pNote ) ) {
+			break;
+		}
+		m_stealHeap[ nIndex ] = m_stealHeap[ nChild ];
+		m_stealHeap[ nIndex ]->get_sampler_voice()->nStealIndex = nIndex;
+		nIndex = nChild;
+	}
+
+	m_stealHeap[ nIndex ] = pNote;
+	pNote->get_sampler_voice()->nStealIndex = nIndex;
+}
+
+void Sampler::updateStealPriority( Note* pNote )
+{
+	auto pVoice = pNote->get_sampler_voice();
+	if ( pVoice->nStealIndex == -1 ) {
+		return;
+	}
+
+	const auto pPref = Preferences::get_instance();
+	auto pADSR = pNote->get_adsr();
+
+	int nTier = 2;
+	if ( pADSR->is_released() ) {
+		// Voices released by a note off or their mute group are
+		// fading out anyway.
+		nTier = 0;
+	} else if ( pPref->m_bStealSameInstrumentFirst &&
+				( pVoice->bSuperseded[ Note::SamplerVoice::ByInstrument ] ||
+				  pVoice->bSuperseded[ Note::SamplerVoice::ByMuteGroup ] ) ) {
+		nTier = 1;
+	}
+
+	double fPriority;
+	if ( pPref->m_voiceStealing == Preferences::VoiceStealing::Quietest ) {
+		// Do not cut off onsets which did not reach their peak yet.
+		const float fLevel = pADSR->is_attacking() ? 1.0 : pADSR->get_value();
+		fPriority = fLevel * pNote->get_velocity();
+	} else {
+		fPriority = static_cast<double>( pVoice->nSerial );
+	}
+
+	if ( nTier == pVoice->nStealTier && fPriority == pVoice->fStealPriority ) {
+		return;
+	}
+	pVoice->nStealTier = nTier;
+	pVoice->fStealPriority = fPriority;
+	siftStealCandidate( pVoice->nStealIndex );
+}
+
+void Sampler::removeStealCandidate( Note* pNote )
+{
+	auto pVoice = pNote->get_sampler_voice();
+	if ( pVoice->nStealIndex == -1 ) {
+		return;
+	}
+
+	const int nIndex = pVoice->nStealIndex;
+	Note* pLast = m_stealHeap.back();
+	m_stealHeap.pop_back();
+	pVoice->nStealIndex = -1;
+	if ( pLast != pNote ) {
+		m_stealHeap[ nIndex ] = pLast;
+		pLast->get_sampler_voice()->nStealIndex = nIndex;
+		siftStealCandidate( nIndex );
+	}
+
+	// Hand the role of the most recent voice over to the next older
+	// one.
+	for ( int ii : { Note::SamplerVoice::ByInstrument,
+					 Note::SamplerVoice::ByMuteGroup } ) {
+		if ( pVoice->nBuckets[ ii ] == -1 || pVoice->bSuperseded[ ii ] ) {
+			continue;
+		}
+		Note* pOlder = findUnstolenVoice( pVoice->pNext[ ii ], ii,
+										  pVoice->nKeys[ ii ] );
+		if ( pOlder != nullptr ) {
+			pOlder->get_sampler_voice()->bSuperseded[ ii ] = false;
+			updateStealPriority( pOlder );
+		}
+	}
+}
+
+Note* Sampler::findUnstolenVoice( Note* pNote, int nIndex, intptr_t nKey ) const
+{
+	// Voices are prepended to their bucket. So, the first match is
+	// the most recent one.
+	while ( pNote != nullptr ) {
+		auto pVoice = pNote->get_sampler_voice();
+		if ( pVoice->nKeys[ nIndex ] == nKey && pVoice->nStealIndex != -1 ) {
+			return pNote;
+		}
+		pNote = pVoice->pNext[ nIndex ];
+	}
+	return nullptr;
+}
+
+static_assert( Note::SamplerVoice::Indices == 3,
+			   "Sampler::VOICE_INDICES out of sync" );
+
+int Sampler::getVoiceBucket( intptr_t nKey ) {
+	// Instruments are keyed by their address. Mix in the higher bits
+	// as the lowest ones are always zero.
+	const uintptr_t nHash = static_cast<uintptr_t>( nKey );
+	return static_cast<int>( ( nHash ^ ( nHash >> 7 ) ^ ( nHash >> 14 ) ) %
+							 VOICE_BUCKETS );
+}
+
+void Sampler::addVoice( Note* pNote )
+{
+	if ( static_cast<int>( m_playingNotesQueue.size() ) >= m_nMaxVoices ) {
+		dropVoice();
+	}
+
+	auto pVoice = pNote->get_sampler_voice();
+	pVoice->nQueueIndex = m_playingNotesQueue.size();
+	pVoice->nSerial = m_nNextVoiceSerial++;
+	m_playingNotesQueue.push_back( pNote );
+
+	auto pInstr = pNote->get_instrument();
+	const bool bIndexed[ VOICE_INDICES ] = {
+		true,
+		pInstr->get_mute_group() != -1,
+		pNote->get_midi_msg() >= 0 };
+	pVoice->nKeys[ Note::SamplerVoice::ByInstrument ] =
+		reinterpret_cast<intptr_t>( pInstr.get() );
+	pVoice->nKeys[ Note::SamplerVoice::ByMuteGroup ] = pInstr->get_mute_group();
+	pVoice->nKeys[ Note::SamplerVoice::ByMidiKey ] = pNote->get_midi_msg();
+
+	for ( int ii = 0; ii < VOICE_INDICES; ++ii ) {
+		pVoice->bSuperseded[ ii ] = false;
+		if ( ! bIndexed[ ii ] ) {
+			pVoice->nBuckets[ ii ] = -1;
+			continue;
+		}
+		const int nBucket = getVoiceBucket( pVoice->nKeys[ ii ] );
+		Note* pHead = m_voiceBuckets[ ii ][ nBucket ];
+		if ( ii != Note::SamplerVoice::ByMidiKey ) {
+			Note* pPrevious = findUnstolenVoice( pHead, ii, pVoice->nKeys[ ii ] );
+			if ( pPrevious != nullptr ) {
+				pPrevious->get_sampler_voice()->bSuperseded[ ii ] = true;
+				updateStealPriority( pPrevious );
+			}
+		}
+		pVoice->nBuckets[ ii ] = nBucket;
+		pVoice->pPrev[ ii ] = nullptr;
+		pVoice->pNext[ ii ] = pHead;
+		if ( pHead != nullptr ) {
+			pHead->get_sampler_voice()->pPrev[ ii ] = pNote;
+		}
+		m_voiceBuckets[ ii ][ nBucket ] = pNote;
+	}
+
+	// Forces updateStealPriority() to sift the new voice into place.
+	pVoice->nStealTier = -1;
+	pVoice->nStealIndex = m_stealHeap.size();
+	m_stealHeap.push_back( pNote );
+	updateStealPriority( pNote );
+}
+
+void Sampler::removeVoice( Note* pNote )
+{
+	auto pVoice = pNote->get_sampler_voice();
+	assert( pVoice->nQueueIndex >= 0 &&
+			m_playingNotesQueue[ pVoice->nQueueIndex ] == pNote );
+
+	removeStealCandidate( pNote );
+
+	Note* pLast = m_playingNotesQueue.back();
+	m_playingNotesQueue[ pVoice->nQueueIndex ] = pLast;
+	pLast->get_sampler_voice()->nQueueIndex = pVoice->nQueueIndex;
+	m_playingNotesQueue.pop_back();
+	pVoice->nQueueIndex = -1;
+
+	for ( int ii = 0; ii < VOICE_INDICES; ++ii ) {
+		if ( pVoice->nBuckets[ ii ] == -1 ) {
+			continue;
+		}
+		if ( pVoice->pPrev[ ii ] != nullptr ) {
+			pVoice->pPrev[ ii ]->get_sampler_voice()->pNext[ ii ] = pVoice->pNext[ ii ];
+		} else {
+			m_voiceBuckets[ ii ][ pVoice->nBuckets[ ii ] ] = pVoice->pNext[ ii ];
+		}
+		if ( pVoice->pNext[ ii ] != nullptr ) {
+			pVoice->pNext[ ii ]->get_sampler_voice()->pPrev[ ii ] = pVoice->pPrev[ ii ];
+		}
+		pVoice->nBuckets[ ii ] = -1;
+		pVoice->pPrev[ ii ] = nullptr;
+		pVoice->pNext[ ii ] = nullptr;
+	}
+}
+
+template <typename Callback>
+void Sampler::forEachVoice( int nIndex, intptr_t nKey, Callback callback )
+{
+	Note* pNote = m_voiceBuckets[ nIndex ][ getVoiceBucket( nKey ) ];
+	while ( pNote != nullptr ) {
+		// Retrieved first since the callback might remove the note.
+		Note* pNext = pNote->get_sampler_voice()->pNext[ nIndex ];
+		if ( pNote->get_sampler_voice()->nKeys[ nIndex ] == nKey ) {
+			callback( pNote );
+		}
+		pNote = pNext;
+	}
+}
+
 bool Sampler::isRenderingNotes() const {
 	return m_playingNotesQueue.size() > 0;
 }
@@ -183,36 +606,41 @@ void Sampler::noteOn(Note *pNote )
 	int nMuteGrp = pInstr->get_mute_group();
 	if ( nMuteGrp != -1 ) {
 		// remove all notes using the same mute group
-		for ( const auto& pNote: m_playingNotesQueue ) {	// delete older note
-			if ( ( pNote->get_instrument() != pInstr )  && ( pNote->get_instrument()->get_mute_group() == nMuteGrp ) ) {
-				pNote->get_adsr()->release();
+		forEachVoice( Note::SamplerVoice::ByMuteGroup, nMuteGrp,
+					  [&]( Note* pOtherNote ) {	// delete older note
+			if ( pOtherNote->get_instrument() != pInstr ) {
+				pOtherNote->get_adsr()->release();
+				updateStealPriority( pOtherNote );
 			}
-		}
+		} );
 	}
 
 	//note off notes
 	if( pNote->get_note_off() ){
-		for ( const auto& pNote: m_playingNotesQueue ) {
-			if ( ( pNote->get_instrument() == pInstr ) ) {
-				//ERRORLOG("note_off");
-				pNote->get_adsr()->release();
-			}
-		}
+		forEachVoice( Note::SamplerVoice::ByInstrument,
+					  reinterpret_cast<intptr_t>( pInstr.get() ),
+					  [&]( Note* pOtherNote ) {
+			//ERRORLOG("note_off");
+			pOtherNote->get_adsr()->release();
+			updateStealPriority( pOtherNote );
+		} );
 	}
 
 	pInstr->enqueue();
 	if( !pNote->get_note_off() ){
-		m_playingNotesQueue.push_back( pNote );
+		addVoice( pNote );
 	}
 }
 
 void Sampler::midiKeyboardNoteOff( int key )
 {
-	for ( const auto& pNote: m_playingNotesQueue ) {
-		if ( ( pNote->get_midi_msg() == key) ) {
-			pNote->get_adsr()->release();
-		}
+	if ( key < 0 ) {
+		return;
 	}
+	forEachVoice( Note::SamplerVoice::ByMidiKey, key, [&]( Note* pNote ) {
+		pNote->get_adsr()->release();
+		updateStealPriority( pNote );
+	} );
 }
 
 
@@ -222,11 +650,12 @@ void Sampler::noteOff(Note* pNote )
 {
 	auto pInstr = pNote->get_instrument();
 	// find the notes using the same instrument, and release them
-	for ( const auto& pNote: m_playingNotesQueue ) {
-		if ( pNote->get_instrument() == pInstr ) {
-			pNote->get_adsr()->release();
-		}
-	}
+	forEachVoice( Note::SamplerVoice::ByInstrument,
+				  reinterpret_cast<intptr_t>( pInstr.get() ),
+				  [&]( Note* pOtherNote ) {
+		pOtherNote->get_adsr()->release();
+		updateStealPriority( pOtherNote );
+	} );
 	
 	delete pNote;
 }
@@ -362,54 +791,87 @@ float Sampler::ratioConstKNormPanLaw( float fPan, float k) {
 }
 
 // function to direct the computation to the selected pan law.
-inline float Sampler::panLaw( float fPan, std::shared_ptr<Song> pSong ) {
-	int nPanLawType = pSong->getPanLawType();
-	if ( nPanLawType == RATIO_STRAIGHT_POLYGONAL ) {
-		return ratioStraightPolygonalPanLaw( fPan );
-	} else if ( nPanLawType == RATIO_CONST_POWER ) {
-		return ratioConstPowerPanLaw( fPan );
-	} else if ( nPanLawType == RATIO_CONST_SUM ) {
-		return ratioConstSumPanLaw( fPan );
-	} else if ( nPanLawType == LINEAR_STRAIGHT_POLYGONAL ) {
-		return linearStraightPolygonalPanLaw( fPan );
-	} else if ( nPanLawType == LINEAR_CONST_POWER ) {
-		return linearConstPowerPanLaw( fPan );
-	} else if ( nPanLawType == LINEAR_CONST_SUM ) {
-		return linearConstSumPanLaw( fPan );
-	} else if ( nPanLawType == POLAR_STRAIGHT_POLYGONAL ) {
-		return polarStraightPolygonalPanLaw( fPan );
-	} else if ( nPanLawType == POLAR_CONST_POWER ) {
-		return polarConstPowerPanLaw( fPan );
-	} else if ( nPanLawType == POLAR_CONST_SUM ) {
-		return polarConstSumPanLaw( fPan );
-	} else if ( nPanLawType == QUADRATIC_STRAIGHT_POLYGONAL ) {
-		return quadraticStraightPolygonalPanLaw( fPan );
-	} else if ( nPanLawType == QUADRATIC_CONST_POWER ) {
-		return quadraticConstPowerPanLaw( fPan );
-	} else if ( nPanLawType == QUADRATIC_CONST_SUM ) {
-		return quadraticConstSumPanLaw( fPan );
-	} else if ( nPanLawType == LINEAR_CONST_K_NORM ) {
-		return linearConstKNormPanLaw( fPan, pSong->getPanLawKNorm() );
-	} else if ( nPanLawType == POLAR_CONST_K_NORM ) {
-		return polarConstKNormPanLaw( fPan, pSong->getPanLawKNorm() );
-	} else if ( nPanLawType == RATIO_CONST_K_NORM ) {
-		return ratioConstKNormPanLaw( fPan, pSong->getPanLawKNorm() );
-	} else if ( nPanLawType == QUADRATIC_CONST_K_NORM ) {
-		return quadraticConstKNormPanLaw( fPan, pSong->getPanLawKNorm() );
-	} else {
-		WARNINGLOG( "Unknown pan law type. Set default." );
-		pSong->setPanLawType( RATIO_STRAIGHT_POLYGONAL );
-		return ratioStraightPolygonalPanLaw( fPan );
+Sampler::PanLawFunction Sampler::getPanLawFunction( int nPanLawType ) {
+	switch ( nPanLawType ) {
+	case RATIO_STRAIGHT_POLYGONAL:
+		return []( float fPan, float ) { return ratioStraightPolygonalPanLaw( fPan ); };
+	case RATIO_CONST_POWER:
+		return []( float fPan, float ) { return ratioConstPowerPanLaw( fPan ); };
+	case RATIO_CONST_SUM:
+		return []( float fPan, float ) { return ratioConstSumPanLaw( fPan ); };
+	case LINEAR_STRAIGHT_POLYGONAL:
+		return []( float fPan, float ) { return linearStraightPolygonalPanLaw( fPan ); };
+	case LINEAR_CONST_POWER:
+		return []( float fPan, float ) { return linearConstPowerPanLaw( fPan ); };
+	case LINEAR_CONST_SUM:
+		return []( float fPan, float ) { return linearConstSumPanLaw( fPan ); };
+	case POLAR_STRAIGHT_POLYGONAL:
+		return []( float fPan, float ) { return polarStraightPolygonalPanLaw( fPan ); };
+	case POLAR_CONST_POWER:
+		return []( float fPan, float ) { return polarConstPowerPanLaw( fPan ); };
+	case POLAR_CONST_SUM:
+		return []( float fPan, float ) { return polarConstSumPanLaw( fPan ); };
+	case QUADRATIC_STRAIGHT_POLYGONAL:
+		return []( float fPan, float ) { return quadraticStraightPolygonalPanLaw( fPan ); };
+	case QUADRATIC_CONST_POWER:
+		return []( float fPan, float ) { return quadraticConstPowerPanLaw( fPan ); };
+	case QUADRATIC_CONST_SUM:
+		return []( float fPan, float ) { return quadraticConstSumPanLaw( fPan ); };
+	case LINEAR_CONST_K_NORM:
+		return linearConstKNormPanLaw;
+	case POLAR_CONST_K_NORM:
+		return polarConstKNormPanLaw;
+	case RATIO_CONST_K_NORM:
+		return ratioConstKNormPanLaw;
+	case QUADRATIC_CONST_K_NORM:
+		return quadraticConstKNormPanLaw;
+	default:
+		return nullptr;
 	}
 }
 
-void Sampler::handleTimelineOrTempoChange() {
-	if ( m_playingNotesQueue.size() == 0 ) {
-		return;
+void Sampler::updateMixerSnapshot( std::shared_ptr<Song> pSong ) {
+	Hydrogen* pHydrogen = Hydrogen::get_instance();
+	Preferences* pPref = Preferences::get_instance();
+
+	m_mixerSnapshot.bAnyInstrumentSoloed = isAnyInstrumentSoloed();
+	m_mixerSnapshot.bExportSessionActive = pHydrogen->getIsExportSessionActive();
+	m_mixerSnapshot.bSongMuted = pSong->getIsMuted();
+	m_mixerSnapshot.fSongVolume = pSong->getVolume();
+	m_mixerSnapshot.bJackTrackPostFader =
+		pPref->m_JackTrackOutputMode == Preferences::JackTrackOutputMode::postFader;
+	m_mixerSnapshot.bJackTrackPreFader =
+		pPref->m_JackTrackOutputMode == Preferences::JackTrackOutputMode::preFader;
+	m_mixerSnapshot.bJackTrackOuts = pPref->m_bJackTrackOuts;
+	m_mixerSnapshot.nSampleRate = pHydrogen->getAudioOutput()->getSampleRate();
+
+	m_mixerSnapshot.panLaw = getPanLawFunction( pSong->getPanLawType() );
+	if ( m_mixerSnapshot.panLaw == nullptr ) {
+		WARNINGLOG( "Unknown pan law type. Set default." );
+		pSong->setPanLawType( RATIO_STRAIGHT_POLYGONAL );
+		m_mixerSnapshot.panLaw = getPanLawFunction( RATIO_STRAIGHT_POLYGONAL );
 	}
-
-	for ( auto nnote : m_playingNotesQueue ) {
-		nnote->computeNoteStart();
+	m_mixerSnapshot.fPanLawKNorm = pSong->getPanLawKNorm();
+	m_mixerSnapshot.fTailThreshold = std::pow( 10.0f, pPref->m_fVoiceTailThreshold / 20.0f );
+
+	auto pComponents = pSong->getComponents();
+	auto& defaultComponent = m_mixerSnapshot.defaultComponent;
+	defaultComponent.pComponent = pComponents->empty() ? nullptr : pComponents->front();
+	if ( defaultComponent.pComponent != nullptr ) {
+		defaultComponent.fVolume = defaultComponent.pComponent->get_volume();
+		defaultComponent.bMuted = defaultComponent.pComponent->is_muted();
+	}
+	for ( auto& component : m_mixerSnapshot.components ) {
+		component = defaultComponent;
+	}
+	for ( const auto& pComponent : *pComponents ) {
+		const int nID = pComponent->get_id();
+		if ( nID >= 0 && nID < MAX_COMPONENTS ) {
+			auto& component = m_mixerSnapshot.components[ nID ];
+			component.pComponent = pComponent;
+			component.fVolume = pComponent->get_volume();
+			component.bMuted = pComponent->is_muted();
+		}
 	}
 }
 
@@ -431,7 +893,6 @@ void Sampler::handleSongSizeChange() {
 		nnote->set_position( std::max( nnote->get_position() +
 									   static_cast<long>(std::floor(pAudioEngine->getTickOffset())),
 									   static_cast<long>(0) ) );
-		nnote->computeNoteStart();
 		
 		// DEBUGLOG( QString( "new note: %1" )
 		// 		  .arg( nnote->toQString( "", true ) ) );
@@ -441,17 +902,26 @@ void Sampler::handleSongSizeChange() {
 
 //------------------------------------------------------------------
 
-/// Render a note
-/// Return false: the note is not ended
-/// Return true: the note is ended
-bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Song> pSong )
+void Sampler::prepareNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Song> pSong,
+						   NoteRender* pNoteRender, int nFirstComponent )
 {
 	assert( pSong );
 
+	pNoteRender->pNote = pNote;
+	pNoteRender->nInitialSilence = 0;
+	pNoteRender->nFirstComponent = nFirstComponent;
+	pNoteRender->nComponents = 0;
+	// The note is ended once all its components are.
+	pNoteRender->bEnded = true;
+	pNoteRender->bEnvelopeRendered = false;
+	pNoteRender->bEnvelopeEnded = false;
+	// No release within this cycle.
+	pNoteRender->nReleaseFrame = nBufferSize + 1;
+
 	auto pInstr = pNote->get_instrument();
 	if ( pInstr == nullptr ) {
 		ERRORLOG( "NULL instrument" );
-		return 1;
+		return;
 	}
 
 	long long nFrames;
@@ -471,8 +941,10 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 	// glitches when relocating transport during playback or starting
 	// transport while using realtime playback.
 	long long nInitialSilence = 0;
+	// The note start might have been invalidated by a change in
+	// tempo since the previous buffer.
+	const long long nNoteStartInFrames = pNote->updateNoteStart();
 	if ( ! pNote->isPartiallyRendered() ) {
-		long long nNoteStartInFrames = pNote->getNoteStart();
 
 		// DEBUGLOG(QString( "framepos: %1, note pos: %2, ticksize: %3, curr tick: %4, curr frame: %5, nNoteStartInFrames: %6 ")
 		// 		 .arg( nFrames).arg( pNote->get_position() ).arg( pAudioEngine->getTickSize() )
@@ -486,18 +958,37 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 			if ( nBufferSize < nInitialSilence ) {
 
 				if ( ! pNote->isPartiallyRendered() &&
-					 pNote->getNoteStart() > nFrames + nBufferSize ) {
+					 nNoteStartInFrames > nFrames + nBufferSize ) {
 					// this note is not valid. it's in the future...let's skip it....
-					ERRORLOG( QString( "Note pos in the future?? Current frames: %1, note frame pos: %2" ).arg( nFrames ).arg( pNote->getNoteStart() ) );
+					ERRORLOG( QString( "Note pos in the future?? Current frames: %1, note frame pos: %2" ).arg( nFrames ).arg( nNoteStartInFrames ) );
 
-					return true;
+					return;
 				}
 				// delay note execution
 				// DEBUGLOG("delayed");
-				return false;
+				pNoteRender->bEnded = false;
+				return;
 			}
 		}
 	}
+	pNoteRender->nInitialSilence = nInitialSilence;
+
+	// The release depends on the length of the note only. It is
+	// measured in frames of the envelope shared by all components,
+	// regardless of their sample rate and pitch.
+	if ( pNote->get_length() != -1 ) {
+		double fTickMismatch;
+		const long long nNoteLength =
+			pAudioEngine->computeFrameFromTick( pNote->get_position() +
+												pNote->get_length(), &fTickMismatch ) -
+			nNoteStartInFrames;
+		const long long nReleaseFrame =
+			nNoteLength - pNote->get_sampler_voice()->nEnvelopeFrames;
+		if ( nReleaseFrame <= static_cast<long long>( nBufferSize ) ) {
+			pNoteRender->nReleaseFrame =
+				static_cast<int>( std::max( nReleaseFrame, 0LL ) );
+		}
+	}
 
 	// new instrument and note pan interaction--------------------------
 	// notePan moves the RESULTANT pan in a smaller pan range centered at instrumentPan
@@ -522,48 +1013,48 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 	float fPan = pInstr->getPan() + pNote->getPan() * ( 1 - fabs( pInstr->getPan() ) );
 	
 	// Pass fPan to the Pan Law
-	float fPan_L = panLaw( fPan, pSong );
-	float fPan_R = panLaw( -fPan, pSong );
+	const auto& mixer = m_mixerSnapshot;
+	float fPan_L = mixer.panLaw( fPan, mixer.fPanLawKNorm );
+	float fPan_R = mixer.panLaw( -fPan, mixer.fPanLawKNorm );
 	//---------------------------------------------------------
 	auto components = pInstr->get_components();
-	bool nReturnValues[ components->size() ];
-
-	for(int i = 0; i < components->size(); i++){
-		nReturnValues[i] = false;
-	}
 
-	int nReturnValueIndex = 0;
 	int nAlreadySelectedLayer = -1;
 
 	for ( const auto& pCompo : *components ) {
-		nReturnValues[nReturnValueIndex] = false;
-		DrumkitComponent* pMainCompo = nullptr;
+		if ( nFirstComponent + pNoteRender->nComponents >= m_componentRenders.size() ) {
+			ERRORLOG( QString( "Instrument [%1] exceeds the maximum number of components" )
+					  .arg( pInstr->get_name() ) );
+			break;
+		}
+		ComponentRender* pRender =
+			&m_componentRenders[ nFirstComponent + pNoteRender->nComponents ];
+		pNoteRender->nComponents++;
+
+		pRender->bRender = false;
+		pRender->bEnded = false;
 
 		if( pNote->get_specific_compo_id() != -1 && pNote->get_specific_compo_id() != pCompo->get_drumkit_componentID() ) {
-			nReturnValueIndex++;
 			continue;
 		}
 
+		const MixerSnapshot::ComponentMix* pMainCompoMix;
 		if(		pInstr->is_preview_instrument()
 			||	pInstr->is_metronome_instrument()){
-			pMainCompo = pHydrogen->getSong()->getComponents()->front();
+			pMainCompoMix = &mixer.defaultComponent;
 		} else {
-			int nComponentID = pCompo->get_drumkit_componentID();
-			if ( nComponentID >= 0 ) {
-				pMainCompo = pHydrogen->getSong()->getComponent( nComponentID );
-			} else {
-				/* Invalid component found. This is possible on loading older or broken song files. */
-				pMainCompo = pHydrogen->getSong()->getComponents()->front();
-			}
+			/* Invalid components - possible on loading older or
+			 * broken song files - are mapped to the default one. */
+			pMainCompoMix = &getComponentMix( pCompo->get_drumkit_componentID() );
 		}
+		DrumkitComponent* pMainCompo = pMainCompoMix->pComponent;
 
 		assert(pMainCompo);
 
 		auto pSample = pNote->getSample( pCompo->get_drumkit_componentID(),
 										 nAlreadySelectedLayer );
 		if ( pSample == nullptr ) {
-			nReturnValues[nReturnValueIndex] = true;
-			nReturnValueIndex++;
+			pRender->bEnded = true;
 			continue;
 		}
 
@@ -579,8 +1070,7 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 
 		if( pSelectedLayer->SelectedLayer == -1 ) {
 			ERRORLOG( "Sample selection did not work." );
-			nReturnValues[nReturnValueIndex] = true;
-			nReturnValueIndex++;
+			pRender->bEnded = true;
 			continue;
 		}
 		auto pLayer = pCompo->get_layer( pSelectedLayer->SelectedLayer );
@@ -589,8 +1079,7 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 
 		if ( pSelectedLayer->SamplePosition >= pSample->get_frames() ) {
 			WARNINGLOG( "sample position out of bounds. The layer has been resized during note play?" );
-			nReturnValues[nReturnValueIndex] = true;
-			nReturnValueIndex++;
+			pRender->bEnded = true;
 			continue;
 		}
 
@@ -599,8 +1088,8 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 		float cost_track_L = 1.0f;
 		float cost_track_R = 1.0f;
 		
-		bool isMutedForExport = (pHydrogen->getIsExportSessionActive() && !pInstr->is_currently_exported());
-		bool isMutedBecauseOfSolo = (isAnyInstrumentSoloed() && !pInstr->is_soloed());
+		bool isMutedForExport = (mixer.bExportSessionActive && !pInstr->is_currently_exported());
+		bool isMutedBecauseOfSolo = (mixer.bAnyInstrumentSoloed && !pInstr->is_soloed());
 		
 		/*
 		 *  Is instrument muted?
@@ -611,10 +1100,10 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 		 *       but this instrument is not currently being exported.
 		 *   - if at least one instrument is soloed (but not this instrument)
 		 */
-		if ( isMutedForExport || pInstr->is_muted() || pSong->getIsMuted() || pMainCompo->is_muted() || isMutedBecauseOfSolo) {	
+		if ( isMutedForExport || pInstr->is_muted() || mixer.bSongMuted || pMainCompoMix->bMuted || isMutedBecauseOfSolo) {	
 			cost_L = 0.0;
 			cost_R = 0.0;
-			if ( Preferences::get_instance()->m_JackTrackOutputMode == Preferences::JackTrackOutputMode::postFader ) {
+			if ( mixer.bJackTrackPostFader ) {
 				cost_track_L = 0.0;
 				cost_track_R = 0.0;
 			}
@@ -631,30 +1120,30 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 			cost_L = cost_L * pInstr->get_gain();		// instrument gain
 
 			cost_L = cost_L * pCompo->get_gain();		// Component gain
-			cost_L = cost_L * pMainCompo->get_volume(); // Component volument
+			cost_L = cost_L * pMainCompoMix->fVolume; // Component volument
 
 			cost_L = cost_L * pInstr->get_volume();		// instrument volume
-			if ( Preferences::get_instance()->m_JackTrackOutputMode == Preferences::JackTrackOutputMode::postFader ) {
+			if ( mixer.bJackTrackPostFader ) {
 				cost_track_L = cost_L * 2;
 			}
-			cost_L = cost_L * pSong->getVolume();	// song volume
+			cost_L = cost_L * mixer.fSongVolume;	// song volume
 
 			cost_R *= fPan_R;							// pan
 			cost_R = cost_R * fLayerGain;				// layer gain
 			cost_R = cost_R * pInstr->get_gain();		// instrument gain
 
 			cost_R = cost_R * pCompo->get_gain();		// Component gain
-			cost_R = cost_R * pMainCompo->get_volume(); // Component volument
+			cost_R = cost_R * pMainCompoMix->fVolume; // Component volument
 
 			cost_R = cost_R * pInstr->get_volume();		// instrument volume
-			if ( Preferences::get_instance()->m_JackTrackOutputMode == Preferences::JackTrackOutputMode::postFader ) {
+			if ( mixer.bJackTrackPostFader ) {
 				cost_track_R = cost_R * 2;
 			}
-			cost_R = cost_R * pSong->getVolume();	// song pan
+			cost_R = cost_R * mixer.fSongVolume;	// song pan
 		}
 
 		// direct track outputs only use velocity
-		if ( Preferences::get_instance()->m_JackTrackOutputMode == Preferences::JackTrackOutputMode::preFader ) {
+		if ( mixer.bJackTrackPreFader ) {
 			cost_track_L = cost_track_L * pNote->get_velocity();
 			cost_track_L = cost_track_L * fLayerGain;
 			cost_track_R = cost_track_L;
@@ -674,21 +1163,74 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 			}
 		}
 
-		if ( fTotalPitch == 0.0 &&
-			 pSample->get_sample_rate() == pAudioDriver->getSampleRate() ) { // NO RESAMPLE
-			nReturnValues[nReturnValueIndex] = renderNoteNoResample( pSample, pNote, pSelectedLayer, pCompo, pMainCompo, nBufferSize, nInitialSilence, cost_L, cost_R, cost_track_L, cost_track_R, pSong );
-		} else { // RESAMPLE
-			nReturnValues[nReturnValueIndex] = renderNoteResample( pSample, pNote, pSelectedLayer, pCompo, pMainCompo, nBufferSize, nInitialSilence, cost_L, cost_R, cost_track_L, cost_track_R, fLayerPitch, pSong );
+		pRender->bResample = ! ( fTotalPitch == 0.0 &&
+								 pSample->get_sample_rate() == mixer.nSampleRate );
+
+		pRender->pTrackOut_L = nullptr;
+		pRender->pTrackOut_R = nullptr;
+#ifdef H2CORE_HAVE_JACK
+		if ( mixer.bJackTrackOuts ) {
+			auto pJackAudioDriver = dynamic_cast<JackAudioDriver*>( pAudioDriver );
+			if( pJackAudioDriver ) {
+				pRender->pTrackOut_L = pJackAudioDriver->getTrackOut_L( pInstr, pCompo );
+				pRender->pTrackOut_R = pJackAudioDriver->getTrackOut_R( pInstr, pCompo );
+			}
 		}
+#endif
 
-		nReturnValueIndex++;
+		pRender->pSample = pSample;
+		pRender->pSelectedLayerInfo = pSelectedLayer;
+		pRender->pDrumCompo = pMainCompo;
+		pRender->cost_L = cost_L;
+		pRender->cost_R = cost_R;
+		pRender->cost_track_L = cost_track_L;
+		pRender->cost_track_R = cost_track_R;
+		pRender->fLayerPitch = fLayerPitch;
+		pRender->bRender = true;
 	}
-	for ( unsigned i = 0 ; i < components->size() ; i++ ) {
-		if ( !nReturnValues[i] ) {
-			return false;
-		}
+}
+
+void Sampler::renderComponent( NoteRender* pNoteRender, int nComponent,
+							   unsigned nBufferSize, float* pScratch )
+{
+	auto pRender = &m_componentRenders[ pNoteRender->nFirstComponent + nComponent ];
+	if ( ! pRender->bRender ) {
+		return;
+	}
+
+	if ( pRender->bResample ) {
+		pRender->bEnded = renderNoteResample( pNoteRender, pRender, nBufferSize,
+											  pScratch );
+	} else {
+		pRender->bEnded = renderNoteNoResample( pNoteRender, pRender, nBufferSize,
+												pScratch );
+	}
+}
+
+const float* Sampler::renderEnvelope( NoteRender* pNoteRender, int nBufferSize )
+{
+	if ( ! pNoteRender->bEnvelopeRendered ) {
+		const int nFrames = nBufferSize - pNoteRender->nInitialSilence;
+		float* pEnvelope = &pNoteRender->pEnvelope[ pNoteRender->nInitialSilence ];
+		std::fill( pEnvelope, pEnvelope + nFrames, 1.0f );
+		pNoteRender->bEnvelopeEnded = pNoteRender->pNote->get_adsr()->
+			applyADSR( pEnvelope, nullptr, nFrames, pNoteRender->nReleaseFrame, 1 );
+		pNoteRender->pNote->get_sampler_voice()->nEnvelopeFrames += nFrames;
+		pNoteRender->bEnvelopeRendered = true;
+	}
+	return pNoteRender->pEnvelope;
+}
+
+void Sampler::renderNoteJob( void* pContext, int nJob )
+{
+	auto pSampler = static_cast<Sampler*>( pContext );
+	auto pNoteRender = &pSampler->m_noteRenders[ nJob ];
+
+	for ( int ii = 0; ii < pNoteRender->nComponents; ++ii ) {
+		const int nSlot = pNoteRender->nFirstComponent + ii;
+		pSampler->renderComponent( pNoteRender, ii, pSampler->m_nRenderBufferSize,
+								   &pSampler->m_pRenderBuffers[ nSlot * 4 * MAX_BUFFER_SIZE ] );
 	}
-	return true;
 }
 
 bool Sampler::processPlaybackTrack(int nBufferSize)
@@ -715,14 +1257,13 @@ bool Sampler::processPlaybackTrack(int nBufferSize)
 	float fVal_L;
 	float fVal_R;
 
-	auto pSample_data_L = pSample->get_data_l();
-	auto pSample_data_R = pSample->get_data_r();
-	
 	float fInstrPeak_L = m_pPlaybackTrackInstrument->get_peak_l(); // this value will be reset to 0 by the mixer..
 	float fInstrPeak_R = m_pPlaybackTrackInstrument->get_peak_r(); // this value will be reset to 0 by the mixer..
 
 	int nAvail_bytes = 0;
 	int	nInitialBufferPos = 0;
+	// Position reached at the end of this cycle.
+	int nStreamPosition = 0;
 
 	if(pSample->get_sample_rate() == pAudioDriver->getSampleRate()){
 		//No resampling	
@@ -746,8 +1287,8 @@ bool Sampler::processPlaybackTrack(int nBufferSize)
 		}
 	
 		for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
-			fVal_L = pSample_data_L[ nSamplePos ];
-			fVal_R = pSample_data_R[ nSamplePos ];
+			fVal_L = pSample->get_value_l( nSamplePos );
+			fVal_R = pSample->get_value_r( nSamplePos );
 	
 			fVal_L = fVal_L * 1.0f * pSong->getPlaybackTrackVolume(); //costr
 			fVal_R = fVal_R * 1.0f * pSong->getPlaybackTrackVolume(); //cost l
@@ -767,6 +1308,7 @@ bool Sampler::processPlaybackTrack(int nBufferSize)
 			
 			++nSamplePos;
 		}
+		nStreamPosition = nSamplePos;
 	} else {
 		//Perform resampling
 		double	fSamplePos = 0;
@@ -806,31 +1348,31 @@ bool Sampler::processPlaybackTrack(int nBufferSize)
 						last_l = 0.0;
 						last_r = 0.0;
 					} else {
-						last_l =  pSample_data_L[nSamplePos + 2];
-						last_r =  pSample_data_R[nSamplePos + 2];
+						last_l =  pSample->get_value_l( nSamplePos + 2 );
+						last_r =  pSample->get_value_r( nSamplePos + 2 );
 					}
 	
 					switch( m_interpolateMode ){
 	
 						case Interpolation::InterpolateMode::Linear:
-								fVal_L = pSample_data_L[nSamplePos] * (1 - fDiff ) + pSample_data_L[nSamplePos + 1] * fDiff;
-								fVal_R = pSample_data_R[nSamplePos] * (1 - fDiff ) + pSample_data_R[nSamplePos + 1] * fDiff;
+								fVal_L = pSample->get_value_l( nSamplePos ) * (1 - fDiff ) + pSample->get_value_l( nSamplePos + 1 ) * fDiff;
+								fVal_R = pSample->get_value_r( nSamplePos ) * (1 - fDiff ) + pSample->get_value_r( nSamplePos + 1 ) * fDiff;
 								break;
 						case Interpolation::InterpolateMode::Cosine:
-								fVal_L = Interpolation::cosine_Interpolate( pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], fDiff);
-								fVal_R = Interpolation::cosine_Interpolate( pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], fDiff);
+								fVal_L = Interpolation::cosine_Interpolate( pSample->get_value_l( nSamplePos ), pSample->get_value_l( nSamplePos + 1 ), fDiff);
+								fVal_R = Interpolation::cosine_Interpolate( pSample->get_value_r( nSamplePos ), pSample->get_value_r( nSamplePos + 1 ), fDiff);
 								break;
 						case Interpolation::InterpolateMode::Third:
-								fVal_L = Interpolation::third_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
-								fVal_R = Interpolation::third_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
+								fVal_L = Interpolation::third_Interpolate( pSample->get_value_l( nSamplePos -1 ), pSample->get_value_l( nSamplePos ), pSample->get_value_l( nSamplePos + 1 ), last_l, fDiff);
+								fVal_R = Interpolation::third_Interpolate( pSample->get_value_r( nSamplePos -1 ), pSample->get_value_r( nSamplePos ), pSample->get_value_r( nSamplePos + 1 ), last_r, fDiff);
 								break;
 						case Interpolation::InterpolateMode::Cubic:
-								fVal_L = Interpolation::cubic_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
-								fVal_R = Interpolation::cubic_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
+								fVal_L = Interpolation::cubic_Interpolate( pSample->get_value_l( nSamplePos -1 ), pSample->get_value_l( nSamplePos ), pSample->get_value_l( nSamplePos + 1 ), last_l, fDiff);
+								fVal_R = Interpolation::cubic_Interpolate( pSample->get_value_r( nSamplePos -1 ), pSample->get_value_r( nSamplePos ), pSample->get_value_r( nSamplePos + 1 ), last_r, fDiff);
 								break;
 						case Interpolation::InterpolateMode::Hermite:
-								fVal_L = Interpolation::hermite_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
-								fVal_R = Interpolation::hermite_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
+								fVal_L = Interpolation::hermite_Interpolate( pSample->get_value_l( nSamplePos -1 ), pSample->get_value_l( nSamplePos ), pSample->get_value_l( nSamplePos + 1 ), last_l, fDiff);
+								fVal_R = Interpolation::hermite_Interpolate( pSample->get_value_r( nSamplePos -1 ), pSample->get_value_r( nSamplePos ), pSample->get_value_r( nSamplePos + 1 ), last_r, fDiff);
 								break;
 					}
 			}
@@ -848,7 +1390,11 @@ bool Sampler::processPlaybackTrack(int nBufferSize)
 
 			fSamplePos += fStep;
 		} //for
+		nStreamPosition = static_cast<int>( fSamplePos );
 	}
+
+	m_pSampleStreamer->update( pSample, nStreamPosition,
+							   &m_nPlaybackTrackPrefetchedFrame );
 	
 	m_pPlaybackTrackInstrument->set_peak_l( fInstrPeak_L );
 	m_pPlaybackTrackInstrument->set_peak_r( fInstrPeak_R );
@@ -856,35 +1402,146 @@ bool Sampler::processPlaybackTrack(int nBufferSize)
 	return true;
 }
 
-bool Sampler::renderNoteNoResample(
-	std::shared_ptr<Sample> pSample,
-	Note *pNote,
-	std::shared_ptr<SelectedLayerInfo> pSelectedLayerInfo,
-	std::shared_ptr<InstrumentComponent> pCompo,
-	DrumkitComponent *pDrumCompo,
-	int nBufferSize,
-	int nInitialSilence,
-	float cost_L,
-	float cost_R,
-	float cost_track_L,
-	float cost_track_R,
-	std::shared_ptr<Song> pSong
-)
+/**
+ * Mixes the frames [@a nFrom, @a nTo) of a rendered note into the
+ * JACK per track outputs, the DrumkitComponent, and the main output
+ * of the #Sampler and updates the peaks of the instrument.
+ *
+ * The whole block is handled by the VectorMath kernels at once
+ * instead of frame by frame.
+ */
+static void mixRenderedNote( const float* pBuffer_L, const float* pBuffer_R,
+							 int nFrom, int nTo,
+							 float cost_L, float cost_R,
+							 float cost_track_L, float cost_track_R,
+							 float* pTrackOutL, float* pTrackOutR,
+							 DrumkitComponent* pDrumCompo,
+							 float* pMainOut_L, float* pMainOut_R,
+							 float* pInstrPeak_L, float* pInstrPeak_R )
 {
-	auto pAudioDriver = Hydrogen::get_instance()->getAudioOutput();
-	auto pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
-	auto pInstrument = pNote->get_instrument();
-	bool retValue = true; // the note is ended
+	const int nFrames = nTo - nFrom;
+	if ( nFrames <= 0 ) {
+		return;
+	}
 
-	int nNoteLength = -1;
-	if ( pNote->get_length() != -1 ) {
-		double fTickMismatch;
-		nNoteLength =
-			pAudioEngine->computeFrameFromTick( pNote->get_position() +
-												pNote->get_length(), &fTickMismatch ) -
-			pNote->getNoteStart();
+	pBuffer_L += nFrom;
+	pBuffer_R += nFrom;
+
+	if ( pTrackOutL != nullptr ) {
+		VectorMath::addScaled( pTrackOutL + nFrom, pBuffer_L, cost_track_L, nFrames );
+	}
+	if ( pTrackOutR != nullptr ) {
+		VectorMath::addScaled( pTrackOutR + nFrom, pBuffer_R, cost_track_R, nFrames );
 	}
 
+	// update instr peak
+	*pInstrPeak_L = VectorMath::peakScaled( pBuffer_L, cost_L, nFrames, *pInstrPeak_L );
+	*pInstrPeak_R = VectorMath::peakScaled( pBuffer_R, cost_R, nFrames, *pInstrPeak_R );
+
+	pDrumCompo->add_outs( pBuffer_L, pBuffer_R, cost_L, cost_R, nFrom, nFrames );
+
+	// to main mix
+	VectorMath::addScaled( pMainOut_L + nFrom, pBuffer_L, cost_L, nFrames );
+	VectorMath::addScaled( pMainOut_R + nFrom, pBuffer_R, cost_R, nFrames );
+}
+
+void Sampler::mixComponent( NoteRender* pNoteRender, int nComponent )
+{
+	auto pRender = &m_componentRenders[ pNoteRender->nFirstComponent + nComponent ];
+	if ( ! pRender->bRender ) {
+		return;
+	}
+
+	auto pInstrument = pNoteRender->pNote->get_instrument();
+
+	float fInstrPeak_L = pInstrument->get_peak_l(); // this value will be reset to 0 by the mixer..
+	float fInstrPeak_R = pInstrument->get_peak_r(); // this value will be reset to 0 by the mixer..
+
+	// Mix rendered sample buffer to track and mixer output
+	mixRenderedNote( pRender->pMix_L, pRender->pMix_R,
+					 pRender->nMixFrom, pRender->nMixTo,
+					 pRender->cost_L, pRender->cost_R,
+					 pRender->cost_track_L, pRender->cost_track_R,
+					 pRender->pTrackOut_L, pRender->pTrackOut_R,
+					 pRender->pDrumCompo, m_pMainOut_L, m_pMainOut_R,
+					 &fInstrPeak_L, &fInstrPeak_R );
+
+	pInstrument->set_peak_l( fInstrPeak_L );
+	pInstrument->set_peak_r( fInstrPeak_R );
+
+#ifdef H2CORE_HAVE_LADSPA
+	// LADSPA
+	if ( ! pInstrument->is_muted() && ! m_mixerSnapshot.bSongMuted ) {
+		float masterVol = m_mixerSnapshot.fSongVolume;
+		for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
+			LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
+
+			float fLevel = pInstrument->get_fx_level( nFX );
+
+			if ( ( pFX ) && ( fLevel != 0.0 ) ) {
+				fLevel = fLevel * pFX->getVolume();
+				float *pBuf_L = pFX->m_pBuffer_L;
+				float *pBuf_R = pFX->m_pBuffer_R;
+
+				float fFXCost_L = fLevel * masterVol;
+				float fFXCost_R = fLevel * masterVol;
+
+				VectorMath::addScaled( &pBuf_L[ pRender->nMixFrom ], pRender->pSend_L,
+									   fFXCost_L, pRender->nSendFrames );
+				VectorMath::addScaled( &pBuf_R[ pRender->nMixFrom ], pRender->pSend_R,
+									   fFXCost_R, pRender->nSendFrames );
+			}
+		}
+	}
+	// ~LADSPA
+#endif
+
+	if ( ! pRender->bEnded ) {
+		m_pSampleStreamer->update( pRender->pSample,
+								   static_cast<int>( pRender->pSelectedLayerInfo->SamplePosition ),
+								   &pRender->pSelectedLayerInfo->nPrefetchedFrame );
+	}
+
+	// Do not keep the sample alive till the next cycle.
+	pRender->pSample = nullptr;
+	pRender->pSelectedLayerInfo = nullptr;
+}
+
+/** Converts @a nFrames frames of @a pSrc stored as @a T into
+ * floats. */
+template < typename T >
+static void convertValues( const void* pSrc, float* __restrict__ pDst, int nFrames )
+{
+	const T* __restrict__ pValues = static_cast<const T*>( pSrc );
+	for ( int i = 0; i < nFrames; ++i ) {
+		pDst[ i ] = Sample::to_float( pValues[ i ] );
+	}
+}
+
+/** Converts the frames [@a nFrame, @a nFrame + @a nFrames) of a
+ * compactly stored channel @a pData of @a format into @a pDst. */
+static void convertFrames( Sample::Format format, const void* pData, int nFrame,
+						   float* pDst, int nFrames )
+{
+	if ( format == Sample::Format::Int16 ) {
+		convertValues<int16_t>( static_cast<const int16_t*>( pData ) + nFrame,
+								pDst, nFrames );
+	} else {
+		convertValues<Sample::PackedInt24>(
+			static_cast<const Sample::PackedInt24*>( pData ) + nFrame, pDst, nFrames );
+	}
+}
+
+bool Sampler::renderNoteNoResample( NoteRender* pNoteRender, ComponentRender* pRender,
+									int nBufferSize, float* pScratch )
+{
+	auto pNote = pNoteRender->pNote;
+	const int nInitialSilence = pNoteRender->nInitialSilence;
+	auto pInstrument = pNote->get_instrument();
+	auto pSample = pRender->pSample;
+	auto pSelectedLayerInfo = pRender->pSelectedLayerInfo;
+	bool retValue = true; // the note is ended
+
 	int nAvail_bytes = pSample->get_frames() - ( int )pSelectedLayerInfo->SamplePosition;	// verifico il numero di frame disponibili ancora da eseguire
 
 	if ( nAvail_bytes > nBufferSize - nInitialSilence ) {	// il sample e' piu' grande del buffersize
@@ -904,185 +1561,285 @@ bool Sampler::renderNoteNoResample(
 	auto pSample_data_L = pSample->get_data_l();
 	auto pSample_data_R = pSample->get_data_r();
 
-	float fInstrPeak_L = pInstrument->get_peak_l(); // this value will be reset to 0 by the mixer..
-	float fInstrPeak_R = pInstrument->get_peak_r(); // this value will be reset to 0 by the mixer..
-
-	auto pADSR = pNote->get_adsr();
-	float fADSRValue;
-	float fVal_L;
-	float fVal_R;
-
-#ifdef H2CORE_HAVE_JACK
-	float *		pTrackOutL = nullptr;
-	float *		pTrackOutR = nullptr;
-
-	if ( Preferences::get_instance()->m_bJackTrackOuts ) {
-		auto pJackAudioDriver = dynamic_cast<JackAudioDriver*>( pAudioDriver );
-		if( pJackAudioDriver ) {
-			pTrackOutL = pJackAudioDriver->getTrackOut_L( pInstrument, pCompo );
-			pTrackOutR = pJackAudioDriver->getTrackOut_R( pInstrument, pCompo );
-		}
-	}
-#endif
-
-	float buffer_L[ MAX_BUFFER_SIZE ];
-	float buffer_R[ MAX_BUFFER_SIZE ];
-	int nNoteEnd;
-	if ( nNoteLength == -1) {
-		nNoteEnd = pSelectedLayerInfo->SamplePosition + nTimes + 1;
-	} else {
-		nNoteEnd = nNoteLength - pSelectedLayerInfo->SamplePosition;
-	}
+	float* buffer_L = pScratch;
+	float* buffer_R = pScratch + MAX_BUFFER_SIZE;
 
 	int nSampleFrames = std::min( nTimes,
 								  ( nInitialSilence + pSample->get_frames()
 								    - ( int )pSelectedLayerInfo->SamplePosition ) );
-	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nSampleFrames; ++nBufferPos ) {
-		buffer_L[ nBufferPos ] = pSample_data_L[ nSamplePos ];
-		buffer_R[ nBufferPos ] = pSample_data_R[ nSamplePos ];
-		nSamplePos++;
+	// Mono samples are rendered into the left buffer only and
+	// panned while mixing.
+	const bool bMono = pSample->is_mono();
+	const Sample::Format format = pSample->get_format();
+	// The sends of compactly stored samples are fed using the
+	// converted frames.
+	float* send_L = pScratch + 2 * MAX_BUFFER_SIZE;
+	float* send_R = bMono ? send_L : pScratch + 3 * MAX_BUFFER_SIZE;
+	if ( nSampleFrames > nInitialBufferPos ) {
+		const int nCopyFrames = nSampleFrames - nInitialBufferPos;
+		if ( format == Sample::Format::Float ) {
+			memcpy( &buffer_L[ nInitialBufferPos ], &pSample_data_L[ nSamplePos ],
+					nCopyFrames * sizeof( float ) );
+			if ( ! bMono ) {
+				memcpy( &buffer_R[ nInitialBufferPos ], &pSample_data_R[ nSamplePos ],
+						nCopyFrames * sizeof( float ) );
+			}
+		} else {
+			convertFrames( format, pSample->get_pcm_l(), nSamplePos,
+						   &send_L[ nInitialBufferPos ], nCopyFrames );
+			memcpy( &buffer_L[ nInitialBufferPos ], &send_L[ nInitialBufferPos ],
+					nCopyFrames * sizeof( float ) );
+			if ( ! bMono ) {
+				convertFrames( format, pSample->get_pcm_r(), nSamplePos,
+							   &send_R[ nInitialBufferPos ], nCopyFrames );
+				memcpy( &buffer_R[ nInitialBufferPos ], &send_R[ nInitialBufferPos ],
+						nCopyFrames * sizeof( float ) );
+			}
+		}
 	}
-	for ( int nBufferPos = nSampleFrames; nBufferPos < nTimes; ++nBufferPos ) {
+	for ( int nBufferPos = std::max( nSampleFrames, nInitialBufferPos );
+		  nBufferPos < nTimes; ++nBufferPos ) {
 		buffer_L[ nBufferPos ] = buffer_R[ nBufferPos ] = 0.0;
 	}
 
 
-	retValue = pADSR->applyADSR( buffer_L, buffer_R, nTimes, nNoteEnd, 1 );
-	bool bFilterIsActive = pInstrument->is_filter_active();
-	// Low pass resonant filter
-
-	if ( bFilterIsActive ) {
-		for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
+	const float* pEnvelope = renderEnvelope( pNoteRender, nBufferSize );
+	if ( bMono ) {
+		VectorMath::multiply( &buffer_L[ nInitialBufferPos ], &pEnvelope[ nInitialBufferPos ],
+							  nTimes - nInitialBufferPos );
+	} else {
+		VectorMath::multiplyStereo( &buffer_L[ nInitialBufferPos ], &buffer_R[ nInitialBufferPos ],
+									&pEnvelope[ nInitialBufferPos ], nTimes - nInitialBufferPos );
+	}
+	retValue = pNoteRender->bEnvelopeEnded;
 
-			fVal_L = buffer_L[ nBufferPos ];
-			fVal_R = buffer_R[ nBufferPos ];
+	pRender->pMix_L = buffer_L;
+	pRender->pMix_R = bMono ? buffer_L : buffer_R;
+	// Low pass resonant filter
+	if ( pInstrument->is_filter_active() ) {
+		if ( bMono ) {
+			// Both channels have a filter state of their own.
+			memcpy( &buffer_R[ nInitialBufferPos ], &buffer_L[ nInitialBufferPos ],
+					( nTimes - nInitialBufferPos ) * sizeof( float ) );
+			pRender->pMix_R = buffer_R;
+		}
+		pNote->applyFilter( &buffer_L[ nInitialBufferPos ], &buffer_R[ nInitialBufferPos ],
+							&buffer_L[ nInitialBufferPos ], &buffer_R[ nInitialBufferPos ],
+							nTimes - nInitialBufferPos );
+	}
 
-			pNote->compute_lr_values( &fVal_L, &fVal_R );
+	pRender->nMixFrom = nInitialBufferPos;
+	pRender->nMixTo = nTimes;
 
-			buffer_L[ nBufferPos ] = fVal_L;
-			buffer_R[ nBufferPos ] = fVal_R;
+	// The LADSPA sends are fed using the raw sample. While the filter
+	// is ringing there might be fewer sample frames left than
+	// rendered ones.
+	if ( format == Sample::Format::Float ) {
+		pRender->pSend_L = &pSample_data_L[ nInitialSamplePos ];
+		pRender->pSend_R = &pSample_data_R[ nInitialSamplePos ];
+	} else {
+		pRender->pSend_L = &send_L[ nInitialBufferPos ];
+		pRender->pSend_R = &send_R[ nInitialBufferPos ];
+	}
+	pRender->nSendFrames = std::min( nAvail_bytes,
+									 pSample->get_frames() - nInitialSamplePos );
 
-		}
+	if ( pInstrument->is_filter_active() && pNote->filter_sustain() ) {
+		// Note is still ringing, do not end.
+		retValue = false;
 	}
 
-	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
+	const bool bSampleDone =
+		nInitialSamplePos + nAvail_bytes >= pSample->get_frames();
+	if ( ! retValue && isTailSilent( pNote, pRender, bSampleDone ) ) {
+		retValue = true;
+	}
 
-		fVal_L = buffer_L[ nBufferPos ];
-		fVal_R = buffer_R[ nBufferPos ];
+	pSelectedLayerInfo->SamplePosition += nAvail_bytes;
 
+	return retValue;
+}
 
-#ifdef H2CORE_HAVE_JACK
-		if(  pTrackOutL ) {
-			 pTrackOutL[nBufferPos] += fVal_L * cost_track_L;
-		}
-		if( pTrackOutR ) {
-			pTrackOutR[nBufferPos] += fVal_R * cost_track_R;
+/**
+ * Renders a single resampled frame at @a fSamplePos while checking
+ * each of the four support points against the boundaries of the
+ * sample. Frames off the beginning or end of the sample are treated
+ * as silence.
+ *
+ * With @a bStereo set to false only the left channel is rendered.
+ */
+template < Interpolation::InterpolateMode mode, bool bStereo, typename T >
+static inline void resampleFrameChecked( const T* pSample_data_L,
+										 const T* pSample_data_R,
+										 int nSampleFrames, double fSamplePos,
+										 float* pVal_L, float* pVal_R )
+{
+	int nSamplePos = ( int )fSamplePos;
+	double fDiff = fSamplePos - nSamplePos;
+	if ( ( nSamplePos - 1 ) >= nSampleFrames ) {
+		//we reach the last audioframe.
+		//set this last frame to zero do nothing wrong.
+		*pVal_L = 0.0;
+		if ( bStereo ) {
+			*pVal_R = 0.0;
 		}
-#endif
-
-		fVal_L = fVal_L * cost_L;
-		fVal_R = fVal_R * cost_R;
+		return;
+	}
 
-		// update instr peak
-		if ( fVal_L > fInstrPeak_L ) {
-			fInstrPeak_L = fVal_L;
+	float l0, l1, l2, l3, r0, r1, r2, r3;
+	l0 = l1 = l2 = l3 = r0 = r1 = r2 = r3 = 0.0;
+	if ( nSamplePos >= 1 ) {
+		l0 = Sample::to_float( pSample_data_L[ nSamplePos-1 ] );
+		if ( bStereo ) {
+			r0 = Sample::to_float( pSample_data_R[ nSamplePos-1 ] );
+		}
+	}
+	// Each successive frame may be past the end of the sample so check individually.
+	if ( nSamplePos < nSampleFrames ) {
+		l1 = Sample::to_float( pSample_data_L[ nSamplePos ] );
+		if ( bStereo ) {
+			r1 = Sample::to_float( pSample_data_R[ nSamplePos ] );
 		}
-		if ( fVal_R > fInstrPeak_R ) {
-			fInstrPeak_R = fVal_R;
+		if ( nSamplePos+1 < nSampleFrames ) {
+			l2 = Sample::to_float( pSample_data_L[ nSamplePos+1 ] );
+			if ( bStereo ) {
+				r2 = Sample::to_float( pSample_data_R[ nSamplePos+1 ] );
+			}
+			if ( nSamplePos+2 < nSampleFrames ) {
+				l3 = Sample::to_float( pSample_data_L[ nSamplePos+2 ] );
+				if ( bStereo ) {
+					r3 = Sample::to_float( pSample_data_R[ nSamplePos+2 ] );
+				}
+			}
 		}
-
-		pDrumCompo->set_outs( nBufferPos, fVal_L, fVal_R );
-
-		// to main mix
-		m_pMainOut_L[nBufferPos] += fVal_L;
-		m_pMainOut_R[nBufferPos] += fVal_R;
-
 	}
-	if ( pInstrument->is_filter_active() && pNote->filter_sustain() ) {
-		// Note is still ringing, do not end.
-		retValue = false;
+
+	*pVal_L = Interpolation::interpolate<mode>( l0, l1, l2, l3, fDiff );
+	if ( bStereo ) {
+		*pVal_R = Interpolation::interpolate<mode>( r0, r1, r2, r3, fDiff );
 	}
+}
 
-	pSelectedLayerInfo->SamplePosition += nAvail_bytes;
-	pInstrument->set_peak_l( fInstrPeak_L );
-	pInstrument->set_peak_r( fInstrPeak_R );
+/**
+ * Resamples the stereo sample @a pSample_data_L / @a
+ * pSample_data_R into the frames [@a nBufferPos, @a nTimes) of @a
+ * pBuffer_L and @a pBuffer_R.
+ *
+ * Only the frames at the very beginning and end of the sample,
+ * for which some of the four support points of the interpolation
+ * are missing, are rendered using bounds checking. In between the
+ * kernel runs without any branches and is a candidate for
+ * auto-vectorisation.
+ *
+ * Mono samples are rendered with @a bStereo set to false. Only @a
+ * pSample_data_L and @a pBuffer_L are used in that case. Frames
+ * stored compactly are converted to float using Sample::to_float()
+ * right before being interpolated.
+ *
+ * \return Sample position following the last rendered frame.
+ */
+template < Interpolation::InterpolateMode mode, bool bStereo, typename T >
+static double resample( const T* __restrict__ pSample_data_L,
+						const T* __restrict__ pSample_data_R,
+						int nSampleFrames,
+						float* __restrict__ pBuffer_L,
+						float* __restrict__ pBuffer_R,
+						int nBufferPos, int nTimes,
+						double fSamplePos, float fStep )
+{
+	// Frames requiring a support point before the start of the sample.
+	for ( ; nBufferPos < nTimes && fSamplePos < 1; ++nBufferPos ) {
+		resampleFrameChecked<mode, bStereo, T>( pSample_data_L, pSample_data_R, nSampleFrames,
+									fSamplePos, &pBuffer_L[ nBufferPos ],
+									&pBuffer_R[ nBufferPos ] );
+		fSamplePos += fStep;
+	}
 
+	// All four support points are within the sample as long as
+	// fSamplePos < nSampleFrames - 2. A safety margin of two frames
+	// accounts for rounding errors accumulating in fSamplePos.
+	double fInBoundsFrames =
+		std::floor( ( nSampleFrames - 2 - fSamplePos ) / fStep ) - 1;
+	int nInBoundsEnd = nBufferPos;
+	if ( fInBoundsFrames > 0 ) {
+		nInBoundsEnd += static_cast<int>(
+			std::min( fInBoundsFrames, static_cast<double>( nTimes - nBufferPos ) ) );
+	}
 
-#ifdef H2CORE_HAVE_LADSPA
-	// LADSPA
-	// change the below return logic if you add code after that ifdef
-	if (pInstrument->is_muted() || pSong->getIsMuted() ) return retValue;
-	float masterVol =  pSong->getVolume();
-	for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
-		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
-
-		float fLevel = pInstrument->get_fx_level( nFX );
-
-		if ( ( pFX ) && ( fLevel != 0.0 ) ) {
-			fLevel = fLevel * pFX->getVolume();
-			float *pBuf_L = pFX->m_pBuffer_L;
-			float *pBuf_R = pFX->m_pBuffer_R;
-
-			float fFXCost_L = fLevel * masterVol;
-			float fFXCost_R = fLevel * masterVol;
-
-			int nBufferPos = nInitialBufferPos;
-			int nSamplePos = nInitialSamplePos;
-			for ( int i = 0; i < nAvail_bytes; ++i ) {
-				pBuf_L[ nBufferPos ] += pSample_data_L[ nSamplePos ] * fFXCost_L;
-				pBuf_R[ nBufferPos ] += pSample_data_R[ nSamplePos ] * fFXCost_R;
-				++nSamplePos;
-				++nBufferPos;
-			}
+	for ( ; nBufferPos < nInBoundsEnd; ++nBufferPos ) {
+		int nSamplePos = ( int )fSamplePos;
+		double fDiff = fSamplePos - nSamplePos;
+		pBuffer_L[ nBufferPos ] =
+			Interpolation::interpolate<mode>( Sample::to_float( pSample_data_L[ nSamplePos-1 ] ),
+											  Sample::to_float( pSample_data_L[ nSamplePos ] ),
+											  Sample::to_float( pSample_data_L[ nSamplePos+1 ] ),
+											  Sample::to_float( pSample_data_L[ nSamplePos+2 ] ), fDiff );
+		if ( bStereo ) {
+			pBuffer_R[ nBufferPos ] =
+				Interpolation::interpolate<mode>( Sample::to_float( pSample_data_R[ nSamplePos-1 ] ),
+												  Sample::to_float( pSample_data_R[ nSamplePos ] ),
+												  Sample::to_float( pSample_data_R[ nSamplePos+1 ] ),
+												  Sample::to_float( pSample_data_R[ nSamplePos+2 ] ), fDiff );
 		}
+		fSamplePos += fStep;
 	}
-	// ~LADSPA
-#endif
 
-	return retValue;
+	// Frames close to or beyond the end of the sample.
+	for ( ; nBufferPos < nTimes; ++nBufferPos ) {
+		resampleFrameChecked<mode, bStereo, T>( pSample_data_L, pSample_data_R, nSampleFrames,
+									fSamplePos, &pBuffer_L[ nBufferPos ],
+									&pBuffer_R[ nBufferPos ] );
+		fSamplePos += fStep;
+	}
+
+	return fSamplePos;
 }
 
-bool Sampler::renderNoteResample(
-	std::shared_ptr<Sample> pSample,
-	Note *pNote,
-	std::shared_ptr<SelectedLayerInfo> pSelectedLayerInfo,
-	std::shared_ptr<InstrumentComponent> pCompo,
-	DrumkitComponent *pDrumCompo,
-	int nBufferSize,
-	int nInitialSilence,
-	float cost_L,
-	float cost_R,
-	float cost_track_L,
-	float cost_track_R,
-	float fLayerPitch,
-	std::shared_ptr<Song> pSong
-)
+/** resample() for a sample holding values of type @a T. */
+template < Interpolation::InterpolateMode mode, bool bStereo, typename T >
+static double resampleValues( const void* pSample_data_L, const void* pSample_data_R,
+							  int nSampleFrames, float* pBuffer_L, float* pBuffer_R,
+							  int nBufferPos, int nTimes, double fSamplePos, float fStep )
 {
-	auto pAudioDriver = Hydrogen::get_instance()->getAudioOutput();
-	auto pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
-	auto pInstrument = pNote->get_instrument();
+	return resample<mode, bStereo, T>( static_cast<const T*>( pSample_data_L ),
+									   static_cast<const T*>( pSample_data_R ),
+									   nSampleFrames, pBuffer_L, pBuffer_R,
+									   nBufferPos, nTimes, fSamplePos, fStep );
+}
 
-	int nNoteLength = -1;
-	if ( pNote->get_length() != -1 ) {
-		float fResampledTickSize = AudioEngine::computeTickSize( pSample->get_sample_rate(),
-																 pAudioEngine->getBpm(),
-																 pSong->getResolution() );
-		double fTickMismatch;
-		// Note is not located at the very beginning of the song
-		// and is enqueued by the AudioEngine. Take possible
-		// changes in tempo into account
-		nNoteLength =
-			pAudioEngine->computeFrameFromTick( pNote->get_position() +
-												pNote->get_length(), &fTickMismatch,
-												fResampledTickSize ) -
-			pNote->getNoteStart();
+typedef double (*resampleFunction)( const void*, const void*, int,
+									  float*, float*, int, int, double, float );
+
+template < Interpolation::InterpolateMode mode >
+static resampleFunction selectResample( bool bStereo, Sample::Format format )
+{
+	switch ( format ) {
+	case Sample::Format::Int16:
+		return bStereo ? resampleValues<mode, true, int16_t> :
+			resampleValues<mode, false, int16_t>;
+	case Sample::Format::Int24:
+		return bStereo ? resampleValues<mode, true, Sample::PackedInt24> :
+			resampleValues<mode, false, Sample::PackedInt24>;
+	default:
+		return bStereo ? resampleValues<mode, true, float> :
+			resampleValues<mode, false, float>;
 	}
+}
 
-	float fNotePitch = pNote->get_total_pitch() + fLayerPitch;
+bool Sampler::renderNoteResample( NoteRender* pNoteRender, ComponentRender* pRender,
+								  int nBufferSize, float* pScratch )
+{
+	auto pNote = pNoteRender->pNote;
+	const int nInitialSilence = pNoteRender->nInitialSilence;
+	auto pInstrument = pNote->get_instrument();
+	auto pSample = pRender->pSample;
+	auto pSelectedLayerInfo = pRender->pSelectedLayerInfo;
+
+	float fNotePitch = pNote->get_total_pitch() + pRender->fLayerPitch;
 	float fStep = Note::pitchToFrequency( fNotePitch );
 
 	fStep *= static_cast<float>(pSample->get_sample_rate()) /
-		static_cast<float>(pAudioDriver->getSampleRate()); // Adjust for audio driver sample rate
+		static_cast<float>(m_mixerSnapshot.nSampleRate); // Adjust for audio driver sample rate
 
 	// verifico il numero di frame disponibili ancora da eseguire
 	int nAvail_bytes = ( int )( ( float )( pSample->get_frames() - pSelectedLayerInfo->SamplePosition ) / fStep );
@@ -1106,221 +1863,140 @@ bool Sampler::renderNoteResample(
 	auto pSample_data_L = pSample->get_data_l();
 	auto pSample_data_R = pSample->get_data_r();
 
-	float fInstrPeak_L = pInstrument->get_peak_l(); // this value will be reset to 0 by the mixer..
-	float fInstrPeak_R = pInstrument->get_peak_r(); // this value will be reset to 0 by the mixer..
-
-	auto pADSR = pNote->get_adsr();
-	float fADSRValue = 1.0;
-	float fVal_L;
-	float fVal_R;
 	int nSampleFrames = pSample->get_frames();
-	int nNoteEnd;
-	if ( nNoteLength == -1) {
-		nNoteEnd = nSampleFrames + 1;
-	}
-	else {
-		nNoteEnd = nNoteLength - pSelectedLayerInfo->SamplePosition;
-	}
 
-
-#ifdef H2CORE_HAVE_JACK
-	float *		pTrackOutL = nullptr;
-	float *		pTrackOutR = nullptr;
-
-	if ( Preferences::get_instance()->m_bJackTrackOuts ) {
-		auto pJackAudioDriver = dynamic_cast<JackAudioDriver*>( pAudioDriver );
-		if( pJackAudioDriver ) {
-			pTrackOutL = pJackAudioDriver->getTrackOut_L( pInstrument, pCompo );
-			pTrackOutR = pJackAudioDriver->getTrackOut_R( pInstrument, pCompo );
-		}
+	float* buffer_L = pScratch;
+	float* buffer_R = pScratch + MAX_BUFFER_SIZE;
+
+	// Pick the kernel for the interpolation method and the format
+	// of the sample once for the whole note instead of branching on
+	// it for every single frame.
+	const bool bStereo = ! pSample->is_mono();
+	const Sample::Format format = pSample->get_format();
+	resampleFunction resampleKernel;
+	switch ( m_interpolateMode ) {
+	case Interpolation::InterpolateMode::Linear:
+		resampleKernel = selectResample<Interpolation::InterpolateMode::Linear>( bStereo, format );
+		break;
+	case Interpolation::InterpolateMode::Cosine:
+		resampleKernel = selectResample<Interpolation::InterpolateMode::Cosine>( bStereo, format );
+		break;
+	case Interpolation::InterpolateMode::Third:
+		resampleKernel = selectResample<Interpolation::InterpolateMode::Third>( bStereo, format );
+		break;
+	case Interpolation::InterpolateMode::Cubic:
+		resampleKernel = selectResample<Interpolation::InterpolateMode::Cubic>( bStereo, format );
+		break;
+	case Interpolation::InterpolateMode::Hermite:
+	default:
+		resampleKernel = selectResample<Interpolation::InterpolateMode::Hermite>( bStereo, format );
+		break;
 	}
-#endif
-
-	float buffer_L[MAX_BUFFER_SIZE];
-	float buffer_R[MAX_BUFFER_SIZE];
-
 
 	// Main rendering loop.
-	// With some re-work, more of this could likely be vectorised fairly easily.
-	//   - assert no buffer aliasing
-	//   - template and multiple instantiations for is_filter_active x each interpolation method
-	//   - iterate LP IIR filter coefficients to longer IIR filter to fit vector width
-	//
-	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
-
-		int nSamplePos = ( int )fSamplePos;
-		double fDiff = fSamplePos - nSamplePos;
-		if ( ( nSamplePos - 1 ) >= nSampleFrames ) {
-			//we reach the last audioframe.
-			//set this last frame to zero do nothing wrong.
-			fVal_L = 0.0;
-			fVal_R = 0.0;
-		} else {
-			// Gather frame samples
-			float l0, l1, l2, l3, r0, r1, r2, r3;
-			// Short-circuit: the common case is that all required frames are within the sample.
-			if ( nSamplePos >= 1 && nSamplePos + 2 < nSampleFrames ) {
-				l0 = pSample_data_L[ nSamplePos-1 ];
-				l1 = pSample_data_L[ nSamplePos ];
-				l2 = pSample_data_L[ nSamplePos+1 ];
-				l3 = pSample_data_L[ nSamplePos+2 ];
-				r0 = pSample_data_R[ nSamplePos-1 ];
-				r1 = pSample_data_R[ nSamplePos ];
-				r2 = pSample_data_R[ nSamplePos+1 ];
-				r3 = pSample_data_R[ nSamplePos+2 ];
-			} else {
-				l0 = l1 = l2 = l3 = r0 = r1 = r2 = r3 = 0.0;
-				// Some required frames are off the beginning or end of the sample.
-				if ( nSamplePos >= 1 && nSamplePos < nSampleFrames + 1 ) {
-					l0 = pSample_data_L[ nSamplePos-1 ];
-					r0 = pSample_data_R[ nSamplePos-1 ];
-				}
-				// Each successive frame may be past the end of the sample so check individually.
-				if ( nSamplePos < nSampleFrames ) {
-					l1 = pSample_data_L[ nSamplePos ];
-					r1 = pSample_data_R[ nSamplePos ];
-					if ( nSamplePos+1 < nSamplePos ) {
-						l2 = pSample_data_L[ nSamplePos+1 ];
-						r2 = pSample_data_R[ nSamplePos+1 ];
-						if ( nSamplePos+2 < nSamplePos ) {
-							l3 = pSample_data_L[ nSamplePos+2 ];
-							r3 = pSample_data_R[ nSamplePos+2 ];
-						}
-					}
-				}
-			}
-
-			// Interpolate frame values from Sample domain to audio output range
-			switch ( m_interpolateMode ) {
-			case Interpolation::InterpolateMode::Linear:
-				fVal_L = l1 * (1 - fDiff ) + l2 * fDiff;
-				fVal_R = r1 * (1 - fDiff ) + r2 * fDiff;
-				break;
-			case Interpolation::InterpolateMode::Cosine:
-				fVal_L = Interpolation::cosine_Interpolate( l1, l2, fDiff);
-				fVal_R = Interpolation::cosine_Interpolate( r1, r2, fDiff);
-				break;
-			case Interpolation::InterpolateMode::Third:
-				fVal_L = Interpolation::third_Interpolate( l0, l1, l2, l3, fDiff);
-				fVal_R = Interpolation::third_Interpolate( r0, r1, r2, r3, fDiff);
-				break;
-			case Interpolation::InterpolateMode::Cubic:
-				fVal_L = Interpolation::cubic_Interpolate( l0, l1, l2, l3, fDiff);
-				fVal_R = Interpolation::cubic_Interpolate( r0, r1, r2, r3, fDiff);
-				break;
-			case Interpolation::InterpolateMode::Hermite:
-				fVal_L = Interpolation::hermite_Interpolate( l0, l1, l2, l3, fDiff);
-				fVal_R = Interpolation::hermite_Interpolate( r0, r1, r2, r3, fDiff);
-				break;
-			}
-		}
-
-		buffer_L[nBufferPos] = fVal_L;
-		buffer_R[nBufferPos] = fVal_R;
-
-		fSamplePos += fStep;
+	resampleKernel( format == Sample::Format::Float ?
+					static_cast<const void*>( pSample_data_L ) : pSample->get_pcm_l(),
+					format == Sample::Format::Float ?
+					static_cast<const void*>( pSample_data_R ) : pSample->get_pcm_r(),
+					nSampleFrames,
+					buffer_L, buffer_R, nInitialBufferPos, nTimes,
+					fSamplePos, fStep );
+
+	// Mono samples were rendered into the left buffer only and are
+	// panned while mixing.
+	if ( ! bStereo ) {
+		buffer_R = buffer_L;
 	}
 
-	retValue = pADSR->applyADSR( buffer_L, buffer_R, nTimes, nNoteEnd, 1 );
-
-	// Mix rendered sample buffer to track and mixer output
-	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
-
-		fVal_L = buffer_L[nBufferPos];
-		fVal_R = buffer_R[nBufferPos];
-
-		// Low pass resonant filter
-		if ( pInstrument->is_filter_active() ) {
-			pNote->compute_lr_values( &fVal_L, &fVal_R );
-		}
-
-#ifdef H2CORE_HAVE_JACK
-		if ( pTrackOutL ) {
-			pTrackOutL[nBufferPos] += fVal_L * cost_track_L;
-		}
-		if ( pTrackOutR ) {
-			pTrackOutR[nBufferPos] += fVal_R * cost_track_R;
-		}
-#endif
-
-		fVal_L = fVal_L * cost_L;
-		fVal_R = fVal_R * cost_R;
-
-		// update instr peak
-		if ( fVal_L > fInstrPeak_L ) {
-			fInstrPeak_L = fVal_L;
-		}
-		if ( fVal_R > fInstrPeak_R ) {
-			fInstrPeak_R = fVal_R;
-		}
-
-		pDrumCompo->set_outs( nBufferPos, fVal_L, fVal_R );
-
-		// to main mix
-		m_pMainOut_L[nBufferPos] += fVal_L;
-		m_pMainOut_R[nBufferPos] += fVal_R;
-
+	const float* pEnvelope = renderEnvelope( pNoteRender, nBufferSize );
+	if ( bStereo ) {
+		VectorMath::multiplyStereo( &buffer_L[ nInitialBufferPos ], &buffer_R[ nInitialBufferPos ],
+									&pEnvelope[ nInitialBufferPos ], nTimes - nInitialBufferPos );
+	} else {
+		VectorMath::multiply( &buffer_L[ nInitialBufferPos ], &pEnvelope[ nInitialBufferPos ],
+							  nTimes - nInitialBufferPos );
 	}
+	retValue = pNoteRender->bEnvelopeEnded;
+
+	// Low pass resonant filter. The LADSPA sends are fed using the
+	// unfiltered buffer.
+	pRender->pMix_L = buffer_L;
+	pRender->pMix_R = buffer_R;
+	if ( pInstrument->is_filter_active() ) {
+		float* filtered_L = pScratch + 2 * MAX_BUFFER_SIZE;
+		float* filtered_R = pScratch + 3 * MAX_BUFFER_SIZE;
+		pNote->applyFilter( &buffer_L[ nInitialBufferPos ], &buffer_R[ nInitialBufferPos ],
+							&filtered_L[ nInitialBufferPos ], &filtered_R[ nInitialBufferPos ],
+							nTimes - nInitialBufferPos );
+		pRender->pMix_L = filtered_L;
+		pRender->pMix_R = filtered_R;
+	}
+	pRender->nMixFrom = nInitialBufferPos;
+	pRender->nMixTo = nTimes;
+
+	pRender->pSend_L = &buffer_L[ nInitialBufferPos ];
+	pRender->pSend_R = &buffer_R[ nInitialBufferPos ];
+	pRender->nSendFrames = nAvail_bytes;
 
 	if ( pInstrument->is_filter_active() && pNote->filter_sustain() ) {
 		// Note is still ringing, do not end.
 		retValue = false;
 	}
-	
-	pSelectedLayerInfo->SamplePosition += nAvail_bytes * fStep;
-	pInstrument->set_peak_l( fInstrPeak_L );
-	pInstrument->set_peak_r( fInstrPeak_R );
-
 
-#ifdef H2CORE_HAVE_LADSPA
-	// LADSPA
-	// change the below return logic if you add code after that ifdef
-	if ( pInstrument->is_muted() || pSong->getIsMuted() ) {
-		return retValue;
+	const bool bSampleDone =
+		fSamplePos + nAvail_bytes * fStep >= pSample->get_frames();
+	if ( ! retValue && isTailSilent( pNote, pRender, bSampleDone ) ) {
+		retValue = true;
 	}
-	float masterVol = pSong->getVolume();
-	for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
-		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
-		float fLevel = pInstrument->get_fx_level( nFX );
-		if ( ( pFX ) && ( fLevel != 0.0 ) ) {
-			fLevel = fLevel * pFX->getVolume();
-
-			float *pBuf_L = pFX->m_pBuffer_L;
-			float *pBuf_R = pFX->m_pBuffer_R;
-
-			float fFXCost_L = fLevel * masterVol;
-			float fFXCost_R = fLevel * masterVol;
+	
+	pSelectedLayerInfo->SamplePosition += nAvail_bytes * fStep;
 
-			int nBufferPos = nInitialBufferPos;
-			for ( int i = 0; i < nAvail_bytes; ++i ) {
+	return retValue;
+}
 
-				fVal_L = buffer_L[ nBufferPos ];
-				fVal_R = buffer_R[ nBufferPos ];
 
-				pBuf_L[ nBufferPos ] += fVal_L * fFXCost_L;
-				pBuf_R[ nBufferPos ] += fVal_R * fFXCost_R;
-				++nBufferPos;
-			}
+bool Sampler::isTailSilent( Note* pNote, const ComponentRender* pRender,
+							bool bSampleDone ) const
+{
+	const float fThreshold = m_mixerSnapshot.fTailThreshold;
+
+	if ( ! bSampleDone ) {
+		// The sample is still playing. It can only be inaudible from
+		// now on if the envelope is decaying and already below the
+		// threshold.
+		auto pADSR = pNote->get_adsr();
+		if ( pADSR->is_attacking() || ! pADSR->is_released() ||
+			 pADSR->get_value() >= fThreshold ) {
+			return false;
 		}
 	}
-#endif
-	return retValue;
-}
 
+	if ( pNote->get_instrument()->is_filter_active() &&
+		 ( std::fabs( pNote->get_bpfb_l() ) >= fThreshold ||
+		   std::fabs( pNote->get_bpfb_r() ) >= fThreshold ||
+		   std::fabs( pNote->get_lpfb_l() ) >= fThreshold ||
+		   std::fabs( pNote->get_lpfb_r() ) >= fThreshold ) ) {
+		return false;
+	}
+
+	const int nFrames = pRender->nMixTo - pRender->nMixFrom;
+	float fPeak = VectorMath::absPeak( &pRender->pMix_L[ pRender->nMixFrom ],
+									   nFrames, 0.0 );
+	fPeak = VectorMath::absPeak( &pRender->pMix_R[ pRender->nMixFrom ],
+								 nFrames, fPeak );
+	return fPeak < fThreshold;
+}
 
 void Sampler::stopPlayingNotes( std::shared_ptr<Instrument> pInstr )
 {
 	if ( pInstr ) { // stop all notes using this instrument
-		for ( unsigned i = 0; i < m_playingNotesQueue.size(); ) {
-			Note *pNote = m_playingNotesQueue[ i ];
-			assert( pNote );
-			if ( pNote->get_instrument() == pInstr ) {
-				delete pNote;
-				pInstr->dequeue();
-				m_playingNotesQueue.erase( m_playingNotesQueue.begin() + i );
-			}
-			++i;
-		}
+		forEachVoice( Note::SamplerVoice::ByInstrument,
+					  reinterpret_cast<intptr_t>( pInstr.get() ),
+					  [&]( Note* pNote ) {
+			removeVoice( pNote );
+			pInstr->dequeue();
+			delete pNote;
+		} );
 	} else { // stop all notes
 		// delete all copied notes in the playing notes queue
 		for ( unsigned i = 0; i < m_playingNotesQueue.size(); ++i ) {
@@ -1329,6 +2005,10 @@ void Sampler::stopPlayingNotes( std::shared_ptr<Instrument> pInstr )
 			delete pNote;
 		}
 		m_playingNotesQueue.clear();
+		m_stealHeap.clear();
+		for ( int ii = 0; ii < VOICE_INDICES; ++ii ) {
+			std::fill( m_voiceBuckets[ ii ], m_voiceBuckets[ ii ] + VOICE_BUCKETS, nullptr );
+		}
 	}
 }
 
@@ -1344,7 +2024,7 @@ void Sampler::preview_sample(std::shared_ptr<Sample> pSample, int length )
 
 		pLayer->set_sample( pSample );
 
-		Note *pPreviewNote = new Note( m_pPreviewInstrument, 0, 1.0, 0.f, length, 0 );
+		Note *pPreviewNote = new ( Note::realtime ) Note( m_pPreviewInstrument, 0, 1.0, 0.f, length, 0 );
 
 		stopPlayingNotes( m_pPreviewInstrument );
 		noteOn( pPreviewNote );
@@ -1367,7 +2047,7 @@ void Sampler::preview_instrument( std::shared_ptr<Instrument> pInstr )
 	m_pPreviewInstrument = pInstr;
 	pInstr->set_is_preview_instrument(true);
 
-	Note *pPreviewNote = new Note( m_pPreviewInstrument, 0, 1.0, 0.f, MAX_NOTES, 0 );
+	Note *pPreviewNote = new ( Note::realtime ) Note( m_pPreviewInstrument, 0, 1.0, 0.f, MAX_NOTES, 0 );
 
 	noteOn( pPreviewNote );	// exclusive note
 	Hydrogen::get_instance()->getAudioEngine()->unlock();
@@ -1470,14 +2150,15 @@ bool Sampler::isAnyInstrumentSoloed() const
 
 bool Sampler::isInstrumentPlaying( std::shared_ptr<Instrument> instrument )
 {
-	if ( instrument ) { // stop all notes using this instrument
-		for ( unsigned j = 0; j < m_playingNotesQueue.size(); j++ ) {
-			if ( instrument->get_name() == m_playingNotesQueue[ j ]->get_instrument()->get_name()){
-				return true;
-			}
-		}
+	bool bPlaying = false;
+	if ( instrument ) {
+		forEachVoice( Note::SamplerVoice::ByInstrument,
+					  reinterpret_cast<intptr_t>( instrument.get() ),
+					  [&]( Note* ) {
+			bPlaying = true;
+		} );
 	}
-	return false;
+	return bPlaying;
 }
 
 void Sampler::reinitializePlaybackTrack()
@@ -1487,13 +2168,14 @@ void Sampler::reinitializePlaybackTrack()
 	std::shared_ptr<Sample>	pSample;
 
 	if(!pSong->getPlaybackTrackFilename().isEmpty()){
-		pSample = Sample::load( pSong->getPlaybackTrackFilename() );
+		pSample = SampleRegistry::load( pSong->getPlaybackTrackFilename() );
 	}
 	
 	auto  pPlaybackTrackLayer = std::make_shared<InstrumentLayer>( pSample );
 
 	m_pPlaybackTrackInstrument->get_components()->front()->set_layer( pPlaybackTrackLayer, 0 );
 	m_nPlayBackSamplePosition = 0;
+	m_nPlaybackTrackPrefetchedFrame = 0;
 }
 
 };
@@ -28,6 +28,7 @@
 #include <core/Globals.h>
 #include <core/Sampler/Interpolation.h>
 
+#include <atomic>
 #include <inttypes.h>
 #include <vector>
 #include <memory>
@@ -43,6 +44,8 @@ class Instrument;
 struct SelectedLayerInfo;
 class InstrumentComponent;
 class AudioOutput;
+class RenderThreadPool;
+class SampleStreamer;
 
 ///
 /// Waveform based sampler.
@@ -146,6 +149,15 @@ public:
 	static float ratioConstKNormPanLaw( float fPan, float k );
 	static float quadraticConstKNormPanLaw( float fPan, float k );
 
+	/** Signature shared by all pan laws. @a k is only used by the
+	 * constant k norm ones. */
+	typedef float (*PanLawFunction)( float fPan, float k );
+	/**
+	 * \return Pan law corresponding to @a nPanLawType (see
+	 * #PAN_LAW_TYPES) or nullptr if the type is unknown.
+	 */
+	static PanLawFunction getPanLawFunction( int nPanLawType );
+
    /** This function is used to load old version files (v<=1.1).
 	* It returns the single pan parameter in [-1,1] from the L,R gains
 	* as it was input from the GUI (up to scale and translation, which is arbitrary).
@@ -224,23 +236,284 @@ public:
 	void reinitializePlaybackTrack();
 
 	/** 
-	 * Recalculates all note starts to make them valid again after a
-	 * TempoMarker was added to or deleted from the #Timeline or the
-	 * latter was activated.
-	 */
-	void handleTimelineOrTempoChange();
-	/** 
-	 * Recalculates all note starts and positions to make them valid
-	 * again after the song size changed, e.g. a pattern was inserted
-	 * or it's length was changed.
+	 * Shifts the positions of all notes to make them valid again
+	 * after the song size changed, e.g. a pattern was inserted or
+	 * it's length was changed. Their starts are recalculated once
+	 * they are rendered.
 	 */
 	void handleSongSizeChange();
 
 	const std::vector<Note*> getPlayingNotesQueue() const;
+
+	/**
+	 * Sets the number of threads used to render the voices.
+	 *
+	 * Must not be called while the Sampler is processing (e.g. with
+	 * the AudioEngine being locked).
+	 *
+	 * \param nThreads 1 renders on the audio thread only, 0 uses one
+	 * thread per CPU core.
+	 */
+	void setRenderThreads( int nThreads );
+
+	/**
+	 * Sets the hard upper limit of voices played at the same time
+	 * to twice @a nMaxNotes and reserves all containers holding
+	 * voices accordingly. This way the audio thread never has to
+	 * allocate memory when adding voices.
+	 *
+	 * Must not be called while the Sampler is processing (e.g. with
+	 * the AudioEngine being locked).
+	 *
+	 * \param nMaxNotes Preferences::m_nMaxNotes
+	 */
+	void setMaxNotes( int nMaxNotes );
+
+	/** \return Number of voices stolen since the Sampler was
+	 * created because more than Preferences::m_nMaxNotes were
+	 * playing. */
+	int getStolenVoiceCount() const;
+
+	/**
+	 * Fades out the voices with the lowest priority till at most @a
+	 * nMaxNotes voices, which are not fading out already, are left.
+	 *
+	 * Released voices are stolen first, followed by those superseded
+	 * by a more recent voice of the same instrument or mute group
+	 * (if Preferences::m_bStealSameInstrumentFirst is set). Within
+	 * each tier the oldest or quietest voice is picked depending on
+	 * Preferences::m_voiceStealing.
+	 *
+	 * Called by process() at the beginning of each cycle. The
+	 * candidates are kept in a heap maintained while adding and
+	 * removing voices, so each victim is found in O(log n).
+	 */
+	void stealVoices( int nMaxNotes );
 	
 private:
+	/**
+	 * Everything required to render and mix a single component of
+	 * a #Note during one process cycle.
+	 *
+	 * Filled on the audio thread by prepareNote(), completed by
+	 * renderComponent() - possibly on a worker thread - and finally
+	 * mixed by mixComponent() on the audio thread again.
+	 */
+	struct ComponentRender {
+		std::shared_ptr<Sample> pSample;
+		SelectedLayerInfo* pSelectedLayerInfo;
+		DrumkitComponent* pDrumCompo;
+		float cost_L;
+		float cost_R;
+		float cost_track_L;
+		float cost_track_R;
+		float fLayerPitch;
+		bool bResample;
+		float* pTrackOut_L;
+		float* pTrackOut_R;
+		/** Whether the component has to be rendered at all. */
+		bool bRender;
+
+		/** Whether the component is done playing. */
+		bool bEnded;
+		/** Rendered frames [#nMixFrom, #nMixTo) to be mixed. */
+		const float* pMix_L;
+		const float* pMix_R;
+		int nMixFrom;
+		int nMixTo;
+		/** Input for the LADSPA sends starting at #nMixFrom */
+		const float* pSend_L;
+		const float* pSend_R;
+		int nSendFrames;
+	};
+
+	/** A #Note rendered during the current process cycle. */
+	struct NoteRender {
+		Note* pNote;
+		int nInitialSilence;
+		/** Index of the note's first component in #m_componentRenders */
+		int nFirstComponent;
+		int nComponents;
+		bool bEnded;
+		/** ADSR of the note rendered for the whole cycle, shared by
+		 * all its components. #MAX_BUFFER_SIZE frames. */
+		float* pEnvelope;
+		/** Whether #pEnvelope was already rendered this cycle. */
+		bool bEnvelopeRendered;
+		/** Whether the ADSR finished within this cycle. */
+		bool bEnvelopeEnded;
+		/** Frame the release phase of the note starts at, counted
+		 * from #nInitialSilence. Larger than the buffer in case it
+		 * does not start within this cycle. */
+		int nReleaseFrame;
+	};
+
+	/**
+	 * Collects all information required to render @a pNote during
+	 * this cycle.
+	 *
+	 * Everything touching state shared between notes - like layer
+	 * selection or the MIDI output - is done in here on the audio
+	 * thread.
+	 *
+	 * \param nFirstComponent Index of the first free element in
+	 * #m_componentRenders.
+	 */
+	void prepareNote( Note* pNote, unsigned nBufferSize,
+					  std::shared_ptr<Song> pSong, NoteRender* pNoteRender,
+					  int nFirstComponent );
+	/**
+	 * Renders the @a nComponent th component of a prepared note into
+	 * @a pScratch.
+	 *
+	 * Only the #Note itself is altered. The function may thus run on
+	 * any thread as long as no other thread works on the same note.
+	 */
+	void renderComponent( NoteRender* pNoteRender, int nComponent,
+						  unsigned nBufferSize, float* pScratch );
+	/**
+	 * Mixes a rendered component into the main, track, component,
+	 * and FX outputs and updates the instrument peaks.
+	 *
+	 * Components are always mixed in the order of
+	 * #m_playingNotesQueue. This way the output does not depend on
+	 * the number of render threads.
+	 */
+	void mixComponent( NoteRender* pNoteRender, int nComponent );
+	/** Job of #m_pRenderThreadPool rendering all components of the
+	 * @a nJob th element of #m_noteRenders. */
+	static void renderNoteJob( void* pContext, int nJob );
+
+	/**
+	 * Mixer settings shared by all notes rendered within a single
+	 * process() cycle.
+	 *
+	 * They are collected once at the beginning of process(). This way
+	 * the setup of each note in prepareNote() neither has to walk
+	 * the instrument list nor to query the Preferences or the Song.
+	 */
+	struct MixerSnapshot {
+		/** Effective state of a DrumkitComponent. */
+		struct ComponentMix {
+			DrumkitComponent* pComponent;
+			float fVolume;
+			bool bMuted;
+		};
+
+		bool bAnyInstrumentSoloed;
+		bool bExportSessionActive;
+		bool bSongMuted;
+		float fSongVolume;
+		/** Whether Preferences::m_JackTrackOutputMode is set to
+		 * post fader. */
+		bool bJackTrackPostFader;
+		bool bJackTrackPreFader;
+		bool bJackTrackOuts;
+		unsigned nSampleRate;
+		PanLawFunction panLaw;
+		float fPanLawKNorm;
+		/** Preferences::m_fVoiceTailThreshold as linear gain. */
+		float fTailThreshold;
+		/** Components of the song indexed by their ID. Unused
+		 * elements hold #defaultComponent. */
+		ComponentMix components[ MAX_COMPONENTS ];
+		/** First component of the song used for the preview and
+		 * metronome instruments as well as for invalid IDs. */
+		ComponentMix defaultComponent;
+	};
+
+	/** Fills #m_mixerSnapshot using @a pSong. */
+	void updateMixerSnapshot( std::shared_ptr<Song> pSong );
+	/** \return Snapshot of the component with ID @a nID. */
+	const MixerSnapshot::ComponentMix& getComponentMix( int nID ) const;
+
+	MixerSnapshot m_mixerSnapshot;
+
+	/** Pool rendering notes in parallel. nullptr in case all notes
+	 * are rendered by the audio thread. */
+	RenderThreadPool* m_pRenderThreadPool;
+	std::vector<ComponentRender> m_componentRenders;
+	std::vector<NoteRender> m_noteRenders;
+	/** Scratch buffers, 4 * #MAX_BUFFER_SIZE frames for each of the
+	 * #m_nRenderSlots, followed by the envelopes of
+	 * #m_noteRenders. */
+	float* m_pRenderBuffers;
+	/** Unaligned allocation #m_pRenderBuffers is located in. */
+	float* m_pRenderBuffersMemory;
+	/** Number of #m_componentRenders with a scratch buffer of their
+	 * own. */
+	int m_nRenderSlots;
+	/** Buffer size of the cycle currently rendered by the pool. */
+	unsigned m_nRenderBufferSize;
+
+	/**
+	 * All voices currently playing.
+	 *
+	 * Finished voices are replaced by the last one in the queue. So,
+	 * the order does not reflect the time the notes were started
+	 * (see Note::SamplerVoice::nSerial).
+	 */
 	std::vector<Note*> m_playingNotesQueue;
 	std::vector<Note*> m_queuedNoteOffs;
+	/** Capacity of #m_playingNotesQueue, #m_queuedNoteOffs, and
+	 * #m_stealHeap. addVoice() never exceeds it. See
+	 * setMaxNotes(). */
+	int m_nMaxVoices;
+
+	/** Number of hash buckets of each voice index. */
+	static constexpr int VOICE_BUCKETS = 128;
+	/** Number of voice indices (Note::SamplerVoice::Indices). */
+	static constexpr int VOICE_INDICES = 3;
+	/** First voice of each bucket of the instrument, mute group,
+	 * and MIDI key index. */
+	Note* m_voiceBuckets[ VOICE_INDICES ][ VOICE_BUCKETS ];
+	/** Serial number assigned to the next voice. */
+	long long m_nNextVoiceSerial;
+
+	/** Appends @a pNote to #m_playingNotesQueue and all voice
+	 * indices. In case #m_nMaxVoices are playing already, a voice
+	 * is dropped first - preferably one fading out. */
+	void addVoice( Note* pNote );
+	/** Removes @a pNote from all voice indices and from
+	 * #m_playingNotesQueue by moving the last voice in its place. */
+	void removeVoice( Note* pNote );
+	/** Removes and deletes a voice right away to make room in
+	 * #m_playingNotesQueue. Voices already stolen go first, followed
+	 * by the next victim of stealVoices(). */
+	void dropVoice();
+	/**
+	 * Calls @a callback for each playing voice stored with @a nKey
+	 * in the voice index @a nIndex (Note::SamplerVoice::Index).
+	 *
+	 * @a callback may remove the voice passed to it.
+	 */
+	template <typename Callback>
+	void forEachVoice( int nIndex, intptr_t nKey, Callback callback );
+	static int getVoiceBucket( intptr_t nKey );
+
+	/**
+	 * All playing voices which were not stolen yet. Arranged as a
+	 * binary heap with the next victim of stealVoices() on top (see
+	 * Note::SamplerVoice::nStealIndex).
+	 */
+	std::vector<Note*> m_stealHeap;
+	/** Recomputes the tier and priority of @a pNote and moves it
+	 * within #m_stealHeap accordingly. */
+	void updateStealPriority( Note* pNote );
+	/** Removes @a pNote from #m_stealHeap. In case it was the most
+	 * recent voice of its instrument or mute group, the next older
+	 * one is not superseded anymore. */
+	void removeStealCandidate( Note* pNote );
+	/** Restores the heap property of #m_stealHeap for the voice at
+	 * @a nIndex. */
+	void siftStealCandidate( int nIndex );
+	/** \return Whether @a pNote is stolen before @a pOther. */
+	static bool isStolenBefore( Note* pNote, Note* pOther );
+	/** \return Most recent voice with @a nKey in voice index @a
+	 * nIndex, which was not stolen, starting the search at @a
+	 * pNote. */
+	Note* findUnstolenVoice( Note* pNote, int nIndex, intptr_t nKey ) const;
+	std::atomic<int> m_nStolenVoices;
 	
 	/// Instrument used for the playback track feature.
 	std::shared_ptr<Instrument> m_pPlaybackTrackInstrument;
@@ -256,10 +529,13 @@ private:
 	int m_nMaxLayers;
 	
 	int m_nPlayBackSamplePosition;
+	/** First frame of the playback track not requested from
+	 * #m_pSampleStreamer yet. */
+	int m_nPlaybackTrackPrefetchedFrame;
+
+	/** Reads streamed samples from disk ahead of the voices. */
+	SampleStreamer* m_pSampleStreamer;
 	
-	/** function to direct the computation to the selected pan law function
-	 */
-	float panLaw( float fPan, std::shared_ptr<Song> pSong );
 
 
 
@@ -267,42 +543,61 @@ private:
 	
 	bool isAnyInstrumentSoloed() const;
 	
-	bool renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Song> pSong );
 
 	Interpolation::InterpolateMode m_interpolateMode;
 
-	bool renderNoteNoResample(
-		std::shared_ptr<Sample> pSample,
-		Note *pNote,
-		std::shared_ptr<SelectedLayerInfo> pSelectedLayerInfo,
-		std::shared_ptr<InstrumentComponent> pCompo,
-		DrumkitComponent *pDrumCompo,
-		int nBufferSize,
-		int nInitialSilence,
-		float cost_L,
-		float cost_R,
-		float cost_track_L,
-		float cost_track_R,
-		std::shared_ptr<Song> pSong
-	);
-
-	bool renderNoteResample(
-		std::shared_ptr<Sample> pSample,
-		Note *pNote,
-		std::shared_ptr<SelectedLayerInfo> pSelectedLayerInfo,
-		std::shared_ptr<InstrumentComponent> pCompo,
-		DrumkitComponent *pDrumCompo,
-		int nBufferSize,
-		int nInitialSilence,
-		float cost_L,
-		float cost_R,
-		float cost_track_L,
-		float cost_track_R,
-		float fLayerPitch,
-		std::shared_ptr<Song> pSong
-	);
+	/**
+	 * Renders a component of a prepared note played at its original
+	 * pitch and sample rate into @a pScratch.
+	 *
+	 * \return true if the component is done playing.
+	 */
+	bool renderNoteNoResample( NoteRender* pNoteRender, ComponentRender* pRender,
+							   int nBufferSize, float* pScratch );
+	/** Resampling counterpart of renderNoteNoResample(). */
+	bool renderNoteResample( NoteRender* pNoteRender, ComponentRender* pRender,
+							 int nBufferSize, float* pScratch );
+	/**
+	 * Renders the ADSR of a prepared note into its
+	 * NoteRender::pEnvelope.
+	 *
+	 * Only the first call per cycle does actual work. This way the
+	 * envelope is advanced exactly once per cycle no matter how many
+	 * components and layers the note is made of. It starts at
+	 * NoteRender::nInitialSilence and is released at
+	 * NoteRender::nReleaseFrame.
+	 *
+	 * \return Envelope of the whole cycle.
+	 */
+	const float* renderEnvelope( NoteRender* pNoteRender, int nBufferSize );
+	/**
+	 * Tail detector.
+	 *
+	 * \param pNote Note a component was just rendered for.
+	 * \param pRender Rendered component.
+	 * \param bSampleDone Whether the end of the sample was reached.
+	 *
+	 * \return true in case the component is below
+	 * MixerSnapshot::fTailThreshold for the whole buffer and won't
+	 * get any louder: either the sample is done playing or the
+	 * envelope is in its release phase and the filter is not ringing
+	 * above the threshold either.
+	 */
+	bool isTailSilent( Note* pNote, const ComponentRender* pRender,
+					   bool bSampleDone ) const;
 };
 
+inline const Sampler::MixerSnapshot::ComponentMix& Sampler::getComponentMix( int nID ) const {
+	if ( nID < 0 || nID >= MAX_COMPONENTS ) {
+		return m_mixerSnapshot.defaultComponent;
+	}
+	return m_mixerSnapshot.components[ nID ];
+}
+
+inline int Sampler::getStolenVoiceCount() const {
+	return m_nStolenVoices.load( std::memory_order_relaxed );
+}
+
 inline const std::vector<Note*> Sampler::getPlayingNotesQueue() const {
 	return m_playingNotesQueue;
 }
@@ -106,15 +106,13 @@ void SampleWaveDisplay::updateDisplay( QString filename )
 
 		float fGain = height() / 2.0 * 1.0;
 
-		auto pSampleData = pNewSample->get_data_l();
-
 		int nSamplePos =0;
 		int nVal;
 		for ( int i = 0; i < width(); ++i ){
 			nVal = 0;
 			for ( int j = 0; j < nScaleFactor; ++j ) {
 				if ( j < nSampleLength ) {
-					int newVal = static_cast<int>( pSampleData[ nSamplePos ] * fGain );
+					int newVal = static_cast<int>( pNewSample->get_value_l( nSamplePos ) * fGain );
 					if ( newVal > nVal ) {
 						nVal = newVal;
 					}
@@ -835,6 +835,10 @@ void HydrogenApp::onEventQueueTimer()
 			case EVENT_DRUMKIT_LOADED:
 				pListener->drumkitLoadedEvent();
 				break;
+
+			case EVENT_SAMPLE_LOADING_PROGRESS:
+				pListener->sampleLoadingProgressEvent( event.value );
+				break;
 				
 			default:
 				ERRORLOG( QString("[onEventQueueTimer] Unhandled event: %1").arg( event.type ) );
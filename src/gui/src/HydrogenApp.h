@@ -211,6 +211,8 @@ signals:
 		     EventListener::updatePreferencesEvent()
 		 * - H2Core::EVENT_UPDATE_SONG -> 
 		     EventListener::updateSongEvent()
+		 * - H2Core::EVENT_SAMPLE_LOADING_PROGRESS -> 
+		     EventListener::sampleLoadingProgressEvent()
 		 * - H2Core::EVENT_NONE -> nothing
 		 *
 		 * In addition, all MIDI notes in
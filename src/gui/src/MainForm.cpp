@@ -2258,6 +2258,14 @@ void MainForm::undoRedoActionEvent( int nEvent ){
 	}
 }
 
+void MainForm::sampleLoadingProgressEvent( int nValue ) {
+	if ( nValue < 100 ) {
+		h2app->setStatusBarMessage( tr( "Loading samples... %1%" ).arg( nValue ) );
+	} else {
+		h2app->setStatusBarMessage( tr( "Samples loaded." ), 2000 );
+	}
+}
+
 bool MainForm::handleSelectNextPrevSongOnPlaylist( int step )
 {
 	int nPlaylistSize = Playlist::get_instance()->size();
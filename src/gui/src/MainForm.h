@@ -78,6 +78,7 @@ class MainForm :  public QMainWindow, protected WidgetWithScalableFont<8, 10, 12
 		 */
 		virtual void updatePreferencesEvent( int nValue ) override;
 		virtual void undoRedoActionEvent( int nEvent ) override;
+		virtual void sampleLoadingProgressEvent( int nValue ) override;
 		static void usr1SignalHandler(int unused);
 
 public slots:
@@ -295,9 +295,8 @@ void DrumPatternEditor::addOrDeleteNoteAction(	int nColumn,
 
 	if ( isDelete ) {
 		// Find and delete an existing (matching) note.
-		Pattern::notes_t *notes = (Pattern::notes_t *)pPattern->get_notes();
 		bool bFound = false;
-		FOREACH_NOTE_IT_BOUND( notes, it, nColumn ) {
+		FOREACH_NOTE_CST_IT_BOUND( pPattern->get_notes(), it, nColumn ) {
 			Note *pNote = it->second;
 			assert( pNote );
 			if ( ( isNoteOff && pNote->get_note_off() )
@@ -306,7 +305,7 @@ void DrumPatternEditor::addOrDeleteNoteAction(	int nColumn,
 					  && pNote->get_octave() == oldOctaveKeyVal
 					  && pNote->get_velocity() == oldVelocity
 					  && pNote->get_probability() == fProbability ) ) {
-				notes->erase( it );
+				pPattern->remove_note( pNote );
 				delete pNote;
 				bFound = true;
 				break;
@@ -389,7 +388,7 @@ void DrumPatternEditor::moveNoteAction( int nColumn,
 	auto pFromInstrument = pInstrumentList->get( nRow );
 	auto pToInstrument = pInstrumentList->get( nNewRow );
 
-	FOREACH_NOTE_IT_BOUND((Pattern::notes_t *)pPattern->get_notes(), it, nColumn) {
+	FOREACH_NOTE_CST_IT_BOUND(pPattern->get_notes(), it, nColumn) {
 		Note *pCandidateNote = it->second;
 		if ( pCandidateNote->get_instrument() == pFromInstrument
 			 && pCandidateNote->get_key() == pNote->get_key()
@@ -1429,13 +1428,12 @@ void DrumPatternEditor::functionPasteNotesUndoAction(std::list<H2Core::Pattern*>
 				assert(pNote);
 
 				// Check if note is not present
-				Pattern::notes_t* notes = (Pattern::notes_t *)pat->get_notes();
-				FOREACH_NOTE_IT_BOUND(notes, it, pNote->get_position())
+				FOREACH_NOTE_CST_IT_BOUND(pat->get_notes(), it, pNote->get_position())
 				{
 					Note *pFoundNote = it->second;
 					if (pFoundNote->get_instrument() == pNote->get_instrument())
 					{
-						notes->erase(it);
+						pat->remove_note(pFoundNote);
 						delete pFoundNote;
 						break;
 					}
@@ -1534,13 +1532,12 @@ void DrumPatternEditor::functionFillNotesUndoAction( QStringList noteList, int n
 
 	for (int i = 0; i < noteList.size(); i++ ) {
 		int nColumn  = noteList.value(i).toInt();
-		Pattern::notes_t* notes = (Pattern::notes_t*)pPattern->get_notes();
-		FOREACH_NOTE_IT_BOUND(notes,it,nColumn) {
+		FOREACH_NOTE_CST_IT_BOUND(pPattern->get_notes(),it,nColumn) {
 			Note *pNote = it->second;
 			assert( pNote );
 			if ( pNote->get_instrument() == pSelectedInstrument ) {
 				// the note exists...remove it!
-				notes->erase( it );
+				pPattern->remove_note( pNote );
 				delete pNote;
 				break;
 			}
@@ -476,25 +476,25 @@ void PatternEditor::deselectAndOverwriteNotes( std::vector< H2Core::Note *> &sel
 	// Iterate over all the notes in 'selected' and 'overwrite' by erasing any *other* notes occupying the
 	// same position.
 	m_pAudioEngine->lock( RIGHT_HERE );
-	Pattern::notes_t *pNotes = const_cast< Pattern::notes_t *>( m_pPattern->get_notes() );
+	const Pattern::notes_t *pNotes = m_pPattern->get_notes();
 	for ( auto pSelectedNote : selected ) {
 		m_selection.removeFromSelection( pSelectedNote, /* bCheck=*/false );
 		bool bFoundExact = false;
 		int nPosition = pSelectedNote->get_position();
-		for ( auto it = pNotes->lower_bound( nPosition ); it != pNotes->end() && it->first == nPosition; ) {
+		std::vector< Note *> removed;
+		for ( auto it = pNotes->lower_bound( nPosition ); it != pNotes->end() && it->first == nPosition; ++it ) {
 			Note *pNote = it->second;
 			if ( !bFoundExact && notesMatchExactly( pNote, pSelectedNote ) ) {
 				// Found an exact match. We keep this.
 				bFoundExact = true;
-				++it;
 			} else if ( pSelectedNote->match( pNote ) && pNote->get_position() == pSelectedNote->get_position() ) {
 				// Something else occupying the same position (which may or may not be an exact duplicate)
-				it = pNotes->erase( it );
-			} else {
-				// Any other note
-				++it;
+				removed.push_back( pNote );
 			}
 		}
+		for ( auto pNote : removed ) {
+			m_pPattern->remove_note( pNote );
+		}
 	}
 	Hydrogen::get_instance()->setIsModified( true );
 	m_pAudioEngine->unlock();
@@ -656,7 +656,7 @@ void PianoRollEditor::moveNoteAction( int nColumn,
 
 	Pattern *pPattern = pPatternList->get( nPattern );
 
-	FOREACH_NOTE_IT_BOUND((Pattern::notes_t *)pPattern->get_notes(), it, nColumn) {
+	FOREACH_NOTE_CST_IT_BOUND(pPattern->get_notes(), it, nColumn) {
 		Note *pCandidateNote = it->second;
 		if ( pCandidateNote->get_instrument() == pNote->get_instrument()
 			 && pCandidateNote->get_octave() == octave
@@ -337,6 +337,10 @@ PreferencesDialog::PreferencesDialog(QWidget* parent)
 	maxVoicesTxt->setSize( audioTabWidgetSizeBottom );
 	maxVoicesTxt->setValue( pPref->m_nMaxNotes );
 
+	// Audio tab - render threads
+	renderThreadsSpinBox->setSize( audioTabWidgetSizeBottom );
+	renderThreadsSpinBox->setValue( pPref->m_nRenderThreads );
+
 	resampleComboBox->setSize( audioTabWidgetSizeBottom );
 	resampleComboBox->setCurrentIndex( (int) Hydrogen::get_instance()->getAudioEngine()->getSampler()->getInterpolateMode() );
 	connect( resampleComboBox, SIGNAL(currentIndexChanged(int)), this,
@@ -756,8 +760,20 @@ void PreferencesDialog::on_okBtn_clicked()
 	// metronome
 	pPref->m_fMetronomeVolume = (metronomeVolumeSpinBox->value()) / 100.0;
 
-	// maxVoices
-	pPref->m_nMaxNotes = maxVoicesTxt->value();
+	// maxVoices and render threads. Both are applied while the
+	// audio engine is not processing.
+	const int nMaxNotes = maxVoicesTxt->value();
+	const int nRenderThreads = renderThreadsSpinBox->value();
+	if ( static_cast<int>( pPref->m_nMaxNotes ) != nMaxNotes ||
+		 pPref->m_nRenderThreads != nRenderThreads ) {
+		pPref->m_nMaxNotes = nMaxNotes;
+		pPref->m_nRenderThreads = nRenderThreads;
+		auto pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
+		pAudioEngine->lock( RIGHT_HERE );
+		pAudioEngine->getSampler()->setMaxNotes( nMaxNotes );
+		pAudioEngine->getSampler()->setRenderThreads( nRenderThreads );
+		pAudioEngine->unlock();
+	}
 
 	if ( m_pMidiDriverComboBox->currentText() == "ALSA" ) {
 		pPref->m_sMidiDriver = "ALSA";
@@ -139,12 +139,9 @@ void DetailWaveDisplay::updateDisplay( QString filename )
 
 		float fGain = height() / 4.0 * 1.0;
 
-		auto pSampleDatal = pNewSample->get_data_l();
-		auto pSampleDatar = pNewSample->get_data_r();
-
 		for ( int i = 0; i < mSampleLength; i++ ){
-			m_pPeakDatal[ i ] = static_cast<int>( pSampleDatal[ i ] * fGain );
-			m_pPeakDatar[ i ] = static_cast<int>( pSampleDatar[ i ] * fGain );
+			m_pPeakDatal[ i ] = static_cast<int>( pNewSample->get_value_l( i ) * fGain );
+			m_pPeakDatar[ i ] = static_cast<int>( pNewSample->get_value_r( i ) * fGain );
 		}
 
 
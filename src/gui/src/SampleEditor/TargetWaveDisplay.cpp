@@ -215,8 +215,7 @@ void TargetWaveDisplay::updateDisplay( std::shared_ptr<H2Core::InstrumentLayer>
 
 		float fGain = (height() - 8) / 2.0 * pLayer->get_gain();
 
-		auto pSampleDatal = pLayer->get_sample()->get_data_l();
-		auto pSampleDatar = pLayer->get_sample()->get_data_r();
+		auto pSample = pLayer->get_sample();
 		int nSamplePos = 0;
 		int nVall;
 		int nValr;
@@ -225,20 +224,20 @@ void TargetWaveDisplay::updateDisplay( std::shared_ptr<H2Core::InstrumentLayer>
 			nValr = 0;
 			for ( int j = 0; j < nScaleFactor; ++j ) {
 				if ( j < nSampleLength ) {
-					if ( pSampleDatal[ nSamplePos ] < 0 ){
-						int newVal = static_cast<int>( pSampleDatal[ nSamplePos ] * -fGain );
+					if ( pSample->get_value_l( nSamplePos ) < 0 ){
+						int newVal = static_cast<int>( pSample->get_value_l( nSamplePos ) * -fGain );
 						nVall = newVal;
 					}else
 					{
-						int newVal = static_cast<int>( pSampleDatal[ nSamplePos ] * fGain );
+						int newVal = static_cast<int>( pSample->get_value_l( nSamplePos ) * fGain );
 						nVall = newVal;
 					}
-					if ( pSampleDatar[ nSamplePos ] > 0 ){
-						int newVal = static_cast<int>( pSampleDatar[ nSamplePos ] * -fGain );
+					if ( pSample->get_value_r( nSamplePos ) > 0 ){
+						int newVal = static_cast<int>( pSample->get_value_r( nSamplePos ) * -fGain );
 						nValr = newVal;
 					}else
 					{
-						int newVal = static_cast<int>( pSampleDatar[ nSamplePos ] * fGain );
+						int newVal = static_cast<int>( pSample->get_value_r( nSamplePos ) * fGain );
 						nValr = newVal;
 					}
 				}
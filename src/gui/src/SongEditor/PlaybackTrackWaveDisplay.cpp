@@ -107,7 +107,7 @@ void PlaybackTrackWaveDisplay::updateDisplay( std::shared_ptr<H2Core::Instrument
 		m_pLayer = pLayer;
 		m_sSampleName = m_pLayer->get_sample()->get_filename();
 		
-		auto	pSampleData = pLayer->get_sample()->get_data_l();
+		auto	pSample = pLayer->get_sample();
 		int		nSampleLength = m_pLayer->get_sample()->get_frames();
 		float	fLengthOfPlaybackTrackInSecs = ( float )( nSampleLength / (float) m_pLayer->get_sample()->get_sample_rate() );
 		float	fRemainingLengthOfPlaybackTrack = fLengthOfPlaybackTrackInSecs;		
@@ -164,7 +164,7 @@ void PlaybackTrackWaveDisplay::updateDisplay( std::shared_ptr<H2Core::Instrument
 						int nSamplesToRenderInThisStep =  (nSamplesToRender / nSongEditorGridWith);
 						for ( int j = 0; j < nSamplesToRenderInThisStep; ++j ) {
 							if ( nSamplePos < nSampleLength ) {
-								int newVal = (int)( pSampleData[ nSamplePos ] * fGain );
+								int newVal = (int)( pSample->get_value_l( nSamplePos ) * fGain );
 								if ( newVal > nVal ) {
 									nVal = newVal;
 								}
@@ -1848,6 +1848,9 @@ void SongEditorPatternList::fillRangeWithPattern( FillRange* pRange, int nPatter
 				break;
 			}
 		}
+	// Keeps the transport position and the column lookups
+	// consistent.
+	m_pHydrogen->updateSongSize();
 	m_pAudioEngine->unlock();
 
 
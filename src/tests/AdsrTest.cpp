@@ -224,6 +224,83 @@ void ADSRTest::testEarlyRelease() {
 
 }
 
+/* Release phases longer than the decay must not be cut short. */
+void ADSRTest::testLongRelease() {
+	const int N = 256;
+	const float fSustain = 0.75;
+	float a[8*N], b[8*N];
+	for ( int n = 0; n < 8*N; n++) {
+		a[n] = b[n] = 1.0;
+	}
+
+	ADSR Adsr( N, N, fSustain, 4 * N );
+	Adsr.applyADSR( a, b, 8 * N, 3 * N, 1.0 );
+	checkEqual( a, b, 8 * N );
+
+	/* Release: 3N..7N-1 from fSustain to 0.0 */
+	CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE( "release starting at sustain level", fSustain, a[3*N], 1.0/N );
+	checkConcave( &a[3*N], 4 * N );
+	CPPUNIT_ASSERT_MESSAGE( "release still running", a[5*N] > 0.01 );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE( "release ending at 0", 0.0, a[7*N-1], 1.0/N );
+
+	/* Idle */
+	checkAllEqual( a + 7 * N, 0.0, N );
+}
+
+/* A fade out started during the sustain phase ends after its own
+   length regardless of the release of the envelope. */
+void ADSRTest::testFadeOut() {
+	const int N = 256;
+	const float fSustain = 0.75;
+	float a[6*N], b[6*N];
+	for ( int n = 0; n < 6*N; n++) {
+		a[n] = b[n] = 1.0;
+	}
+
+	ADSR Adsr( N, N, fSustain, 16 * N );
+	Adsr.applyADSR( a, b, 3 * N, 100 * N, 1.0 );
+	CPPUNIT_ASSERT( ! Adsr.is_released() );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( fSustain, Adsr.get_value(), delta );
+
+	Adsr.fadeOut( N );
+	CPPUNIT_ASSERT( Adsr.is_released() );
+
+	/* The fade out is not affected by a release frame ahead. */
+	bool bEnded = Adsr.applyADSR( a + 3 * N, b + 3 * N, 3 * N, N, 1.0 );
+	CPPUNIT_ASSERT( bEnded );
+	checkEqual( a, b, 6 * N );
+
+	CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE( "fade out starting at sustain level", fSustain, a[3*N], 1.0/N );
+	checkConcave( &a[3*N], N );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE( "fade out ending at 0", 0.0, a[4*N-1], 1.0/N );
+	checkAllEqual( a + 4 * N, 0.0, 2 * N );
+}
+
+void ADSRTest::testEnvelope() {
+	const int N = 256;
+	float a[6*N], b[6*N], envelope[6*N];
+	for ( int n = 0; n < 6*N; n++) {
+		a[n] = b[n] = 0.5 - 0.25 * ( n % 5 );
+		envelope[n] = 1.0;
+	}
+
+	/* Rendering the envelope on its own and applying it afterwards
+	 * is identical to applying it to the stereo buffers directly. */
+	ADSR Stereo( N, N, 0.4, 2 * N );
+	ADSR Mono( N, N, 0.4, 2 * N );
+	for ( int nChunk = 0; nChunk < 6; nChunk++ ) {
+		int nOffset = nChunk * N;
+		bool bStereoEnded = Stereo.applyADSR( a + nOffset, b + nOffset, N, 3 * N - nOffset, 1.0 );
+		bool bMonoEnded = Mono.applyADSR( envelope + nOffset, nullptr, N, 3 * N - nOffset, 1.0 );
+		CPPUNIT_ASSERT_EQUAL( bStereoEnded, bMonoEnded );
+	}
+	for ( int n = 0; n < 6*N; n++ ) {
+		CPPUNIT_ASSERT_EQUAL( a[n], ( 0.5f - 0.25f * ( n % 5 ) ) * envelope[n] );
+	}
+	checkEqual( a, b, 6 * N );
+	checkAllEqual( envelope + 5 * N, 0.0, N );
+}
+
 void ADSRTest::testAttack()
 {
 	m_adsr->attack();
@@ -36,6 +36,9 @@ class ADSRTest : public CppUnit::TestCase {
 	CPPUNIT_TEST( testBasicADSR );
 	CPPUNIT_TEST( testEarlyRelease );
   	CPPUNIT_TEST( testBufferChunks );
+	CPPUNIT_TEST( testLongRelease );
+	CPPUNIT_TEST( testFadeOut );
+	CPPUNIT_TEST( testEnvelope );
 	CPPUNIT_TEST_SUITE_END();
 
 	private:
@@ -51,6 +54,9 @@ class ADSRTest : public CppUnit::TestCase {
 	void testBasicADSR();
   	void testEarlyRelease();
 	void testBufferChunks();
+	void testLongRelease();
+	void testFadeOut();
+	void testEnvelope();
 };
 
 #endif
@@ -28,6 +28,7 @@
 #include <core/Basics/InstrumentList.h>
 #include <core/Basics/InstrumentComponent.h>
 #include <core/Basics/PatternList.h>
+#include <core/Preferences/Preferences.h>
 #include "TestHelper.h"
 #include "AudioBenchmark.h"
 
@@ -214,5 +215,30 @@ void AudioBenchmark::audioBenchmark(void)
 	timeExport( 44100 );
 	timeExport( 48000 );
 
+
+	// Conversion of the samples to float while rendering.
+	qDebug() << "Now with compact samples";
+	auto pPref = Preferences::get_instance();
+	const bool bUseCompactSamples = pPref->m_bUseCompactSamples;
+	pPref->m_bUseCompactSamples = true;
+	pSong = Song::load( songFile );
+	CPPUNIT_ASSERT( pSong != nullptr );
+
+	if( !pSong ) {
+		pPref->m_bUseCompactSamples = bUseCompactSamples;
+		return;
+	}
+
+	pHydrogen->setSong( pSong );
+	pInstrumentList = pSong->getInstrumentList();
+	for ( int i = 0; i < pInstrumentList->size(); i++ ) {
+		pInstrumentList->get(i)->set_currently_exported( true );
+	}
+
+	timeExport( 44100 );
+	timeExport( 48000 );
+
+	pPref->m_bUseCompactSamples = bUseCompactSamples;
+
 	qDebug() << "---";
 }
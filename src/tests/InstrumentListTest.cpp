@@ -23,8 +23,12 @@
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <core/Hydrogen.h>
+#include <core/Basics/Drumkit.h>
 #include <core/Basics/Instrument.h>
 #include <core/Basics/InstrumentList.h>
+#include <core/Basics/Song.h>
+
+#include "TestHelper.h"
 
 using namespace H2Core;
 
@@ -35,6 +39,7 @@ class InstrumentListTest : public CppUnit::TestCase {
 	CPPUNIT_TEST( test2 );
 	CPPUNIT_TEST( test3 );
 	CPPUNIT_TEST( test4 );
+	CPPUNIT_TEST( testStagedDrumkit );
 	CPPUNIT_TEST_SUITE_END();
 	
 	public:
@@ -121,5 +126,34 @@ class InstrumentListTest : public CppUnit::TestCase {
 		CPPUNIT_ASSERT( !list.is_valid_index(1) );
 		CPPUNIT_ASSERT( !list.is_valid_index(-42) );
 	}
+
+	void testStagedDrumkit()
+	{
+		auto pDrumkit = Drumkit::load( H2TEST_FILE( "drumkits/baseKit" ), true );
+		CPPUNIT_ASSERT( pDrumkit != nullptr );
+
+		auto pSong = Song::getEmptySong();
+		auto pInstrumentList = pSong->getInstrumentList();
+		auto pFirst = pInstrumentList->get( 0 );
+		auto pFormerComponents = pFirst->get_components();
+
+		// Staging leaves the song untouched.
+		auto pStaged = Song::stageDrumkit( pDrumkit );
+		CPPUNIT_ASSERT_EQUAL( pDrumkit->get_instruments()->size(),
+							  static_cast<int>( pStaged->instruments.size() ) );
+		CPPUNIT_ASSERT( pFirst->get_components() == pFormerComponents );
+
+		// Instruments referenced by patterns are retained but take
+		// over the content of the staged ones.
+		pSong->loadDrumkit( pStaged.get(), false );
+		CPPUNIT_ASSERT( pInstrumentList->get( 0 ) == pFirst );
+		CPPUNIT_ASSERT( pFirst->get_name() ==
+						pDrumkit->get_instruments()->get( 0 )->get_name() );
+		CPPUNIT_ASSERT( pFirst->get_components() != pFormerComponents );
+		CPPUNIT_ASSERT( pStaged->instruments[ 0 ]->get_components() == pFormerComponents );
+		CPPUNIT_ASSERT_EQUAL( pDrumkit->get_instruments()->size(), pInstrumentList->size() );
+
+		delete pDrumkit;
+	}
 };
 
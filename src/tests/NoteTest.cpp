@@ -23,16 +23,23 @@
 #include <cppunit/extensions/HelperMacros.h>
 #include <core/Basics/Note.h>
 #include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
 #include <core/Basics/InstrumentList.h>
+#include <core/Helpers/RealtimePool.h>
 #include <core/Helpers/Xml.h>
 #include <QDomDocument>
 
+#include <vector>
+
 using namespace H2Core;
 
 class NoteTest : public CppUnit::TestCase {
 	CPPUNIT_TEST_SUITE( NoteTest );
 	CPPUNIT_TEST( testProbability );
 	CPPUNIT_TEST( testSerializeProbability );
+	CPPUNIT_TEST( testRealtimePool );
+	CPPUNIT_TEST( testRealtimeNote );
+	CPPUNIT_TEST( testCopyFilterSettings );
 	CPPUNIT_TEST_SUITE_END();
 
 	void testProbability()
@@ -77,5 +84,100 @@ class NoteTest : public CppUnit::TestCase {
 		delete snare;
 		*/
 	}
-};
 
+	void testRealtimePool()
+	{
+		RealtimePool pool( 20, 8 );
+		CPPUNIT_ASSERT( pool.getBlockSize() >= 20 );
+		CPPUNIT_ASSERT_EQUAL( 8, pool.getCapacity() );
+
+		std::vector<void*> blocks;
+		for ( int ii = 0; ii < 8; ++ii ) {
+			void* pBlock = pool.acquire();
+			CPPUNIT_ASSERT( pBlock != nullptr );
+			CPPUNIT_ASSERT( pool.contains( pBlock ) );
+			for ( auto pOther : blocks ) {
+				CPPUNIT_ASSERT( pOther != pBlock );
+			}
+			blocks.push_back( pBlock );
+		}
+		CPPUNIT_ASSERT_EQUAL( 8, pool.getUsed() );
+		// Exhausted
+		CPPUNIT_ASSERT( pool.acquire() == nullptr );
+
+		int nOutside;
+		CPPUNIT_ASSERT( ! pool.contains( &nOutside ) );
+
+		pool.release( blocks[ 3 ] );
+		CPPUNIT_ASSERT_EQUAL( 7, pool.getUsed() );
+		CPPUNIT_ASSERT( pool.acquire() == blocks[ 3 ] );
+
+		for ( auto pBlock : blocks ) {
+			pool.release( pBlock );
+		}
+		CPPUNIT_ASSERT_EQUAL( 0, pool.getUsed() );
+	}
+
+	void testRealtimeNote()
+	{
+		// Created in AudioEngine::AudioEngine().
+		Note::createRealtimePool( 16 );
+		auto pPool = Note::getRealtimePool();
+		CPPUNIT_ASSERT( pPool != nullptr );
+
+		auto pInstrument = std::make_shared<Instrument>( 1, "Snare", nullptr );
+		pInstrument->get_components()->push_back(
+			std::make_shared<InstrumentComponent>( 2 ) );
+
+		const int nUsed = pPool->getUsed();
+		Note* pNote = new ( Note::realtime ) Note( pInstrument, 0, 1.0f, 0.f, -1, 0 );
+		CPPUNIT_ASSERT( pPool->contains( pNote ) );
+		CPPUNIT_ASSERT_EQUAL( nUsed + 1, pPool->getUsed() );
+
+		auto pLayer = pNote->get_layer_selected( 2 );
+		CPPUNIT_ASSERT( pLayer != nullptr );
+		CPPUNIT_ASSERT_EQUAL( -1, pLayer->SelectedLayer );
+		CPPUNIT_ASSERT( pNote->get_layer_selected( 0 ) == nullptr );
+		pLayer->SamplePosition = 10;
+
+		Note* pCopy = new ( Note::realtime ) Note( pNote );
+		CPPUNIT_ASSERT( pPool->contains( pCopy ) );
+		CPPUNIT_ASSERT_EQUAL( 10.f, pCopy->get_layer_selected( 2 )->SamplePosition );
+		CPPUNIT_ASSERT( pCopy->get_adsr() != pNote->get_adsr() );
+
+		// Regular notes are still allocated on the heap.
+		Note* pHeapNote = new Note( pInstrument, 0, 1.0f, 0.f, -1, 0 );
+		CPPUNIT_ASSERT( ! pPool->contains( pHeapNote ) );
+
+		delete pNote;
+		delete pCopy;
+		delete pHeapNote;
+		CPPUNIT_ASSERT_EQUAL( nUsed, pPool->getUsed() );
+	}
+
+	void testCopyFilterSettings()
+	{
+		auto pInstrument = std::make_shared<Instrument>( 1, "Snare", nullptr );
+		pInstrument->set_filter_cutoff( 0.8f );
+		pInstrument->set_filter_resonance( 0.1f );
+		Note note( pInstrument, 0, 1.0f, 0.f, -1, 0 );
+		CPPUNIT_ASSERT_EQUAL( 0.8f, note.get_cut_off() );
+		CPPUNIT_ASSERT_EQUAL( 0.1f, note.get_resonance() );
+
+		// Notes copied for playback have to start with the current
+		// filter settings of the instrument.
+		pInstrument->set_filter_cutoff( 0.3f );
+		pInstrument->set_filter_resonance( 0.6f );
+		Note copy( &note );
+		CPPUNIT_ASSERT_EQUAL( 0.3f, copy.get_cut_off() );
+		CPPUNIT_ASSERT_EQUAL( 0.6f, copy.get_resonance() );
+
+		// The same holds for an instrument passed explicitly.
+		auto pOther = std::make_shared<Instrument>( 2, "Kick", nullptr );
+		pOther->set_filter_cutoff( 0.5f );
+		pOther->set_filter_resonance( 0.2f );
+		Note otherCopy( &note, pOther );
+		CPPUNIT_ASSERT_EQUAL( 0.5f, otherCopy.get_cut_off() );
+		CPPUNIT_ASSERT_EQUAL( 0.2f, otherCopy.get_resonance() );
+	}
+};
@@ -25,6 +25,8 @@
 #include <core/AudioEngine/AudioEngine.h>
 #include <core/Basics/Pattern.h>
 
+#include <vector>
+
 using namespace H2Core;
 
 void PatternTest::testPurgeInstrument()
@@ -41,3 +43,37 @@ void PatternTest::testPurgeInstrument()
 
 	delete pPattern;
 }
+
+void PatternTest::testNoteRange()
+{
+	auto pInstrument = std::make_shared<Instrument>();
+	auto pOtherInstrument = std::make_shared<Instrument>();
+	Note *pNote5 = new Note( pInstrument, 5, 1.0, 0.f, 1, 1.0 );
+	Note *pNote1 = new Note( pInstrument, 1, 1.0, 0.f, 1, 1.0 );
+	Note *pOtherNote5 = new Note( pOtherInstrument, 5, 1.0, 0.f, 1, 1.0 );
+	Note *pNote3 = new Note( pOtherInstrument, 3, 1.0, 0.f, 1, 1.0 );
+
+	Pattern *pPattern = new Pattern();
+	pPattern->insert_note( pNote5 );
+	pPattern->insert_note( pNote1 );
+	pPattern->insert_note( pOtherNote5 );
+	pPattern->insert_note( pNote3 );
+
+	auto getRange = [&]( int nStart, int nEnd ) {
+		std::vector<Note*> notes;
+		FOREACH_NOTE_CST_IT_RANGE( pPattern->get_notes(), it, nStart, nEnd ) {
+			notes.push_back( it->second );
+		}
+		return notes;
+	};
+
+	// Notes sharing a position keep the order of insertion.
+	CPPUNIT_ASSERT( getRange( 5, 6 ) == std::vector<Note*>( { pNote5, pOtherNote5 } ) );
+	CPPUNIT_ASSERT( getRange( 2, 5 ) == std::vector<Note*>( { pNote3 } ) );
+	CPPUNIT_ASSERT( getRange( 0, 100 ) ==
+					std::vector<Note*>( { pNote1, pNote3, pNote5, pOtherNote5 } ) );
+	CPPUNIT_ASSERT( getRange( 6, 100 ).empty() );
+	CPPUNIT_ASSERT( getRange( 3, 3 ).empty() );
+
+	delete pPattern;
+}
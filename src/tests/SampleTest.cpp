@@ -23,11 +23,45 @@
 #include "PatternTest.h"
 #include "TestHelper.h"
 
+#include <core/AudioEngine/AudioEngine.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/InstrumentList.h>
 #include <core/Basics/Sample.h>
+#include <core/Basics/Song.h>
+#include <core/Helpers/Filesystem.h>
+#include <core/Helpers/SampleCache.h>
+#include <core/Helpers/SampleLoader.h>
+#include <core/Helpers/SampleRateConverter.h>
+#include <core/Helpers/SampleRegistry.h>
+#include <core/Helpers/TimeStretcher.h>
+#include <core/Hydrogen.h>
+#include <core/Preferences/Preferences.h>
+#include <core/Sampler/SampleStreamer.h>
+
+#include <QDir>
+#include <QFile>
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
 
 class SampleTest : public CppUnit::TestCase {
 	CPPUNIT_TEST_SUITE( SampleTest );
 	CPPUNIT_TEST( testLoadInvalidSample );
+	CPPUNIT_TEST( testSampleCache );
+	CPPUNIT_TEST( testMonoSample );
+	CPPUNIT_TEST( testSampleRegistry );
+	CPPUNIT_TEST( testSampleLoader );
+	CPPUNIT_TEST( testSampleStreaming );
+	CPPUNIT_TEST( testCompactSample );
+	CPPUNIT_TEST( testSampleRateConverter );
+	CPPUNIT_TEST( testSampleRateConversion );
+	CPPUNIT_TEST( testTransformationKey );
+	CPPUNIT_TEST( testTimeStretcher );
+	CPPUNIT_TEST( testTrimSilence );
 
 	CPPUNIT_TEST_SUITE_END();
 
@@ -45,4 +79,580 @@ class SampleTest : public CppUnit::TestCase {
 		pSample = H2Core::Sample::load( H2TEST_FILE("drumkits/baseKit/drumkit.xml") );
 		CPPUNIT_ASSERT(pSample == nullptr);
 	}
+
+	void testSampleCache()
+	{
+		auto pPref = H2Core::Preferences::get_instance();
+		const bool bUseSampleCache = pPref->m_bUseSampleCache;
+		pPref->m_bUseSampleCache = true;
+
+		const QString sSamplePath = H2TEST_FILE( "drumkits/baseKit/snare.wav" );
+		QFile::remove( H2Core::SampleCache::getCachePath( sSamplePath ) );
+		// The tests use a temporary cache directory set up in main().
+		CPPUNIT_ASSERT( ! H2Core::Filesystem::getSampleCacheOverwritePath().isEmpty() );
+		CPPUNIT_ASSERT( H2Core::SampleCache::getCachePath( sSamplePath ).startsWith(
+							H2Core::Filesystem::getSampleCacheOverwritePath() ) );
+
+		// Decoded and written to the cache.
+		auto pDecoded = H2Core::Sample::load( sSamplePath );
+		CPPUNIT_ASSERT( pDecoded != nullptr );
+		CPPUNIT_ASSERT( ! pDecoded->is_mapped() );
+		CPPUNIT_ASSERT( QFile::exists( H2Core::SampleCache::getCachePath( sSamplePath ) ) );
+
+#ifndef WIN32
+		// Mapped from the cache.
+		auto pMapped = H2Core::Sample::load( sSamplePath );
+		CPPUNIT_ASSERT( pMapped != nullptr );
+		CPPUNIT_ASSERT( pMapped->is_mapped() );
+		CPPUNIT_ASSERT_EQUAL( pDecoded->get_frames(), pMapped->get_frames() );
+		CPPUNIT_ASSERT_EQUAL( pDecoded->get_sample_rate(), pMapped->get_sample_rate() );
+		for ( int i = 0; i < pDecoded->get_frames(); i++ ) {
+			CPPUNIT_ASSERT_EQUAL( pDecoded->get_data_l()[ i ], pMapped->get_data_l()[ i ] );
+			CPPUNIT_ASSERT_EQUAL( pDecoded->get_data_r()[ i ], pMapped->get_data_r()[ i ] );
+		}
+
+		// Altering the mapped data must neither affect the cache
+		// nor other samples mapping it.
+		auto pOther = H2Core::Sample::load( sSamplePath );
+		CPPUNIT_ASSERT( pOther->is_mapped() );
+		for ( int i = 0; i < pMapped->get_frames(); i++ ) {
+			pMapped->get_data_l()[ i ] = 2.0;
+		}
+		pMapped.reset();
+		auto pReloaded = H2Core::Sample::load( sSamplePath );
+		CPPUNIT_ASSERT( pReloaded->is_mapped() );
+		for ( int i = 0; i < pDecoded->get_frames(); i++ ) {
+			CPPUNIT_ASSERT_EQUAL( pDecoded->get_data_l()[ i ], pOther->get_data_l()[ i ] );
+			CPPUNIT_ASSERT_EQUAL( pDecoded->get_data_l()[ i ], pReloaded->get_data_l()[ i ] );
+		}
+#endif
+
+		pPref->m_bUseSampleCache = bUseSampleCache;
+	}
+
+	void testMonoSample()
+	{
+		auto pPref = H2Core::Preferences::get_instance();
+		const bool bUseSampleCache = pPref->m_bUseSampleCache;
+		pPref->m_bUseSampleCache = true;
+
+		const QString sSamplePath = H2TEST_FILE( "drumkits/baseKit/kick.wav" );
+		QFile::remove( H2Core::SampleCache::getCachePath( sSamplePath ) );
+
+		// Both channels share a single buffer, regardless of whether
+		// the sample was decoded or mapped from the cache.
+		auto pDecoded = H2Core::Sample::load( sSamplePath );
+		CPPUNIT_ASSERT( pDecoded != nullptr );
+		CPPUNIT_ASSERT( pDecoded->is_mono() );
+		CPPUNIT_ASSERT( pDecoded->get_data_l() == pDecoded->get_data_r() );
+		CPPUNIT_ASSERT_EQUAL( pDecoded->get_frames() * static_cast<int>( sizeof( float ) ),
+							  pDecoded->get_size() );
+
+		auto pCached = H2Core::Sample::load( sSamplePath );
+		CPPUNIT_ASSERT( pCached->is_mono() );
+		for ( int i = 0; i < pDecoded->get_frames(); i++ ) {
+			CPPUNIT_ASSERT_EQUAL( pDecoded->get_data_l()[ i ], pCached->get_data_l()[ i ] );
+		}
+
+		auto pCopy = std::make_shared<H2Core::Sample>( pDecoded );
+		CPPUNIT_ASSERT( pCopy->is_mono() );
+
+		// Panning hard left alters the right channel only.
+		H2Core::Sample::PanEnvelope pan;
+		pan.push_back( H2Core::EnvelopePoint( 0, 0 ) );
+		pan.push_back( H2Core::EnvelopePoint( 841, 0 ) );
+		pCopy->apply_pan( pan );
+		CPPUNIT_ASSERT( ! pCopy->is_mono() );
+		CPPUNIT_ASSERT_EQUAL( 2 * pDecoded->get_size(), pCopy->get_size() );
+		for ( int i = 0; i < pDecoded->get_frames(); i++ ) {
+			CPPUNIT_ASSERT_EQUAL( pDecoded->get_data_l()[ i ], pCopy->get_data_l()[ i ] );
+			CPPUNIT_ASSERT_EQUAL( 0.0f, std::abs( pCopy->get_data_r()[ i ] ) );
+		}
+
+		pPref->m_bUseSampleCache = bUseSampleCache;
+	}
+
+	void testSampleRegistry()
+	{
+		const QString sSamplePath = H2TEST_FILE( "drumkits/baseKit/snare.wav" );
+
+		auto pFirst = H2Core::SampleRegistry::load( sSamplePath );
+		CPPUNIT_ASSERT( pFirst != nullptr );
+
+		// Identical requests share the loaded sample.
+		const long nHits = H2Core::SampleRegistry::getHits();
+		auto pSecond = H2Core::SampleRegistry::load(
+			H2TEST_FILE( "drumkits/baseKit/../baseKit/snare.wav" ) );
+		CPPUNIT_ASSERT( pSecond == pFirst );
+		CPPUNIT_ASSERT_EQUAL( nHits + 1, H2Core::SampleRegistry::getHits() );
+
+		// Transformations result in a different sample.
+		H2Core::Sample::VelocityEnvelope velocity;
+		velocity.push_back( H2Core::EnvelopePoint( 0, 45 ) );
+		velocity.push_back( H2Core::EnvelopePoint( 841, 45 ) );
+		auto pTransformed = H2Core::SampleRegistry::load(
+			sSamplePath, H2Core::Sample::Loops(), H2Core::Sample::Rubberband(),
+			velocity, H2Core::Sample::PanEnvelope(), 120 );
+		CPPUNIT_ASSERT( pTransformed != nullptr );
+		CPPUNIT_ASSERT( pTransformed != pFirst );
+		CPPUNIT_ASSERT( pTransformed->get_is_modified() );
+		CPPUNIT_ASSERT( ! pFirst->get_is_modified() );
+	}
+
+	void testSampleLoader()
+	{
+		const QStringList samples = { "kick.wav", "snare.wav", "hh.wav",
+									  "crash.wav", "kick.wav",
+									  "PathDoesNotExist.wav" };
+		std::vector<H2Core::SampleLoader::Request> requests;
+		for ( const auto& sSample : samples ) {
+			requests.push_back( H2Core::SampleLoader::Request(
+				H2TEST_FILE( "drumkits/baseKit/" + sSample ) ) );
+		}
+
+		CPPUNIT_ASSERT( H2Core::SampleLoader::load( requests,
+													H2Core::SampleLoader::Scope::Song ) );
+		for ( int i = 0; i < samples.size() - 1; i++ ) {
+			CPPUNIT_ASSERT( requests[ i ].pSample != nullptr );
+			CPPUNIT_ASSERT( requests[ i ].pSample->get_frames() > 0 );
+		}
+		CPPUNIT_ASSERT( requests.back().pSample == nullptr );
+
+		// Identical requests share the sample, even if they were
+		// handled by different threads.
+		CPPUNIT_ASSERT( requests[ 0 ].pSample == requests[ 4 ].pSample );
+
+		// Batches of other scopes must not cancel the song.
+		std::vector<H2Core::SampleLoader::Request> songRequests;
+		for ( int ii = 0; ii < 50; ++ii ) {
+			songRequests.push_back( H2Core::SampleLoader::Request(
+				H2TEST_FILE( "drumkits/baseKit/" + samples[ ii % 4 ] ) ) );
+		}
+		bool bSongLoaded = false;
+		std::thread songThread( [&]() {
+			bSongLoaded = H2Core::SampleLoader::load(
+				songRequests, H2Core::SampleLoader::Scope::Song );
+		} );
+		for ( int ii = 0; ii < 10; ++ii ) {
+			std::vector<H2Core::SampleLoader::Request> kitRequests = {
+				H2Core::SampleLoader::Request( H2TEST_FILE( "drumkits/baseKit/kick.wav" ) ) };
+			CPPUNIT_ASSERT( H2Core::SampleLoader::load(
+								kitRequests, H2Core::SampleLoader::Scope::Drumkit ) );
+			H2Core::SampleLoader::cancel( H2Core::SampleLoader::Scope::SampleRate );
+		}
+		songThread.join();
+		CPPUNIT_ASSERT( bSongLoaded );
+		for ( const auto& request : songRequests ) {
+			CPPUNIT_ASSERT( request.pSample != nullptr );
+		}
+	}
+
+	void testSampleStreaming()
+	{
+#ifndef WIN32
+		auto pPref = H2Core::Preferences::get_instance();
+		const bool bUseSampleCache = pPref->m_bUseSampleCache;
+		const int nStreamingThreshold = pPref->m_nStreamingThreshold;
+		pPref->m_bUseSampleCache = true;
+
+		// The decoded crash sample occupies slightly more than 1 MiB.
+		const QString sSamplePath = H2TEST_FILE( "drumkits/baseKit/crash.wav" );
+		QFile::remove( H2Core::SampleCache::getCachePath( sSamplePath ) );
+
+		pPref->m_nStreamingThreshold = 1;
+		auto pStreamed = H2Core::Sample::load( sSamplePath );
+		CPPUNIT_ASSERT( pStreamed != nullptr );
+		// Streamed right after being decoded for the first time.
+		CPPUNIT_ASSERT( pStreamed->is_streamed() );
+
+		pPref->m_nStreamingThreshold = 0;
+		auto pResident = H2Core::Sample::load( sSamplePath );
+		CPPUNIT_ASSERT( pResident->is_mapped() );
+		CPPUNIT_ASSERT( ! pResident->is_streamed() );
+		CPPUNIT_ASSERT_EQUAL( pResident->get_frames(), pStreamed->get_frames() );
+
+		H2Core::SampleStreamer* pStreamer = new H2Core::SampleStreamer();
+		int nPrefetchedFrame = 0;
+		pStreamer->update( pResident, 0, &nPrefetchedFrame );
+		CPPUNIT_ASSERT_EQUAL( 0, nPrefetchedFrame );
+		pStreamer->update( pStreamed, 0, &nPrefetchedFrame );
+		CPPUNIT_ASSERT( nPrefetchedFrame > 0 );
+		CPPUNIT_ASSERT( nPrefetchedFrame <= pStreamed->get_frames() );
+
+		// Requests are not repeated as long as enough frames are
+		// ahead of the voice.
+		const int nFirstRequest = nPrefetchedFrame;
+		pStreamer->update( pStreamed, 1, &nPrefetchedFrame );
+		CPPUNIT_ASSERT_EQUAL( nFirstRequest, nPrefetchedFrame );
+		delete pStreamer;
+
+		for ( int i = 0; i < pStreamed->get_frames(); i++ ) {
+			CPPUNIT_ASSERT_EQUAL( pResident->get_data_l()[ i ], pStreamed->get_data_l()[ i ] );
+			CPPUNIT_ASSERT_EQUAL( pResident->get_data_r()[ i ], pStreamed->get_data_r()[ i ] );
+		}
+
+		pPref->m_bUseSampleCache = bUseSampleCache;
+		pPref->m_nStreamingThreshold = nStreamingThreshold;
+#endif
+	}
+
+	/** Compares the values of @a pCompact with the ones of @a
+	 * pFloat stored as floats. */
+	void checkCompactSample( std::shared_ptr<H2Core::Sample> pCompact,
+							 std::shared_ptr<H2Core::Sample> pFloat,
+							 H2Core::Sample::Format format )
+	{
+		CPPUNIT_ASSERT( pCompact != nullptr );
+		CPPUNIT_ASSERT( pCompact->get_format() == format );
+		CPPUNIT_ASSERT( pCompact->get_data_l() == nullptr );
+		CPPUNIT_ASSERT( ! pCompact->is_empty() );
+		CPPUNIT_ASSERT_EQUAL( pFloat->is_mono(), pCompact->is_mono() );
+		CPPUNIT_ASSERT_EQUAL( pFloat->get_frames(), pCompact->get_frames() );
+		CPPUNIT_ASSERT( pCompact->get_size() < pFloat->get_size() );
+		// The conversion is lossless.
+		for ( int i = 0; i < pFloat->get_frames(); i++ ) {
+			CPPUNIT_ASSERT_EQUAL( pFloat->get_data_l()[ i ], pCompact->get_value_l( i ) );
+			CPPUNIT_ASSERT_EQUAL( pFloat->get_data_r()[ i ], pCompact->get_value_r( i ) );
+		}
+	}
+
+	void testCompactSample()
+	{
+		auto pPref = H2Core::Preferences::get_instance();
+		const bool bUseSampleCache = pPref->m_bUseSampleCache;
+		const bool bUseCompactSamples = pPref->m_bUseCompactSamples;
+		pPref->m_bUseSampleCache = false;
+
+		const QString s24BitPath = H2Core::Filesystem::tmp_file_path( "compact24.wav" );
+		for ( const auto& sSamplePath : { H2TEST_FILE( "drumkits/baseKit/kick.wav" ),
+										  H2TEST_FILE( "drumkits/baseKit/snare.wav" ) } ) {
+			pPref->m_bUseCompactSamples = false;
+			auto pFloat = H2Core::Sample::load( sSamplePath );
+			CPPUNIT_ASSERT( pFloat->get_format() == H2Core::Sample::Format::Float );
+
+			pPref->m_bUseCompactSamples = true;
+			auto pCompact = H2Core::Sample::load( sSamplePath );
+			checkCompactSample( pCompact, pFloat, H2Core::Sample::Format::Int16 );
+			checkCompactSample( std::make_shared<H2Core::Sample>( pCompact ), pFloat,
+								H2Core::Sample::Format::Int16 );
+
+			// 24 bit PCM
+			CPPUNIT_ASSERT( pFloat->write( s24BitPath, SF_FORMAT_WAV | SF_FORMAT_PCM_24 ) );
+			pPref->m_bUseCompactSamples = false;
+			auto pFloat24 = H2Core::Sample::load( s24BitPath );
+			pPref->m_bUseCompactSamples = true;
+			checkCompactSample( H2Core::Sample::load( s24BitPath ), pFloat24,
+								H2Core::Sample::Format::Int24 );
+
+			// Transformations are applied to floats.
+			H2Core::Sample::VelocityEnvelope velocity;
+			velocity.push_back( H2Core::EnvelopePoint( 0, 0 ) );
+			velocity.push_back( H2Core::EnvelopePoint( 841, 45 ) );
+			pFloat->apply_velocity( velocity );
+			pCompact->apply_velocity( velocity );
+			CPPUNIT_ASSERT( pCompact->get_format() == H2Core::Sample::Format::Float );
+			for ( int i = 0; i < pFloat->get_frames(); i++ ) {
+				CPPUNIT_ASSERT_EQUAL( pFloat->get_data_l()[ i ], pCompact->get_data_l()[ i ] );
+				CPPUNIT_ASSERT_EQUAL( pFloat->get_data_r()[ i ], pCompact->get_data_r()[ i ] );
+			}
+		}
+		QFile::remove( s24BitPath );
+
+		pPref->m_bUseSampleCache = bUseSampleCache;
+		pPref->m_bUseCompactSamples = bUseCompactSamples;
+	}
+
+	void testSampleRateConverter()
+	{
+		const int nSourceRate = 48000;
+		const int nTargetRate = 44100;
+		const double fFrequency = 1000;
+		std::vector<float> source( nSourceRate );
+		for ( int i = 0; i < source.size(); i++ ) {
+			source[ i ] = std::sin( 2 * M_PI * fFrequency * i / nSourceRate );
+		}
+
+		const H2Core::SampleRateConverter converter( nSourceRate, nTargetRate );
+		CPPUNIT_ASSERT_EQUAL( nTargetRate, converter.getFrames( source.size() ) );
+		std::vector<float> target( converter.getFrames( source.size() ) );
+		converter.process( source.data(), source.size(), target.data() );
+
+		// Apart from the fade in and out at both ends the sine is
+		// reproduced at the target rate.
+		for ( int i = nTargetRate / 4; i < nTargetRate * 3 / 4; i++ ) {
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(
+				std::sin( 2 * M_PI * fFrequency * i / nTargetRate ), target[ i ], 1e-4 );
+		}
+	}
+
+	void testSampleRateConversion()
+	{
+		auto pPref = H2Core::Preferences::get_instance();
+		const bool bUseSampleCache = pPref->m_bUseSampleCache;
+		pPref->m_bUseSampleCache = true;
+
+		const QString sSamplePath = H2TEST_FILE( "drumkits/baseKit/snare.wav" );
+		auto pPlain = H2Core::Sample::load( sSamplePath );
+		CPPUNIT_ASSERT( pPlain != nullptr );
+		const int nSampleRate = pPlain->get_sample_rate() == 48000 ? 44100 : 48000;
+		const QString sCachePath = H2Core::SampleCache::getCachePath(
+			sSamplePath, H2Core::Sample::sample_rate_variant( nSampleRate ) );
+		QFile::remove( sCachePath );
+
+		auto pConverted = H2Core::Sample::load( sSamplePath, nSampleRate );
+		CPPUNIT_ASSERT( pConverted != nullptr );
+		CPPUNIT_ASSERT_EQUAL( nSampleRate, pConverted->get_sample_rate() );
+		CPPUNIT_ASSERT_EQUAL(
+			H2Core::SampleRateConverter( pPlain->get_sample_rate(), nSampleRate )
+			.getFrames( pPlain->get_frames() ), pConverted->get_frames() );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( pPlain->get_sample_duration(),
+									  pConverted->get_sample_duration(), 1e-3 );
+
+#ifndef WIN32
+		// The converted data is cached separately.
+		CPPUNIT_ASSERT( QFile::exists( sCachePath ) );
+		auto pCached = H2Core::Sample::load( sSamplePath, nSampleRate );
+		CPPUNIT_ASSERT( pCached->is_mapped() );
+		CPPUNIT_ASSERT_EQUAL( pConverted->get_frames(), pCached->get_frames() );
+		for ( int i = 0; i < pConverted->get_frames(); i++ ) {
+			CPPUNIT_ASSERT_EQUAL( pConverted->get_data_l()[ i ], pCached->get_data_l()[ i ] );
+			CPPUNIT_ASSERT_EQUAL( pConverted->get_data_r()[ i ], pCached->get_data_r()[ i ] );
+		}
+#endif
+
+		// Samples already having the requested rate are left
+		// untouched.
+		auto pUnaltered = H2Core::Sample::load( sSamplePath, pPlain->get_sample_rate() );
+		CPPUNIT_ASSERT_EQUAL( pPlain->get_frames(), pUnaltered->get_frames() );
+		for ( int i = 0; i < pPlain->get_frames(); i++ ) {
+			CPPUNIT_ASSERT_EQUAL( pPlain->get_data_l()[ i ], pUnaltered->get_data_l()[ i ] );
+		}
+
+		// Transformations refer to the frames of the file and are
+		// applied prior to the conversion.
+		H2Core::Sample::Loops loops;
+		loops.end_frame = pPlain->get_frames() / 2;
+		auto pLooped = H2Core::Sample::load( sSamplePath, loops, H2Core::Sample::Rubberband(),
+											 H2Core::Sample::VelocityEnvelope(),
+											 H2Core::Sample::PanEnvelope(), 120, nSampleRate );
+		CPPUNIT_ASSERT_EQUAL( nSampleRate, pLooped->get_sample_rate() );
+		CPPUNIT_ASSERT( pLooped->get_loops() == loops );
+		CPPUNIT_ASSERT_EQUAL(
+			H2Core::SampleRateConverter( pPlain->get_sample_rate(), nSampleRate )
+			.getFrames( loops.end_frame ), pLooped->get_frames() );
+
+		pPref->m_bUseSampleCache = bUseSampleCache;
+	}
+
+	void testTransformationKey()
+	{
+		H2Core::Sample::Loops loops;
+		H2Core::Sample::Rubberband rubber;
+		H2Core::Sample::VelocityEnvelope velocity;
+		H2Core::Sample::PanEnvelope pan;
+
+		// The tempo only matters when stretching.
+		CPPUNIT_ASSERT( H2Core::Sample::transformations_to_key( loops, rubber, velocity, pan, 120 ) ==
+						H2Core::Sample::transformations_to_key( loops, rubber, velocity, pan, 140 ) );
+		rubber.use = true;
+		CPPUNIT_ASSERT( H2Core::Sample::transformations_to_key( loops, rubber, velocity, pan, 120 ) !=
+						H2Core::Sample::transformations_to_key( loops, rubber, velocity, pan, 140 ) );
+
+		const QString sKey =
+			H2Core::Sample::transformations_to_key( loops, rubber, velocity, pan, 120 );
+		pan.push_back( H2Core::EnvelopePoint( 0, 20 ) );
+		CPPUNIT_ASSERT( sKey !=
+						H2Core::Sample::transformations_to_key( loops, rubber, velocity, pan, 120 ) );
+	}
+
+	/** \return All values of @a pSample. */
+	static std::vector<float> getData( std::shared_ptr<H2Core::Sample> pSample )
+	{
+		std::vector<float> data;
+		for ( int i = 0; i < pSample->get_frames(); i++ ) {
+			data.push_back( pSample->get_value_l( i ) );
+			data.push_back( pSample->get_value_r( i ) );
+		}
+		return data;
+	}
+
+	void waitTillIdle( const H2Core::TimeStretcher& timeStretcher )
+	{
+		for ( int ii = 0; ii < 500 && ! timeStretcher.isIdle(); ++ii ) {
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		}
+		CPPUNIT_ASSERT( timeStretcher.isIdle() );
+	}
+
+	void testTimeStretcher()
+	{
+		H2Core::TimeStretcher timeStretcher;
+		CPPUNIT_ASSERT( timeStretcher.isIdle() );
+
+		// Requests return right away and are handled in the
+		// background.
+		timeStretcher.request( 120 );
+		waitTillIdle( timeStretcher );
+
+		timeStretcher.stretch( 120, false );
+		CPPUNIT_ASSERT( timeStretcher.isIdle() );
+
+		H2Core::Sample::Rubberband rubberband;
+		rubberband.use = true;
+		const QString sSamplePath = H2TEST_FILE( "drumkits/baseKit/snare.wav" );
+		auto pOriginal = H2Core::SampleRegistry::load(
+			sSamplePath, H2Core::Sample::Loops(), rubberband,
+			H2Core::Sample::VelocityEnvelope(), H2Core::Sample::PanEnvelope(), 100 );
+		CPPUNIT_ASSERT( pOriginal != nullptr );
+		if ( ! pOriginal->get_rubberband().use ) {
+			___WARNINGLOG( "Neither Rubber Band library nor CLI available. Skipping stretching tests." );
+			return;
+		}
+		const auto originalData = getData( pOriginal );
+
+		auto pHydrogen = H2Core::Hydrogen::get_instance();
+		auto pAudioEngine = pHydrogen->getAudioEngine();
+		auto pPreviousSong = pHydrogen->getSong();
+		auto pLayer = std::make_shared<H2Core::InstrumentLayer>( pOriginal );
+		auto pComponent = std::make_shared<H2Core::InstrumentComponent>( 0 );
+		pComponent->set_layer( pLayer, 0 );
+		auto pInstr = std::make_shared<H2Core::Instrument>( 100 );
+		pInstr->get_components()->push_back( pComponent );
+		auto pSong = H2Core::Song::getEmptySong();
+		pSong->getInstrumentList()->add( pInstr );
+		pHydrogen->setSong( pSong );
+
+		auto getLayerSample = [&]() {
+			pAudioEngine->lock( RIGHT_HERE );
+			auto pSample = pLayer->get_sample();
+			pAudioEngine->unlock();
+			return pSample;
+		};
+
+		// The stretched sample replaces the previous one of the
+		// layer. The latter is neither freed nor altered.
+		timeStretcher.stretch( 140, false );
+		auto pStretched = getLayerSample();
+		CPPUNIT_ASSERT( pStretched != pOriginal );
+		CPPUNIT_ASSERT( pStretched->get_rubberband().use );
+		CPPUNIT_ASSERT( pStretched->get_frames() < pOriginal->get_frames() );
+		CPPUNIT_ASSERT( getData( pOriginal ) == originalData );
+
+		// Stretching the same sample to the same tempo again is
+		// served by the registry.
+		const long nHits = H2Core::SampleRegistry::getHits();
+		const long nMisses = H2Core::SampleRegistry::getMisses();
+		timeStretcher.stretch( 140, false );
+		CPPUNIT_ASSERT( getLayerSample() == pStretched );
+		CPPUNIT_ASSERT( H2Core::SampleRegistry::getHits() > nHits );
+		CPPUNIT_ASSERT_EQUAL( nMisses, H2Core::SampleRegistry::getMisses() );
+
+		// Till a request is done, the previous sample keeps playing
+		// unaltered.
+		const auto stretchedData = getData( pStretched );
+		timeStretcher.request( 120 );
+		for ( int ii = 0; ii < 500 && ! timeStretcher.isIdle(); ++ii ) {
+			auto pSample = getLayerSample();
+			CPPUNIT_ASSERT( pSample == pStretched ||
+							pSample->get_frames() > pStretched->get_frames() );
+			CPPUNIT_ASSERT( getData( pStretched ) == stretchedData );
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		}
+		CPPUNIT_ASSERT( timeStretcher.isIdle() );
+		auto pCurrent = getLayerSample();
+		CPPUNIT_ASSERT( pCurrent->get_frames() > pStretched->get_frames() );
+		CPPUNIT_ASSERT( getData( pStretched ) == stretchedData );
+
+		// A layer whose sample was replaced while stretching is left
+		// untouched. The job holds a reference to the sample as soon
+		// as it was created.
+		auto pPlain = H2Core::SampleRegistry::load( sSamplePath );
+		CPPUNIT_ASSERT( pPlain != nullptr );
+		const long nUseCount = pCurrent.use_count();
+		timeStretcher.request( 160 );
+		for ( int ii = 0; ii < 50000 && pCurrent.use_count() == nUseCount; ++ii ) {
+			std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+		}
+		CPPUNIT_ASSERT( pCurrent.use_count() > nUseCount );
+		pAudioEngine->lock( RIGHT_HERE );
+		const bool bStillPlaying = pLayer->get_sample() == pCurrent;
+		pLayer->set_sample( pPlain );
+		pAudioEngine->unlock();
+		CPPUNIT_ASSERT( bStillPlaying );
+		waitTillIdle( timeStretcher );
+		CPPUNIT_ASSERT( getLayerSample() == pPlain );
+
+		if ( pPreviousSong != nullptr ) {
+			pHydrogen->setSong( pPreviousSong );
+		}
+	}
+
+	void testTrimSilence()
+	{
+		auto pPref = H2Core::Preferences::get_instance();
+		const bool bUseSampleCache = pPref->m_bUseSampleCache;
+		const bool bUseCompactSamples = pPref->m_bUseCompactSamples;
+		pPref->m_bUseSampleCache = false;
+
+		// Content above -90 dBFS spans [100, 850) across both
+		// channels.
+		const int nFrames = 1000;
+		float* pData_L = new float[ nFrames ];
+		float* pData_R = new float[ nFrames ];
+		for ( int i = 0; i < nFrames; i++ ) {
+			pData_L[ i ] = i >= 100 && i < 800 ? 0.5 : 1e-6;
+			pData_R[ i ] = i >= 150 && i < 850 ? -0.5 : 0;
+		}
+		const QString sSamplePath = H2Core::Filesystem::tmp_file_path( "silence.wav" );
+		auto pSample = std::make_shared<H2Core::Sample>( sSamplePath, nFrames, 44100,
+														  pData_L, pData_R );
+		CPPUNIT_ASSERT( pSample->write( sSamplePath, SF_FORMAT_WAV | SF_FORMAT_PCM_16 ) );
+
+		auto pTrimmed = std::make_shared<H2Core::Sample>( pSample );
+		CPPUNIT_ASSERT( pTrimmed->trim_silence( -90 ) );
+		CPPUNIT_ASSERT_EQUAL( 750, pTrimmed->get_frames() );
+		for ( int i = 0; i < pTrimmed->get_frames(); i++ ) {
+			CPPUNIT_ASSERT_EQUAL( pData_L[ i + 100 ], pTrimmed->get_data_l()[ i ] );
+			CPPUNIT_ASSERT_EQUAL( pData_R[ i + 100 ], pTrimmed->get_data_r()[ i ] );
+		}
+		CPPUNIT_ASSERT( ! pTrimmed->trim_silence( -90 ) );
+
+		// Compactly stored samples are trimmed without converting
+		// them.
+		pPref->m_bUseCompactSamples = true;
+		auto pCompact = H2Core::Sample::load( sSamplePath );
+		CPPUNIT_ASSERT( pCompact->get_format() == H2Core::Sample::Format::Int16 );
+		CPPUNIT_ASSERT( pCompact->trim_silence( -90 ) );
+		CPPUNIT_ASSERT( pCompact->get_format() == H2Core::Sample::Format::Int16 );
+		CPPUNIT_ASSERT_EQUAL( 750, pCompact->get_frames() );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.5, pCompact->get_value_l( 0 ), 1e-4 );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( -0.5, pCompact->get_value_r( 749 ), 1e-4 );
+		QFile::remove( sSamplePath );
+
+		// The detected range is stored in a sidecar file.
+		const QString sCachedPath = H2TEST_FILE( "drumkits/baseKit/snare.wav" );
+		int nStart, nEnd;
+		CPPUNIT_ASSERT( H2Core::SampleCache::storeTrimRange( sCachedPath, "test", -90,
+															 nFrames, 100, 850 ) );
+		CPPUNIT_ASSERT( H2Core::SampleCache::readTrimRange( sCachedPath, "test", -90,
+															nFrames, &nStart, &nEnd ) );
+		CPPUNIT_ASSERT_EQUAL( 100, nStart );
+		CPPUNIT_ASSERT_EQUAL( 850, nEnd );
+		CPPUNIT_ASSERT( ! H2Core::SampleCache::readTrimRange( sCachedPath, "test", -60,
+															  nFrames, &nStart, &nEnd ) );
+		CPPUNIT_ASSERT( ! H2Core::SampleCache::readTrimRange( sCachedPath, "test", -90,
+															  nFrames + 1, &nStart, &nEnd ) );
+
+		// The sidecar file ends up in the temporary cache directory
+		// of the test run and not in the one of the user.
+		QDir cacheDir( H2Core::Filesystem::getSampleCacheOverwritePath() );
+		const QStringList trimFiles = cacheDir.entryList( QStringList( "*.h2st" ), QDir::Files );
+		CPPUNIT_ASSERT( ! trimFiles.isEmpty() );
+		for ( const auto& sFile : trimFiles ) {
+			CPPUNIT_ASSERT( cacheDir.remove( sFile ) );
+		}
+
+		pPref->m_bUseSampleCache = bUseSampleCache;
+		pPref->m_bUseCompactSamples = bUseCompactSamples;
+	}
 };
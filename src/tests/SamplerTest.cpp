@@ -0,0 +1,436 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/AudioEngine.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/Note.h>
+#include <core/Basics/Sample.h>
+#include <core/Basics/Song.h>
+#include <core/EventQueue.h>
+#include <core/Helpers/Filesystem.h>
+#include <core/Hydrogen.h>
+#include <core/Preferences/Preferences.h>
+#include <core/Sampler/Sampler.h>
+#include "TestHelper.h"
+
+#include <sndfile.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+using namespace H2Core;
+
+class SamplerTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SamplerTest );
+	CPPUNIT_TEST( testStealOldest );
+	CPPUNIT_TEST( testStealQuietest );
+	CPPUNIT_TEST( testStealReleasedFirst );
+	CPPUNIT_TEST( testStealSameInstrumentFirst );
+	CPPUNIT_TEST( testVoiceCapacity );
+	CPPUNIT_TEST( testTailRetired );
+	CPPUNIT_TEST( testTailAboveThreshold );
+	CPPUNIT_TEST( testRenderThreads );
+	CPPUNIT_TEST_SUITE_END();
+
+	Sampler* m_pSampler;
+	Preferences::VoiceStealing m_voiceStealing;
+	bool m_bStealSameInstrumentFirst;
+	float m_fVoiceTailThreshold;
+
+	/** Starts playing a note of @a pInstr. The returned note is
+	 * owned by #m_pSampler. */
+	Note* playNote( std::shared_ptr<Instrument> pInstr, float fVelocity )
+	{
+		auto pNote = new Note( pInstr, 0, fVelocity, 0.f, -1, 0 );
+		m_pSampler->noteOn( pNote );
+		return pNote;
+	}
+
+	/** Creates an instrument playing a short pulse through its
+	 * resonant low pass filter. Using a @a fResonance of 1 the filter
+	 * keeps ringing at a constant level. */
+	std::shared_ptr<Instrument> createRingingInstrument( float fResonance )
+	{
+		const int nFrames = 256;
+		auto pData = new float[ nFrames ];
+		std::fill( pData, pData + nFrames, 0.5f );
+		auto pSample = std::make_shared<Sample>(
+			Filesystem::tmp_file_path( "tail.wav" ), nFrames, 44100, pData, pData );
+
+		auto pInstr = std::make_shared<Instrument>( 1 );
+		auto pComponent = std::make_shared<InstrumentComponent>( 0 );
+		pComponent->set_layer( std::make_shared<InstrumentLayer>( pSample ), 0 );
+		pInstr->get_components()->push_back( pComponent );
+		pInstr->set_filter_active( true );
+		pInstr->set_filter_cutoff( 0.05 );
+		pInstr->set_filter_resonance( fResonance );
+		return pInstr;
+	}
+
+	/** \return Largest magnitude of the filter states of @a pNote. */
+	static float filterLevel( Note* pNote )
+	{
+		return std::max( { std::fabs( pNote->get_bpfb_l() ),
+						   std::fabs( pNote->get_bpfb_r() ),
+						   std::fabs( pNote->get_lpfb_l() ),
+						   std::fabs( pNote->get_lpfb_r() ) } );
+	}
+
+	/** Exports functional/test.h2song with the voices being
+	 * rendered by @a nThreads threads.
+	 *
+	 * \return All samples of the export. */
+	std::vector<int> exportSong( int nThreads )
+	{
+		auto pHydrogen = Hydrogen::get_instance();
+		auto pAudioEngine = pHydrogen->getAudioEngine();
+		auto pQueue = EventQueue::get_instance();
+
+		auto pSong = Song::load( H2TEST_FILE( "functional/test.h2song" ) );
+		CPPUNIT_ASSERT( pSong != nullptr );
+		pHydrogen->setSong( pSong );
+		auto pInstrumentList = pSong->getInstrumentList();
+		for ( int ii = 0; ii < pInstrumentList->size(); ++ii ) {
+			pInstrumentList->get( ii )->set_currently_exported( true );
+		}
+
+		pAudioEngine->lock( RIGHT_HERE );
+		pAudioEngine->getSampler()->setRenderThreads( nThreads );
+		pAudioEngine->unlock();
+
+		// Export using 32 bit to not hide any difference by
+		// quantisation.
+		const QString sOutFile = Filesystem::tmp_file_path( "renderThreads.wav" );
+		pHydrogen->startExportSession( 44100, 32 );
+		pHydrogen->startExportSong( sOutFile );
+		bool bDone = false;
+		while ( ! bDone ) {
+			Event event = pQueue->pop_event();
+			if ( event.type == EVENT_PROGRESS && event.value == 100 ) {
+				bDone = true;
+			}
+			else if ( event.type == EVENT_NONE ) {
+				usleep( 100 * 1000 );
+			}
+		}
+		pHydrogen->stopExportSession();
+
+		SF_INFO info = {0};
+		SNDFILE* pFile = sf_open( sOutFile.toLocal8Bit().data(), SFM_READ, &info );
+		CPPUNIT_ASSERT( pFile != nullptr );
+		std::vector<int> samples( info.frames * info.channels );
+		CPPUNIT_ASSERT_EQUAL( static_cast<sf_count_t>( samples.size() ),
+							  sf_read_int( pFile, samples.data(), samples.size() ) );
+		sf_close( pFile );
+		Filesystem::rm( sOutFile );
+
+		return samples;
+	}
+
+public:
+	void setUp() override
+	{
+		auto pPref = Preferences::get_instance();
+		m_voiceStealing = pPref->m_voiceStealing;
+		m_bStealSameInstrumentFirst = pPref->m_bStealSameInstrumentFirst;
+		m_fVoiceTailThreshold = pPref->m_fVoiceTailThreshold;
+		m_pSampler = new Sampler();
+	}
+
+	void tearDown() override
+	{
+		m_pSampler->stopPlayingNotes();
+		delete m_pSampler;
+
+		auto pPref = Preferences::get_instance();
+		pPref->m_voiceStealing = m_voiceStealing;
+		pPref->m_bStealSameInstrumentFirst = m_bStealSameInstrumentFirst;
+		pPref->m_fVoiceTailThreshold = m_fVoiceTailThreshold;
+	}
+
+	void testStealOldest()
+	{
+		auto pPref = Preferences::get_instance();
+		pPref->m_voiceStealing = Preferences::VoiceStealing::Oldest;
+		pPref->m_bStealSameInstrumentFirst = false;
+
+		auto pNote1 = playNote( std::make_shared<Instrument>( 1 ), 0.9 );
+		auto pNote2 = playNote( std::make_shared<Instrument>( 2 ), 0.1 );
+		auto pNote3 = playNote( std::make_shared<Instrument>( 3 ), 0.5 );
+		const int nStolen = m_pSampler->getStolenVoiceCount();
+
+		m_pSampler->stealVoices( 2 );
+		CPPUNIT_ASSERT( pNote1->get_stolen() );
+		CPPUNIT_ASSERT( ! pNote2->get_stolen() );
+		CPPUNIT_ASSERT( ! pNote3->get_stolen() );
+
+		m_pSampler->stealVoices( 1 );
+		CPPUNIT_ASSERT( pNote2->get_stolen() );
+		CPPUNIT_ASSERT( ! pNote3->get_stolen() );
+		CPPUNIT_ASSERT_EQUAL( nStolen + 2, m_pSampler->getStolenVoiceCount() );
+
+		// Stolen voices keep fading out and do not count anymore.
+		CPPUNIT_ASSERT_EQUAL( 3, m_pSampler->getPlayingNotesNumber() );
+		m_pSampler->stealVoices( 1 );
+		CPPUNIT_ASSERT( ! pNote3->get_stolen() );
+	}
+
+	void testStealQuietest()
+	{
+		auto pPref = Preferences::get_instance();
+		pPref->m_voiceStealing = Preferences::VoiceStealing::Quietest;
+		pPref->m_bStealSameInstrumentFirst = false;
+
+		auto pNote1 = playNote( std::make_shared<Instrument>( 1 ), 0.9 );
+		auto pNote2 = playNote( std::make_shared<Instrument>( 2 ), 0.1 );
+		auto pNote3 = playNote( std::make_shared<Instrument>( 3 ), 0.5 );
+
+		m_pSampler->stealVoices( 2 );
+		CPPUNIT_ASSERT( ! pNote1->get_stolen() );
+		CPPUNIT_ASSERT( pNote2->get_stolen() );
+		CPPUNIT_ASSERT( ! pNote3->get_stolen() );
+
+		m_pSampler->stealVoices( 1 );
+		CPPUNIT_ASSERT( ! pNote1->get_stolen() );
+		CPPUNIT_ASSERT( pNote3->get_stolen() );
+	}
+
+	void testStealReleasedFirst()
+	{
+		auto pPref = Preferences::get_instance();
+		pPref->m_voiceStealing = Preferences::VoiceStealing::Oldest;
+		pPref->m_bStealSameInstrumentFirst = true;
+
+		auto pInstr1 = std::make_shared<Instrument>( 1 );
+		auto pInstr2 = std::make_shared<Instrument>( 2 );
+		auto pInstr3 = std::make_shared<Instrument>( 3 );
+		pInstr2->set_mute_group( 1 );
+		pInstr3->set_mute_group( 1 );
+		auto pInstr4 = std::make_shared<Instrument>( 4 );
+
+		auto pNote1 = playNote( pInstr1, 0.9 );
+		// Released by the next note of the same mute group.
+		auto pNote2 = playNote( pInstr2, 0.9 );
+		auto pNote3 = playNote( pInstr3, 0.9 );
+		auto pNote4 = playNote( pInstr4, 0.9 );
+		// Released by a note off.
+		m_pSampler->noteOff( new Note( pInstr4, 0, 0.9, 0.f, -1, 0 ) );
+
+		m_pSampler->stealVoices( 2 );
+		CPPUNIT_ASSERT( ! pNote1->get_stolen() );
+		CPPUNIT_ASSERT( pNote2->get_stolen() );
+		CPPUNIT_ASSERT( ! pNote3->get_stolen() );
+		CPPUNIT_ASSERT( pNote4->get_stolen() );
+
+		m_pSampler->stealVoices( 1 );
+		CPPUNIT_ASSERT( pNote1->get_stolen() );
+		CPPUNIT_ASSERT( ! pNote3->get_stolen() );
+	}
+
+	void testStealSameInstrumentFirst()
+	{
+		auto pPref = Preferences::get_instance();
+		pPref->m_voiceStealing = Preferences::VoiceStealing::Quietest;
+		pPref->m_bStealSameInstrumentFirst = true;
+
+		auto pInstr1 = std::make_shared<Instrument>( 1 );
+		auto pInstr2 = std::make_shared<Instrument>( 2 );
+		auto pInstr3 = std::make_shared<Instrument>( 3 );
+
+		auto pNote1 = playNote( pInstr1, 0.1 );
+		auto pNote2 = playNote( pInstr2, 0.9 );
+		auto pNote3 = playNote( pInstr2, 0.8 );
+		auto pNote4 = playNote( pInstr2, 1.0 );
+		playNote( pInstr3, 0.5 );
+
+		// Voices superseded by a more recent one of the same
+		// instrument go first, even if others are quieter.
+		m_pSampler->stealVoices( 4 );
+		CPPUNIT_ASSERT( ! pNote1->get_stolen() );
+		CPPUNIT_ASSERT( ! pNote2->get_stolen() );
+		CPPUNIT_ASSERT( pNote3->get_stolen() );
+		CPPUNIT_ASSERT( ! pNote4->get_stolen() );
+
+		// Same when picking the oldest voice. Once the superseded
+		// voice is gone, all others are in the same tier again.
+		pPref->m_voiceStealing = Preferences::VoiceStealing::Oldest;
+		m_pSampler->stopPlayingNotes();
+		pNote1 = playNote( pInstr1, 0.9 );
+		pNote2 = playNote( pInstr2, 0.9 );
+		pNote3 = playNote( pInstr2, 0.9 );
+		pNote4 = playNote( pInstr3, 0.9 );
+
+		m_pSampler->stealVoices( 3 );
+		CPPUNIT_ASSERT( ! pNote1->get_stolen() );
+		CPPUNIT_ASSERT( pNote2->get_stolen() );
+
+		m_pSampler->stealVoices( 2 );
+		CPPUNIT_ASSERT( pNote1->get_stolen() );
+		CPPUNIT_ASSERT( ! pNote3->get_stolen() );
+		CPPUNIT_ASSERT( ! pNote4->get_stolen() );
+
+		// Without preferring the same instrument, the oldest voice
+		// is stolen regardless of its instrument.
+		pPref->m_bStealSameInstrumentFirst = false;
+		m_pSampler->stopPlayingNotes();
+		pNote1 = playNote( pInstr1, 0.9 );
+		pNote2 = playNote( pInstr2, 0.9 );
+		pNote3 = playNote( pInstr2, 0.9 );
+
+		m_pSampler->stealVoices( 2 );
+		CPPUNIT_ASSERT( pNote1->get_stolen() );
+		CPPUNIT_ASSERT( ! pNote2->get_stolen() );
+	}
+
+	void testVoiceCapacity()
+	{
+		auto pPref = Preferences::get_instance();
+		pPref->m_voiceStealing = Preferences::VoiceStealing::Oldest;
+		pPref->m_bStealSameInstrumentFirst = false;
+
+		auto isPlaying = [&]( Note* pNote ) {
+			const auto queue = m_pSampler->getPlayingNotesQueue();
+			return std::find( queue.begin(), queue.end(), pNote ) != queue.end();
+		};
+
+		// Room for four voices.
+		m_pSampler->setMaxNotes( 2 );
+		playNote( std::make_shared<Instrument>( 1 ), 0.9 );
+		auto pNote2 = playNote( std::make_shared<Instrument>( 2 ), 0.9 );
+		auto pNote3 = playNote( std::make_shared<Instrument>( 3 ), 0.9 );
+		auto pNote4 = playNote( std::make_shared<Instrument>( 4 ), 0.9 );
+		CPPUNIT_ASSERT_EQUAL( 4, m_pSampler->getPlayingNotesNumber() );
+
+		// The oldest voice is dropped to make room.
+		auto pNote5 = playNote( std::make_shared<Instrument>( 5 ), 0.9 );
+		CPPUNIT_ASSERT_EQUAL( 4, m_pSampler->getPlayingNotesNumber() );
+		CPPUNIT_ASSERT( isPlaying( pNote2 ) );
+		CPPUNIT_ASSERT( isPlaying( pNote5 ) );
+
+		// Voices fading out already go first.
+		m_pSampler->stealVoices( 3 );
+		CPPUNIT_ASSERT( pNote2->get_stolen() );
+		auto pNote6 = playNote( std::make_shared<Instrument>( 6 ), 0.9 );
+		CPPUNIT_ASSERT_EQUAL( 4, m_pSampler->getPlayingNotesNumber() );
+		CPPUNIT_ASSERT( ! isPlaying( pNote2 ) );
+		CPPUNIT_ASSERT( isPlaying( pNote3 ) );
+		CPPUNIT_ASSERT( isPlaying( pNote4 ) );
+		CPPUNIT_ASSERT( isPlaying( pNote6 ) );
+
+		// Shrinking the capacity drops surplus voices.
+		m_pSampler->setMaxNotes( 1 );
+		CPPUNIT_ASSERT_EQUAL( 2, m_pSampler->getPlayingNotesNumber() );
+		CPPUNIT_ASSERT( isPlaying( pNote6 ) );
+	}
+
+	void testTailRetired()
+	{
+		auto pPref = Preferences::get_instance();
+		pPref->m_fVoiceTailThreshold = -40.0;
+		const float fThreshold = std::pow( 10.0f, -40.0f / 20.0f );
+		auto pSong = Song::getEmptySong();
+
+		auto pNote = playNote( createRingingInstrument( 0.995 ), 1.0 );
+
+		// The sample is over after the first block. The voice is kept
+		// by the ringing filter only.
+		m_pSampler->process( 512, pSong );
+		CPPUNIT_ASSERT_EQUAL( 1, m_pSampler->getPlayingNotesNumber() );
+
+		int nBlocksBelowThreshold = 0;
+		bool bFilterSustain = true;
+		for ( int nBlock = 0; nBlock < 50 &&
+				  m_pSampler->getPlayingNotesNumber() > 0; ++nBlock ) {
+			if ( filterLevel( pNote ) < fThreshold ) {
+				++nBlocksBelowThreshold;
+			}
+			bFilterSustain = pNote->filter_sustain();
+			m_pSampler->process( 512, pSong );
+		}
+
+		CPPUNIT_ASSERT_EQUAL( 0, m_pSampler->getPlayingNotesNumber() );
+		// Once the filter decayed below the threshold, the voice is
+		// retired within the next block, ...
+		CPPUNIT_ASSERT( nBlocksBelowThreshold <= 1 );
+		// ... before the filter would have stopped sustaining the
+		// note on its own.
+		CPPUNIT_ASSERT( bFilterSustain );
+	}
+
+	void testTailAboveThreshold()
+	{
+		auto pPref = Preferences::get_instance();
+		auto pSong = Song::getEmptySong();
+
+		// Without damping the filter keeps ringing at the level
+		// reached after the sample is over.
+		auto pNote = playNote( createRingingInstrument( 1.0 ), 1.0 );
+		float fLevel = 0;
+		for ( int nBlock = 0; nBlock < 4; ++nBlock ) {
+			m_pSampler->process( 512, pSong );
+			CPPUNIT_ASSERT_EQUAL( 1, m_pSampler->getPlayingNotesNumber() );
+			if ( nBlock > 0 ) {
+				fLevel = std::max( fLevel, filterLevel( pNote ) );
+			}
+		}
+		CPPUNIT_ASSERT( fLevel > 0 );
+
+		// A note just above the threshold must not be cut off.
+		pPref->m_fVoiceTailThreshold = 20 * std::log10( fLevel ) - 1.0;
+		for ( int nBlock = 0; nBlock < 20; ++nBlock ) {
+			m_pSampler->process( 512, pSong );
+			CPPUNIT_ASSERT_EQUAL( 1, m_pSampler->getPlayingNotesNumber() );
+		}
+	}
+
+	void testRenderThreads()
+	{
+		auto pPref = Preferences::get_instance();
+		auto pSampler = Hydrogen::get_instance()->getAudioEngine()->getSampler();
+
+		// Rendering on multiple threads must not alter the output,
+		// not even by a rounding error.
+		const auto serial = exportSong( 1 );
+		CPPUNIT_ASSERT( ! serial.empty() );
+		for ( int nThreads : { 2, 4 } ) {
+			const auto parallel = exportSong( nThreads );
+			CPPUNIT_ASSERT_EQUAL( serial.size(), parallel.size() );
+			for ( size_t ii = 0; ii < serial.size(); ++ii ) {
+				if ( serial[ ii ] != parallel[ ii ] ) {
+					CPPUNIT_FAIL( QString( "Sample [%1] differs using [%2] threads" )
+								  .arg( ii ).arg( nThreads ).toStdString() );
+				}
+			}
+		}
+
+		Hydrogen::get_instance()->getAudioEngine()->lock( RIGHT_HERE );
+		pSampler->setRenderThreads( pPref->m_nRenderThreads );
+		Hydrogen::get_instance()->getAudioEngine()->unlock();
+	}
+};
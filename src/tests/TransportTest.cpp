@@ -22,10 +22,15 @@
 
 #include <core/CoreActionController.h>
 #include <core/AudioEngine/AudioEngine.h>
+#include <core/AudioEngine/NoteQueue.h>
 #include <core/Hydrogen.h>
 #include <core/Preferences/Preferences.h>
 #include <core/Helpers/Filesystem.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/PatternList.h>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include "TransportTest.h"
@@ -168,3 +173,215 @@ void TransportTest::testNoteEnqueuing() {
 		CPPUNIT_ASSERT( bNoMismatch );
 	}
 }		
+
+void TransportTest::testColumnLookup() {
+	auto pHydrogen = Hydrogen::get_instance();
+	auto pCoreActionController = pHydrogen->getCoreActionController();
+
+	pCoreActionController->openSong( m_pSongDemo );
+	auto pSong = pHydrogen->getSong();
+	auto pColumns = pSong->getPatternGroupVector();
+
+	// Compare the cached column start ticks with the lengths of
+	// the columns.
+	auto checkColumns = [&]() {
+		const int nColumns = pColumns->size();
+		long nStartTick = 0;
+		long nPatternStartTick;
+		for ( int ii = 0; ii < nColumns; ++ii ) {
+			PatternList* pColumn = ( *pColumns )[ ii ];
+			const long nLength = pColumn->size() != 0 ?
+				pColumn->longest_pattern_length() : MAX_NOTES;
+
+			CPPUNIT_ASSERT_EQUAL( nStartTick, pHydrogen->getTickForColumn( ii ) );
+			for ( const long nTick : { nStartTick, nStartTick + nLength / 2,
+									   nStartTick + nLength - 1 } ) {
+				CPPUNIT_ASSERT_EQUAL( ii, pHydrogen->getColumnForTick(
+										  nTick, false, &nPatternStartTick ) );
+				CPPUNIT_ASSERT_EQUAL( nStartTick, nPatternStartTick );
+			}
+			nStartTick += nLength;
+		}
+		CPPUNIT_ASSERT_EQUAL( nStartTick, pSong->lengthInTicks() );
+
+		// Beyond the end of the song
+		CPPUNIT_ASSERT_EQUAL( -1, pHydrogen->getColumnForTick(
+								  nStartTick, false, &nPatternStartTick ) );
+		CPPUNIT_ASSERT_EQUAL( 0, pHydrogen->getColumnForTick(
+								  nStartTick, true, &nPatternStartTick ) );
+		CPPUNIT_ASSERT_EQUAL( 0L, nPatternStartTick );
+		CPPUNIT_ASSERT_EQUAL( nColumns - 1, pHydrogen->getColumnForTick(
+								  2 * nStartTick - 1, true, &nPatternStartTick ) );
+		CPPUNIT_ASSERT_EQUAL( -1, pHydrogen->getColumnForTick(
+								  -1, true, &nPatternStartTick ) );
+	};
+
+	pHydrogen->getAudioEngine()->lock( RIGHT_HERE );
+	checkColumns();
+	pHydrogen->getAudioEngine()->unlock();
+
+	// Appending a column and removing it again.
+	const int nColumns = pColumns->size();
+	pCoreActionController->toggleGridCell( nColumns, 0 );
+	CPPUNIT_ASSERT_EQUAL( nColumns + 1, static_cast<int>( pColumns->size() ) );
+	pHydrogen->getAudioEngine()->lock( RIGHT_HERE );
+	checkColumns();
+	pHydrogen->getAudioEngine()->unlock();
+
+	pCoreActionController->toggleGridCell( nColumns, 0 );
+	pHydrogen->getAudioEngine()->lock( RIGHT_HERE );
+	checkColumns();
+
+	// The lookups are read-only and do not rebuild an outdated
+	// cache themselves.
+	pColumns->push_back( new PatternList() );
+	CPPUNIT_ASSERT_EQUAL( -1L, pSong->getColumnStartTick( 0 ) );
+	delete pColumns->back();
+	pColumns->pop_back();
+	CPPUNIT_ASSERT_EQUAL( 0L, pSong->getColumnStartTick( 0 ) );
+	pHydrogen->getAudioEngine()->unlock();
+}
+
+void TransportTest::testTempoMap() {
+	auto pHydrogen = Hydrogen::get_instance();
+	auto pAudioEngine = pHydrogen->getAudioEngine();
+	auto pCoreActionController = pHydrogen->getCoreActionController();
+
+	pCoreActionController->openSong( m_pSongDemo );
+	pCoreActionController->activateSongMode( true );
+	pCoreActionController->activateTimeline( true );
+	pCoreActionController->addTempoMarker( 0, 120 );
+	pCoreActionController->addTempoMarker( 3, 100 );
+	pCoreActionController->addTempoMarker( 5, 40 );
+
+	auto pSong = pHydrogen->getSong();
+	const double fSampleRate =
+		static_cast<double>( pHydrogen->getAudioOutput()->getSampleRate() );
+	const double fResolution = static_cast<double>( pSong->getResolution() );
+	auto tickSize = [&]( double fBpm ) {
+		return fSampleRate * 60.0 / fBpm / fResolution;
+	};
+
+	const double fTick3 = static_cast<double>( pHydrogen->getTickForColumn( 3 ) );
+	const double fTick5 = static_cast<double>( pHydrogen->getTickForColumn( 5 ) );
+	const double fSongSize = static_cast<double>( pSong->lengthInTicks() );
+	double fTickMismatch;
+
+	pAudioEngine->lock( RIGHT_HERE );
+
+	// Frames accumulated across the tempo segments.
+	const double fFrames5 = fTick3 * tickSize( 120 ) +
+		( fTick5 - fTick3 ) * tickSize( 100 );
+	CPPUNIT_ASSERT_EQUAL( static_cast<long long>( std::round( fFrames5 ) ),
+						  pAudioEngine->computeFrameFromTick( fTick5, &fTickMismatch ) );
+	CPPUNIT_ASSERT( std::abs( pAudioEngine->computeTickFromFrame(
+								  static_cast<long long>( fFrames5 + 10 ) ) -
+							  ( fTick5 + ( std::floor( fFrames5 ) + 10 - fFrames5 ) /
+								tickSize( 40 ) ) ) < 1e-6 );
+
+	// Round trips within the song and across repetitions.
+	for ( const double fTick : { 1.5, fTick3 - 0.3, fTick3, fTick5 + 17.25,
+								 fSongSize, 2 * fSongSize, 3 * fSongSize + 42.5 } ) {
+		const long long nFrame =
+			pAudioEngine->computeFrameFromTick( fTick, &fTickMismatch );
+		CPPUNIT_ASSERT( std::abs( pAudioEngine->computeTickFromFrame( nFrame ) +
+								  fTickMismatch - fTick ) < 1e-6 );
+	}
+
+	// Positions at the very end of a repetition.
+	const long long nSongSizeInFrames =
+		pAudioEngine->computeFrameFromTick( fSongSize, &fTickMismatch );
+	CPPUNIT_ASSERT( std::abs( pAudioEngine->computeFrameFromTick( 2 * fSongSize, &fTickMismatch ) -
+							  2 * nSongSizeInFrames ) <= 1 );
+
+	pAudioEngine->unlock();
+
+	// Changes in the Timeline have to be picked up right away.
+	pCoreActionController->addTempoMarker( 3, 60 );
+	pAudioEngine->lock( RIGHT_HERE );
+	CPPUNIT_ASSERT_EQUAL( static_cast<long long>(
+							  std::round( fTick3 * tickSize( 120 ) +
+										  ( fTick5 - fTick3 ) * tickSize( 60 ) ) ),
+						  pAudioEngine->computeFrameFromTick( fTick5, &fTickMismatch ) );
+	pAudioEngine->unlock();
+
+	pCoreActionController->deleteTempoMarker( 3 );
+	pCoreActionController->deleteTempoMarker( 5 );
+	pCoreActionController->activateTimeline( false );
+}
+
+void TransportTest::testNoteQueue() {
+	auto pHydrogen = Hydrogen::get_instance();
+
+	pHydrogen->getCoreActionController()->openSong( m_pSongDemo );
+	auto pInstrument = pHydrogen->getSong()->getInstrumentList()->get( 0 );
+
+	// A small ring to have notes in the overflow as well.
+	NoteQueue queue( 4, 16 );
+	std::vector<Note*> notes;
+
+	for ( const int nPosition : { 48, 3, 4000, 48, 1, 192, 100000, 7, 3, 5, 61 } ) {
+		Note* pNote = new Note( pInstrument, nPosition, 1.0, 0.f, -1, 0 );
+		notes.push_back( pNote );
+		queue.push( pNote );
+	}
+	CPPUNIT_ASSERT_EQUAL( static_cast<int>( notes.size() ), queue.size() );
+	const auto allNotes = notes;
+
+	// Notes sharing a position have to retain the order they were
+	// pushed in.
+	std::vector<Note*> sortedNotes;
+	auto checkOrder = [&]() {
+		sortedNotes = notes;
+		std::stable_sort( sortedNotes.begin(), sortedNotes.end(),
+						  []( Note* pNote1, Note* pNote2 ) {
+							  return pNote1->get_position() < pNote2->get_position();
+						  } );
+		std::vector<Note*> queuedNotes;
+		queue.forEach( [&]( Note* pNote ) {
+			queuedNotes.push_back( pNote );
+		} );
+		CPPUNIT_ASSERT( queuedNotes == sortedNotes );
+	};
+	checkOrder();
+
+	queue.setBucketSize( 100 );
+	checkOrder();
+	queue.setBucketSize( 16 );
+	checkOrder();
+
+	// Only notes positioned before the provided end are
+	// considered. They have to be extracted in order.
+	auto isOdd = []( Note* pNote ) {
+		return pNote->get_position() % 2 != 0;
+	};
+	std::vector<Note*> expectedNotes, extractedNotes;
+	for ( auto pNote : sortedNotes ) {
+		if ( pNote->get_position() < 61 && isOdd( pNote ) ) {
+			expectedNotes.push_back( pNote );
+		}
+	}
+	queue.extract( 61, isOdd, extractedNotes );
+	CPPUNIT_ASSERT( extractedNotes == expectedNotes );
+	for ( auto pNote : extractedNotes ) {
+		notes.erase( std::find( notes.begin(), notes.end(), pNote ) );
+	}
+	CPPUNIT_ASSERT_EQUAL( static_cast<int>( notes.size() ), queue.size() );
+	checkOrder();
+
+	queue.update( []( Note* pNote ) {
+		pNote->set_position( pNote->get_position() * 2 );
+	} );
+	checkOrder();
+
+	for ( const auto& pNote : sortedNotes ) {
+		CPPUNIT_ASSERT( queue.top() == pNote );
+		queue.pop();
+	}
+	CPPUNIT_ASSERT( queue.empty() );
+	CPPUNIT_ASSERT( queue.top() == nullptr );
+
+	for ( auto pNote : allNotes ) {
+		delete pNote;
+	}
+}
@@ -0,0 +1,193 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/config.h>
+#include <core/Helpers/VectorMath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace H2Core;
+
+/** Checks all VectorMath backends supported by the current CPU to
+ * yield results bit-identical to the generic one (or within a rounding
+ * error in case the compiler was allowed to fuse operations). */
+class VectorMathTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( VectorMathTest );
+	CPPUNIT_TEST( testBackends );
+	CPPUNIT_TEST( testAbsPeak );
+	CPPUNIT_TEST( testResonantLowPass );
+	CPPUNIT_TEST( testFlushToZero );
+	CPPUNIT_TEST_SUITE_END();
+
+	/** Compares the output of a backend with the generic one. */
+	void checkEqual( const std::vector<float>& reference,
+					 const std::vector<float>& values )
+	{
+		CPPUNIT_ASSERT_EQUAL( reference.size(), values.size() );
+		for ( size_t ii = 0; ii < values.size(); ++ii ) {
+			checkEqual( reference[ ii ], values[ ii ] );
+		}
+	}
+	void checkEqual( float fReference, float fValue )
+	{
+#ifdef H2CORE_HAVE_STRICT_VECTOR_MATH
+		CPPUNIT_ASSERT_EQUAL( fReference, fValue );
+#else
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( fReference, fValue,
+									  1e-5 * std::max( 1.0f, std::abs( fReference ) ) );
+#endif
+	}
+
+	void testBackends()
+	{
+		const auto previousBackend = VectorMath::getBackend();
+		std::mt19937 randomEngine( 1234 );
+		std::uniform_real_distribution<float> dist( -1.0, 1.0 );
+
+		// Odd sizes make sure the scalar tails of the kernels are
+		// covered too.
+		for ( int nFrames : { 0, 1, 3, 7, 16, 33, 255, 1024 } ) {
+			std::vector<float> src( nFrames ), dst( nFrames );
+			for ( int ii = 0; ii < nFrames; ++ii ) {
+				src[ ii ] = dist( randomEngine );
+				dst[ ii ] = dist( randomEngine );
+			}
+			const float fGain = 0.73;
+
+			std::vector<float> referenceAdd, referenceAddScaled,
+				referenceMultiply;
+			float fReferencePeak, fReferencePeakScaled;
+
+			for ( auto backend : { VectorMath::Backend::Generic,
+								   VectorMath::Backend::SSE2,
+								   VectorMath::Backend::AVX2,
+								   VectorMath::Backend::NEON } ) {
+				if ( ! VectorMath::setBackend( backend ) ) {
+					continue;
+				}
+
+				std::vector<float> add( dst ), addScaled( dst ),
+					cleared( dst );
+				VectorMath::add( add.data(), src.data(), nFrames );
+				VectorMath::addScaled( addScaled.data(), src.data(), fGain,
+									   nFrames );
+				VectorMath::clear( cleared.data(), nFrames );
+				std::vector<float> multiply( dst );
+				VectorMath::multiply( multiply.data(), src.data(), nFrames );
+				float fPeak = VectorMath::peak( src.data(), nFrames, -2.0 );
+				float fPeakScaled = VectorMath::peakScaled( src.data(), fGain,
+															nFrames, 0.0 );
+
+				for ( const auto& fValue : cleared ) {
+					CPPUNIT_ASSERT_EQUAL( 0.0f, fValue );
+				}
+
+				if ( backend == VectorMath::Backend::Generic ) {
+					referenceAdd = add;
+					referenceAddScaled = addScaled;
+					referenceMultiply = multiply;
+					fReferencePeak = fPeak;
+					fReferencePeakScaled = fPeakScaled;
+					continue;
+				}
+
+				checkEqual( referenceAdd, add );
+				checkEqual( referenceAddScaled, addScaled );
+				checkEqual( referenceMultiply, multiply );
+				checkEqual( fReferencePeak, fPeak );
+				checkEqual( fReferencePeakScaled, fPeakScaled );
+			}
+		}
+
+		VectorMath::setBackend( previousBackend );
+	}
+
+	void testAbsPeak()
+	{
+		const float data[] = { 0.1, -0.7, 0.5, -0.2, 0.3 };
+		CPPUNIT_ASSERT_EQUAL( 0.7f, VectorMath::absPeak( data, 5, 0.0 ) );
+		CPPUNIT_ASSERT_EQUAL( 0.9f, VectorMath::absPeak( data, 5, 0.9 ) );
+		CPPUNIT_ASSERT_EQUAL( 0.1f, VectorMath::absPeak( data, 1, 0.0 ) );
+		CPPUNIT_ASSERT_EQUAL( 0.0f, VectorMath::absPeak( data, 0, 0.0 ) );
+	}
+
+	void testResonantLowPass()
+	{
+		std::mt19937 randomEngine( 1234 );
+		std::uniform_real_distribution<float> dist( -1.0, 1.0 );
+		const int nFrames = 257;
+		std::vector<float> src_L( nFrames ), src_R( nFrames );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			src_L[ ii ] = dist( randomEngine );
+			src_R[ ii ] = dist( randomEngine );
+		}
+
+		// Filtering a whole block at once is the same as filtering it
+		// in two pieces, both out of and in place.
+		std::vector<float> whole_L( nFrames ), whole_R( nFrames );
+		float wholeState[ 4 ] = { 0.1, -0.1, 0.2, 0.0 };
+		VectorMath::resonantLowPass( src_L.data(), src_R.data(),
+									 whole_L.data(), whole_R.data(),
+									 nFrames, 0.3, 0, 0.8, 0, wholeState );
+
+		std::vector<float> split_L( src_L ), split_R( src_R );
+		float splitState[ 4 ] = { 0.1, -0.1, 0.2, 0.0 };
+		VectorMath::resonantLowPass( split_L.data(), split_R.data(),
+									 split_L.data(), split_R.data(),
+									 100, 0.3, 0, 0.8, 0, splitState );
+		VectorMath::resonantLowPass( split_L.data() + 100, split_R.data() + 100,
+									 split_L.data() + 100, split_R.data() + 100,
+									 nFrames - 100, 0.3, 0, 0.8, 0, splitState );
+
+		CPPUNIT_ASSERT( whole_L == split_L );
+		CPPUNIT_ASSERT( whole_R == split_R );
+		for ( int ii = 0; ii < 4; ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( wholeState[ ii ], splitState[ ii ] );
+		}
+		// The channels are filtered independently.
+		CPPUNIT_ASSERT( whole_L != whole_R );
+	}
+
+	void testFlushToZero()
+	{
+		// The mode is set per thread. Use a separate one to not
+		// affect the remaining tests.
+		bool bSupported = false;
+		volatile float fDenormal = std::numeric_limits<float>::min() / 4;
+		float fResult = 0;
+		std::thread thread( [&]() {
+			bSupported = VectorMath::enableFlushToZero();
+			fResult = fDenormal * 1.5f;
+		} );
+		thread.join();
+
+		if ( bSupported ) {
+			CPPUNIT_ASSERT_EQUAL( 0.0f, fResult );
+		}
+	}
+};
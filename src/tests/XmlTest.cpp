@@ -97,7 +97,7 @@ void XmlTest::testDrumkit()
 					.size() == 0 );
 	
 	// manually load samples
-	pDrumkitLoaded->load_samples();
+	CPPUNIT_ASSERT( pDrumkitLoaded->load_samples() );
 	CPPUNIT_ASSERT( pDrumkitLoaded->samples_loaded()==true );
 	CPPUNIT_ASSERT( check_samples_data( pDrumkitLoaded, true ) );
 	
@@ -30,6 +30,7 @@
 #include <core/config.h>
 
 #include <QCoreApplication>
+#include <QTemporaryDir>
 
 #include "registeredTests.h"
 #include "TestHelper.h"
@@ -110,6 +111,13 @@ int main( int argc, char **argv)
 		}
 	}
 
+	// Do not write into the sample cache of the user running the
+	// tests. The directory is removed once the tests are done.
+	QTemporaryDir sampleCacheDir;
+	if ( sampleCacheDir.isValid() ) {
+		H2Core::Filesystem::setSampleCacheOverwritePath( sampleCacheDir.path() + "/" );
+	}
+
 	setupEnvironment(logLevelOpt);
 
 #ifdef HAVE_EXECINFO_H
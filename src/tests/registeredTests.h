@@ -35,9 +35,11 @@
 #include "OscServerTest.h"
 #include "PatternTest.h"
 #include "SampleTest.cpp"
+#include "SamplerTest.cpp"
 #include "TimeTest.h"
 #include "Translations.cpp"
 #include "TransportTest.h"
+#include "VectorMathTest.cpp"
 #include "XmlTest.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION( ADSRTest );
@@ -55,7 +57,9 @@ CPPUNIT_TEST_SUITE_REGISTRATION( OscServerTest );
 #endif
 CPPUNIT_TEST_SUITE_REGISTRATION( PatternTest );
 CPPUNIT_TEST_SUITE_REGISTRATION( SampleTest );
+CPPUNIT_TEST_SUITE_REGISTRATION( SamplerTest );
 CPPUNIT_TEST_SUITE_REGISTRATION( TimeTest );
 CPPUNIT_TEST_SUITE_REGISTRATION( TransportTest );
 CPPUNIT_TEST_SUITE_REGISTRATION( UITranslationTest );
+CPPUNIT_TEST_SUITE_REGISTRATION( VectorMathTest );
 CPPUNIT_TEST_SUITE_REGISTRATION( XmlTest );